@@ -4,6 +4,17 @@
 /*(compute the phases of the 1st and 2nd Fourier coefficients)                             */
 /* Author: S. Couvidat (based on a code by J. Schou)                                       */
 /* Version 1.9 August 24, 2010                                                             */
+/* Version 2.0: optional inverse look-up tables to locate the interval of the look-up      */
+/*              tables that brackets the velocities, instead of scanning them              */
+/* Version 2.1: loop over the span of each row inside the crop circle instead of testing   */
+/*              the distance of every pixel                                                */
+/* Version 2.2: the Fourier coefficients are computed for blocks of NPIXBLOCK adjacent     */
+/*              pixels at once, in vectorized loops                                        */
+/* Version 2.3: the Fourier coefficients are computed by a kernel specialized for the      */
+/*              number of wavelengths (mdikernel.c)                                        */
+/* Version 2.4: only the observables selected by the bitmask Observables (observables.h)   */
+/*              are computed; the arrays of the other observables may be NULL              */
+/* Version 2.5: optional timing of the Fourier, look-up, and inversion stages (StageTimes) */
 /*                                                                                         */
 /* uses a MDI-like algorithm with 5 or 6 tuning positions                                  */
 /* averages the velocities returned by 1st and 2nd Fourier                                 */
@@ -24,6 +35,9 @@
 #include <complex.h>
 #include <jsoc_main.h>
 #include <omp.h>                      //OpenMP header
+#include "inverselookup.h"            //inverse look-up tables
+#include "mdikernel.h"                //Fourier coefficients of the MDI-like algorithm, specialized for N=5, 6, 8, and 10
+#include "observables.h"              //bitmask selecting the level 1.5 observables
 
 #undef I                              //I is the complex number (0,1). We un-define it to avoid confusion
 
@@ -54,10 +68,18 @@ struct parameterDoppler {             //structure to provide some parameters def
 
 /*-----------------------------------------------------------------------------------------*/
 /* MDI-like algorithm                                                                      */
+/* Inversetable contains the inverse look-up tables produced by InverseLookup(), at the    */
+/* same nodes as Lookuptable. If it is NULL, the look-up tables are scanned at each pixel  */
+/* The velocities and SATVALS are the same with or without Inversetable                    */
+/* Observables selects the arrLev15 to compute (LEV15_ALL for all of them): the arrays of  */
+/* the observables not selected are not accessed and may be NULL                           */
+/* If StageTimes is not NULL, it returns the times spent computing the Fourier             */
+/* coefficients, interpolating the look-up tables and locating the brackets, and inverting */
+/* the velocities and computing the observables, summed over the threads (in seconds)      */
 /*-----------------------------------------------------------------------------------------*/
 
 
-int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSize,DRMS_Array_t *Lookuptable,float Rsun,float X0,float Y0,struct parameterDoppler DopplerParameters,int MISSVALS[5],int *SATVALS,float cdelt1,TIME TargetTime)
+int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSize,DRMS_Array_t *Lookuptable,DRMS_Array_t *Inversetable,float Rsun,float X0,float Y0,struct parameterDoppler DopplerParameters,int MISSVALS[5],int *SATVALS,float cdelt1,TIME TargetTime,int Observables,double StageTimes[3])
 {
 
   double FSR[7];
@@ -119,20 +141,10 @@ int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSiz
     }
 
   int N=framelistSize/2;                                             //number of different wavelengths
-  double *cosi;
-  double *sini;
-  double *cos2i;
-  double *sin2i;
-  cosi = (double *)malloc(N*sizeof(double));  
-  sini = (double *)malloc(N*sizeof(double));  
-  cos2i= (double *)malloc(N*sizeof(double));  
-  sin2i= (double *)malloc(N*sizeof(double));  
-  if(cosi == NULL || sini == NULL || cos2i == NULL || sin2i == NULL)
-    {
-      printf("Error: memory could not be allocated in the Dopplergram() function\n");
-      exit(EXIT_FAILURE);
-    }
-  float L[N],R[N]; //NO MALLOCS BECAUSE THEY ARE WRITTEN INSIDE THE OMP LOOP, THE LEVEL 1P DATA ARE ASSUMED TO BE OF TYPE FLOAT
+  MDIKernel kernel=MDISelectKernel(N);                               //Fourier coefficients for N wavelengths, selected once per call
+  float  *lev1pdata[20];                                             //THE LEVEL 1P DATA ARE ASSUMED TO BE OF TYPE FLOAT
+  double block[MDI_NBLOCK][NPIXBLOCK];                               //Fourier coefficients, sums of the intensities, and phases of a block of adjacent pixels. NO MALLOCS BECAUSE THEY ARE WRITTEN INSIDE THE OMP LOOP
+  int    cblock,nblock,k;
  
 
   //check that all level 1p data have the same data type (IS THAT NECESSARY?)
@@ -143,12 +155,9 @@ int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSiz
 	{
 	  printf("Error in subroutine computing the Dopplergrams: data type of level 1p data is not FLOAT\n");
 	  error = 1;
-	  free(cosi);
-	  free(sini);
-	  free(cos2i);
-	  free(sin2i);
 	  return error;
 	}
+      lev1pdata[i] = arrLev1p[i]->data;
     }
   
   //with C convention Array[row][column], axis[0] is the number of columns 
@@ -162,10 +171,6 @@ int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSiz
 	{
 	  printf("Error in subroutine computing the Dopplergrams: dimensions of level 1p data are not %d x %d \n",nRows,nColumns);
 	  error = 2;
-	  free(cosi);
-	  free(sini);
-	  free(cos2i);
-	  free(sin2i);
 	  return error;
 	}
     }
@@ -174,38 +179,37 @@ int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSiz
   //THE LEVEL 1.5 DATA ARE ASSUMED TO BE OF TYPE FLOAT
   double correction=0.0;
   double a0,a1,a2,a3,a4;
-  float *lam0g  = arrLev15[0]->data ;                                 //Dopplergram
-  float *B0g    = arrLev15[1]->data;                                  //magnetogram
-  float *Idg    = arrLev15[2]->data;                                  //linedepth
-  float *widthg = arrLev15[3]->data;                                  //linewidth
-  float *I0g    = arrLev15[4]->data;                                  //continuum
-  float *rawlam0g = arrLev15[5]->data ;                               //raw (uncorrected) Dopplergram
-
-  memset(lam0g,  0.0, drms_array_size(arrLev15[0]));                  //fill the observable arrays with 0
-  memset(B0g  ,  0.0, drms_array_size(arrLev15[1]));
-  memset(Idg  ,  0.0, drms_array_size(arrLev15[2]));
-  memset(widthg, 0.0, drms_array_size(arrLev15[3]));
-  memset(I0g   , 0.0, drms_array_size(arrLev15[4]));
-  memset(rawlam0g,0.0, drms_array_size(arrLev15[5]));                  //fill the observable arrays with 0
+  //the pointers of the observables that are not selected are NULL
+  float *lam0g  = (Observables & LEV15_DOPPLERGRAM) ? arrLev15[0]->data : NULL; //Dopplergram
+  float *B0g    = (Observables & LEV15_MAGNETOGRAM) ? arrLev15[1]->data : NULL; //magnetogram
+  float *Idg    = (Observables & LEV15_LINEDEPTH)   ? arrLev15[2]->data : NULL; //linedepth
+  float *widthg = (Observables & LEV15_LINEWIDTH)   ? arrLev15[3]->data : NULL; //linewidth
+  float *I0g    = (Observables & LEV15_CONTINUUM)   ? arrLev15[4]->data : NULL; //continuum
+  float *rawlam0g = (Observables & LEV15_DOPPLERGRAM) ? arrLev15[5]->data : NULL; //raw (uncorrected) Dopplergram
+  float *outg[6]={lam0g,B0g,Idg,widthg,I0g,rawlam0g};                //same order as arrLev15
+  int   velocities=(lam0g != NULL || B0g != NULL || I0g != NULL);   //the inversion of the look-up tables is only needed for these observables
+
+  if(Observables & ~LEV15_ALL || !(Observables & LEV15_ALL))
+    {
+      printf("Error in subroutine computing the Dopplergrams: invalid selection of observables %d\n",Observables);
+      error=5;
+      return error;
+    }
+
+  //NB: the observable arrays are not filled with 0 first, because the loop over the rows writes every pixel exactly once
   
   //variables for the MDI-like algorithm
   double FSRNB   = FSR[0];                       //FSR Narrow-Band Michelson, in Angstroms (WILL CHANGE ONCE THE VALUE IS ACCURATELY MEASURED)
   double dtune   = FSRNB/2.5;                    //wavelength separation between each tuning position, nominally 68.8 mA  (SHOULD BE THE SAME FOR 5 OR 6 WAVELENGTHS)
   double dv      = 1.0/dlamdv;                   //conversion factor from wavelength to velocity
   double dvtune  = dtune*dv;
-  double *tune   = NULL, *angle=NULL;
+  double *tune   = NULL;
   tune=(double *)malloc(N*sizeof(double));
   if(tune == NULL)
     {
       printf("Error: unable to allocate memory to tune\n");
       exit(EXIT_FAILURE);
     }
-  angle=(double *)malloc(N*sizeof(double));
-  if(angle == NULL)
-    {
-      printf("Error: unable to allocate memory to angle\n");
-      exit(EXIT_FAILURE);
-    }
 
 
   if(N == 6)
@@ -217,7 +221,6 @@ int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSiz
       tune[3]=-0.5;//I3
       tune[4]=-1.5;//I4
       tune[5]=-2.5;//I5
-      for(i=0;i<N;++i) angle[i]=tune[i];
     }
   if(N == 5)
     {
@@ -227,7 +230,6 @@ int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSiz
       tune[2]= 0.0;
       tune[3]=-1.0;
       tune[4]=-2.0;
-      for(i=0;i<N;++i) angle[i]=tune[i];
     }
   if(N == 8)
     {
@@ -240,7 +242,6 @@ int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSiz
       tune[4]=-1.5;//I4
       tune[5]=-2.5;//I5
       tune[6]=-3.5;//I6
-      for(i=0;i<N;++i) angle[i]=tune[i];
     }
   if(N == 10)
     {
@@ -255,7 +256,6 @@ int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSiz
       tune[5]=-2.5;//I5
       tune[6]=-3.5;//I6
       tune[8]=-4.5;//I8
-      for(i=0;i<N;++i) angle[i]=tune[i];
     }
 
   double period = (double)(N-1)*dtune;
@@ -268,15 +268,7 @@ int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSiz
   pv1 = dvtune*(double)(N-1);
   pv2 = pv1/2.;
   
-  for(i=0;i<N;++i) 
-    {
-      tune[i] = tune[i]*dtune;
-      angle[i]= angle[i]*2.0*M_PI/(double)N;
-      cosi[i] = cos(angle[i]);
-      sini[i] = sin(angle[i]);
-      cos2i[i]= cos(2.0*angle[i]);
-      sin2i[i]= sin(2.0*angle[i]);
-    }
+  for(i=0;i<N;++i) tune[i] = tune[i]*dtune; //the cos/sin weights of the phase angles 2*pi*tune/(N*dtune) are constants of the kernels in mdikernel.c
   
   
   //array containing the look-up table (type FLOAT)
@@ -291,15 +283,30 @@ int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSiz
     {
       printf("Error in subroutine computing the Dopplergrams: dimensions of the look-up tables exceed what is allowed: %d %d %d\n",maxVtest,maxNx,maxNx); //if there is a problem
       error = 4;
-      free(cosi);
-      free(sini);
-      free(cos2i);
-      free(sin2i);
       free(tune);
-      free(angle);
       return error;        
     }
 
+  //array containing the inverse look-up tables (type FLOAT), if available
+  float *inverset = NULL;
+  float *inv1,*inv2,*inv3,*inv4;
+  int   axisinv[3]={0,0,0};
+  int   ninv=0,ninvblock=0;
+  if(Inversetable != NULL)
+    {
+      axisinv[0]=Inversetable->axis[0]; //2*(NINVHEADER+ninv)
+      axisinv[1]=Inversetable->axis[1]; //number of columns (same as the look-up tables)
+      axisinv[2]=Inversetable->axis[2]; //number of rows
+      if(Inversetable->type == DRMS_TYPE_FLOAT && axisinv[1] == axist[1] && axisinv[2] == axist[2])
+	{
+	  inverset =Inversetable->data;
+	  ninvblock=axisinv[0]/2;
+	  ninv     =ninvblock-NINVHEADER;
+	  printf("Using the inverse look-up tables: %d %d %d\n",axisinv[0],axisinv[1],axisinv[2]);
+	}
+      else printf("WARNING: the inverse look-up tables do not match the look-up tables and are not used\n");
+    }
+
   //we reconstruct the test (input) velocities used to produce the look-up tables
   //WARNING: MUST BE THE SAME AS IN lookup.c
   for(i=0;i<ntest;++i) vtest[i] = dvtest*((double)i-((double)ntest-1.0)/2.0); 
@@ -312,7 +319,6 @@ int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSiz
   int   ratio,indexL,indexR,indexL2,indexR2,row,column,step=10;
   long  loc1,loc2,loc3,loc4; //coded 8 bytes
   double Kfourier;
-  float *tempvec=NULL;
   Kfourier = dtune/period*2.0;
   ratio = nRows/axist[2];
   float minlookupt1=0.0,maxlookupt1=0.0,minlookupt2=0.0,maxlookupt2=0.0;
@@ -324,28 +330,79 @@ int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSiz
   int MISSVALS24=0; //the number of missing values (NaN) for continuum intensity
 
   int SATVALS2 =0; //number of saturated values
+  int    timing=(StageTimes != NULL); //timing of the stages of the algorithm
+  double tmark=0.0,tnow,tfourier=0.0,tlookup=0.0,tinversion=0.0;
   float offset=((float)ratio-1.0)/2.0; //because the phase maps were rebinned using rebin() which means that pixel 0 is actually (ratio-1)/2 on the initial grid
+  float cropradius=Rsun+ExtraCrop;     //only the pixels at a distance <= cropradius from (X0,Y0) are processed
+  float dx,dy2,half;
+  int   colstart,colend;               //columns [colstart,colend) of a row that are inside the crop circle
 
   /***********************************************************************************************************/
-  /*LOOP OVER ALL THE PIXELS OF THE FILTERGRAMS                                                              */
+  /*LOOP OVER THE ROWS OF THE FILTERGRAMS, AND OVER THE SPAN OF EACH ROW THAT IS INSIDE THE CROP CIRCLE        */
   /***********************************************************************************************************/
 
 
-#pragma omp parallel default(none) reduction(+:MISSVALS20,MISSVALS21,MISSVALS22,MISSVALS23,MISSVALS24,SATVALS2) shared(step,arrLev1p,cosi,sini,cos2i,sin2i,pv1,pv2,index_lo,index_hi,vtest,period,dtune,dv,I0g,B0g,Idg,lam0g,rawlam0g,widthg,magnetic,axist,ratio,lookupt,nRows,nColumns,MISSINGDATA,MISSINGRESULT,Kfourier,Rsun,X0,Y0,ntest,tune,N,cost,minimumCoeffs,FWHMCoeffs,offset,ExtraCrop,cdelt1,TargetTime,QUICKLOOK,coeff) private(tempvec,iii,L,R,f1LCPc,f1RCPc,f1LCPs,f1RCPs,vLCP,vRCP,f2LCPc,f2RCPc,f2LCPs,f2RCPs,temp,tempbis,temp2,temp2bis,temp3,temp3bis,meanL,meanR,v2LCP,v2RCP,x0,y0,x1,y1,RR1,RR2,i,loc1,loc2,loc3,loc4,xa,xb,ya,yb,indexL,indexR,indexL2,indexR2,poly,poly2,row,column,distance,j,minlookupt1,maxlookupt1,minlookupt2,maxlookupt2,FWHM,minimum,angulardistance,minimumR,minimumL,correction,a0,a1,a2,a3,a4)
+#pragma omp parallel default(none) reduction(+:MISSVALS20,MISSVALS21,MISSVALS22,MISSVALS23,MISSVALS24,SATVALS2,tfourier,tlookup,tinversion) shared(timing,step,kernel,outg,velocities,lev1pdata,pv1,pv2,index_lo,index_hi,vtest,period,dtune,dv,I0g,B0g,Idg,lam0g,rawlam0g,widthg,magnetic,axist,ratio,lookupt,nRows,nColumns,MISSINGDATA,MISSINGRESULT,Kfourier,Rsun,X0,Y0,ntest,tune,N,cost,minimumCoeffs,FWHMCoeffs,offset,ExtraCrop,cropradius,cdelt1,TargetTime,QUICKLOOK,coeff,inverset,axisinv,ninv,ninvblock) private(dx,dy2,half,colstart,colend,block,cblock,nblock,k,inv1,inv2,inv3,inv4,iii,f1LCPc,f1RCPc,f1LCPs,f1RCPs,vLCP,vRCP,f2LCPc,f2RCPc,f2LCPs,f2RCPs,temp,tempbis,temp2,temp2bis,temp3,temp3bis,meanL,meanR,v2LCP,v2RCP,x0,y0,x1,y1,RR1,RR2,i,loc1,loc2,loc3,loc4,xa,xb,ya,yb,indexL,indexR,indexL2,indexR2,poly,poly2,row,column,distance,j,minlookupt1,maxlookupt1,minlookupt2,maxlookupt2,FWHM,minimum,angulardistance,minimumR,minimumL,correction,a0,a1,a2,a3,a4,tnow) firstprivate(tmark)
  {
 
-#pragma omp for
-   for(iii=0;iii<nRows*nColumns;++iii)
+#pragma omp for schedule(dynamic,8)
+   for(row=0;row<nRows;++row)
 	{
-	  //with the convention adopted for a 2D array, the index iii is defined as iii=column+row*nColumns
-	  row   =iii / nColumns;
-	  column=iii % nColumns;
-
-	  distance = sqrt(((float)row-Y0)*((float)row-Y0)+((float)column-X0)*((float)column-X0)); //distance in pixels
-	  //printf("%d %d %d %f %f %d %f %f %f\n",iii,row,column,distance,Rsun,nColumns,X0,Y0,tempvec[iii]);
+	  //span of the row inside the crop circle, from the chord half-length, then adjusted at both ends so that it contains exactly the pixels with distance <= cropradius
+	  dy2      = ((float)row-Y0)*((float)row-Y0);
+	  half     = (dy2 < cropradius*cropradius) ? sqrt(cropradius*cropradius-dy2) : 0.0;
+	  colstart = (int)ceil(X0-half);
+	  colend   = (int)floor(X0+half)+1;
+	  if(colstart < 0)        colstart=0;
+	  if(colstart > nColumns) colstart=nColumns;
+	  if(colend   > nColumns) colend  =nColumns;
+	  if(colend   < colstart) colend  =colstart;
+	  while(colstart > 0        && (float)sqrt(dy2+((float)(colstart-1)-X0)*((float)(colstart-1)-X0)) <= cropradius) colstart--;
+	  while(colstart < colend   && (float)sqrt(dy2+((float)colstart-X0)*((float)colstart-X0))         >  cropradius) colstart++;
+	  while(colend   < nColumns && (float)sqrt(dy2+((float)colend-X0)*((float)colend-X0))             <= cropradius) colend++;
+	  while(colend   > colstart && (float)sqrt(dy2+((float)(colend-1)-X0)*((float)(colend-1)-X0))     >  cropradius) colend--;
+
+	  //pixels outside of the crop circle
+	  for(k=0;k<6;++k) if(outg[k] != NULL)
+	    {
+	      for(iii=row*nColumns;iii<row*nColumns+colstart;++iii)      outg[k][iii] = MISSINGRESULT;
+	      for(iii=row*nColumns+colend;iii<(row+1)*nColumns;++iii)   outg[k][iii] = MISSINGRESULT;
+	    }
+
+	  for(cblock=colstart;cblock<colend;cblock+=NPIXBLOCK)
+	    {
+	      nblock=(colend-cblock < NPIXBLOCK) ? colend-cblock : NPIXBLOCK;
+
+	      /*-------------------------------------------------------------*/
+	      /* MDI-like algorithm: First and Second Fourier coefficients   */
+	      /* of nblock adjacent pixels, reading each filtergram row      */
+	      /* contiguously                                                */
+	      /*-------------------------------------------------------------*/
+
+	      if(timing) tmark=omp_get_wtime();
+	      kernel(lev1pdata,(long)row*nColumns+cblock,nblock,pv1,pv2,block);
+	      if(timing)
+		{
+		  tnow      = omp_get_wtime();
+		  tfourier += tnow-tmark;
+		  tmark     = tnow;
+		}
 
-	  if(distance <= (Rsun+ExtraCrop))
+	      for(k=0;k<nblock;++k)
 		{
+		  if(timing) //the previous pixel, including when it ended with a continue
+		    {
+		      tnow        = omp_get_wtime();
+		      tinversion += tnow-tmark;
+		      tmark       = tnow;
+		    }
+
+		  //with the convention adopted for a 2D array, the index iii is defined as iii=column+row*nColumns
+		  column   = cblock+k;
+		  iii      = column+row*nColumns;
+		  dx       = (float)column-X0;
+		  distance = sqrt(dy2+dx*dx); //distance in pixels
+
 
 		  //CALCULATE THE SOLAR LINE PARAMETER AT THE DISTANCE FROM DISK CENTER (USING A LAW DERIVED FROM THE 3 Fe I PROFILES PROVIDED BY ROGER ULRICH)
 		  //if(distance <= Rsun) angulardistance=cos(asin(distance/Rsun)); //convert projected angular distance from disk center to cos(angle) between the solar surface normal and the l.o.s. to the observer (INFINITE DISTANCE APPROXIMATION)
@@ -357,46 +414,27 @@ int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSiz
 
 		  //CALCULATE THE SOLAR LINE PARAMETER AT THE DISTANCE FROM DISK CENTER (USING A LAW DERIVED FROM A LINEWIDTH MAP OBTAINED WITH THE MDI-LIKE ALGORITHM)
 		  distance=distance*cdelt1; //convert from pixels to arcsecs
-		  FWHM=100.67102+0.015037016*distance-0.00010128197*distance*distance+3.1548385E-7*distance*distance*distance-3.7298102E-10*distance*distance*distance*distance+1.7275788E-13*distance*distance*distance*distance*distance;
+		  //FWHM=100.67102+0.015037016*distance-0.00010128197*distance*distance+3.1548385E-7*distance*distance*distance-3.7298102E-10*distance*distance*distance*distance+1.7275788E-13*distance*distance*distance*distance*distance;
+		  FWHM=100.67102+distance*(0.015037016+distance*(-0.00010128197+distance*(3.1548385E-7+distance*(-3.7298102E-10+distance*1.7275788E-13)))); //same polynomial, Horner scheme
 		  FWHM=FWHM/2.0/sqrt(log(2.0))/1000.; //we convert from FWHM in mA to sigma in A
 
 		  /*-------------------------------------------------------------*/
 		  /* MDI-like algorithm                                          */
 		  /*-------------------------------------------------------------*/
 
-		  for(i=0;i<N;++i) 
-		    {
-		      tempvec=(float *)arrLev1p[i*2]->data;   //LCP (ASSUMES THE LEVEL 1p DATA ARE STORED LCP/RCP BACK-TO-BACK) IN THE ORDER I0, I1, I2, I3, I4, and I5
-		      L[i]= tempvec[iii] ;
-		      tempvec=(float *)arrLev1p[i*2+1]->data; //RCP
-		      R[i]= tempvec[iii] ;		      
-		    }
-
-		  //First and Second Fourier coefficients
-		  f1LCPc=0.0;
-		  f1RCPc=0.0;
-		  f1LCPs=0.0;
-		  f1RCPs=0.0;
-		  f2LCPc=0.0;
-		  f2RCPc=0.0;
-		  f2LCPs=0.0;
-		  f2RCPs=0.0;
-		  for(i=0;i<N;++i) 
-		    {
-		      f1LCPc += cosi[i] *(double)L[i];
-		      f1RCPc += cosi[i] *(double)R[i];
-		      f1LCPs += sini[i] *(double)L[i];
-		      f1RCPs += sini[i] *(double)R[i];
-		      f2LCPc += cos2i[i]*(double)L[i];
-		      f2RCPc += cos2i[i]*(double)R[i];
-		      f2LCPs += sin2i[i]*(double)L[i];
-		      f2RCPs += sin2i[i]*(double)R[i];
-		    }
- 		  
-		  vLCP    = atan2(-f1LCPs,-f1LCPc)*pv1/2.0/M_PI; //-f1LCPs and -f1LCPc so that the jump is at 180 degrees and not 0 degrees
-		  vRCP    = atan2(-f1RCPs,-f1RCPc)*pv1/2.0/M_PI;
-      		  v2LCP   = atan2(-f2LCPs,-f2LCPc)*pv2/2.0/M_PI;
-		  v2RCP   = atan2(-f2RCPs,-f2RCPc)*pv2/2.0/M_PI;
+		  //First and Second Fourier coefficients, and their phases, computed for the block
+		  f1LCPc  = block[MDI_F1LCPC][k];
+		  f1RCPc  = block[MDI_F1RCPC][k];
+		  f1LCPs  = block[MDI_F1LCPS][k];
+		  f1RCPs  = block[MDI_F1RCPS][k];
+		  f2LCPc  = block[MDI_F2LCPC][k];
+		  f2RCPc  = block[MDI_F2RCPC][k];
+		  f2LCPs  = block[MDI_F2LCPS][k];
+		  f2RCPs  = block[MDI_F2RCPS][k];
+		  vLCP    = block[MDI_VLCP][k];
+		  vRCP    = block[MDI_VRCP][k];
+		  v2LCP   = block[MDI_V2LCP][k];
+		  v2RCP   = block[MDI_V2RCP][k];
 		  v2LCP   = fmod((v2LCP-vLCP+10.5*pv2),pv2)-pv2/2.0+vLCP; //we use the uncorrected velocity, i.e. phase, of the 1st Fourier coefficient to correct for the estimate of v2LCP and v2RCP, because the range of velocities obtained with the second Fourier coefficient is half the range of the first Fourier coefficient
 		  v2RCP   = fmod((v2RCP-vRCP+10.5*pv2),pv2)-pv2/2.0+vRCP; 
 
@@ -407,12 +445,7 @@ int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSiz
 		      MISSVALS22 +=1;
 		      MISSVALS23 +=1;
 		      MISSVALS24 +=1;
-		      lam0g[iii]  = MISSINGRESULT;
-		      B0g[iii]    = MISSINGRESULT;
-		      widthg[iii] = MISSINGRESULT;
-		      Idg[iii]    = MISSINGRESULT;
-		      I0g[iii]    = MISSINGRESULT;
-		      rawlam0g[iii]  = MISSINGRESULT;
+		      for(j=0;j<6;++j) if(outg[j] != NULL) outg[j][iii] = MISSINGRESULT;
 		      continue;
 		    }
 
@@ -461,129 +494,160 @@ int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSiz
 		  loc3=x0*axist[0]+y1*axist[0]*axist[1];
 		  loc4=x1*axist[0]+y1*axist[0]*axist[1];
 		  
-		  indexL =ntest+1;
-		  indexR =ntest+1;
-		  indexL2=ntest+1;
-		  indexR2=ntest+1;
-
-		  //initializes arrays (NOT NEEDED ACTUALLY)
-		  memset(poly,0.0,sizeof(poly));
-		  memset(poly2,0.0,sizeof(poly2));
-
-		  poly[0]  =ya*(lookupt[loc1]*xa+lookupt[loc2]*xb)+yb*(lookupt[loc3]*xa+lookupt[loc4]*xb);                          //for 1st Fourier coefficient
-		  poly2[0] =ya*(lookupt[loc1+ntest]*xa+lookupt[loc2+ntest]*xb)+yb*(lookupt[loc3+ntest]*xa+lookupt[loc4+ntest]*xb);  //for 2nd Fourier coefficient
-		  minlookupt1 = poly[0];
-		  minlookupt2 = poly2[0];
-
-		  poly[ntest-1]=ya*(lookupt[loc1+ntest-1]*xa+lookupt[loc2+ntest-1]*xb)+yb*(lookupt[loc3+ntest-1]*xa+lookupt[loc4+ntest-1]*xb);          //for 1st Fourier coefficient
-		  poly2[ntest-1]=ya*(lookupt[loc1+2*ntest-1]*xa+lookupt[loc2+2*ntest-1]*xb)+yb*(lookupt[loc3+2*ntest-1]*xa+lookupt[loc4+2*ntest-1]*xb);  //for 2nd Fourier coefficient
-		  maxlookupt1 = poly[ntest-1];
-		  maxlookupt2 = poly2[ntest-1];
-
-		  for(i=step;i<ntest;i=i+step) //make sure (ntest-1)/step is an integer
+		  if(!velocities)
+		    {
+		      //only the linewidth and/or the linedepth are selected: they do not depend on the velocities
+		    }
+		  else
 		    {
-		      poly[i]  =ya*(lookupt[loc1+i]*xa+lookupt[loc2+i]*xb)+yb*(lookupt[loc3+i]*xa+lookupt[loc4+i]*xb);                          //for 1st Fourier coefficient
-		      poly2[i] =ya*(lookupt[loc1+i+ntest]*xa+lookupt[loc2+i+ntest]*xb)+yb*(lookupt[loc3+i+ntest]*xa+lookupt[loc4+i+ntest]*xb);  //for 2nd Fourier coefficient
-		      if(poly[i] > vLCP && poly[i-step]   <= vLCP)
+		      indexL =ntest+1;
+		      indexR =ntest+1;
+		      indexL2=ntest+1;
+		      indexR2=ntest+1;
+
+		      poly[0]  =ya*(lookupt[loc1]*xa+lookupt[loc2]*xb)+yb*(lookupt[loc3]*xa+lookupt[loc4]*xb);                          //for 1st Fourier coefficient
+		      poly2[0] =ya*(lookupt[loc1+ntest]*xa+lookupt[loc2+ntest]*xb)+yb*(lookupt[loc3+ntest]*xa+lookupt[loc4+ntest]*xb);  //for 2nd Fourier coefficient
+		      minlookupt1 = poly[0];
+		      minlookupt2 = poly2[0];
+
+		      poly[ntest-1]=ya*(lookupt[loc1+ntest-1]*xa+lookupt[loc2+ntest-1]*xb)+yb*(lookupt[loc3+ntest-1]*xa+lookupt[loc4+ntest-1]*xb);          //for 1st Fourier coefficient
+		      poly2[ntest-1]=ya*(lookupt[loc1+2*ntest-1]*xa+lookupt[loc2+2*ntest-1]*xb)+yb*(lookupt[loc3+2*ntest-1]*xa+lookupt[loc4+2*ntest-1]*xb);  //for 2nd Fourier coefficient
+		      maxlookupt1 = poly[ntest-1];
+		      maxlookupt2 = poly2[ntest-1];
+
+		      //inverse tables at the 4 neighbors, for the 1st Fourier coefficient (the 2nd one is ninvblock further)
+		      if(inverset != NULL)
 			{
-			  for(j=i-step+1;j<=i;j++)
-			    {
-			      poly[j]  =ya*(lookupt[loc1+j]*xa+lookupt[loc2+j]*xb)+yb*(lookupt[loc3+j]*xa+lookupt[loc4+j]*xb);                          //for 1st Fourier coefficient
-			      if(poly[j] > vLCP && poly[j-1]   <= vLCP) indexL = j-1;
-			    }
+			  inv1=inverset+(long)(x0+y0*axisinv[1])*axisinv[0];
+			  inv2=inverset+(long)(x1+y0*axisinv[1])*axisinv[0];
+			  inv3=inverset+(long)(x0+y1*axisinv[1])*axisinv[0];
+			  inv4=inverset+(long)(x1+y1*axisinv[1])*axisinv[0];
 			}
-		      if(poly[i] > vRCP && poly[i-step]   <= vRCP)
+
+		      //the inverse tables locate the intervals of the look-up tables that bracket the velocities (same result as the scan),
+		      //if the interpolated tables are non-decreasing: all 4 nodes monotone and no extrapolation at the edges of the grid
+		      if(inverset != NULL && xa >= 0.0 && xb >= 0.0 && ya >= 0.0 && yb >= 0.0 && inv1[3] != 0.0 && inv2[3] != 0.0 && inv3[3] != 0.0 && inv4[3] != 0.0 && inv1[ninvblock+3] != 0.0 && inv2[ninvblock+3] != 0.0 && inv3[ninvblock+3] != 0.0 && inv4[ninvblock+3] != 0.0)
 			{
-			  for(j=i-step+1;j<=i;j++)
-			    {
-			      poly[j]  =ya*(lookupt[loc1+j]*xa+lookupt[loc2+j]*xb)+yb*(lookupt[loc3+j]*xa+lookupt[loc4+j]*xb);                          //for 1st Fourier coefficient
-			      if(poly[j] > vRCP && poly[j-1]   <= vRCP) indexR = j-1;
-			    }
+			  indexL =InverseBracket(inv1,inv2,inv3,inv4,lookupt+loc1,lookupt+loc2,lookupt+loc3,lookupt+loc4,xa,xb,ya,yb,ninv,ntest,(ntest-1)/step*step,vtest,vLCP,poly);
+			  indexR =InverseBracket(inv1,inv2,inv3,inv4,lookupt+loc1,lookupt+loc2,lookupt+loc3,lookupt+loc4,xa,xb,ya,yb,ninv,ntest,(ntest-1)/step*step,vtest,vRCP,poly);
+			  indexL2=InverseBracket(inv1+ninvblock,inv2+ninvblock,inv3+ninvblock,inv4+ninvblock,lookupt+loc1+ntest,lookupt+loc2+ntest,lookupt+loc3+ntest,lookupt+loc4+ntest,xa,xb,ya,yb,ninv,ntest,(ntest-1)/step*step,vtest,v2LCP,poly2);
+			  indexR2=InverseBracket(inv1+ninvblock,inv2+ninvblock,inv3+ninvblock,inv4+ninvblock,lookupt+loc1+ntest,lookupt+loc2+ntest,lookupt+loc3+ntest,lookupt+loc4+ntest,xa,xb,ya,yb,ninv,ntest,(ntest-1)/step*step,vtest,v2RCP,poly2);
 			}
-		      if(poly2[i]> v2LCP && poly2[i-step] <= v2LCP)
+		      else
 			{
-			  for(j=i-step+1;j<=i;j++)
+			  for(i=step;i<ntest;i=i+step) //make sure (ntest-1)/step is an integer
 			    {
-			      poly2[j] =ya*(lookupt[loc1+j+ntest]*xa+lookupt[loc2+j+ntest]*xb)+yb*(lookupt[loc3+j+ntest]*xa+lookupt[loc4+j+ntest]*xb);  //for 2nd Fourier coefficient
-			      if(poly2[j] > v2LCP && poly2[j-1]   <= v2LCP) indexL2 = j-1;
+			      poly[i]  =ya*(lookupt[loc1+i]*xa+lookupt[loc2+i]*xb)+yb*(lookupt[loc3+i]*xa+lookupt[loc4+i]*xb);                          //for 1st Fourier coefficient
+			      poly2[i] =ya*(lookupt[loc1+i+ntest]*xa+lookupt[loc2+i+ntest]*xb)+yb*(lookupt[loc3+i+ntest]*xa+lookupt[loc4+i+ntest]*xb);  //for 2nd Fourier coefficient
+			      if(poly[i] > vLCP && poly[i-step]   <= vLCP)
+				{
+				  for(j=i-step+1;j<=i;j++)
+				    {
+				      poly[j]  =ya*(lookupt[loc1+j]*xa+lookupt[loc2+j]*xb)+yb*(lookupt[loc3+j]*xa+lookupt[loc4+j]*xb);                          //for 1st Fourier coefficient
+				      if(poly[j] > vLCP && poly[j-1]   <= vLCP) indexL = j-1;
+				    }
+				}
+			      if(poly[i] > vRCP && poly[i-step]   <= vRCP)
+				{
+				  for(j=i-step+1;j<=i;j++)
+				    {
+				      poly[j]  =ya*(lookupt[loc1+j]*xa+lookupt[loc2+j]*xb)+yb*(lookupt[loc3+j]*xa+lookupt[loc4+j]*xb);                          //for 1st Fourier coefficient
+				      if(poly[j] > vRCP && poly[j-1]   <= vRCP) indexR = j-1;
+				    }
+				}
+			      if(poly2[i]> v2LCP && poly2[i-step] <= v2LCP)
+				{
+				  for(j=i-step+1;j<=i;j++)
+				    {
+				      poly2[j] =ya*(lookupt[loc1+j+ntest]*xa+lookupt[loc2+j+ntest]*xb)+yb*(lookupt[loc3+j+ntest]*xa+lookupt[loc4+j+ntest]*xb);  //for 2nd Fourier coefficient
+				      if(poly2[j] > v2LCP && poly2[j-1]   <= v2LCP) indexL2 = j-1;
+				    }
+				}
+			      if(poly2[i]> v2RCP && poly2[i-step] <= v2RCP)
+				{
+				  for(j=i-step+1;j<=i;j++)
+				    {
+				      poly2[j] =ya*(lookupt[loc1+j+ntest]*xa+lookupt[loc2+j+ntest]*xb)+yb*(lookupt[loc3+j+ntest]*xa+lookupt[loc4+j+ntest]*xb);  //for 2nd Fourier coefficient
+				      if(poly2[j] > v2RCP && poly2[j-1]   <= v2RCP) indexR2 = j-1;
+				    } 
+				}
 			    }
 			}
-		      if(poly2[i]> v2RCP && poly2[i-step] <= v2RCP)
+
+		      if(timing)
 			{
-			  for(j=i-step+1;j<=i;j++)
-			    {
-			      poly2[j] =ya*(lookupt[loc1+j+ntest]*xa+lookupt[loc2+j+ntest]*xb)+yb*(lookupt[loc3+j+ntest]*xa+lookupt[loc4+j+ntest]*xb);  //for 2nd Fourier coefficient
-			      if(poly2[j] > v2RCP && poly2[j-1]   <= v2RCP) indexR2 = j-1;
-			    } 
+			  tnow     = omp_get_wtime();
+			  tlookup += tnow-tmark;
+			  tmark    = tnow;
 			}
-		    }
-
 
-		  //TO DEAL WITH SATURATION
-		  if(vLCP < minlookupt1)
-		    { 
-		      vLCP=vtest[0];
-		      indexL=ntest+1;
-		      //printf("take1 %f %f %f %f\n",vLCP,minlookupt1,vRCP,distance);
-		    }
-		  if(vLCP > maxlookupt1)
-		    {
-		      vLCP=vtest[ntest-1];
-		      indexL=ntest+1;
-		      //printf("take2 %f %f %f %f\n",vLCP,maxlookupt1,vRCP,distance);
-		    }
-		  if(vRCP < minlookupt1)
-		    { 
-		      vRCP=vtest[0];
-		      indexR=ntest+1;
-		      //printf("take3 %f %f %f %f\n",vRCP,minlookupt1,vLCP,distance);
-		    }
-		  if(vRCP > maxlookupt1)
-		    {
-		      vRCP=vtest[ntest-1];
-		      indexR=ntest+1;
-		      //printf("take4 %f %f %f %f\n",vRCP,maxlookupt1,vLCP,distance);
-		    }
-		  if(v2LCP < minlookupt2)
-		    { 
-		      v2LCP=vtest[0];
-		      indexL2=ntest+1;
-		    }
-		  if(v2LCP > maxlookupt2)
-		    {
-		      v2LCP=vtest[ntest-1];
-		      indexL2=ntest+1;
-		    }
-		  if(v2RCP < minlookupt2)
-		    { 
-		      v2RCP=vtest[0];
-		      indexR2=ntest+1;
-		    }
-		  if(v2RCP > maxlookupt2)
-		    {
-		      v2RCP=vtest[ntest-1];
-		      indexR2=ntest+1;
-		    }
 
-		  if(indexL == ntest+1 || indexR == ntest+1 || indexL2 == ntest+1 || indexR2 == ntest+1)
-		    {
-		      //printf("Error FINAL: the Doppler velocity calculated at pixel %d %d is spurious: %f %f %f %f. Distance: %f\n",column,row,vLCP,vRCP,v2LCP,v2RCP,distance);
-		      //lam0g[iii]  = MISSINGRESULT;
-		      //B0g[iii]    = MISSINGRESULT;
-		      //widthg[iii] = MISSINGRESULT;
-		      //Idg[iii]    = MISSINGRESULT;
-		      //I0g[iii]    = MISSINGRESULT;
-		      SATVALS2   += 1;
-		    }
-		  //else
-		  //{
+		      //TO DEAL WITH SATURATION
+		      if(vLCP < minlookupt1)
+		        { 
+		          vLCP=vtest[0];
+		          indexL=ntest+1;
+		          //printf("take1 %f %f %f %f\n",vLCP,minlookupt1,vRCP,distance);
+		        }
+		      if(vLCP > maxlookupt1)
+		        {
+		          vLCP=vtest[ntest-1];
+		          indexL=ntest+1;
+		          //printf("take2 %f %f %f %f\n",vLCP,maxlookupt1,vRCP,distance);
+		        }
+		      if(vRCP < minlookupt1)
+		        { 
+		          vRCP=vtest[0];
+		          indexR=ntest+1;
+		          //printf("take3 %f %f %f %f\n",vRCP,minlookupt1,vLCP,distance);
+		        }
+		      if(vRCP > maxlookupt1)
+		        {
+		          vRCP=vtest[ntest-1];
+		          indexR=ntest+1;
+		          //printf("take4 %f %f %f %f\n",vRCP,maxlookupt1,vLCP,distance);
+		        }
+		      if(v2LCP < minlookupt2)
+		        { 
+		          v2LCP=vtest[0];
+		          indexL2=ntest+1;
+		        }
+		      if(v2LCP > maxlookupt2)
+		        {
+		          v2LCP=vtest[ntest-1];
+		          indexL2=ntest+1;
+		        }
+		      if(v2RCP < minlookupt2)
+		        { 
+		          v2RCP=vtest[0];
+		          indexR2=ntest+1;
+		        }
+		      if(v2RCP > maxlookupt2)
+		        {
+		          v2RCP=vtest[ntest-1];
+		          indexR2=ntest+1;
+		        }
+
+		      if(indexL == ntest+1 || indexR == ntest+1 || indexL2 == ntest+1 || indexR2 == ntest+1)
+		        {
+		          //printf("Error FINAL: the Doppler velocity calculated at pixel %d %d is spurious: %f %f %f %f. Distance: %f\n",column,row,vLCP,vRCP,v2LCP,v2RCP,distance);
+		          //lam0g[iii]  = MISSINGRESULT;
+		          //B0g[iii]    = MISSINGRESULT;
+		          //widthg[iii] = MISSINGRESULT;
+		          //Idg[iii]    = MISSINGRESULT;
+		          //I0g[iii]    = MISSINGRESULT;
+		          SATVALS2   += 1;
+		        }
+		      //else
+		      //{
 
-		      //We linearly interpolate in the look-up table for the 1st Fourier coefficient to retrieve the actual velocities
-		      if(indexL != ntest+1)  vLCP   = vtest[indexL] +(vLCP-(double)poly[indexL])   *(vtest[indexL+1] -vtest[indexL]) /((double)poly[indexL+1]  -(double)poly[indexL]  );
-		      if(indexR != ntest+1)  vRCP   = vtest[indexR] +(vRCP-(double)poly[indexR])   *(vtest[indexR+1] -vtest[indexR]) /((double)poly[indexR+1]  -(double)poly[indexR]  );
-		      //We linearly interpolate in the look-up table for the 2nd Fourier coefficient to retrieve the actual velocities
-		      if(indexL2 != ntest+1) v2LCP  = vtest[indexL2]+(v2LCP-(double)poly2[indexL2])*(vtest[indexL2+1]-vtest[indexL2])/((double)poly2[indexL2+1]-(double)poly2[indexL2]);
-		      if(indexR2 != ntest+1) v2RCP  = vtest[indexR2]+(v2RCP-(double)poly2[indexR2])*(vtest[indexR2+1]-vtest[indexR2])/((double)poly2[indexR2+1]-(double)poly2[indexR2]);
+		          //We linearly interpolate in the look-up table for the 1st Fourier coefficient to retrieve the actual velocities
+		          if(indexL != ntest+1)  vLCP   = vtest[indexL] +(vLCP-(double)poly[indexL])   *(vtest[indexL+1] -vtest[indexL]) /((double)poly[indexL+1]  -(double)poly[indexL]  );
+		          if(indexR != ntest+1)  vRCP   = vtest[indexR] +(vRCP-(double)poly[indexR])   *(vtest[indexR+1] -vtest[indexR]) /((double)poly[indexR+1]  -(double)poly[indexR]  );
+		          //We linearly interpolate in the look-up table for the 2nd Fourier coefficient to retrieve the actual velocities
+		          if(indexL2 != ntest+1) v2LCP  = vtest[indexL2]+(v2LCP-(double)poly2[indexL2])*(vtest[indexL2+1]-vtest[indexL2])/((double)poly2[indexL2+1]-(double)poly2[indexL2]);
+		          if(indexR2 != ntest+1) v2RCP  = vtest[indexR2]+(v2RCP-(double)poly2[indexR2])*(vtest[indexR2+1]-vtest[indexR2])/((double)poly2[indexR2+1]-(double)poly2[indexR2]);
+		    }//if(!velocities)
 
 		      /*-------------------------------------------------------------*/
 		      /* Calculation of observables                                  */
@@ -600,7 +664,7 @@ int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSiz
 
 		      //We compute the uncorrected (raw) Doppler velocity
 		      //lam0g[iii]  = (float)((vLCP+vRCP+v2LCP+v2RCP)/4.);//simple average. Need weights? REMINDER: SIGN CONVENTION: v<0 FOR MOTION TOWARD THE OBSERVER (BLUESHIFT)
-		      rawlam0g[iii]  = (float)((vLCP+vRCP)/2.);
+		      if(rawlam0g != NULL) rawlam0g[iii]  = (float)((vLCP+vRCP)/2.);
 
 		      
 		      //THE FOLLOWING CORRECTION COEFFICIENTS WERE OBTAINED WITH correction_calibration.pro
@@ -658,20 +722,32 @@ int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSiz
 		      
 		      //We compute the Doppler velocity
 		      //lam0g[iii]  = (float)((vLCP+vRCP+v2LCP+v2RCP)/4.);//simple average. Need weights? REMINDER: SIGN CONVENTION: v<0 FOR MOTION TOWARD THE OBSERVER (BLUESHIFT)
-		      lam0g[iii]  = (float)((vLCP+vRCP)/2.);
-		      if(isnan(lam0g[iii])) MISSVALS20 += 1;
+		      if(lam0g != NULL)
+			{
+			  lam0g[iii]  = (float)((vLCP+vRCP)/2.);
+			  if(isnan(lam0g[iii])) MISSVALS20 += 1;
+			}
 
 
 		      //We compute the l.o.s. magnetic field
 		      //B0g[iii]    = (float)((vLCP-vRCP+v2LCP-v2RCP)/2.0*magnetic);
-		      B0g[iii]    = (float)((vLCP-vRCP)*magnetic);
-		      if(isnan(B0g[iii])) MISSVALS21 += 1;
+		      if(B0g != NULL)
+			{
+			  B0g[iii]    = (float)((vLCP-vRCP)*magnetic);
+			  if(isnan(B0g[iii])) MISSVALS21 += 1;
+			}
 
 		      //We compute the linewidth (in Angstroms)
-		      temp        = period/M_PI*sqrt(1.0/6.0*log((f1LCPc*f1LCPc+f1LCPs*f1LCPs)/(f2LCPc*f2LCPc+f2LCPs*f2LCPs)));
-		      tempbis     = period/M_PI*sqrt(1.0/6.0*log((f1RCPc*f1RCPc+f1RCPs*f1RCPs)/(f2RCPc*f2RCPc+f2RCPs*f2RCPs)));
-		      widthg[iii] = (float)((temp+tempbis)*sqrt(log(2.0)))*1000.; //we want the FWHM not the sigma of the Gaussian, in milliAngstoms	      
-		      if(isnan(widthg[iii])) MISSVALS23 += 1;
+		      if(widthg != NULL)
+			{
+			  temp        = period/M_PI*sqrt(1.0/6.0*log((f1LCPc*f1LCPc+f1LCPs*f1LCPs)/(f2LCPc*f2LCPc+f2LCPs*f2LCPs)));
+			  tempbis     = period/M_PI*sqrt(1.0/6.0*log((f1RCPc*f1RCPc+f1RCPs*f1RCPs)/(f2RCPc*f2RCPc+f2RCPs*f2RCPs)));
+			  widthg[iii] = (float)((temp+tempbis)*sqrt(log(2.0)))*1000.; //we want the FWHM not the sigma of the Gaussian, in milliAngstoms	      
+			  if(isnan(widthg[iii])) MISSVALS23 += 1;
+			}
+
+		      //the linedepth is also needed by the continuum intensity
+		      if(Idg == NULL && I0g == NULL) continue;
 		      
 		      //We compute the linedepth
 		      //temp2       = period/2.0*sqrt(f1LCPc*f1LCPc+f1LCPs*f1LCPs)/sqrt(M_PI)/temp*exp(M_PI*M_PI*temp*temp/period/period);
@@ -683,8 +759,12 @@ int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSiz
 		      //temp2bis    = period/2.0/sqrt(M_PI)/tempbis*pow((f1RCPc*f1RCPc+f1RCPs*f1RCPs),2./3.)/pow((f2RCPc*f2RCPc+f2RCPs*f2RCPs),1./6.);
 		      temp2       = period/2.0*sqrt(f1LCPc*f1LCPc+f1LCPs*f1LCPs)/sqrt(M_PI)/FWHM*exp(M_PI*M_PI*FWHM*FWHM/period/period);  //to not use the second Fourier coefficient
 		      temp2bis    = period/2.0*sqrt(f1RCPc*f1RCPc+f1RCPs*f1RCPs)/sqrt(M_PI)/FWHM*exp(M_PI*M_PI*FWHM*FWHM/period/period);
-		      Idg[iii]    = (float)((temp2+temp2bis)/2.0);
-		      if(isnan(Idg[iii])) MISSVALS22 += 1;
+		      if(Idg != NULL)
+			{
+			  Idg[iii]    = (float)((temp2+temp2bis)/2.0);
+			  if(isnan(Idg[iii])) MISSVALS22 += 1;
+			}
+		      if(I0g == NULL) continue;
 
 		      //We compute the continuum intensity
 		      //temp3       = (vLCP+v2LCP)/2.0/dv;
@@ -708,13 +788,8 @@ int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSiz
 
 		      temp3       = vLCP/dv;
 		      temp3bis    = vRCP/dv;
-		      meanL=0.0;
-		      meanR=0.0;
-		      for(i=0;i<N;++i)
-			{
-			  meanL      += L[i];
-			  meanR      += R[i];
-			}
+		      meanL=block[MDI_SUML][k];
+		      meanR=block[MDI_SUMR][k];
 		      meanL=meanL/(double)N;
 		      meanR=meanR/(double)N;
 		      //minimumL=(L[0]+L[N-1])/2.*minimum/(double)N; //(L[0]+L[N-1])/2. estimate of the continuum
@@ -732,27 +807,15 @@ int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSiz
 
 		      // }		  
 		  
-		}//if (distance <= Rsun)
-	      else
-		{
-		  lam0g[iii]  = MISSINGRESULT;
-		  B0g[iii]    = MISSINGRESULT;
-		  widthg[iii] = MISSINGRESULT;
-		  Idg[iii]    = MISSINGRESULT;
-		  I0g[iii]    = MISSINGRESULT;
-		  rawlam0g[iii]  = MISSINGRESULT;
-		}
+		}//for k
+	      if(timing) tinversion += omp_get_wtime()-tmark;
+	    }//for cblock
 	      
-	}//for iii
+	}//for row
  }//end #pragma omp parallel
   
 
-      free(cosi);
-      free(sini);
-      free(cos2i);
-      free(sin2i);
       free(tune);
-      free(angle);
 
       //fclose(fp);
 
@@ -762,6 +825,12 @@ int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSiz
       MISSVALS[3]=MISSVALS23;
       MISSVALS[4]=MISSVALS24;
       *SATVALS=SATVALS2;
+      if(StageTimes != NULL)
+	{
+	  StageTimes[0]=tfourier;
+	  StageTimes[1]=tlookup;
+	  StageTimes[2]=tinversion;
+	}
       return error;
       
 }//end routine
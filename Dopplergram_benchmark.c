@@ -0,0 +1,464 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Benchmark of Dopplergram() (MDI-like algorithm) on synthetic data                       */
+/* Version 1.0                                                                             */
+/* Version 1.1: mean time per thread of the Fourier, look-up, and inversion stages         */
+/*                                                                                         */
+/* no DRMS record is read or written: the code synthesizes framelistSize level 1p          */
+/* filtergrams (LCP/RCP back-to-back, in the order expected by Dopplergram()) from known   */
+/* Doppler velocity and l.o.s. magnetic field maps, and look-up tables of dimensions       */
+/* {2*nvtest,nx,nx} computed with the same line and filter model, so that the velocities   */
+/* returned by Dopplergram() can be compared to the injected ones                          */
+/*                                                                                         */
+/* SYNTHETIC MODEL: Gaussian Fe I line (FWHM from the same radial law as in Dopplergram(), */
+/* depth 0.6) observed through Gaussian filters of FWHM 76 mA, and limb-darkened           */
+/* continuum. With this model the look-up tables are monotone for N=5, 6, 8, and 10        */
+/* velocity map: solar rotation + a supergranulation-like pattern                          */
+/* magnetic field map: one bipolar region                                                  */
+/*                                                                                         */
+/* for each thread count, Dopplergram() is run repeat times with the scan of the look-up   */
+/* tables and repeat times with the inverse look-up tables, and the code reports the best  */
+/* and mean elapsed times, the number of Mpixels/s, and the errors on the Dopplergrams and */
+/* magnetograms (on the solar disk only). One more call measures the mean time per thread  */
+/* of the Fourier, look-up, and inversion stages of Dopplergram()                          */
+/*                                                                                         */
+/* link with Dopplergram.o, mdikernel.o, and inverselookup.o                               */
+/* example: Dopplergram_benchmark N=6 size=4096 nthreads=16 scaling=1                      */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+#include <omp.h>                      //OpenMP header
+#include "HMIparam.h"                 //header with basic HMI parameters and definitions
+#include "inverselookup.h"            //inverse look-up tables for the MDI-like algorithm
+#include "observables.h"              //bitmask selecting the level 1.5 observables
+
+#undef I                              //I is the complex number (0,1). We un-define it to avoid confusion
+
+char *module_name    = "Dopplergram_benchmark";      //name of the module
+
+#define kN         "N"                //names of the arguments of the module
+#define kSize      "size"
+#define kNx        "nx"
+#define kNthreads  "nthreads"
+#define kScaling   "scaling"
+#define kRepeat    "repeat"
+#define kVrot      "vrot"
+#define kBmax      "bmax"
+
+                                      //arguments of the module
+ModuleArgs_t module_args[] =
+{
+     {ARG_INT   , kN,        "6",     "number of wavelengths (5, 6, 8, or 10)"},
+     {ARG_INT   , kSize,     "4096",  "number of rows and columns of the filtergrams"},
+     {ARG_INT   , kNx,       "256",   "number of rows and columns of the look-up tables (must divide size)"},
+     {ARG_INT   , kNthreads, "0",     "maximum number of OpenMP threads (0: omp_get_max_threads())"},
+     {ARG_INT   , kScaling,  "0",     "also run with 1, 2, 4, ... threads up to nthreads? yes=1, no=0 (default)"},
+     {ARG_INT   , kRepeat,   "3",     "number of calls to Dopplergram() per thread count and inversion method"},
+     {ARG_DOUBLE, kVrot,     "2000.0","amplitude of the rotation velocity at the limb (m/s)"},
+     {ARG_DOUBLE, kBmax,     "2000.0","maximum l.o.s. magnetic field of the bipolar region (G)"},
+     {ARG_END}
+};
+
+int Dopplergram(DRMS_Array_t **arrLev1p,DRMS_Array_t **arrLev15,int framelistSize,DRMS_Array_t *Lookuptable,DRMS_Array_t *Inversetable,float Rsun,float X0,float Y0,struct parameterDoppler DopplerParameters,int MISSVALS[5],int *SATVALS,float cdelt1,TIME TargetTime,int Observables,double StageTimes[3]);
+
+
+/*-----------------------------------------------------------------------------------------*/
+/* parameters of the synthetic Sun and of the synthetic instrument                         */
+/*-----------------------------------------------------------------------------------------*/
+
+struct syntheticSun {
+  int    N;                           //number of wavelengths
+  double tune[10];                    //tuning positions (in Angstroms), in the order I0, I1, ...
+  double dlamdv;                      //conversion factor from velocity to wavelength
+  double sigmaf;                      //width of the Gaussian filters (in Angstroms)
+  double depth;                       //depth of the Fe I line
+  float  X0,Y0,Rsun,cdelt1;           //disk center and radius (in pixels), and image scale (arcsec/pixel)
+  double vrot,bmax;                   //amplitudes of the velocity and magnetic field maps
+  double magnetic;                    //conversion factor from LCP-RCP velocity to l.o.s. magnetic field
+};
+
+
+//injected Doppler velocity (in m/s) and l.o.s. magnetic field (in G) at pixel (row,column)
+void SyntheticTruth(struct syntheticSun *sun,int row,int column,double *v,double *B)
+{
+  double x=((double)column-sun->X0)/sun->Rsun;
+  double y=((double)row   -sun->Y0)/sun->Rsun;
+  double d1=(x-0.25)*(x-0.25)+(y-0.1)*(y-0.1);
+  double d2=(x-0.35)*(x-0.35)+(y-0.1)*(y-0.1);
+
+  *v = sun->vrot*x+300.0*sin(40.0*x)*sin(40.0*y);
+  *B = sun->bmax*(exp(-d1/0.0025)-exp(-d2/0.0025));
+}
+
+
+//continuum intensity and Gaussian width of the line observed through the filters, at a distance (in pixels) from disk center
+void SyntheticLine(struct syntheticSun *sun,float distance,double *continuum,double *sigma)
+{
+  double r=distance/sun->Rsun;
+  double mu,sigmal,FWHM;
+
+  mu = (r < 1.0) ? sqrt(1.0-r*r) : 0.0;
+  *continuum=60000.0*(1.0-0.6*(1.0-mu));
+
+  distance=distance*sun->cdelt1;      //from pixels to arcsecs, SAME LAW AS IN Dopplergram()
+  FWHM=100.67102+0.015037016*distance-0.00010128197*distance*distance+3.1548385E-7*distance*distance*distance-3.7298102E-10*distance*distance*distance*distance+1.7275788E-13*distance*distance*distance*distance*distance;
+  sigmal=FWHM/2.0/sqrt(log(2.0))/1000.;
+  *sigma=sqrt(sigmal*sigmal+sun->sigmaf*sun->sigmaf);
+}
+
+
+//intensities observed at the N tuning positions for a line shifted by the velocity v
+void SyntheticIntensities(struct syntheticSun *sun,double continuum,double sigma,double v,double *inten)
+{
+  int    i;
+  double lam0=v*sun->dlamdv;
+  double dip=sun->depth*sqrt(sigma*sigma-sun->sigmaf*sun->sigmaf)/sigma; //the filters conserve the equivalent width of the line
+  double x;
+
+  for(i=0;i<sun->N;++i)
+    {
+      x=(sun->tune[i]-lam0)/sigma;
+      inten[i]=continuum*(1.0-dip*exp(-x*x));
+    }
+}
+
+
+/*-----------------------------------------------------------------------------------------*/
+/* DoIt is the entry point of the module                                                   */
+/*-----------------------------------------------------------------------------------------*/
+
+int DoIt(void)
+{
+  int   N        = cmdparams_get_int(&cmdparams,kN,        NULL);
+  int   size     = cmdparams_get_int(&cmdparams,kSize,     NULL);
+  int   nx       = cmdparams_get_int(&cmdparams,kNx,       NULL);
+  int   nthreads = cmdparams_get_int(&cmdparams,kNthreads, NULL);
+  int   scaling  = cmdparams_get_int(&cmdparams,kScaling,  NULL);
+  int   repeat   = cmdparams_get_int(&cmdparams,kRepeat,   NULL);
+  double vrot    = cmdparams_get_double(&cmdparams,kVrot,  NULL);
+  double bmax    = cmdparams_get_double(&cmdparams,kBmax,  NULL);
+
+  int    status=0;
+  int    framelistSize=2*N;
+  int    i,j,k,iii,row,column,method,nth;
+  int    ratio,ndisk,nvtest;
+  int    MISSVALS[5],SATVALS;
+  int    axis[2]={size,size};
+  float  offset,distance;
+  float  missingdata=MISSINGDATA,missingresult=MISSINGRESULT;
+  double t0,t1,elapsed,best,mean;
+  double stage[3];                    //times of the Fourier, look-up, and inversion stages of Dopplergram()
+  double inten[10],intenR[10],continuum,sigma,v,B,vL,vR;
+  double f1c,f1s,f2c,f2s,vel1,vel2;
+  double errv,errB,maxv,maxB,rmsv,rmsB,sumv2,sumB2;
+  struct syntheticSun sun;
+  struct parameterDoppler DopplerParameters;
+
+  DRMS_Array_t **arrLev1p=NULL;
+  DRMS_Array_t **arrLev15=NULL;
+  DRMS_Array_t  *arrintable=NULL;
+  DRMS_Array_t  *arrinverse=NULL;
+  float *data=NULL,*dataR=NULL,*lookupt=NULL,*lam0g=NULL,*B0g=NULL;
+
+  if(N != 5 && N != 6 && N != 8 && N != 10)
+    {
+      printf("Error: the number of wavelengths must be 5, 6, 8, or 10\n");
+      return 1;
+    }
+  if(nx <= 0 || size <= 0 || size % nx != 0 || nx > maxNx)
+    {
+      printf("Error: nx must divide size and be at most %d\n",maxNx);
+      return 1;
+    }
+  if(nthreads <= 0) nthreads=omp_get_max_threads();
+  if(repeat <= 0) repeat=1;
+  nvtest=(N == 8 || N == 10) ? 1333 : ntest; //number of test velocities: must match what is in lookup.c
+
+  //tuning positions and weights of the MDI-like algorithm, SAME AS IN Dopplergram()
+  double angle[10];
+  double cosi[10],sini[10],cos2i[10],sin2i[10];
+  double dtune=FSR[0]/2.5;
+  double dvtune=dtune/dlamdv;
+  double pv1=dvtune*(double)(N-1);
+  double pv2=pv1/2.;
+  double vtest[nvtest];
+
+  if(N == 5) for(i=0;i<N;++i) angle[i]=2.0-(double)i;
+  if(N == 6) for(i=0;i<N;++i) angle[i]=2.5-(double)i;
+  if(N == 8)
+    {
+      for(i=0;i<7;++i) angle[i]=2.5-(double)i;
+      angle[7]=+3.5;
+    }
+  if(N == 10)
+    {
+      for(i=0;i<7;++i) angle[i]=2.5-(double)i;
+      angle[7]=+3.5;
+      angle[8]=-4.5;
+      angle[9]=+4.5;
+    }
+
+  sun.N       = N;
+  sun.dlamdv  = dlamdv;
+  sun.sigmaf  = 0.076/2.0/sqrt(log(2.0));
+  sun.depth   = 0.6;
+  sun.X0      = ((float)size-1.0)/2.0;
+  sun.Y0      = ((float)size-1.0)/2.0;
+  sun.Rsun    = 1900.0*(float)size/4096.0;
+  if(sun.Rsun > (float)size/2.0-50.0-(float)(size/nx)) sun.Rsun=(float)size/2.0-50.0-(float)(size/nx); //Dopplergram() crops at Rsun+50 pixels, which must stay inside the grid of the look-up tables
+  sun.cdelt1  = 0.504*4096.0/(float)size;
+  sun.vrot    = vrot;
+  sun.bmax    = bmax;
+  sun.magnetic= 1.0/(2.0*4.67E-5*0.000061733433*2.5*299792458.0); //SAME AS IN Dopplergram()
+  for(i=0;i<N;++i)
+    {
+      sun.tune[i]= angle[i]*dtune;
+      angle[i]   = angle[i]*2.0*M_PI/(double)N;
+      cosi[i]    = cos(angle[i]);
+      sini[i]    = sin(angle[i]);
+      cos2i[i]   = cos(2.0*angle[i]);
+      sin2i[i]   = sin(2.0*angle[i]);
+    }
+  for(i=0;i<nvtest;++i) vtest[i] = dvtest*((double)i-((double)nvtest-1.0)/2.0); //MUST BE THE SAME AS IN lookup.c
+
+  printf("BENCHMARK OF Dopplergram(): %d WAVELENGTHS, %d x %d FILTERGRAMS, %d x %d LOOK-UP TABLES, %d TEST VELOCITIES, UP TO %d THREADS\n",N,size,size,nx,nx,nvtest,nthreads);
+  omp_set_num_threads(nthreads);
+
+
+  /***********************************************************************************************************/
+  /*SYNTHETIC LEVEL 1P FILTERGRAMS                                                                           */
+  /***********************************************************************************************************/
+
+  arrLev1p = (DRMS_Array_t **)malloc(framelistSize*sizeof(DRMS_Array_t *));
+  arrLev15 = (DRMS_Array_t **)malloc(6*sizeof(DRMS_Array_t *));
+  if(arrLev1p == NULL || arrLev15 == NULL)
+    {
+      printf("Error: memory could not be allocated to arrLev1p or arrLev15\n");
+      return 1;
+    }
+  for(i=0;i<framelistSize;++i)
+    {
+      arrLev1p[i]=drms_array_create(DRMS_TYPE_FLOAT,2,axis,NULL,&status);
+      if(status != DRMS_SUCCESS || arrLev1p[i] == NULL)
+	{
+	  printf("Error: cannot create an array for the synthetic filtergrams\n");
+	  return 1;
+	}
+    }
+  for(i=0;i<6;++i)
+    {
+      arrLev15[i]=drms_array_create(DRMS_TYPE_FLOAT,2,axis,NULL,&status);
+      if(status != DRMS_SUCCESS || arrLev15[i] == NULL)
+	{
+	  printf("Error: cannot create an array for the observables\n");
+	  return 1;
+	}
+    }
+
+  t0=dsecnd();
+#pragma omp parallel for default(none) private(iii,i,row,column,distance,continuum,sigma,v,B,vL,vR,inten,intenR,data,dataR) shared(size,sun,arrLev1p,N,missingdata)
+  for(iii=0;iii<size*size;++iii)
+    {
+      row     =iii / size;
+      column  =iii % size;
+      distance=sqrt(((float)row-sun.Y0)*((float)row-sun.Y0)+((float)column-sun.X0)*((float)column-sun.X0));
+      if(distance <= sun.Rsun+60.0)
+	{
+	  SyntheticLine(&sun,distance,&continuum,&sigma);
+	  SyntheticTruth(&sun,row,column,&v,&B);
+	  vL=v+B/sun.magnetic/2.0; //Dopplergram() returns B=(vLCP-vRCP)*magnetic
+	  vR=v-B/sun.magnetic/2.0;
+	  SyntheticIntensities(&sun,continuum,sigma,vL,inten);
+	  SyntheticIntensities(&sun,continuum,sigma,vR,intenR);
+	}
+      else for(i=0;i<N;++i) inten[i]=intenR[i]=missingdata;
+      for(i=0;i<N;++i)
+	{
+	  data =arrLev1p[2*i]->data;
+	  dataR=arrLev1p[2*i+1]->data;
+	  data[iii] =(float)inten[i];
+	  dataR[iii]=(float)intenR[i];
+	}
+    }
+  t1=dsecnd();
+  printf("TIME ELAPSED TO SYNTHESIZE THE FILTERGRAMS: %f\n",t1-t0);
+
+
+  /***********************************************************************************************************/
+  /*SYNTHETIC LOOK-UP TABLES AND INVERSE LOOK-UP TABLES                                                      */
+  /***********************************************************************************************************/
+
+  int axist[3]={2*nvtest,nx,nx};
+  int axisinv[3]={2*(NINVHEADER+nvtest),nx,nx};
+  ratio =size/nx;
+  offset=((float)ratio-1.0)/2.0; //SAME CONVENTION AS IN Dopplergram(): node 0 is at pixel (ratio-1)/2
+
+  arrintable=drms_array_create(DRMS_TYPE_FLOAT,3,axist,NULL,&status);
+  if(status != DRMS_SUCCESS || arrintable == NULL)
+    {
+      printf("Error: cannot create an array for the look-up tables\n");
+      return 1;
+    }
+  lookupt=arrintable->data;
+
+  t0=dsecnd();
+#pragma omp parallel for default(none) private(iii,i,j,row,column,distance,continuum,sigma,inten,f1c,f1s,f2c,f2s,vel1,vel2) shared(nx,ratio,offset,sun,nvtest,vtest,N,cosi,sini,cos2i,sin2i,pv1,pv2,lookupt,axist)
+  for(iii=0;iii<nx*nx;++iii)
+    {
+      row     =iii / nx;
+      column  =iii % nx;
+      distance=sqrt(((float)row*(float)ratio+offset-sun.Y0)*((float)row*(float)ratio+offset-sun.Y0)+((float)column*(float)ratio+offset-sun.X0)*((float)column*(float)ratio+offset-sun.X0));
+      if(distance > sun.Rsun+60.0) distance=sun.Rsun+60.0; //outside of the synthetic filtergrams, the tables are those of the edge
+      SyntheticLine(&sun,distance,&continuum,&sigma);
+      for(i=0;i<nvtest;++i)
+	{
+	  SyntheticIntensities(&sun,continuum,sigma,vtest[i],inten);
+	  f1c=0.0;
+	  f1s=0.0;
+	  f2c=0.0;
+	  f2s=0.0;
+	  for(j=0;j<N;++j)
+	    {
+	      f1c += cosi[j] *inten[j];
+	      f1s += sini[j] *inten[j];
+	      f2c += cos2i[j]*inten[j];
+	      f2s += sin2i[j]*inten[j];
+	    }
+	  vel1 = atan2(-f1s,-f1c)*pv1/2.0/M_PI;  //SAME AS IN lookup.c
+	  vel2 = atan2(-f2s,-f2c)*pv2/2.0/M_PI;
+	  lookupt[i      +(long)iii*axist[0]] = (float)vel1;
+	  lookupt[i+nvtest+(long)iii*axist[0]] = (float)(fmod((vel2-vel1+10.5*pv2),pv2)-pv2/2.0+vel1);
+	}
+    }
+  t1=dsecnd();
+  printf("TIME ELAPSED TO COMPUTE THE LOOK-UP TABLES: %f\n",t1-t0);
+
+  arrinverse=drms_array_create(DRMS_TYPE_FLOAT,3,axisinv,NULL,&status);
+  if(status != DRMS_SUCCESS || arrinverse == NULL)
+    {
+      printf("Error: cannot create an array for the inverse look-up tables\n");
+      return 1;
+    }
+  t0=dsecnd();
+  status=InverseLookup(arrintable->data,nvtest,nx,nx,dvtest,nvtest,arrinverse->data);
+  t1=dsecnd();
+  if(status != 0) printf("WARNING: the look-up tables are not monotone at %d nodes\n",status);
+  printf("TIME ELAPSED TO COMPUTE THE INVERSE LOOK-UP TABLES: %f\n",t1-t0);
+
+  DopplerParameters.FSRNB=FSR[0];
+  DopplerParameters.FSRWB=FSR[1];
+  DopplerParameters.FSRE1=FSR[2];
+  DopplerParameters.FSRE2=FSR[3];
+  DopplerParameters.FSRE3=FSR[4];
+  DopplerParameters.FSRE4=FSR[5];
+  DopplerParameters.FSRE5=FSR[6];
+  DopplerParameters.dlamdv=dlamdv;
+  DopplerParameters.maxVtest=nvtest*2;
+  DopplerParameters.maxNx=maxNx;
+  DopplerParameters.ntest=nvtest;
+  DopplerParameters.dvtest=dvtest;
+  DopplerParameters.MISSINGDATA=MISSINGDATA;
+  DopplerParameters.MISSINGRESULT=MISSINGRESULT;
+  DopplerParameters.coeff0=0.0;  //no polynomial correction: the look-up tables are exact
+  DopplerParameters.coeff1=0.0;
+  DopplerParameters.coeff2=0.0;
+  DopplerParameters.coeff3=0.0;
+  DopplerParameters.QuickLook=0;
+
+
+  /***********************************************************************************************************/
+  /*TIMING AND ACCURACY OF Dopplergram()                                                                     */
+  /***********************************************************************************************************/
+
+  ndisk=0;
+  for(row=0;row<size;++row) for(column=0;column<size;++column) if(((float)row-sun.Y0)*((float)row-sun.Y0)+((float)column-sun.X0)*((float)column-sun.X0) <= sun.Rsun*sun.Rsun) ndisk++;
+
+  printf("\nMETHOD   THREADS   BEST(s)    MEAN(s)    Mpix/s(FRAME)  Mpix/s(DISK)  RMS dV(m/s)  MAX dV(m/s)  RMS dB(G)  MAX dB(G)  SATURATED  FOURIER(s)  LOOK-UP(s)  INVERSION(s)\n");
+
+  nth=(scaling == 1) ? 1 : nthreads;
+  while(nth <= nthreads)
+    {
+      omp_set_num_threads(nth);
+      for(method=0;method<2;++method) //0: scan of the look-up tables, 1: inverse look-up tables
+	{
+	  best=1.e30;
+	  mean=0.0;
+	  for(k=0;k<repeat;++k)
+	    {
+	      t0=dsecnd();
+	      status=Dopplergram(arrLev1p,arrLev15,framelistSize,arrintable,(method == 1) ? arrinverse : NULL,sun.Rsun,sun.X0,sun.Y0,DopplerParameters,MISSVALS,&SATVALS,sun.cdelt1,0.0,LEV15_ALL,NULL);
+	      t1=dsecnd();
+	      if(status != 0)
+		{
+		  printf("Error: Dopplergram() returned the error code %d\n",status);
+		  return 1;
+		}
+	      elapsed=t1-t0;
+	      mean+=elapsed/(double)repeat;
+	      if(elapsed < best) best=elapsed;
+	    }
+
+	  //one more call with the timing of the stages, which is not counted in best and mean because the timers slow the pixel loop down
+	  status=Dopplergram(arrLev1p,arrLev15,framelistSize,arrintable,(method == 1) ? arrinverse : NULL,sun.Rsun,sun.X0,sun.Y0,DopplerParameters,MISSVALS,&SATVALS,sun.cdelt1,0.0,LEV15_ALL,stage);
+	  if(status != 0)
+	    {
+	      printf("Error: Dopplergram() returned the error code %d\n",status);
+	      return 1;
+	    }
+	  for(i=0;i<3;++i) stage[i]/=(double)nth; //mean time per thread
+
+	  //errors on the solar disk, with respect to the injected velocity and magnetic field
+	  lam0g=arrLev15[0]->data;
+	  B0g  =arrLev15[1]->data;
+	  rmsv=0.0;
+	  rmsB=0.0;
+	  sumv2=0.0;
+	  sumB2=0.0;
+	  maxv=0.0;
+	  maxB=0.0;
+	  j=0;
+#pragma omp parallel for default(none) private(iii,row,column,v,B,errv,errB) shared(size,sun,lam0g,B0g,missingresult) reduction(+:sumv2,sumB2,j) reduction(max:maxv,maxB)
+	  for(iii=0;iii<size*size;++iii)
+	    {
+	      row   =iii / size;
+	      column=iii % size;
+	      if(((float)row-sun.Y0)*((float)row-sun.Y0)+((float)column-sun.X0)*((float)column-sun.X0) > sun.Rsun*sun.Rsun) continue;
+	      if(isnan(lam0g[iii]) || isnan(B0g[iii]) || lam0g[iii] == missingresult) continue;
+	      SyntheticTruth(&sun,row,column,&v,&B);
+	      errv=fabs((double)lam0g[iii]-v);
+	      errB=fabs((double)B0g[iii]-B);
+	      sumv2+=errv*errv;
+	      sumB2+=errB*errB;
+	      if(errv > maxv) maxv=errv;
+	      if(errB > maxB) maxB=errB;
+	      j++;
+	    }
+	  if(j > 0)
+	    {
+	      rmsv=sqrt(sumv2/(double)j);
+	      rmsB=sqrt(sumB2/(double)j);
+	    }
+
+	  printf("%s  %7d   %9.4f  %9.4f  %13.2f  %12.2f  %11.3f  %11.3f  %9.3f  %9.3f  %9d  %10.4f  %10.4f  %12.4f\n",(method == 0) ? "scan   " : "inverse",nth,best,mean,(double)size*(double)size/best/1.e6,(double)ndisk/best/1.e6,rmsv,maxv,rmsB,maxB,SATVALS,stage[0],stage[1],stage[2]);
+	  if(j != ndisk) printf("WARNING: %d pixels of the solar disk have missing values\n",ndisk-j);
+	}
+      if(nth == nthreads) break;
+      nth*=2;
+      if(nth > nthreads) nth=nthreads;
+    }
+  printf("\n");
+
+  for(i=0;i<framelistSize;++i) drms_free_array(arrLev1p[i]);
+  for(i=0;i<6;++i) drms_free_array(arrLev15[i]);
+  free(arrLev1p);
+  free(arrLev15);
+  drms_free_array(arrintable);
+  drms_free_array(arrinverse);
+
+  return 0;
+}
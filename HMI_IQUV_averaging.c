@@ -47,6 +47,7 @@ The value by default is hmi.lev1 (to be consistent with the default value of qui
 \li \c average=number where number is an integer and is either 12 (the value by default) or 96 (WARNING: even though the code runs for 96-min averages, it has not yet been optimized for this value)
 \li \c rotational=number where number is an integer and is either 0 (the value by default) or 1. 1 means that the user wishes to use rotational flat fields instead of the standard pzt flat fields.
 \li \c linearity=number where number is an integer and is either 0 (the value by default) or 1. 1 means that the user wishes to correct for the non-linearity of the cameras.
+\li \c framecache=number where number is an integer and is the maximum memory, in MB, used by the gapfilled level 1 filtergrams kept in memory to be reused at the following target times (8192 by default, which holds the filtergrams used at one target time (about 5 GB for the 65 filtergrams of one wavelength and polarization averaged over 96 minutes at a 135-second cadence, each with its gapfilling error map: 80 MB); 0 means no maximum). The filtergrams that are not used at the current target time are released, and when the maximum is reached, the least recently used filtergrams are released too, and will have to be read and gapfilled again if they are needed.
 
 \par Examples
 
@@ -73,6 +74,12 @@ v 1.18 and 1.19: code now aborts when status of drms_segment_read() or drms_segm
 v 1.20: possibility to apply a rotational flat field instead of the pzt flat field, and possibility to use smooth look-up tables instead of the standard ones
         support for the 8- and 10-wavelength observable sequences run in April 2010
 v 1.21: correcting for non-linearity of cameras
+v 1.22: the gapfilled level 1 filtergrams kept in memory across target times are managed by a frame cache (framecache.c) instead of the arrays Segments, Ierror, and SegmentRead. New parameter framecache: maximum memory used by this cache (8 GB by default). As before, the filtergrams not used at the current target time are released
+v 1.23: the crop mask of each image configuration (HIMGCFID) is built only once per process (cropmask.c), instead of reading the image configuration file and the crop table for every level 1 filtergram
+v 1.24: the numerical keywords of the level 1 records are read in one query (keyvector.c) instead of record by record
+v 1.25: the observable sequence files (Sequences3.txt, std_flight.w, std_flight.p) are read only once, and each framelist decoded by framelistInfo() is kept in memory (framelistcache.c)
+v 1.26: the pzt and rotational flat fields are read only once and kept in memory (flatfieldcache.c). Each filtergram gets the rotational flat field of the validity interval (T_START to T_STOP) that contains its T_OBS, so that a run can span several days and flat fields (a run is not limited anymore to the validity interval of one rotational flat field)
+v 1.27: with average=96, the level 1 filtergrams of a polarization are dropped from the frame cache once do_interpolate() has averaged them, instead of being kept for the next target time. This only lowers the memory used partially: do_interpolate() still needs all the filtergrams of a polarization in memory at once
 
 */
 
@@ -134,6 +141,11 @@ v 1.21: correcting for non-linearity of cameras
 #include "polcal.h"                   //from Jesper
 #include "HMIparam.h"                 //includes the #include <jsoc_main.h> instruction
 #include "fstats.h"                   //header for the statistics function of Keh-Cheng
+#include "framecache.h"               //cache of the gapfilled level 1 filtergrams
+#include "cropmask.h"                 //crop masks of the image configurations
+#include "keyvector.h"                //keywords of the level 1 records read in one query
+#include "framelistcache.h"            //observable sequence tables read only once
+#include "flatfieldcache.h"            //pzt and rotational flat fields read only once
 
 #undef I                              //I is the complex number (0,1) in complex.h. We un-define it to avoid confusion with the loop iterative variable i
 
@@ -155,6 +167,7 @@ char *module_name    = "HMI_IQUV_averaging"; //name of the module
 #define Average        "average"      //average over 12 or 96 minutes? (12 by default)
 #define RotationalFlat "rotational"   //force the use of rotational flat fields?
 #define Linearity      "linearity"    //force the correction for non-linearity of cameras
+#define FrameCacheIn   "framecache"   //maximum memory (in MB) used by the gapfilled level 1 filtergrams kept in memory (0=no maximum). 8192 BY DEFAULT
 
 #define minval(x,y) (((x) < (y)) ? (x) : (y))
 #define maxval(x,y) (((x) < (y)) ? (y) : (x))
@@ -235,6 +248,7 @@ ModuleArgs_t module_args[] =
      {ARG_INT   , RotationalFlat, "0", "Use rotational flat fields? yes=1, no=0 (default)"},
      {ARG_STRING, "dpath", "/home/jsoc/cvs/Development/JSOC/proj/lev1.5_hmi/apps/",  "directory where the source code is located"},
      {ARG_INT   , Linearity, "0", "Correct for non-linearity of cameras? yes=1, no=0 (default)"},
+     {ARG_INT   , FrameCacheIn, "8192", "maximum memory (in MB) used by the gapfilled level 1 filtergrams kept in memory (0=no maximum)"},
      {ARG_END}
 };
 
@@ -360,75 +374,57 @@ int WhichWavelength(int FID)
 
 int framelistInfo(int HFLID,int HPLTID,int HWLTID,int WavelengthID,int *PHWPLPOS,int *WavelengthIndex,int *WavelengthLocation, int *PPolarizationType,int CamIdIn,int *Pcombine,int *Pnpol,int MaxNumFiltergrams,TIME *PDataCadence,int *CameraValues,int *FID,char *dpath)
 {
-  int framelistSize=0,HFLIDread,FIDread,i,j,compteur;
+  int framelistSize=0,i,j,compteur;
   int PLINDEX,WLINDEX;
-  FILE *sequencefile;
 
-  //The three following files have been checked into CVS. I should put the files in /home/cvsuser/cvsroot/JSOC/proj/lev1.5_hmi/
+  //The three files read by SequenceTables() have been checked into CVS. I should put the files in /home/cvsuser/cvsroot/JSOC/proj/lev1.5_hmi/
   //Each time one of the original files is modified, it needs to be checked in CVS again
-  //char filename[]  = "/home/couvidat/cvs/JSOC/proj/lev1.5_hmi/Sequences3.txt"; //file containing information about the different observable sequences
-  //char filename2[] = "/home/couvidat/cvs/JSOC/proj/lev1.5_hmi/std.w";         //file containing the HCM positions for the wavelength selection
-  //char filename3[] = "/home/couvidat/cvs/JSOC/proj/lev1.5_hmi/std.p";         //file containing the HCM positions for the polarization selection
+  //dpath/../Sequences3.txt: file containing information about the different observable sequences
+  //dpath/../../tables/hmi_mech/std_flight.w: file containing the HCM positions for the wavelength selection
+  //dpath/../../tables/hmi_mech/std_flight.p: file containing the HCM positions for the polarization selection
+  //these files are read only once, and each framelist is decoded only once (framelistcache.c)
 
-  char *filename=NULL;
-  char *filename2=NULL;
-  char *filename3=NULL;
-
-  char dpath2[256];
-  strcpy(dpath2,dpath);
-  filename =strdup(strcat(dpath2,"/../Sequences3.txt"));
-  strcpy(dpath2,dpath);
-  filename2=strdup(strcat(dpath2,"/../../tables/hmi_mech/std_flight.w"));
-  strcpy(dpath2,dpath);
-  filename3=strdup(strcat(dpath2,"/../../tables/hmi_mech/std_flight.p"));
-
-
-  char line[256];
+  const struct sequencetables *tables=NULL;
+  const struct sequence *sequence=NULL;
   int  PL_Index[MaxNumFiltergrams],WL_Index[MaxNumFiltergrams];
-  int  WT1P,WT2P,WT3P,WT4P,PS1P,PS2P,PS3P;
+  unsigned char HWPLset[7*MaxNumFiltergrams];                        //1 if PHWPLPOS was found in std_flight.w or std_flight.p
   int  found=0; //found=0 means that there is a problem and the info for a specific framelist cannot be found
-
-  int  combinef,combines,npolf,npols,framelistSizef,framelistSizes,PolarizationTypef,PolarizationTypes,CAMERA;
-  float DataCadencef,DataCadences;
+  int  paramset=0;
+  int  nFID;
 
 
-  //READ THE FILE CONTAINING THE SEQUENCE DESCRIPTION
+  //READ THE SEQUENCE DESCRIPTION
   //----------------------------------------------------------------------------------------------------------
 
   printf("HFLID OF FRAMELIST = %d\n",HFLID);
-  sequencefile = fopen(filename,"r");
-  if(sequencefile == NULL)
-    {
-      printf("The file %s does not exist or cannot be read\n",filename);
-      free(filename);
-      free(filename2);
-      free(filename3);
-      filename=NULL;
-      filename2=NULL;
-      filename3=NULL;
-      return 1;//exit(EXIT_FAILURE);
-    }
+  framelistSize=FramelistCacheGet(HFLID,HPLTID,HWLTID,WavelengthID,CamIdIn,PHWPLPOS,WavelengthIndex,WavelengthLocation,PPolarizationType,Pcombine,Pnpol,PDataCadence,CameraValues,FID);
+  if(framelistSize >= 0) return framelistSize;                       //this framelist was already decoded
+  framelistSize=0;
+
+  tables=SequenceTables(dpath);
+  if(tables == NULL) return 1;
 
   i=0;
   compteur=0;
-  while (fgets(line,256,sequencefile) != NULL)
+  for(j=0;j<tables->nsequences;++j)
     {
-      sscanf(line,"%d %d %d %f %f %d %d %d %d %d %d %d %d",&HFLIDread,&PolarizationTypef,&PolarizationTypes,&DataCadencef,&DataCadences,&npolf,&npols,&combinef,&combines,&framelistSizef,&framelistSizes,&j,&CAMERA);
-     if(HFLIDread == HFLID)
+      sequence=&tables->sequences[j];
+      if(sequence->HFLID == HFLID)
 	{
 
 	  if(CamIdIn == LIGHT_FRONT) //front camera
 	    {
-	      *Pcombine=combinef;
-	      *Pnpol=npolf;
-	      *PDataCadence=DataCadencef;
-	      *PPolarizationType=PolarizationTypef;
-	      framelistSize=framelistSizef;
-	      if(combinef == 0)
+	      *Pcombine=sequence->combinef;
+	      *Pnpol=sequence->npolf;
+	      *PDataCadence=sequence->DataCadencef;
+	      *PPolarizationType=sequence->PolarizationTypef;
+	      paramset=1;
+	      framelistSize=sequence->framelistSizef;
+	      if(sequence->combinef == 0)
 		{
-		  if(CAMERA == 3)//front camera (HCAMID convention used)
+		  if(sequence->CAMERA == 3) //front camera (HCAMID convention used)
 		    {
-		      FID[i]=j;
+		      FID[i]=sequence->FID;
 		      WavelengthLocation[i]=compteur;
 		      CameraValues[i]=LIGHT_FRONT;
 		      i+=1;
@@ -436,25 +432,26 @@ int framelistInfo(int HFLID,int HPLTID,int HWLTID,int WavelengthID,int *PHWPLPOS
 		}
 	      else
 		{
-		  FID[i]=j;
+		  FID[i]=sequence->FID;
 		  WavelengthLocation[i]=compteur;
-		  if(CAMERA == 3) CameraValues[i]=LIGHT_FRONT;
+		  if(sequence->CAMERA == 3) CameraValues[i]=LIGHT_FRONT;
 		  else CameraValues[i]=LIGHT_SIDE;
 		  i+=1;
 		}
 	    }
 	  if(CamIdIn == LIGHT_SIDE) //side camera
 	    {
-	      *Pcombine=combines;
-	      *Pnpol=npols;
-	      *PDataCadence=DataCadences;
-	      *PPolarizationType=PolarizationTypes;
-	      framelistSize=framelistSizes;
-	      if(combines == 0)
+	      *Pcombine=sequence->combines;
+	      *Pnpol=sequence->npols;
+	      *PDataCadence=sequence->DataCadences;
+	      *PPolarizationType=sequence->PolarizationTypes;
+	      paramset=1;
+	      framelistSize=sequence->framelistSizes;
+	      if(sequence->combines == 0)
 		{
-		  if(CAMERA == 2)
+		  if(sequence->CAMERA == 2)
 		    {
-		      FID[i]=j;
+		      FID[i]=sequence->FID;
 		      WavelengthLocation[i]=compteur;
 		      CameraValues[i]=LIGHT_SIDE;
 		      i+=1;
@@ -462,9 +459,9 @@ int framelistInfo(int HFLID,int HPLTID,int HWLTID,int WavelengthID,int *PHWPLPOS
 		}
 	      else
 		{
-		  FID[i]=j;
+		  FID[i]=sequence->FID;
 		  WavelengthLocation[i]=compteur;
-		  if(CAMERA == 3) CameraValues[i]=LIGHT_FRONT;
+		  if(sequence->CAMERA == 3) CameraValues[i]=LIGHT_FRONT;
 		  else CameraValues[i]=LIGHT_SIDE;
 		  i+=1;
 		}
@@ -474,7 +471,7 @@ int framelistInfo(int HFLID,int HPLTID,int HWLTID,int WavelengthID,int *PHWPLPOS
 	  compteur+=1;
 	}
     }
-  fclose(sequencefile);
+  nFID=i;                                                            //number of values of FID set
 
 
   //ASSIGN THE WL_Index AND PL_Index AS A FUNCTION OF FID
@@ -570,12 +567,6 @@ int framelistInfo(int HFLID,int HPLTID,int HWLTID,int WavelengthID,int *PHWPLPOS
       if(WavelengthIndex[i] == -101)
 	{
 	  printf("Error: WavelengthIndex[i]=-101 \n");
-	  free(filename);
-	  free(filename2);
-	  free(filename3);
-	  filename=NULL;
-	  filename2=NULL;
-	  filename3=NULL;
 	  return 1;//exit(EXIT_FAILURE);
 	}
     }
@@ -583,73 +574,38 @@ int framelistInfo(int HFLID,int HPLTID,int HWLTID,int WavelengthID,int *PHWPLPOS
 
 
 
-  //WE READ THE std.w AND std.p FILES THAT PROVIDE, FOR THE HPLTID AND HWLTID VALUES, THE CORRESPONDING HCM POSITIONS
+  //THE std.w AND std.p FILES PROVIDE, FOR THE HPLTID AND HWLTID VALUES, THE CORRESPONDING HCM POSITIONS
   //------------------------------------------------------------------------------------------------------------------
 
-  sequencefile = fopen(filename2,"r");
-  if(sequencefile == NULL)
-    {
-      printf("The file %s does not exist or cannot be read\n",filename2);
-      free(filename);
-      free(filename2);
-      free(filename3);
-      filename=NULL;
-      filename2=NULL;
-      filename3=NULL;
-      return 1;//exit(EXIT_FAILURE);
-    }
-
-  for(j=0;j<6;++j) fgets(line,256,sequencefile);
-  while (fgets(line,256,sequencefile) != NULL)
+  memset(HWPLset,0,7*framelistSize*sizeof(unsigned char));
+  for(j=0;j<tables->nwavelengths;++j)
     {
-      if(line[0] != '#')
+      for(i=0;i<framelistSize;++i)
 	{
-	  sscanf(line,"%d %d %d %d %d",&j,&WT1P,&WT2P,&WT3P,&WT4P);
-	  for(i=0;i<framelistSize;++i)
+	  if(tables->wavelengths[j].index == WL_Index[i])
 	    {
-	      if(j == WL_Index[i])
-		{
-		  PHWPLPOS[i*7  ]=WT1P;
-		  PHWPLPOS[i*7+1]=WT2P;
-		  PHWPLPOS[i*7+2]=WT3P;
-		  PHWPLPOS[i*7+3]=WT4P;
-		}
+	      PHWPLPOS[i*7  ]=tables->wavelengths[j].pos[0];
+	      PHWPLPOS[i*7+1]=tables->wavelengths[j].pos[1];
+	      PHWPLPOS[i*7+2]=tables->wavelengths[j].pos[2];
+	      PHWPLPOS[i*7+3]=tables->wavelengths[j].pos[3];
+	      memset(&HWPLset[i*7],1,4);
 	    }
 	}
     }
-  fclose(sequencefile);
-
-  sequencefile = fopen(filename3,"r");
-  if(sequencefile == NULL)
-    {
-      printf("The file %s does not exist or cannot be read\n",filename3);
-      free(filename);
-      free(filename2);
-      free(filename3);
-      filename=NULL;
-      filename2=NULL;
-      filename3=NULL;
-      return 1;//exit(EXIT_FAILURE);
-    }
 
-  for(j=0;j<6;++j) fgets(line,256,sequencefile);
-  while (fgets(line,256,sequencefile) != NULL)
+  for(j=0;j<tables->npolarizations;++j)
     {
-      if(line[0] != '#')
+      for(i=0;i<framelistSize;++i)
 	{
-	  sscanf(line,"%d %d %d %d",&j,&PS1P,&PS2P,&PS3P);
-	  for(i=0;i<framelistSize;++i)
+	  if(tables->polarizations[j].index == PL_Index[i])
 	    {
-	      if(j == PL_Index[i])
-		{
-		  PHWPLPOS[i*7+4]=PS1P;
-		  PHWPLPOS[i*7+5]=PS2P;
-		  PHWPLPOS[i*7+6]=PS3P;
-		}
+	      PHWPLPOS[i*7+4]=tables->polarizations[j].pos[0];
+	      PHWPLPOS[i*7+5]=tables->polarizations[j].pos[1];
+	      PHWPLPOS[i*7+6]=tables->polarizations[j].pos[2];
+	      memset(&HWPLset[i*7+4],1,3);
 	    }
 	}
     }
-  fclose(sequencefile);
 
 
   if(found == 0)
@@ -657,16 +613,13 @@ int framelistInfo(int HFLID,int HPLTID,int HWLTID,int WavelengthID,int *PHWPLPOS
       framelistSize=0; //problem occured
     }
 
-  free(filename);
-  free(filename2);
-  free(filename3);
-  filename=NULL;
-  filename2=NULL;
-  filename3=NULL;
+  //the framelist is not stored if it was not found (framelistSize=0: the error is reported again at the next call), or if WavelengthIndex was computed from values of FID not set here
+  if(framelistSize > 0 && nFID >= framelistSize) FramelistCachePut(HFLID,HPLTID,HWLTID,WavelengthID,CamIdIn,PHWPLPOS,HWPLset,WavelengthIndex,WavelengthLocation,paramset,*PPolarizationType,*Pcombine,*Pnpol,*PDataCadence,CameraValues,FID,nFID,framelistSize);
 
   return framelistSize;
 }
 
+
 /*------------------------------------------------------------------------------------------------------------------*/
 /*                                                                                                                  */
 /* Function from Richard and modified by Sebastien that produces a mask for the gapfilling                          */
@@ -675,6 +628,7 @@ int framelistInfo(int HFLID,int HPLTID,int HWLTID,int WavelengthID,int *PHWPLPOS
 /* 0 means pixel not missing                                                                                        */
 /* 1 means pixel missing and needs to be filled                                                                     */
 /* 2 means pixel missing and does not need to be filled                                                             */
+/* the crop mask of each image configuration (HIMGCFID) is built only once per process, by CropMask() in cropmask.c */
 /*                                                                                                                  */
 /*------------------------------------------------------------------------------------------------------------------*/
 
@@ -685,16 +639,11 @@ int MaskCreation(unsigned char *Mask, int nx, int ny, DRMS_Array_t  *BadPixels,
 
   if(nx != 4096 || ny != 4096) return status; //the mask creation function only works on 4096x4096 images
 
-  char *filename="/home/production/img_cnfg_ids"; //image configuration ID file
-  const int minid=80;
-  const int maxid=124;
-  const int n_tables=1;
-  const int maxtab=256;
-
   int *badpixellist=BadPixels->data; //ASSUMES THE PIXEL LIST IS IN INT
   int  nBadPixels=BadPixels->axis[0]; //number of bad pixels in the list
   int *cosmicraylist=NULL;
   int  ncosmic=0;
+
   if(CosmicRays != NULL)
     {
       cosmicraylist=CosmicRays->data;
@@ -702,277 +651,19 @@ int MaskCreation(unsigned char *Mask, int nx, int ny, DRMS_Array_t  *BadPixels,
     } 
   else ncosmic = -1;
 
-  int x_orig,y_orig,x_dir,y_dir;
-  int skip, take, skip_x, skip_y;
-  int datum, nsx, nss, nlin,nq,nqq,nsy;
-  int idn=-1;
-  
-  int *id=NULL, *tab=NULL, *nrows=NULL, *ncols=NULL, *rowstr=NULL, *colstr=NULL, *config=NULL;
-  id    =(int *)(malloc(maxtab*sizeof(int)));
-  if(id == NULL)
-    {
-      printf("Error: memory could not be allocated to id\n");
-      return 1;//exit(EXIT_FAILURE);
-    }
-  tab   =(int *)(malloc(maxtab*sizeof(int)));
-  if(tab == NULL)
-    {
-      printf("Error: memory could not be allocated to tab\n");
-      return 1;//exit(EXIT_FAILURE);
-    }
-  nrows =(int *)(malloc(maxtab*sizeof(int)));
-  if(nrows == NULL)
-    {
-      printf("Error: memory could not be allocated to nrows\n");
-      return 1;//exit(EXIT_FAILURE);
-    }
-  ncols =(int *)(malloc(maxtab*sizeof(int)));
-  if(ncols == NULL)
-    {
-      printf("Error: memory could not be allocated to ncols\n");
-      return 1;//exit(EXIT_FAILURE);
-    }
-  rowstr=(int *)(malloc(maxtab*sizeof(int)));
-  if(rowstr == NULL)
-    {
-      printf("Error: memory could not be allocated to rowstr\n");
-      return 1;//exit(EXIT_FAILURE);
-    }
-  colstr=(int *)(malloc(maxtab*sizeof(int)));
-  if(colstr == NULL)
-    {
-      printf("Error: memory could not be allocated to colstr\n");
-      return 1;//exit(EXIT_FAILURE);
-    }
-  config=(int *)(malloc(maxtab*sizeof(int)));
-  if(config == NULL)
-    {
-      printf("Error: memory could not be allocated to config\n");
-      return 1;//exit(EXIT_FAILURE);
-    }
-
-  int skipt[4*2048];
-  int taket[4*2048];
+  const unsigned char *CropArea=NULL;
+  int k;
 
-  int **kx=NULL;
-  int *kkx=NULL;
-
-  kx=(int **)(malloc(9*sizeof(int *)));
-  if(kx == NULL)
-    {
-      printf("Error: memory could not be allocated to kx\n");
-      return 1;//exit(EXIT_FAILURE);
-    }
-
-  //define different readout modes
-  int kx0[11]={4,0,0,1,0,1,1,0,1,1,1}; //EFGH
-  kx[0]=kx0;
-  int kx1[7]={2,1,0,1,1,1,2}; //FG
-  kx[2]=kx1;
-  int kx2[7]={2,0,1,0,0,1,2} ;//HE
-  kx[4]=kx2;
-  int kx3[7]={2,0,0,1,0,2,1}; //EF
-  kx[1]=kx3;
-  int kx4[7]={2,1,1,0,1,2,1}; //GH
-  kx[3]=kx4;
-  int kx5[7]={1,0,0,2,2}; //E
-  kx[5]=kx5;
-  int kx6[5]={1,1,0,2,2}; //F
-  kx[6]=kx6;
-  int kx7[5]={1,1,1,2,2}; //G
-  kx[7]=kx7;
-  int kx8[5]={1,0,1,2,2}; //H
-  kx[8]=kx8;
-
-  char **filename_table=NULL;
-  filename_table=(char **)(malloc(n_tables*sizeof(char *)));
-  if(filename_table == NULL)
+  status=CropMask(HIMGCFID,nx,ny,&CropArea); //crop mask of the image configuration, built only once per process
+  if(status == 0)
     {
-      printf("Error: memory could not be allocated to filename_table\n");
-      return 1;//exit(EXIT_FAILURE);
-    }
-  
-  char *filename_croptable="/home/cvsuser/cvsroot/EGSE/tables/crop/crop6";
-  filename_table[0]=filename_croptable;
- 
-  int i,j,k;
-  int ix, jx;
-  int n_config;
-  char string[256];
-  char strng[5];
-
-
-  FILE *config_file=NULL;
-  FILE *crop_table=NULL;
-
-   
-  config_file=fopen(filename, "r");
-  
-  if (config_file != NULL){
-    fgets(string, 256, config_file);
-    fgets(string, 256, config_file);
-    fgets(string, 256, config_file);
-     
-
-    n_config=0;
-    fscanf(config_file, "%d", &datum);
-    id[n_config]=datum;
-
-    do {
-      
-      fscanf(config_file, "%s", string);
-      
-      config[n_config]=0; //default change
-      if (string[0] == '4')config[n_config]=0;
-      if (string[0] == '2') if (string[7] == 'E')config[n_config]=1;
-      if (string[0] == '2') if (string[7] == 'F')config[n_config]=2;
-      if (string[0] == '2') if (string[7] == 'G')config[n_config]=3;
-      if (string[0] == '2') if (string[7] == 'H')config[n_config]=4;
-      if (string[0] == '1') if (string[7] == 'E')config[n_config]=5;
-      if (string[0] == '1') if (string[7] == 'F')config[n_config]=6;
-      if (string[0] == '1') if (string[7] == 'G')config[n_config]=7;
-      if (string[0] == '1') if (string[7] == 'H')config[n_config]=8;
-
-
-      fscanf(config_file, "%s", string);
-      
-      fscanf(config_file, "%s", string);
-      
-      fscanf(config_file, "%s", string);
-      
-      if (string[0] == 'N') tab[n_config]=-1;
-      if (string[0] == 'c') tab[n_config]=0;
-
-      fscanf(config_file, "%s", string);
-	
-      fscanf(config_file, "%d", &datum);
-      
-      fscanf(config_file, "%d", &datum);
-      
-      fscanf(config_file, "%s", string);
-      
-      fscanf(config_file, "%d", &datum);
-      nrows[n_config]=datum;
-      
-      fscanf(config_file, "%d", &datum);
-      ncols[n_config]=datum;
-      
-      fscanf(config_file, "%d", &datum);
-      rowstr[n_config]=datum;
-      
-      fscanf(config_file, "%d", &datum);
-      colstr[n_config]=datum;
-      
-      fscanf(config_file, "%d", &datum);
-      
-      fscanf(config_file, "%d", &datum);
-      
-      
-      
-      ++n_config;
-      fscanf(config_file, "%d", &datum);
-      id[n_config]=datum;
-
-      
-      
-      //fgets(string, 256, config_file);
-    }
-    while (!feof(config_file) && n_config < maxtab);
-    
-    fclose(config_file);
-  }
-  
-  //printf("reading done\n");
-  
-  for (i=0; i<n_config; ++i) if (id[i] == HIMGCFID) idn=i;
-  
-  skip_x=ncols[idn]/2;
-  skip_y=nrows[idn]/2;
-  
-  //printf("skip %d %d\n", skip_x, skip_y);
-
-  kkx=kx[config[idn]];
-  nq=kkx[0];
-  nlin=kkx[2*nq+3-2]*ny/2;
-  nss=kkx[2*nq+3-1]*nx/2;
-  
-  //printf("len %d %d %d\n", nlin, nss, nq);
-    
-  if (idn == -1)
-    {printf("Error: invalid HIMGCFID\n"); status=2;}
-  else
-    {
-      if (tab[idn] != -1)
-	{
-	  filename_croptable=filename_table[tab[idn]];
-	  crop_table=fopen(filename_croptable, "r");
-	  
-	  //for (k=0; k<23; ++k) 
-	  fscanf(crop_table, "%d", &datum); //read header
-	  
-	  fscanf(crop_table, "%d", &datum);
-	  fscanf(crop_table, "%d", &nqq);
-	  
-	  for (j=0; j<nqq; ++j)
-	    {
-	      fscanf(crop_table, "%d", &skip);
-	      fscanf(crop_table, "%d", &take);
-	      skipt[j]=skip;
-	      taket[j]=take;
-	    }
-	 
-	  fclose(crop_table); 
-	}
-      else
-	{
-	  printf("no crop table\n");
-	  
-	  for (k=0; k<nq; ++k)
-	    for (j=0; j<nlin; ++j)
-	      {
-		skipt[k*nss+j]=0;
-		taket[k*nss+j]=nss;
-	      }
-	}
-      
-      nsx=nss-skip_x;
-      nsy=nlin-skip_y;
-      
-      
-      
-      for (k=0; k<nq; ++k)
-	{
-	  x_orig=kkx[k*2+1]*nx - kkx[k*2+1];
-	  y_orig=kkx[k*2+2]*ny - kkx[k*2+2];
-	  x_dir=-(kkx[k*2+1])*2+1;
-	  y_dir=-(kkx[k*2+2])*2+1;
-	  
-	  
-	  for (j=0; j<skip_y; ++j) for (i=0; i<nss; ++i) Mask[(y_orig+y_dir*j)*nx+x_orig+x_dir*i]=2;   //fill edge rows with NAN
-	  for (j=0; j<nlin; ++j) for (i=0; i<skip_x; ++i) Mask[(y_orig+y_dir*j)*nx+x_orig+x_dir*i]=2;  //fill edge columns with NAN
-	  
-	  
-	  for (j=0; j<nsy; ++j)
-	    {
-	      jx=j+skip_y;
-	      
-	      for (i=0; i<minval(skipt[k*nss+j],nss); ++i){ix=i+skip_x; Mask[(y_orig+y_dir*jx)*nx+x_orig+x_dir*ix]=2;} //pixel OUTSIDE THE CROP TABLE: missing but does not need to be filled
-	      for (i=skipt[k*nss+j]; i<minval(skipt[k*nss+j]+taket[k*nss+j],nss); ++i){ix=i+skip_x; Mask[(y_orig+y_dir*jx)*nx+x_orig+x_dir*ix]=0;} //pixel INSIDE THE CROP TABLE not missing and does not need to be filled
-	      for (i=(skipt[k*nss+j]+taket[k*nss+j]); i<nss; ++i){ix=i+skip_x; Mask[(y_orig+y_dir*jx)*nx+x_orig+x_dir*ix]=2;}
-	    }
-	}
- 
-
       //NEED TO FILL THE NANs INSIDE THE CROP TABLE
       for(k=0;k<nx*ny;++k)
 	{
-	  if(Mask[k] == 0)
-	    {
-	      if(isnan(image[k])) Mask[k] = 1;
-	    }
+	  Mask[k]=CropArea[k];
+	  if(Mask[k] == 0 && isnan(image[k])) Mask[k] = 1;
 	}
 
-
       //NEED TO FILL THE BAD PIXELS INSIDE THE CROP TABLE (FROM THE BAD PIXEL LIST)
       if(ncosmic != -1 && nbadperm != -1) nBadPixels = nbadperm;//the cosmic-ray hit list is not missing and NBADPERM is a valid keyword
       if(nBadPixels > 0)
@@ -983,7 +674,8 @@ int MaskCreation(unsigned char *Mask, int nx, int ny, DRMS_Array_t  *BadPixels,
 	    }
 	}
 
-     //NEED TO CORRECT THE COSMIC-RAY HITS INSIDE THE CROP TABLE (FROM THE COSMIC RAY HIT LIST)
+
+      //NEED TO CORRECT THE COSMIC-RAY HITS INSIDE THE CROP TABLE (FROM THE COSMIC RAY HIT LIST)
       if(ncosmic > 0)
 	{     
 	  for (k=0;k<ncosmic;++k)
@@ -991,27 +683,7 @@ int MaskCreation(unsigned char *Mask, int nx, int ny, DRMS_Array_t  *BadPixels,
 	      if(Mask[cosmicraylist[k]] == 0) Mask[cosmicraylist[k]] = 1; //pixel not in the crop area and in the cosmic-ray hit list: needs to be filled
 	    }
 	}
-
-      status=0;
-      
     }
-  
-  free(id);
-  free(nrows);
-  free(ncols);
-  free(rowstr);
-  free(colstr);
-  free(config);
-  free(kx);
-  free(filename_table);
-  id=NULL;
-  nrows=NULL;
-  ncols=NULL;
-  rowstr=NULL;
-  colstr=NULL;
-  config=NULL;
-  kx=NULL;
-  filename_table=NULL;
 
   return status;
 }
@@ -1024,6 +696,11 @@ char *iquv_version() // Returns CVS version of IQUV averaging
 }
 
 
+//numerical keywords of the level 1 records read in one query (keyvector.c), in the order of Lev1KeyNames[] in DoIt()
+enum lev1key {LEV1_FSN,LEV1_TOBS,LEV1_HWL1POS,LEV1_HWL2POS,LEV1_HWL3POS,LEV1_HWL4POS,LEV1_HPL1POS,LEV1_HPL2POS,LEV1_HPL3POS,LEV1_FID,LEV1_HFTSACID,LEV1_HCAMID,
+	      LEV1_HCFTID,LEV1_CRPIX1,LEV1_CRPIX2,LEV1_X0LF,LEV1_Y0LF,LEV1_RSUN,LEV1_CROTA2,LEV1_CRLTOBS,LEV1_DSUNOBS,LEV1_HIMGCFID,LEV1_CDELT1,LEV1_OBSVR,
+	      LEV1_OBSVW,LEV1_OBSVN,LEV1_CARROT,LEV1_CRLNOBS,LEV1_HWLTID,LEV1_HPLTID,LEV1_EXPTIME,LEV1_NBADPERM,LEV1_QUALITY,LEV1_CALVER32,LEV1_CAMERA,NLEV1KEYS};
+
 
 /*---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
 /*                                                                                                                                                                                             */
@@ -1063,6 +740,7 @@ int DoIt(void)
   int   inRotationalFlat   = cmdparams_get_int(&cmdparams,RotationalFlat, NULL);      //Use rotational flat fields? yes=1, no=0 (default)
   char *dpath              = cmdparams_get_str(&cmdparams,"dpath",         NULL);      //directory where the source code is located
   int   inLinearity        = cmdparams_get_int(&cmdparams,Linearity,       NULL);      //Correct for non-linearity of cameras? yes=1, no=0 (default)
+  int   FrameCacheMB       = cmdparams_get_int(&cmdparams,FrameCacheIn,    NULL);      //maximum memory (in MB) used by the frame cache (0=no maximum)
 
   //THE FOLLOWING VARIABLES SHOULD BE SET AUTOMATICALLY BY OTHER PROGRAMS. FOR NOW SOME ARE SET MANUALLY
   char *CODEVERSION =NULL;                                                             //version of the IQUV averaging code
@@ -1129,8 +807,14 @@ int DoIt(void)
       //exit(EXIT_FAILURE);
     }
 
+  if(FrameCacheMB < 0)                                                                 //check that the memory budget of the frame cache is valid
+    {
+      printf("The parameter framecache must be positive or 0\n");
+      return 1;
+    }
 
-  printf("COMMAND LINE PARAMETERS= %s %s %d %d %f %d %d %d %d %s %d\n",inRecQuery,inRecQuery2,WavelengthID,CamId,DataCadence,Npolin,QuickLook,Averaging,inRotationalFlat,dpath,inLinearity);
+
+  printf("COMMAND LINE PARAMETERS= %s %s %d %d %f %d %d %d %d %s %d %d\n",inRecQuery,inRecQuery2,WavelengthID,CamId,DataCadence,Npolin,QuickLook,Averaging,inRotationalFlat,dpath,inLinearity,FrameCacheMB);
 
 
   // Main Parameters                                                                                                    
@@ -1172,8 +856,6 @@ int DoIt(void)
   DRMS_RecordSet_t *recLev1  = NULL;                                 //records for the level 1 data (input data)
   DRMS_RecordSet_t *recLev1p = NULL;                                 //record for the level 1p data (output data)
   DRMS_RecordSet_t *rectemp  = NULL;     
-  DRMS_RecordSet_t *recflat  = NULL;                                 //record for the pzt flatfield
-  DRMS_RecordSet_t *recflatrot= NULL;                                //record for the rotational flatfield
 
   char  CosmicRaySeries[MaxNString]= "hmi.cosmic_rays";     //name of the series containing the cosmic-ray hits
   char  HMISeries[MaxNString];
@@ -1192,7 +874,6 @@ int DoIt(void)
   char  **source;
   char  recnums[MaxNString];
   char  HMIRotationalFlats[MaxNString]= "hmi.flatfield_update";//contains the rotational flatfields
-  char  HMIFlatField0[MaxNString];
   char  *HMIFlatField;                                               //pzt flafields applied to hmi.lev1 records
 
   TIME  MaxSearchDistanceL,MaxSearchDistanceR;
@@ -1220,7 +901,7 @@ int DoIt(void)
   int   nTime=0;                                                     //number of loops over the time variable
   int   PHWPLPOS[MaxNumFiltergrams*7];
   int   WavelengthIndex[MaxNumFiltergrams], WavelengthLocation[MaxNumFiltergrams], OrganizeFramelist=0,  OrganizeFramelist2=0, *FramelistArray=NULL, *SegmentStatus=NULL;
-  int   FiltergramLocation, Needed;
+  int   FiltergramLocation;
   int   TargetWavelength=0;                                          //index of the filtergram level 1 with the wavelength WavelengthID and that is closest to TargetTime
   int  *IndexFiltergram=NULL;                                        //an array that will contain the indeces of level 1 filtergrams with wavelength=WavelengthID 
   int  nIndexFiltergram;                                             //size of array IndexFiltergram
@@ -1250,10 +931,11 @@ int DoIt(void)
   int  *HPLTID=NULL;
   int   WavelengthID2;
   int  *KeywordMissing=NULL;
-  int  *SegmentRead=NULL;                                            //Array that provides the status of the level 1 filtergrams
-                                                                     //SegmentRead[i]=0 if the segment of the filtergram i is not in memory, and the keywords of the filtergrams are OK
-                                                                     //SegmentRead[i]=1 if the segment of the filtergram i is in memory and will be used again, and the keywords are OK
-                                                                     //SegmentRead[i]=-1 if the segment of the filtergram i is missing or corrupt, or the keywords are missing or corrupt
+  struct framecache Frames;                                          //gapfilled level 1 filtergrams kept in memory. Frames.frame[i].state provides the status of the level 1 filtergram i:
+                                                                     //FRAME_NOTREAD if the segment of the filtergram i is not in memory, and the keywords of the filtergrams are OK
+                                                                     //FRAME_CACHED if the segment of the filtergram i is in memory and will be used again, and the keywords are OK
+                                                                     //FRAME_CORRUPT if the segment of the filtergram i is missing or corrupt, or the keywords are missing or corrupt
+  struct flatfieldcache Flats;                                       //pzt and rotational flat fields kept in memory, when rotational=1
   int  *Badkeyword=NULL;
   int  *HCAMID=NULL;                                                 //front or side camera?
   int   ngood;
@@ -1275,7 +957,6 @@ int DoIt(void)
   int  *QUALITYlev1=NULL;
   int  *QUALITYLEV1=NULL;
   int   COSMICCOUNT=0;
-  int   initialrun=0;
   int  *totalTempIntNum;
   int  *CAMERA=NULL;
 
@@ -1415,20 +1096,20 @@ int DoIt(void)
   char *SOURCES           = "SOURCE";
   char *QUALLEV1S         = "QUALLEV1";
   char *ROTFLAT           = "ROT_FLAT";                              //rotational flat field was used (query used) or not (empty string)
+  struct keyvector Lev1Keys;                                         //numerical keywords of the level 1 records, read in one query
+  const char *Lev1KeyNames[NLEV1KEYS]={FSNS,TOBSS,HWL1POSS,HWL2POSS,HWL3POSS,HWL4POSS,HPL1POSS,HPL2POSS,HPL3POSS,FIDS,"HFTSACID",HCAMIDS,HCFTIDS,CRPIX1S,CRPIX2S,X0LFS,Y0LFS,
+				       RSUNS,CROTA2S,CRLTOBSS,DSUNOBSS,HIMGCFIDS,CDELT1S,OBSVRS,OBSVWS,OBSVNS,CARROTS,CRLNOBSS,HWLTIDS,HPLTIDS,"EXPTIME",NBADPERMS,QUALITYS,CALVER32S,CAMERAS};
   char QueryFlatField[MaxNString];
   strcpy(QueryFlatField,"");
 
-  DRMS_Array_t **Segments=NULL;                                      //pointer to pointers to structures that will contain the segments of the level 1 filtergrams
-  DRMS_Array_t **Ierror=NULL;                                        //for gapfilling code
+  DRMS_Array_t  *FrameImage=NULL;                                   //segment of the level 1 filtergram being read and gapfilled, before it is stored in the frame cache
+  DRMS_Array_t  *FrameError=NULL;                                    //for gapfilling code
   DRMS_Array_t *arrin[TempIntNum];                                   //arrays that will contain pointers to the segments of the filtergrams needed for temporal interpolation
   DRMS_Array_t *arrerrors[TempIntNum];                               //arrays that will contain pointers to the error maps returned by the gapfilling code
   DRMS_Array_t  *BadPixels= NULL;                                    //list of bad pixels, for gapfilling code
   DRMS_Array_t  *CosmicRays= NULL;                                   //list of cosmic ray hits
   DRMS_Array_t **arrLev1d= NULL;                                     //pointer to pointer to an array that will contain a lev1d data produced by Richard's function
   DRMS_Array_t **arrLev1p= NULL;                                     //pointer to pointer of an array that will contain a lev1p data produced by Jesper's function
-  DRMS_Array_t  *flatfield=NULL;                                     //pzt flatfield used for hmi.lev1 records
-  DRMS_Array_t  *flatfieldrot=NULL;                                  //rotational flat field
-  DRMS_Array_t *rotationalflats=NULL;
 
   DRMS_Segment_t *segin  = NULL;		                     
   DRMS_Segment_t *segout = NULL;		                     
@@ -1447,8 +1128,6 @@ int DoIt(void)
   struct polcal_struct pars;                                         //for initialization of Jesper's routine
 
   double minimum,maximum,median,mean,sigma,skewness,kurtosis;        //for Keh-Cheng's statistics functions
-  double *keyF=NULL;
-  double TSTARTFLAT=0.0, TSTOPFLAT=0.0;
 
   //VALUES USED PRIOR TO JANUARY 15, 2014:
   //to remove non-linearity of cameras (values from sun_lin.pro, from hmi_ground.lev0[1420880-1420945])
@@ -1744,32 +1423,15 @@ int DoIt(void)
 	  printf("Error: memory could not be allocated to Y0\n");
 	  return 1;//exit(EXIT_FAILURE);
 	}
-      SegmentRead= (int *)malloc(nRecs1*sizeof(int));
-      if(SegmentRead == NULL)
-	{
-	  printf("Error: memory could not be allocated to SegmentRead\n");
-	  return 1;//exit(EXIT_FAILURE);
-	}
+      status=FrameCacheCreate(&Frames,nRecs1,(long long)FrameCacheMB*1048576LL);
+      if(status != 0) return 1;//exit(EXIT_FAILURE);
+      FlatFieldCacheCreate(&Flats,HMIRotationalFlats);
       KeywordMissing= (int *)malloc(nRecs1*sizeof(int));
       if(KeywordMissing == NULL)
 	{
 	  printf("Error: memory could not be allocated to KeywordMissing\n");
 	  return 1;//exit(EXIT_FAILURE);
 	}
-      Segments   = (DRMS_Array_t **)malloc(nRecs1*sizeof(DRMS_Array_t *));
-      if(Segments == NULL)
-	{
-	  printf("Error: memory could not be allocated to Segments\n");
-	  return 1;//exit(EXIT_FAILURE);
-	}
-      for(i=0;i<nRecs1;i++) Segments[i]=NULL;
-      Ierror   = (DRMS_Array_t **)malloc(nRecs1*sizeof(DRMS_Array_t *));
-      if(Ierror == NULL)
-	{
-	  printf("Error: memory could not be allocated to Ierror\n");
-	  return 1;//exit(EXIT_FAILURE);
-	}
-      for(i=0;i<nRecs1;i++) Ierror[i]=NULL;
       IndexFiltergram = (int *)malloc(nRecs1*sizeof(int));     //array that will contain the record index of the filtergrams with the same wavelength as WavelengthID
       if(IndexFiltergram == NULL)
 	{
@@ -1897,20 +1559,21 @@ int DoIt(void)
       //create an array IndexFiltergram with the record index of all the filtergrams with the wavelength WavelengthID
       //***********************************************************************************************************************
       
+      KeyVectorRead(drms_env,HMISeriesLev1,recLev1,NLEV1KEYS,Lev1KeyNames,&Lev1Keys);
       k=0;
       for(i=0;i<nRecs1;++i)  //loop over all the opened level 1 records
 	{	  
-	  FSN[i]        = drms_getkey_int(recLev1->records[i] ,FSNS            ,&statusA[0]); //not actually needed, just for debugging purpose
-	  internTOBS[i] = drms_getkey_time(recLev1->records[i],TOBSS           ,&statusA[1]);
-	  HWL1POS[i]    = drms_getkey_int(recLev1->records[i] ,HWL1POSS        ,&statusA[2]);
-	  HWL2POS[i]    = drms_getkey_int(recLev1->records[i] ,HWL2POSS        ,&statusA[3]); 
-	  HWL3POS[i]    = drms_getkey_int(recLev1->records[i] ,HWL3POSS        ,&statusA[4]); 
-	  HWL4POS[i]    = drms_getkey_int(recLev1->records[i] ,HWL4POSS        ,&statusA[5]);
-	  HPL1POS[i]    = drms_getkey_int(recLev1->records[i] ,HPL1POSS        ,&statusA[6]);
-	  HPL2POS[i]    = drms_getkey_int(recLev1->records[i] ,HPL2POSS        ,&statusA[7]);
-	  HPL3POS[i]    = drms_getkey_int(recLev1->records[i] ,HPL3POSS        ,&statusA[8]);
-	  FID[i]        = drms_getkey_int(recLev1->records[i] ,FIDS            ,&statusA[9]);
-	  HFLID[i]      = drms_getkey_int(recLev1->records[i] ,"HFTSACID"      ,&statusA[10]);
+	  FSN[i]        = KeyVectorInt(&Lev1Keys,LEV1_FSN,recLev1,i,&statusA[0]); //not actually needed, just for debugging purpose
+	  internTOBS[i] = KeyVectorTime(&Lev1Keys,LEV1_TOBS,recLev1,i,&statusA[1]);
+	  HWL1POS[i]    = KeyVectorInt(&Lev1Keys,LEV1_HWL1POS,recLev1,i,&statusA[2]);
+	  HWL2POS[i]    = KeyVectorInt(&Lev1Keys,LEV1_HWL2POS,recLev1,i,&statusA[3]); 
+	  HWL3POS[i]    = KeyVectorInt(&Lev1Keys,LEV1_HWL3POS,recLev1,i,&statusA[4]); 
+	  HWL4POS[i]    = KeyVectorInt(&Lev1Keys,LEV1_HWL4POS,recLev1,i,&statusA[5]);
+	  HPL1POS[i]    = KeyVectorInt(&Lev1Keys,LEV1_HPL1POS,recLev1,i,&statusA[6]);
+	  HPL2POS[i]    = KeyVectorInt(&Lev1Keys,LEV1_HPL2POS,recLev1,i,&statusA[7]);
+	  HPL3POS[i]    = KeyVectorInt(&Lev1Keys,LEV1_HPL3POS,recLev1,i,&statusA[8]);
+	  FID[i]        = KeyVectorInt(&Lev1Keys,LEV1_FID,recLev1,i,&statusA[9]);
+	  HFLID[i]      = KeyVectorInt(&Lev1Keys,LEV1_HFTSACID,recLev1,i,&statusA[10]);
 
 	  //SOME SEQUENCES NEED TO COMBINE FRONT AND SIDE CAMERAS TO PRODUCE I,Q,U,V BUT TAKE TWICE THE SAME SEQUENCE ON THE
 	  //FRONT CAMERA. IN THESE CASES, THE FID OF THE SECOND HALF OF THE SEQUENCE NEEDS TO BE CHANGED FOR THE CODE
@@ -1929,9 +1592,9 @@ int DoIt(void)
 	      
 	    }
 	  
-	  HCAMID[i]     = drms_getkey_int(recLev1->records[i] ,HCAMIDS         ,&statusA[11]);
+	  HCAMID[i]     = KeyVectorInt(&Lev1Keys,LEV1_HCAMID,recLev1,i,&statusA[11]);
 	  if(HCAMID[i] != LIGHT_SIDE && HCAMID[i] != LIGHT_FRONT) statusA[11]=1;              //we have a dark frame, and this is an error
-	  CFINDEX[i]    = drms_getkey_int(recLev1->records[i] ,HCFTIDS         ,&statusA[12]);
+	  CFINDEX[i]    = KeyVectorInt(&Lev1Keys,LEV1_HCFTID,recLev1,i,&statusA[12]);
 	  IMGTYPE[i]    = (char *)malloc(6*sizeof(char *));                                   //6 because IMG_TYPE is either LIGHT or DARK, i.e. 5 characters + \0 
 	  if(IMGTYPE[i] == NULL)
 	    {
@@ -1939,16 +1602,16 @@ int DoIt(void)
 	      return 1;//exit(EXIT_FAILURE);
 	    }
 	  IMGTYPE[i]    = drms_getkey_string(recLev1->records[i],IMGTYPES       ,&statusA[13]);
-	  X0[i]         = (float)drms_getkey_double(recLev1->records[i],CRPIX1S, &statusA[14]);
+	  X0[i]         = (float)KeyVectorDouble(&Lev1Keys,LEV1_CRPIX1,recLev1,i, &statusA[14]);
 	  if(statusA[14] == DRMS_SUCCESS && !isnan(X0[i])) X0[i]=X0[i]-1.0;                   //BECAUSE CRPIX1 STARTS AT 1
 	  else statusA[14] = 1;
-	  Y0[i]         = (float)drms_getkey_double(recLev1->records[i],CRPIX2S,&statusA[15]);
+	  Y0[i]         = (float)KeyVectorDouble(&Lev1Keys,LEV1_CRPIX2,recLev1,i,&statusA[15]);
 	  if(statusA[15] == DRMS_SUCCESS && !isnan(Y0[i])) Y0[i]=Y0[i]-1.0;                   //BECAUSE CRPIX2 STARTS AT 1
 	  else statusA[15] = 1;
 
 
-	  X0LF = (float)drms_getkey_double(recLev1->records[i],X0LFS, &status);
-	  Y0LF = (float)drms_getkey_double(recLev1->records[i],Y0LFS, &status2);
+	  X0LF = (float)KeyVectorDouble(&Lev1Keys,LEV1_X0LF,recLev1,i, &status);
+	  Y0LF = (float)KeyVectorDouble(&Lev1Keys,LEV1_Y0LF,recLev1,i, &status2);
 	  if(status != DRMS_SUCCESS || status2 != DRMS_SUCCESS || isnan(X0LF) || isnan(Y0LF))
 	    {
 	      statusA[14]=1;
@@ -1959,9 +1622,9 @@ int DoIt(void)
 	    }
 
 
-	  RSUN[i]       = (float)drms_getkey_double(recLev1->records[i],RSUNS   ,&statusA[16]);
+	  RSUN[i]       = (float)KeyVectorDouble(&Lev1Keys,LEV1_RSUN,recLev1,i,&statusA[16]);
 	  if(isnan(RSUN[i])) statusA[16]=1;
-	  CROTA2[i]     = (float)drms_getkey_double(recLev1->records[i],CROTA2S ,&statusA[17]);
+	  CROTA2[i]     = (float)KeyVectorDouble(&Lev1Keys,LEV1_CROTA2,recLev1,i,&statusA[17]);
 
 	  //CHECK FOR WRONG VALUES OF CROTA2 (ABSURD VALUES CAN BE SET IN LEV 1 RECORDS IF THE ANCILLARY DATA HAVE NOT BEEN RECEIVED)
 	  if(statusA[17] == DRMS_SUCCESS && !isnan(CROTA2[i]))
@@ -1971,24 +1634,24 @@ int DoIt(void)
 
 	  if(statusA[17] == DRMS_SUCCESS && !isnan(CROTA2[i])) CROTA2[i]=-CROTA2[i];          //BECAUSE CROTA2 IS THE NEGATIVE OF THE P-ANGLE
 	  else statusA[17] = 1;
-	  CRLTOBS[i]    = (float)drms_getkey_double(recLev1->records[i],CRLTOBSS,&statusA[18]);
+	  CRLTOBS[i]    = (float)KeyVectorDouble(&Lev1Keys,LEV1_CRLTOBS,recLev1,i,&statusA[18]);
 	  if(isnan(CRLTOBS[i])) statusA[18] = 1;
-	  DSUNOBS[i]    = drms_getkey_double(recLev1->records[i],DSUNOBSS,&statusA[19]);
+	  DSUNOBS[i]    = KeyVectorDouble(&Lev1Keys,LEV1_DSUNOBS,recLev1,i,&statusA[19]);
 	  if(isnan(DSUNOBS[i])) statusA[19] = 1;
-	  HIMGCFID[i]   = drms_getkey_int(recLev1->records[i] ,HIMGCFIDS        ,&statusA[20]);
+	  HIMGCFID[i]   = KeyVectorInt(&Lev1Keys,LEV1_HIMGCFID,recLev1,i,&statusA[20]);
 	  if(isnan(HIMGCFID[i])) statusA[20] = 1;
-	  CDELT1[i]     = (float)drms_getkey_double(recLev1->records[i] ,CDELT1S,&statusA[21]);
+	  CDELT1[i]     = (float)KeyVectorDouble(&Lev1Keys,LEV1_CDELT1,recLev1,i,&statusA[21]);
 	  if(isnan(CDELT1[i])) statusA[21] = 1;
-	  OBSVR[i]      = drms_getkey_double(recLev1->records[i] ,OBSVRS ,&statusA[22]);
+	  OBSVR[i]      = KeyVectorDouble(&Lev1Keys,LEV1_OBSVR,recLev1,i,&statusA[22]);
 	  if(isnan(OBSVR[i])) statusA[22] = 1;
-	  OBSVW[i]      = drms_getkey_double(recLev1->records[i] ,OBSVWS ,&statusA[23]);
+	  OBSVW[i]      = KeyVectorDouble(&Lev1Keys,LEV1_OBSVW,recLev1,i,&statusA[23]);
 	  if(isnan(OBSVW[i])) statusA[23] = 1;
-	  OBSVN[i]      = drms_getkey_double(recLev1->records[i] ,OBSVNS ,&statusA[24]);
+	  OBSVN[i]      = KeyVectorDouble(&Lev1Keys,LEV1_OBSVN,recLev1,i,&statusA[24]);
 	  if(isnan(OBSVN[i])) statusA[24] = 1;
-	  CARROT[i]     = drms_getkey_int(recLev1->records[i] ,CARROTS          ,&statusA[25]);
-	  SegmentRead[i]= 0;                                                                  //initialization: segment not in memory
+	  CARROT[i]     = KeyVectorInt(&Lev1Keys,LEV1_CARROT,recLev1,i,&statusA[25]);
+	  Frames.frame[i].fsn=FSN[i];
 	  KeywordMissing[i]=0;                                                                //no keyword is nissing, a priori
-	  CRLNOBS[i]    = (float)drms_getkey_double(recLev1->records[i] ,CRLNOBSS,&statusA[26]);
+	  CRLNOBS[i]    = (float)KeyVectorDouble(&Lev1Keys,LEV1_CRLNOBS,recLev1,i,&statusA[26]);
 	  if(isnan(CRLNOBS[i])) statusA[26] = 1;
 	  //HGLNOBS[i]    = (float)drms_getkey_double(recLev1->records[i] ,HGLNOBSS,&statusA[27]);
 	  //XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX
@@ -1996,8 +1659,8 @@ int DoIt(void)
 	  statusA[27]=0;
 	  //XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX
 	  //if(isnan(HGLNOBS[i])) statusA[27] = 1;
-	  HWLTID[i]     = drms_getkey_int(recLev1->records[i] ,HWLTIDS           ,&statusA[28]);
-	  HPLTID[i]     = drms_getkey_int(recLev1->records[i] ,HPLTIDS           ,&statusA[29]);
+	  HWLTID[i]     = KeyVectorInt(&Lev1Keys,LEV1_HWLTID,recLev1,i,&statusA[28]);
+	  HPLTID[i]     = KeyVectorInt(&Lev1Keys,LEV1_HPLTID,recLev1,i,&statusA[29]);
 	  HWLTNSET[i]   = (char *)malloc(7*sizeof(char *));                                  //6 because HWLTNSET is either OPEN or CLOSED, i.e. 6 characters + \0 
 	  if(HWLTNSET[i] == NULL)
 	    {
@@ -2005,21 +1668,21 @@ int DoIt(void)
 	      return 1;//exit(EXIT_FAILURE);
 	    }
 	  HWLTNSET[i]   = drms_getkey_string(recLev1->records[i] ,HWLTNSETS      ,&statusA[30]);
-	  EXPTIME[i]    = (float)drms_getkey_double(recLev1->records[i],"EXPTIME",&statusA[31]);
+	  EXPTIME[i]    = (float)KeyVectorDouble(&Lev1Keys,LEV1_EXPTIME,recLev1,i,&statusA[31]);
 	      
-	  NBADPERM[i]   = drms_getkey_int(recLev1->records[i] ,NBADPERMS         ,&statusA[32]);
+	  NBADPERM[i]   = KeyVectorInt(&Lev1Keys,LEV1_NBADPERM,recLev1,i,&statusA[32]);
 	  if(statusA[32] != DRMS_SUCCESS) NBADPERM[i]=-1;
-	  QUALITYin[i]  = drms_getkey_int(recLev1->records[i] ,QUALITYS          ,&statusA[33]);
+	  QUALITYin[i]  = KeyVectorInt(&Lev1Keys,LEV1_QUALITY,recLev1,i,&statusA[33]);
 	  if(statusA[33] != DRMS_SUCCESS) KeywordMissing[i]=1;
 	  //WE TEST WHETHER THE DATA SEGMENT IS MISSING
 	  if( (QUALITYin[i] & Q_MISSING_SEGMENT) == Q_MISSING_SEGMENT)
 	    {
 	      statusA[33]=1;
-	      SegmentRead[i]= -1;
+	      FrameCacheDrop(&Frames,i,FRAME_CORRUPT);
 	      KeywordMissing[i]=1;
 	    }
 	  
-	  CALVER32[i]   = (long long)drms_getkey_int(recLev1->records[i] ,CALVER32S    ,&statusA[34]);
+	  CALVER32[i]   = (long long)KeyVectorInt(&Lev1Keys,LEV1_CALVER32,recLev1,i,&statusA[34]);
 	  if(statusA[34] != DRMS_SUCCESS)
 	    {
 	      CALVER32[i]=CALVER_DEFAULT; //following Phil's email of August 27, 2012
@@ -2030,7 +1693,7 @@ int DoIt(void)
 	      printf("Error: CALVER32[%d] is different from CALVER32[0]\n",i);
 	      return 1;
 	    }
-	  CAMERA[i]  = drms_getkey_int(recLev1->records[i],CAMERAS,&statusA[35]); //Phil required a test on CAMERA on 12/20/2012
+	  CAMERA[i]  = KeyVectorInt(&Lev1Keys,LEV1_CAMERA,recLev1,i,&statusA[35]); //Phil required a test on CAMERA on 12/20/2012
 	  if(CAMERA[i] == -2147483648 || statusA[35] != DRMS_SUCCESS) KeywordMissing[i]=1;//missing CAMERA keyword
 
 	  //CORRECTION OF R_SUN and CRPIX1 FOR LIMB FINDER ARTIFACTS
@@ -2087,7 +1750,7 @@ int DoIt(void)
 	      strcpy(HWLTNSET[i],"NONE");
 	      EXPTIME[i]    = MISSINGKEYWORD;
 
-	      //SegmentRead[i]= -1; //-1 denotes a problem with the data segment
+	      //FrameCacheDrop(&Frames,i,FRAME_CORRUPT); //denotes a problem with the data segment
 	      KeywordMissing[i]=1;
 	    }
 	  else
@@ -2099,6 +1762,7 @@ int DoIt(void)
 		}
 	    }
 	}
+      KeyVectorFree(&Lev1Keys);
       
       nIndexFiltergram=k;
       if(nIndexFiltergram == 0) //no filtergram was found with the target wavelength in the opened records
@@ -2691,13 +2355,14 @@ int DoIt(void)
   /*                                                                                                      */
   /********************************************************************************************************/
 
-  initialrun=1;
+
 
   for(it=0;it<nWavelengths;++it) //nWavelengths=5, 6, 8, or 10
     {
       printf("----------------------------------------------------------------------------------------\n");
       printf("CURRENT WAVELENGTH/FILTER NUMBER = %d\n",it);
       printf("----------------------------------------------------------------------------------------\n");
+      FrameCacheFlush(&Frames);                                     //the target time starts over, with the filtergrams of another wavelength
 
       /********************************************************************************************************/
       /*                                                                                                      */
@@ -2715,30 +2380,6 @@ int DoIt(void)
 
       while(TargetTime <= TimeEnd)
 	{
-	  
-
-	  //additional tests when rotational flat field is required
-	  if(inRotationalFlat == 1) 
-	    {
-	      
-	      //check that the run does not straddle 2 days
-	      if(floor(TargetTime/86400.0) != floor(PreviousTargetTime/86400.0) )
-		{
-		  printf("Error: the new target time is for a different day than the previous target time: you are not allowed to change day when applying a rotational flat field\n");
-		  return 1;
-		}
-	      
-	      //check that TargetTime is still within the range of the rotational flat field used
-	      if(initialrun != 1)
-		{
-		  if(TargetTime < TSTARTFLAT || TargetTime > TSTOPFLAT)
-		    {
-		      printf("Error: the target time is not within the time range for which the rotation flat field used is valid\n");
-		      return 1;
-		    }
-		}
-	      
-	    }
 
 	  
 	  sprint_time(timeBegin2,TargetTime,"TAI",0);                   //convert the time TargetTime from TIME format to a string with TAI type
@@ -2869,132 +2510,18 @@ int DoIt(void)
 
 	      if(inRotationalFlat == 1)                                               //rotation flatfield wanted instead of pzt flatfield
 		{
-
-		  HMIFlatField    = (char *)malloc(MaxNString*sizeof(char *));
-		  if(HMIFlatField == NULL)
-		    {
-		      printf("Error: memory could not be allocated to HMIFlatField\n");
-		      return 1;//exit(EXIT_FAILURE);
-		    }
-
 		  HMIFlatField    = drms_getkey_string(recLev1->records[temp],FLATREC,&status);  //read the pzt flatfield used
 		  if (status != DRMS_SUCCESS)
 		    {
 		      printf("Error: could not read the FLAT_REC keyword for the target filtergram FSN= %d",FSN[temp]);
 		      return 1;
 		    }
-		  else
-		    {
-		      printf("PZT FLAT FIELD USED ON TARGET FILTERGRAM= %s\n",HMIFlatField);
-		      if(initialrun == 1)
-			{
-			  strcpy(HMIFlatField0,HMIFlatField); //if this is the first timestep of this run of the observables code
-
-			  //access the pzt flatfield
-			  recflat  = drms_open_records(drms_env,HMIFlatField,&status);
-			  if (status != DRMS_SUCCESS || recflat == NULL || recflat->n == 0)
-			    {
-			      printf("Error: record missing or corrupt for the flat field query %s\n",HMIFlatField);
-			      return 1;
-			    }
-			  segin     = drms_segment_lookup(recflat->records[0],"flatfield");
-			  flatfield = drms_segment_read(segin,type1d,&status); 
-			  if (status != DRMS_SUCCESS || flatfield == NULL)
-			  {
-			    printf("Error: could not read the data segment for the flat field query %s\n",HMIFlatField);
-			    return 1;
-			  }
-			  pztflat  = flatfield->data;
-			  status=drms_close_records(recflat,DRMS_FREE_RECORD);
-
-			  //access the rotational flatfield
-			  char keylist[]="T_START,T_STOP";
-			  int unique = 0;
-			  rotationalflats = drms_record_getvector(drms_env,HMIRotationalFlats,keylist,DRMS_TYPE_DOUBLE,unique,&status);
-			  if(status != DRMS_SUCCESS)
-			    {
-			      printf("Error: cannot read a list of keywords in the rotation flat-field series\n");
-			      return 1;
-			    }
-			  printf("DIMENSIONS OF ROTATIONAL FLAT-FIELD SERIES= %d %d\n",rotationalflats->axis[0],rotationalflats->axis[1]);
-			  int n0,n1;
-			  n1  =rotationalflats->axis[1]; //number of rotational flat-field records found
-			  n0  =rotationalflats->axis[0]; //number of keywords read (should be 2)
-			  keyF=rotationalflats->data;
-
-			  i=0;
-			  while(TargetTime > keyF[i] && TargetTime > keyF[n1+i])
-			    {
-			      i++;
-			    }
-
-			  if(TargetTime >= keyF[i] && TargetTime <= keyF[n1+i]) //we want this record
-			    {
-			      //we build the query for the rotational flatfield 
-			      TSTARTFLAT=keyF[i];
-			      TSTOPFLAT =keyF[n1+i];
-			      sprint_time(query,keyF[i],"TAI",1);
-			      strcpy(QueryFlatField,HMIRotationalFlats); 
-			      strcat(QueryFlatField,"[");
-			      if(CamId == LIGHT_SIDE)  strcat(QueryFlatField,"1"); 
-			      if(CamId == LIGHT_FRONT) strcat(QueryFlatField,"2");
-			      strcat(QueryFlatField,"][");
-			      strcat(QueryFlatField,query);
-			      strcat(QueryFlatField,"]");
-			      printf("QUERY FOR ROTATIONAL FLAT FIELD= %s\n",QueryFlatField);
-	
-			      //we read the rotational flat field
-			      recflatrot  = drms_open_records(drms_env,QueryFlatField,&status);
-			      if (status != DRMS_SUCCESS || recflatrot == NULL || recflatrot->n == 0)
-				{
-				  printf("Error: record missing or corrupt for the rotational flat field query %s\n",QueryFlatField);
-				  return 1;
-				}
-			      segin     = drms_segment_lookup(recflatrot->records[0],"flatfield");
-			      flatfieldrot = drms_segment_read(segin,type1d,&status); 
-			      if (status != DRMS_SUCCESS || flatfieldrot == NULL)
-				{
-				  printf("Error: could not read the data segment for the rotational flat field query %s\n",QueryFlatField);
-				  return 1;
-				}
-			      rotflat  = flatfieldrot->data;
-			      
-			    }
-			  else //no rotational flafield record exists for the target time 
-			    {
-			      printf("Error: no rotational flat field record exists for the target time %s\n",timeBegin2);
-			      return 1;
-			    }
-
-			  drms_free_array(rotationalflats);
-			  rotationalflats=NULL;
-			}//if(initialrun == 1)
-		      else if(strcmp(HMIFlatField,HMIFlatField0) != 0) //if the pzt flatfield changes during a run of the osbervables code
-			{
-			  printf("Warning: the hmi.flatfield record used to produce the level 1 records changed during the run of the observables code\n");
-			  printf("The new hmi,flatfield record used is: %s\n",HMIFlatField);
-			  //access the pzt flatfield
-			  recflat  = drms_open_records(drms_env,HMIFlatField,&status);
-			  if (status != DRMS_SUCCESS || recflat == NULL || recflat->n == 0)
-			    {
-			      printf("Error: record missing or corrupt for the flat field query %s\n",HMIFlatField);
-			      return 1;
-			    }
-			  drms_free_array(flatfield);
-			  strcpy(HMIFlatField0,HMIFlatField);
-			  segin     = drms_segment_lookup(recflat->records[0],"flatfield");
-			  flatfield = drms_segment_read(segin,type1d,&status); 
-			  if (status != DRMS_SUCCESS || flatfield == NULL)
-			  {
-			    printf("Error: could not read the data segment for the flat field query %s\n",HMIFlatField);
-			    return 1;
-			  }
-			  pztflat  = flatfield->data;
-			  status=drms_close_records(recflat,DRMS_FREE_RECORD);
-			}
-
-		    }
+		  printf("PZT FLAT FIELD USED ON TARGET FILTERGRAM= %s\n",HMIFlatField);
+		  pztflat = FlatFieldPzt(&Flats,drms_env,HMIFlatField);                       //read only once, then kept in memory
 		  free(HMIFlatField);
+		  if(pztflat == NULL) return 1;
+		  rotflat = FlatFieldRotational(&Flats,drms_env,(HCAMID[temp] == LIGHT_SIDE) ? 1 : 2,internTOBS[temp]); //flat field of the validity interval that contains the filtergram
+		  if(rotflat == NULL) return 1;
 		}//if(inRotationalFlat == 1)
 	      
 	      //*************************************************************************************
@@ -3310,28 +2837,12 @@ int DoIt(void)
 	      printf("\n");
 
 	      
-	      //looking for filtergrams whose segment is already in memory but that are not needed anymore, and delete them
+	      //the filtergrams already in memory that are needed at this target time are marked as used (the frame cache does not evict them),
+	      //and the filtergrams in memory that are not needed at this target time are deleted
 	      //**************************************************************************************************************
-	      
-	      
-	      for(ii=0;ii<nRecs1;++ii) //loop over all the opened records (TRY TO FIND A FASTER WAY TO DO THAT...) 
-		{
-		  if(SegmentRead[ii] == 1) //segment has already been read and is currently in memory
-		    {
-		      Needed=0; //segment not needed a priori
-		      for(i=0;i<TempIntNum;++i) if (FramelistArray[i] == ii) Needed=1; //Ah, my bad!!! The segment is actually needed
-		      if(Needed == 0)//we delete the segment
-			{
-			  drms_free_array(Segments[ii]);
-			  drms_free_array(Ierror[ii]);
-			  Segments[ii]=NULL;
-			  Ierror[ii]=NULL;
-			  SegmentRead[ii] = 0;
-			}
-		      
-		    }
-		  
-		}
+
+	      for(i=0;i<TempIntNum;++i) if(FramelistArray[i] != -1 && Frames.frame[FramelistArray[i]].state == FRAME_CACHED) FrameCacheUse(&Frames,FramelistArray[i],TargetTime);
+	      if(FrameCacheExpire(&Frames,FramelistArray,TempIntNum) != 0) return 1;
 	      	    
   
 	      if(it2 == 0 && it == 0) //for a given time and wavelength, the keywords will be the average values of the keywords for the polarization number 0
@@ -3388,14 +2899,6 @@ int DoIt(void)
 		  if(KeywordMissing[j] == 1 || KeywordMissing[i] == 1)
 		    {
 		      printf("Error: some keywords are missing/corrupted to interpolate OBS_VR, OBS_VW, OBS_VN, CRLN_OBS, CROTA2, and CAR_ROT at target time %s\n",timeBegin2);
-		      if(SegmentRead[temp]) //temp should still be the target filtergram
-			{
-			  drms_free_array(Segments[temp]);
-			  Segments[temp]=NULL;
-			  if(Ierror[temp] != NULL) drms_free_array(Ierror[temp]);
-			  Ierror[temp]=NULL;
-			  SegmentRead[temp]=0;
-			}
 		      QUALITY[timeindex] = QUALITY[timeindex] | QUAL_NOINTERPOLATEDKEYWORDS;
 		      CreateEmptyRecord=1; goto NextTargetTime;
 		    }
@@ -3531,58 +3034,60 @@ int DoIt(void)
 		  temp=FramelistArray[i];                 //index of the record
 		  if(temp != -1)                          //if the filtergram is not missing 
 		    {
-		      if(SegmentRead[temp] != -1)         //if a keyword needed by do_interpolate is not missing
+		      if(Frames.frame[temp].state != FRAME_CORRUPT) //if a keyword needed by do_interpolate is not missing
 			{
 			  
-			  if(SegmentRead[temp] == 0)      //if a keyword needed by do_interpolate is not missing, or the segment is not corrupted
+			  if(Frames.frame[temp].state == FRAME_NOTREAD) //if a keyword needed by do_interpolate is not missing, or the segment is not corrupted
 			    {
 			      printf("segment needs to be read for FSN %d \n",FSN[temp]);
 			      segin   = drms_segment_lookupnum(recLev1->records[temp], 0);
-			      Segments[temp] = drms_segment_read(segin,type1d, &status); //pointer toward the segment (convert the data into type1d)
-			      if (status != DRMS_SUCCESS || Segments[temp] == NULL)
+			      FrameImage = drms_segment_read(segin,type1d, &status); //pointer toward the segment (convert the data into type1d)
+			      if (status != DRMS_SUCCESS || FrameImage == NULL)
 				{
 				  printf("Error: could not read the segment of level 1 record index %d at target time %s\n",temp,timeBegin2); //if there is a problem  
 				  return 1;
 				  //ActualTempIntNum-=1; //we will use one less filtergram for the temporal interpolation
 				  //arrin[i] = NULL;
 				  //arrerrors[i] = NULL;
-				  //Segments[temp] = NULL;
-				  //Ierror[temp] = NULL;
-				  //SegmentRead[temp]=-1;
+				  //FrameImage = NULL;
+				  //FrameError = NULL;
+				  //FrameCacheDrop(&Frames,temp,FRAME_CORRUPT);
 				}  
 			      else
 				{
-				  Ierror[temp] = drms_array_create(typeEr,2,axisout,NULL,&status);
-				  if(status != DRMS_SUCCESS || Ierror[temp] == NULL)
+				  FrameError = drms_array_create(typeEr,2,axisout,NULL,&status);
+				  if(status != DRMS_SUCCESS || FrameError == NULL)
 				    {
 				      printf("Error: could not create an array for Ierror at target time %s\n",timeBegin2); //if there is a problem
-				      drms_free_array(Segments[temp]);
-				      Segments[temp]=NULL;
-				      Ierror[temp]=NULL;
-				      SegmentRead[temp]=-1; 
+				      drms_free_array(FrameImage);
+				      FrameImage=NULL;
+				      FrameError=NULL;
+				      FrameCacheDrop(&Frames,temp,FRAME_CORRUPT); 
 				      ActualTempIntNum-=1; //we will use one less filtergram for the temporal interpolation
 				      arrin[i] = NULL;
 				      arrerrors[i] = NULL;
 				    }    
 				  else
 				    {
-				      arrin[i] = Segments[temp];
-				      arrerrors[i] = Ierror[temp];
+				      arrin[i] = FrameImage;
+				      arrerrors[i] = FrameError;
 				      if( arrin[i]->axis[0] != axisin[0]  || arrin[i]->axis[1] != axisin[1]) //segment does not have the same size as the segment of the target filtergram (PROBLEM HERE: I CURRENTLY DON'T CHECK IF A SEGMENT ALREADY IN MEMORY HAS THE SAME SIZE AS THE TARGET FILTERGRAM)
 					{
 					  printf("Error: level 1 record index %d at target time %s has a segment with dimensions %d x %d instead of %d x %d\n",temp,timeBegin2,arrin[i]->axis[0],arrin[i]->axis[1],axisin[0],axisin[1]);
-					  drms_free_array(Segments[temp]);
-					  drms_free_array(Ierror[temp]);
+					  drms_free_array(FrameImage);
+					  drms_free_array(FrameError);
 					  ActualTempIntNum-=1; //we will use one less filtergram for the temporal interpolation
 					  arrin[i] = NULL;
 					  arrerrors[i] = NULL;
-					  Segments[temp]=NULL;
-					  Ierror[temp]=NULL;
-					  SegmentRead[temp]=-1;
+					  FrameImage=NULL;
+					  FrameError=NULL;
+					  FrameCacheDrop(&Frames,temp,FRAME_CORRUPT);
 					}
 				      else
 					{
-					  SegmentRead[temp]=1; //now the segment for this record is in memory
+					  FrameCacheStore(&Frames,temp,FrameImage,FrameError,TargetTime); //now the segment for this record is in memory (the arrays are gapfilled below, in place)
+					  FrameImage=NULL;
+					  FrameError=NULL;
 
 					  //call gapfilling code of Richard and Jesper
 					  //*******************************************************************
@@ -3594,13 +3099,9 @@ int DoIt(void)
 					      printf("Error: cannot read the list of bad pixels of level 1 filtergram FSN= %d\n",FSN[temp]);
 					      return 1;
 					      //ActualTempIntNum-=1; //we will use one less filtergram for the temporal interpolation
-					      //drms_free_array(Segments[temp]);
-					      //drms_free_array(Ierror[temp]);
+					      //FrameCacheDrop(&Frames,temp,FRAME_CORRUPT);
 					      //arrin[i] = NULL;
 					      //arrerrors[i] = NULL;
-					      //Segments[temp]=NULL;
-					      //Ierror[temp]=NULL;
-					      //SegmentRead[temp]=-1; 
 					    }
 					  else
 					    {
@@ -3654,7 +3155,7 @@ int DoIt(void)
 						      //}
 						}
 					      					      
-					      image  = Segments[temp]->data;
+					      image  = arrin[i]->data;
 
 					      //***********************************************************************
 					      // applying rotational flat field and correcting for non-linearity
@@ -3663,43 +3164,18 @@ int DoIt(void)
 					      if(inRotationalFlat == 1)
 						{
 
-						  HMIFlatField    = (char *)malloc(MaxNString*sizeof(char *));
-						  if(HMIFlatField == NULL)
-						    {
-						      printf("Error: memory could not be allocated to HMIFlatField\n");
-						      return 1;//exit(EXIT_FAILURE);
-						    }
 						  HMIFlatField    = drms_getkey_string(recLev1->records[temp],FLATREC,&status);  //read the pzt flatfield used
 						  if (status != DRMS_SUCCESS)
 						    {
 						      printf("Error: could not read the FLAT_REC keyword for the target filtergram FSN= %d",FSN[temp]);
 						      return 1;
 						    }
+						  pztflat = FlatFieldPzt(&Flats,drms_env,HMIFlatField);                       //read only once, then kept in memory
+						  free(HMIFlatField);
+						  if(pztflat == NULL) return 1;
+						  rotflat = FlatFieldRotational(&Flats,drms_env,(HCAMID[temp] == LIGHT_SIDE) ? 1 : 2,internTOBS[temp]); //flat field of the validity interval that contains the filtergram
+						  if(rotflat == NULL) return 1;
 
-
-						  if(strcmp(HMIFlatField,HMIFlatField0) != 0) //if the pzt flatfield changes during a run of the osbervables code
-						    {
-						      printf("Warning: the hmi.flatfield record used to produce the level 1 records changed during the run of the observables code\n");
-						      //access the pzt flatfield
-						      recflat  = drms_open_records(drms_env,HMIFlatField,&status);
-						      if (status != DRMS_SUCCESS || recflat == NULL || recflat->n == 0)
-							{
-							  printf("Error: record missing or corrupt for the flat field query %s\n",HMIFlatField);
-							  return 1;
-							}
-						      drms_free_array(flatfield);
-						      strcpy(HMIFlatField0,HMIFlatField);
-						      segin     = drms_segment_lookup(recflat->records[0],"flatfield");
-						      flatfield = drms_segment_read(segin,type1d,&status); 
-						      if (status != DRMS_SUCCESS || flatfield == NULL)
-							{
-							  printf("Error: could not read the data segment for the flat field query %s\n",HMIFlatField);
-							  return 1;
-							}
-						      pztflat  = flatfield->data;
-						      status=drms_close_records(recflat,DRMS_FREE_RECORD);
-						    }
-						  
 						  if(inLinearity == 1)
 						    {
 						      printf("applying rotational flat field and correcting for non-linearity of camera on record FSN=%d\n",FSN[temp]);
@@ -3724,7 +3200,6 @@ int DoIt(void)
 							}
 						    }
 	
-						  free(HMIFlatField);
 
 						}//if(inRotationalFlat == 1)
 					      else
@@ -3787,14 +3262,14 @@ int DoIt(void)
 					}
 				    }
 				}
-			    }//if(SegmentRead[temp] == 0)
+			    }//if(Frames.frame[temp].state == FRAME_NOTREAD)
 			  else //SEGMENT IS ALREAD IN MEMORY AND DOES NOT NEED TO BE READ
 			    {
-			      arrin[i] = Segments[temp];
-			      arrerrors[i] = Ierror[temp];
+			      arrin[i] = Frames.frame[temp].image;
+			      arrerrors[i] = Frames.frame[temp].ierror;
 			    }
 			  
-			}//if(SegmentRead[temp] != -1)
+			}//if(Frames.frame[temp].state != FRAME_CORRUPT)
 		      else //at least one of the keyword needed by do_interpolate is missing, so we just discard this filtergram so that it's not used by do_interpolate
 			{
 			  printf("Error: at least one of the keyword needed by the temporal interpolation function is missing, at target time %s\n",timeBegin2);
@@ -3933,6 +3408,10 @@ int DoIt(void)
 		  KeyInterpOut.focus=TargetCFINDEX;
 
 		  //calling Richard's code: temporal interpolation, de-rotation, un-distortion
+		  //NB: the resampled filtergrams cannot be kept from one target time to the next (to add the filtergrams entering the averaging window
+		  //and subtract those leaving it): do_interpolate() de-rotates and remaps each filtergram to the time and geometry of the target time
+		  //(KeyInterpOut: TOBS, X0AVG, Y0AVG, RSUN, B0, P0), which change with each window. Only the reading and gapfilling of the filtergrams
+		  //shared by consecutive windows are done once, by the frame cache
 		  printf("Calling temporal averaging, de-rotation, and un-distortion code\n");
 
 		  totalTempIntNum[timeindex] += ActualTempIntNum;
@@ -3961,6 +3440,10 @@ int DoIt(void)
 		      //exit(EXIT_FAILURE);
 
 		      printf("End temporal interpolation\n");
+
+		      //96-min averages: the filtergrams of this polarization are dropped from the frame cache once they are averaged, instead of
+		      //being kept for the next target time (96 minutes later)
+		      if(Averaging == 96) for(i=0;i<TempIntNum;++i) if(FramelistArray[i] != -1 && Frames.frame[FramelistArray[i]].state == FRAME_CACHED) FrameCacheDrop(&Frames,FramelistArray[i],FRAME_NOTREAD);
 		    }
 		  else
 		    {
@@ -4303,7 +3786,7 @@ int DoIt(void)
 	  printf("TIME= %f\n",TargetTime);
 	  printf("END TIME= %f\n",TimeEnd);
 	  timeindex+=1;
-	  initialrun=0;
+
 	}//END LOOP ON TIME
 
     }//END LOOP OVER WAVELENGTH
@@ -4347,18 +3830,14 @@ if(nIndexFiltergram != 0)
 	free(DSUNOBS);
 	free(X0);
 	free(Y0);
-	free(SegmentRead);
 	free(KeywordMissing);
-	free(Segments);
-	//free the pzt and rotational flat fields of the target filtergram, if needed
-	if(inRotationalFlat == 1)
-	  {
-	    drms_free_array(flatfield);
-	    drms_free_array(flatfieldrot);
-	    status=drms_close_records(recflatrot,DRMS_FREE_RECORD);
-	  }
+	FrameCacheReport(&Frames);
+	FrameCacheFree(&Frames);                                             //frees the filtergrams still in memory
+	CropMaskFree();                                                      //frees the crop masks
+	FramelistCacheFree();                                                //frees the framelists decoded by framelistInfo()
+	FlatFieldCacheReport(&Flats);
+	FlatFieldCacheFree(&Flats);                                          //frees the pzt and rotational flat fields
 	free(Badkeyword);
-	free(Ierror);  
 	free(IndexFiltergram);
 	free(FSN);
 	free(CFINDEX);
@@ -44,6 +44,13 @@ The value by default is hmi.lev1 (to be consistent with the default value of qui
 \li \c smooth=number where number is an integer and is either 0 (the value by default) or 1. 1 means that the user wishes to use smooth look-up tables instead of the standard ones.
 \li \c rotational=number where number is an integer and is either 0 (the value by default) or 1. 1 means that the user wishes to use rotational flat fields instead of the standard pzt flat fields.
 \li \c linearity=number where number is an integer and is either 0 (the value by default) or 1. 1 means that the user wishes to correct for the non-linearity of the cameras.
+\li \c inverse=number where number is an integer and is either 0 (the value by default) or 1. 0 means that the Dopplergrams are computed by Dopplergram_largercrop(), with the larger crop radius of the expanded look-up tables. 1 means that they are computed by Dopplergram() (Dopplergram.c), which locates the interval of the look-up tables that brackets the velocities with inverse look-up tables instead of scanning the tables, and only computes the observables selected by the parameter observables. Dopplergram() crops the data at Rsun+50 pixels: it has not been validated against Dopplergram_largercrop(), so it should not be used for definitive observables.
+\li \c prefetch=number where number is an integer and is the maximum number of level 1 filtergrams that a background thread reads in advance, while the observables of the current target time are computed (12 by default). Each filtergram read in advance uses 64 MB of memory. 0 means that the level 1 filtergrams are read only when needed.
+\li \c lookahead=number where number is an integer and is the number of target times, after the current one, whose level 1 filtergrams are read in advance by the background thread (1 by default). Without rotational flat field, this thread also corrects for the non-linearity of the cameras and gapfills these filtergrams, so that the filtergrams of the next target times are processed while the observables of the current target time are computed. The parameter prefetch should then be at least lookahead times the number of filtergrams in the framelist.
+\li \c framecache=number where number is an integer and is the maximum memory, in MB, used by the gapfilled level 1 filtergrams kept in memory to be reused at the following target times (8192 by default, which holds the filtergrams used at one target time (5.6 GB for the 72 filtergrams of a target time of the 6-wavelength sequence, each with its gapfilling error map: 80 MB); 0 means no maximum). The filtergrams that are not used at the current target time are released, and when the maximum is reached, the least recently used filtergrams are released too, and will have to be read and gapfilled again if they are needed.
+\li \c page=number where number is an integer and is the number of hours of target times processed with the same level 1 records (6 by default). The level 1 records needed by the target times of a page are opened when the page starts and closed when it ends, so that the memory used does not depend on the length of the time range requested, and a run can span several days (the records opened at once are limited to about one day of filtergrams). The target times of a page without level 1 records get empty level 1.5 records, and the module only stops with an error if no page has level 1 records. 0 means that all the level 1 records of the time range are opened at once.
+\li \c follow=number where number is an integer and is the number of seconds between two checks for new level 1 records in nrt mode (0 by default, which means no nrt mode). It can only be used with quicklook=1 and levin=lev1. In nrt mode, HMI_observables does not stop when the level 1 records available have been processed: it checks the level 1 series every follow seconds, and produces the observables of a target time as soon as the level 1 records needed by its temporal interpolation have arrived, until the ending time end is reached. The flat fields, crop masks, framelists, and polarization calibration stay in memory. The look-up tables and the keywords of the look-up table and polynomial coefficient series are read again at each page, so that the records added to these series during the run are used. The level 1.5 records of each page are committed when the page ends. The ending time can be set far in the future to keep the module running.
+\li \c writer=number where number is an integer and is the maximum number of level 1.5 segments handed over to a background thread, which writes them (scaling, compression, and write of the files) while the next target time is processed (5 by default, i.e. the observables of one target time). Each segment queued uses 64 MB of memory, and the arrays written are reused for the next target times. The level 1.5 records are inserted in the order of the target times, once their segments are written. 0 means that the segments are written by the main thread, before the next target time. The level 1d and level 1p segments are written by the same thread (or by the main thread if there is no writer thread), the main thread waiting for the end of their write.
 
 \par Examples
 
@@ -68,12 +75,36 @@ To calculate definitive line-of-sight observables from the 12-min averaged IQUV
 HMI_observables begin="2010.10.1_0:0:0_TAI" end="2010.10.1_2:45:00_TAI" levin="lev1p" levout="lev15" wavelength=3 quicklook=0 camid=0 cadence=720.0 lev1="hmi.lev1"
 \endcode
 
+\b Example 4:
+
+To keep producing nrt/quick-look standard 45s-cadence line-of-sight observables as the level 1 nrt records arrive, starting at 2010.10.1_0:0:0_TAI, with a check of hmi.lev1_nrt every 5 seconds:
+\code
+HMI_observables begin="2010.10.1_0:0:0_TAI" end="2030.01.1_0:0:0_TAI" levin="lev1" levout="lev15" wavelength=3 quicklook=1 camid=1 cadence=45.0 lev1="hmi.lev1_nrt" follow=5
+\endcode
+
 \par Versions
 
 v 1.26: possibility to apply a rotational flat field instead of the pzt flat field, and possibility to use smooth look-up tables instead of the standard ones. support for the 8- and 10-wavelength observable sequences
 v 1.27: code now aborts when status of drms_segment_read() or drms_segment_write() is not DRMS_SUCCESS
 v 1.28: possibility to apply a rotational flat field instead of the pzt flat field, and possibility to use smooth look-up tables instead of the standard ones. support for the 8- and 10-wavelength observable sequences
 v 1.29: correcting for non-linearity of cameras
+v 1.30: new parameter inverse: with inverse=1, the Dopplergrams are computed by Dopplergram() instead of Dopplergram_largercrop(), with inverse look-up tables used to locate the interval of the look-up tables that brackets the velocities, instead of scanning them (read from the segment "inverse" of the look-up table record, or computed when the tables are read)
+v 1.31: the look-up tables, their inverse, and the keywords of the look-up table and polynomial coefficient series are cached across target times, and only read again when the look-up table keywords change
+v 1.32: new parameter observables, a bitmask selecting the level 1.5 observables to produce (1=Dopplergram, 2=magnetogram, 4=linedepth, 8=linewidth, 16=continuum intensity). The observables not selected are not written (nor computed, with inverse=1: Dopplergram_largercrop() computes all of them)
+v 1.33: the statistics keywords of all the level 1.5 observables are computed at once by ImageStatistics() (imagestats.c), in parallel, instead of two calls to fstats() per observable
+v 1.34: new parameter prefetch: the level 1 filtergrams needed at the current and next target times are read in advance by a background thread (lev1prefetch.c), while the main thread gapfills and computes the observables. The segment reads and writes of the threads go through segmentio.c, which serializes them with one lock, since DRMS and cfitsio are not assumed to be reentrant
+v 1.35: the gapfilled level 1 filtergrams kept in memory across target times are managed by a frame cache (framecache.c) instead of the arrays Segments, Ierror, and SegmentRead. New parameter framecache: maximum memory used by this cache (8 GB by default). As before, the filtergrams not used at the current target time are released
+v 1.36: the prefetch thread also corrects, masks, and gapfills the level 1 filtergrams it reads (unless a rotational flat field is applied), so that the filtergrams of the next target times are processed while the observables of the current target time are computed. The prefetch thread has its own copy of the parameters of the gapfilling routine (const_param). New parameter lookahead: number of target times whose filtergrams are processed in advance. The do_gapfill() calls of the prefetch thread run with a quarter of the OpenMP threads, which the parallel regions of the main thread do not use
+v 1.37: the temporal interpolations of the slots of the framelist (do_interpolate()) are run concurrently, each with a share of the OpenMP threads and its own copy of const_param, and the time elapsed in each is printed on a SLOT TIMING line
+v 1.38: the output geometry of the temporal interpolation (KeyInterpOut) is computed once per target time and shared by all the slots
+v 1.39: the crop mask of each image configuration (HIMGCFID) is built only once per process (cropmask.c), instead of reading the image configuration file and the crop table for every level 1 filtergram
+v 1.40: the numerical keywords of the level 1 records are read in one query (keyvector.c) instead of record by record
+v 1.41: the observable sequence files (Sequences3.txt, std_flight.w, std_flight.p) are read only once, and each framelist decoded by framelistInfo() is kept in memory (framelistcache.c)
+v 1.42: the pzt and rotational flat fields are read only once and kept in memory (flatfieldcache.c). Each filtergram gets the rotational flat field of the validity interval (T_START to T_STOP) that contains its T_OBS, so that a run can span several days and flat fields (a run is not limited anymore to the validity interval of one rotational flat field)
+v 1.43: the target times are processed by pages (new parameter page, 6 hours by default): the level 1 records needed by a page are opened when it starts and closed when it ends, so that the memory used does not depend on the length of the run, and the one-day limit on the time range (nRecmax) only applies to a page. A page without level 1 records gets empty level 1.5 records (QUAL_TARGETFILTERGRAMMISSING): the module only stops with an error if no page of the run has level 1 records
+v 1.44: the level 1p arrays of a wavelength are created just before polcal() produces them, and the level 1d filtergrams of that wavelength are released right after, instead of at the end of the target time: the level 1d filtergrams and level 1p images of all the wavelengths are not in memory at once anymore (the level 1p images of all the wavelengths still are, until the observables are computed)
+v 1.45: new parameter follow (nrt mode): the module waits for new level 1 records instead of stopping, and produces the observables of each target time as soon as its level 1 records have arrived, committing the level 1.5 records page by page. The keywords of the look-up table and polynomial coefficient series, and the look-up tables, are read again at each page. No transaction stays open while the module waits, and a failed query of the level 1 series stops the module
+v 1.46: new parameter writer: the level 1.5 segments are written by a background thread (lev15writer.c) while the next target time is processed, and the level 1.5 records are inserted in order once their segments are written. The level 1d and level 1p segments are written by the same thread (Lev15WriterWrite() waits for the end of the write). The arrays are scaled and converted to the type of their segment outside the segment lock of segmentio.c: only their compression and the write of the files are serialized with the reads of the prefetch thread
 
 */
 
@@ -134,12 +165,24 @@ v 1.29: correcting for non-linearity of cameras
 #include <string.h>
 #include <math.h>
 #include <complex.h>
+#include <unistd.h>                   //sleep()
 #include <omp.h>                      //OpenMP header
 #include "interpol_code.h"            //from Richard's code
 #include "polcal.h"                   //from Jesper's codes
 #include "HMIparam.h"                 //header with basic HMI parameters and definitions
 #include "fstats.h"                   //header for the statistics function of Keh-Cheng
 #include "drms_defs.h"
+#include "inverselookup.h"            //inverse look-up tables for the MDI-like algorithm
+#include "observables.h"              //bitmask selecting the level 1.5 observables
+#include "imagestats.h"               //statistics of the level 1.5 observables
+#include "lev1prefetch.h"             //asynchronous read of the level 1 filtergrams
+#include "segmentio.h"                //segment reads and writes serialized across the threads
+#include "framecache.h"               //cache of the gapfilled level 1 filtergrams
+#include "cropmask.h"                 //crop masks of the image configurations
+#include "keyvector.h"                //keywords of the level 1 records read in one query
+#include "framelistcache.h"            //observable sequence tables read only once
+#include "flatfieldcache.h"            //pzt and rotational flat fields read only once
+#include "lev15writer.h"              //asynchronous write of the level 1.5 segments
 
 #undef I                              //I is the complex number (0,1) in complex.h. We un-define it to avoid confusion with the loop iterative variable i
 
@@ -162,6 +205,14 @@ char *module_name= "HMI_observables"; //name of the module
 #define RotationalFlat "rotational"   //force the use of rotational flat fields?
 #define Linearity      "linearity"    //force the correction for non-linearity of cameras
 #define Unusual        "unusual"      //unusual sequences (more than 6 wavelengths)? yes=1, no=0. Use only when trying to produce side camera observables
+#define InverseIn      "inverse"      //Dopplergrams computed by Dopplergram() with inverse look-up tables (1) or by Dopplergram_largercrop() (0)? 0 BY DEFAULT
+#define ObservablesIn  "observables"  //bitmask of the level 1.5 observables to produce (see observables.h). ALL OF THEM (31) BY DEFAULT
+#define PrefetchIn     "prefetch"     //maximum number of level 1 filtergrams read in advance by the prefetch thread (0=no prefetch)
+#define LookaheadIn    "lookahead"    //number of target times after the current one whose level 1 filtergrams are read and gapfilled in advance
+#define FrameCacheIn   "framecache"   //maximum memory (in MB) used by the gapfilled level 1 filtergrams kept in memory (0=no maximum). 8192 BY DEFAULT
+#define PageIn         "page"         //number of hours of target times whose level 1 records are opened at once (0=the whole time range)
+#define FollowIn       "follow"       //nrt mode: number of seconds between two checks for new level 1 records (0=no nrt mode)
+#define WriterIn       "writer"       //maximum number of level 1.5 segments queued for the writer thread (0=no writer thread)
 
 #define minval(x,y) (((x) < (y)) ? (x) : (y))
 #define maxval(x,y) (((x) < (y)) ? (y) : (x))
@@ -245,6 +296,14 @@ ModuleArgs_t module_args[] =
      {ARG_STRING, "dpath", "/home/jsoc/cvs/Development/JSOC/proj/lev1.5_hmi/apps/",  "directory where the source code is located"},
      {ARG_INT   , Linearity, "0", "Correct for non-linearity of cameras? yes=1, no=0 (default)"},
      {ARG_INT   , Unusual, "0", "unusual sequences (more than 6 wavelengths)? yes=1, no=0. Use only when trying to produce side camera observables"},
+     {ARG_INT   , InverseIn, "0", "Dopplergrams computed by Dopplergram() with inverse look-up tables? yes=1, no=0 (default: Dopplergram_largercrop())"},
+     {ARG_INT   , ObservablesIn, "31", "level 1.5 observables to produce, sum of: 1=Dopplergram, 2=magnetogram, 4=linedepth, 8=linewidth, 16=continuum intensity"},
+     {ARG_INT   , PrefetchIn, "12", "maximum number of level 1 filtergrams read in advance by a background thread (0=no prefetch)"},
+     {ARG_INT   , LookaheadIn, "1", "number of target times after the current one whose level 1 filtergrams are read and gapfilled in advance"},
+     {ARG_INT   , FrameCacheIn, "8192", "maximum memory (in MB) used by the gapfilled level 1 filtergrams kept in memory (0=no maximum)"},
+     {ARG_INT   , PageIn, "6", "number of hours of target times whose level 1 records are opened at once (0=the whole time range)"},
+     {ARG_INT   , FollowIn, "0", "nrt mode (quicklook=1): number of seconds between two checks for new level 1 records (0=the run stops when the available records are processed)"},
+     {ARG_INT   , WriterIn, "5", "maximum number of level 1.5 segments written by a background thread while the next target time is processed (0=no writer thread)"},
      {ARG_END}
 };
 
@@ -374,75 +433,57 @@ int WhichWavelength(int FID)
 
 int framelistInfo(int HFLID,int HPLTID,int HWLTID,int WavelengthID,int *PHWPLPOS,int *WavelengthIndex,int *WavelengthLocation, int *PPolarizationType,int CamIdIn,int *Pcombine,int *Pnpol,int MaxNumFiltergrams,TIME *PDataCadence,int *CameraValues,int *FID,char *dpath)
 {
-  int framelistSize=0,HFLIDread,FIDread,i,j,compteur;
+  int framelistSize=0,i,j,compteur;
   int PLINDEX,WLINDEX;
-  FILE *sequencefile;
 
-  //The three following files have been checked into CVS. I should put the files in /home/cvsuser/cvsroot/JSOC/proj/lev1.5_hmi/
+  //The three files read by SequenceTables() have been checked into CVS. I should put the files in /home/cvsuser/cvsroot/JSOC/proj/lev1.5_hmi/
   //Each time one of the original files is modified, it needs to be checked in CVS again
-  //char filename[]  = "/home/couvidat/cvs/JSOC/proj/lev1.5_hmi/Sequences3.txt"; //file containing information about the different observable sequences
-  //char filename2[] = "/home/couvidat/cvs/JSOC/proj/lev1.5_hmi/std.w";         //file containing the HCM positions for the wavelength selection
-  //char filename3[] = "/home/couvidat/cvs/JSOC/proj/lev1.5_hmi/std.p";         //file containing the HCM positions for the polarization selection
-
-  char *filename=NULL;
-  char *filename2=NULL;
-  char *filename3=NULL;
-
-  char dpath2[256];
-  strcpy(dpath2,dpath);
-  filename =strdup(strcat(dpath2,"/../Sequences3.txt"));
-  strcpy(dpath2,dpath);
-  filename2=strdup(strcat(dpath2,"/../../tables/hmi_mech/std_flight.w"));
-  strcpy(dpath2,dpath);
-  filename3=strdup(strcat(dpath2,"/../../tables/hmi_mech/std_flight.p"));
+  //dpath/../Sequences3.txt: file containing information about the different observable sequences
+  //dpath/../../tables/hmi_mech/std_flight.w: file containing the HCM positions for the wavelength selection
+  //dpath/../../tables/hmi_mech/std_flight.p: file containing the HCM positions for the polarization selection
+  //these files are read only once, and each framelist is decoded only once (framelistcache.c)
 
-  char line[256];
+  const struct sequencetables *tables=NULL;
+  const struct sequence *sequence=NULL;
   int  PL_Index[MaxNumFiltergrams],WL_Index[MaxNumFiltergrams];
-  int  WT1P,WT2P,WT3P,WT4P,PS1P,PS2P,PS3P;
+  unsigned char HWPLset[7*MaxNumFiltergrams];                        //1 if PHWPLPOS was found in std_flight.w or std_flight.p
   int  found=0; //found=0 means that there is a problem and the info for a specific framelist cannot be found
-
-  int  combinef,combines,npolf,npols,framelistSizef,framelistSizes,PolarizationTypef,PolarizationTypes,CAMERA;
-  float DataCadencef,DataCadences;
+  int  paramset=0;
+  int  nFID;
 
 
-  //READ THE FILE CONTAINING THE SEQUENCE DESCRIPTION
+  //READ THE SEQUENCE DESCRIPTION
   //----------------------------------------------------------------------------------------------------------
 
   printf("HFLID OF FRAMELIST = %d\n",HFLID);
-  sequencefile = fopen(filename,"r");
-  if(sequencefile == NULL)
-    {
-      printf("The file %s does not exist or cannot be read\n",filename);
-      free(filename);
-      free(filename2);
-      free(filename3);
-      filename=NULL;
-      filename2=NULL;
-      filename3=NULL;
-      return 1;
-      //exit(EXIT_FAILURE);
-    }
+  framelistSize=FramelistCacheGet(HFLID,HPLTID,HWLTID,WavelengthID,CamIdIn,PHWPLPOS,WavelengthIndex,WavelengthLocation,PPolarizationType,Pcombine,Pnpol,PDataCadence,CameraValues,FID);
+  if(framelistSize >= 0) return framelistSize;                       //this framelist was already decoded
+  framelistSize=0;
+
+  tables=SequenceTables(dpath);
+  if(tables == NULL) return 1;
 
   i=0;
   compteur=0;
-  while (fgets(line,256,sequencefile) != NULL)
+  for(j=0;j<tables->nsequences;++j)
     {
-      sscanf(line,"%d %d %d %f %f %d %d %d %d %d %d %d %d",&HFLIDread,&PolarizationTypef,&PolarizationTypes,&DataCadencef,&DataCadences,&npolf,&npols,&combinef,&combines,&framelistSizef,&framelistSizes,&j,&CAMERA);
-     if(HFLIDread == HFLID)
+      sequence=&tables->sequences[j];
+      if(sequence->HFLID == HFLID)
 	{
 
 	  if(CamIdIn == LIGHT_FRONT) //front camera
 	    {
-	      *Pcombine=combinef;
-	      *Pnpol=npolf;
-	      *PDataCadence=DataCadencef;
-	      *PPolarizationType=PolarizationTypef;
-	      framelistSize=framelistSizef;
-	      if(combinef == 0)
+	      *Pcombine=sequence->combinef;
+	      *Pnpol=sequence->npolf;
+	      *PDataCadence=sequence->DataCadencef;
+	      *PPolarizationType=sequence->PolarizationTypef;
+	      paramset=1;
+	      framelistSize=sequence->framelistSizef;
+	      if(sequence->combinef == 0)
 		{
-		  if(CAMERA == 3) //front camera (HCAMID convention used)
+		  if(sequence->CAMERA == 3) //front camera (HCAMID convention used)
 		    {
-		      FID[i]=j;
+		      FID[i]=sequence->FID;
 		      WavelengthLocation[i]=compteur;
 		      CameraValues[i]=LIGHT_FRONT;
 		      i+=1;
@@ -450,25 +491,26 @@ int framelistInfo(int HFLID,int HPLTID,int HWLTID,int WavelengthID,int *PHWPLPOS
 		}
 	      else
 		{
-		  FID[i]=j;
+		  FID[i]=sequence->FID;
 		  WavelengthLocation[i]=compteur;
-		  if(CAMERA == 3) CameraValues[i]=LIGHT_FRONT;
+		  if(sequence->CAMERA == 3) CameraValues[i]=LIGHT_FRONT;
 		  else CameraValues[i]=LIGHT_SIDE;
 		  i+=1;
 		}
 	    }
 	  if(CamIdIn == LIGHT_SIDE) //side camera
 	    {
-	      *Pcombine=combines;
-	      *Pnpol=npols;
-	      *PDataCadence=DataCadences;
-	      *PPolarizationType=PolarizationTypes;
-	      framelistSize=framelistSizes;
-	      if(combines == 0)
+	      *Pcombine=sequence->combines;
+	      *Pnpol=sequence->npols;
+	      *PDataCadence=sequence->DataCadences;
+	      *PPolarizationType=sequence->PolarizationTypes;
+	      paramset=1;
+	      framelistSize=sequence->framelistSizes;
+	      if(sequence->combines == 0)
 		{
-		  if(CAMERA == 2)
+		  if(sequence->CAMERA == 2)
 		    {
-		      FID[i]=j;
+		      FID[i]=sequence->FID;
 		      WavelengthLocation[i]=compteur;
 		      CameraValues[i]=LIGHT_SIDE;
 		      i+=1;
@@ -476,9 +518,9 @@ int framelistInfo(int HFLID,int HPLTID,int HWLTID,int WavelengthID,int *PHWPLPOS
 		}
 	      else
 		{
-		  FID[i]=j;
+		  FID[i]=sequence->FID;
 		  WavelengthLocation[i]=compteur;
-		  if(CAMERA == 3) CameraValues[i]=LIGHT_FRONT;
+		  if(sequence->CAMERA == 3) CameraValues[i]=LIGHT_FRONT;
 		  else CameraValues[i]=LIGHT_SIDE;
 		  i+=1;
 		}
@@ -488,7 +530,7 @@ int framelistInfo(int HFLID,int HPLTID,int HWLTID,int WavelengthID,int *PHWPLPOS
 	  compteur+=1;
 	}
     }
-  fclose(sequencefile);
+  nFID=i;                                                            //number of values of FID set
 
 
   //ASSIGN THE WL_Index AND PL_Index AS A FUNCTION OF FID
@@ -584,86 +626,43 @@ int framelistInfo(int HFLID,int HPLTID,int HWLTID,int WavelengthID,int *PHWPLPOS
       if(WavelengthIndex[i] == -101)
 	{
 	  printf("Error: WavelengthIndex[i]=-1 \n");
-	  free(filename);
-	  free(filename2);
-	  free(filename3);
-	  filename=NULL;
-	  filename2=NULL;
-	  filename3=NULL;
 	  return 1;
 	  //exit(EXIT_FAILURE);
 	}
     }
   
-  //WE READ THE std.w AND std.p FILES THAT PROVIDE, FOR THE HPLTID AND HWLTID VALUES, THE CORRESPONDING HCM POSITIONS
+  //THE std.w AND std.p FILES PROVIDE, FOR THE HPLTID AND HWLTID VALUES, THE CORRESPONDING HCM POSITIONS
   //------------------------------------------------------------------------------------------------------------------
 
-  sequencefile = fopen(filename2,"r");
-  if(sequencefile == NULL)
-    {
-      printf("The file %s does not exist or cannot be read\n",filename2);
-      free(filename);
-      free(filename2);
-      free(filename3);
-      filename=NULL;
-      filename2=NULL;
-      filename3=NULL;
-      return 1;
-      //exit(EXIT_FAILURE);
-    }
-
-  for(j=0;j<6;++j) fgets(line,256,sequencefile);
-  while (fgets(line,256,sequencefile) != NULL)
+  memset(HWPLset,0,7*framelistSize*sizeof(unsigned char));
+  for(j=0;j<tables->nwavelengths;++j)
     {
-      if(line[0] != '#')
+      for(i=0;i<framelistSize;++i)
 	{
-	  sscanf(line,"%d %d %d %d %d",&j,&WT1P,&WT2P,&WT3P,&WT4P);
-	  for(i=0;i<framelistSize;++i)
+	  if(tables->wavelengths[j].index == WL_Index[i])
 	    {
-	      if(j == WL_Index[i])
-		{
-		  PHWPLPOS[i*7  ]=WT1P;
-		  PHWPLPOS[i*7+1]=WT2P;
-		  PHWPLPOS[i*7+2]=WT3P;
-		  PHWPLPOS[i*7+3]=WT4P;
-		}
+	      PHWPLPOS[i*7  ]=tables->wavelengths[j].pos[0];
+	      PHWPLPOS[i*7+1]=tables->wavelengths[j].pos[1];
+	      PHWPLPOS[i*7+2]=tables->wavelengths[j].pos[2];
+	      PHWPLPOS[i*7+3]=tables->wavelengths[j].pos[3];
+	      memset(&HWPLset[i*7],1,4);
 	    }
 	}
     }
-  fclose(sequencefile);
-
-  sequencefile = fopen(filename3,"r");
-  if(sequencefile == NULL)
-    {
-      printf("The file %s does not exist or cannot be read\n",filename3);
-      free(filename);
-      free(filename2);
-      free(filename3);
-      filename=NULL;
-      filename2=NULL;
-      filename3=NULL;
-      return 1;
-      //exit(EXIT_FAILURE);
-    }
 
-  for(j=0;j<6;++j) fgets(line,256,sequencefile);
-  while (fgets(line,256,sequencefile) != NULL)
+  for(j=0;j<tables->npolarizations;++j)
     {
-      if(line[0] != '#')
+      for(i=0;i<framelistSize;++i)
 	{
-	  sscanf(line,"%d %d %d %d",&j,&PS1P,&PS2P,&PS3P);
-	  for(i=0;i<framelistSize;++i)
+	  if(tables->polarizations[j].index == PL_Index[i])
 	    {
-	      if(j == PL_Index[i])
-		{
-		  PHWPLPOS[i*7+4]=PS1P;
-		  PHWPLPOS[i*7+5]=PS2P;
-		  PHWPLPOS[i*7+6]=PS3P;
-		}
+	      PHWPLPOS[i*7+4]=tables->polarizations[j].pos[0];
+	      PHWPLPOS[i*7+5]=tables->polarizations[j].pos[1];
+	      PHWPLPOS[i*7+6]=tables->polarizations[j].pos[2];
+	      memset(&HWPLset[i*7+4],1,3);
 	    }
 	}
     }
-  fclose(sequencefile);
 
 
   if(found == 0)
@@ -671,16 +670,14 @@ int framelistInfo(int HFLID,int HPLTID,int HWLTID,int WavelengthID,int *PHWPLPOS
       framelistSize=0; //problem occured
     }
 
-  free(filename);
-  free(filename2);
-  free(filename3);
-  filename=NULL;
-  filename2=NULL;
-  filename3=NULL;
+  //the framelist is not stored if it was not found (framelistSize=0: the error is reported again at the next call), or if WavelengthIndex was computed from values of FID not set here
+  if(framelistSize > 0 && nFID >= framelistSize) FramelistCachePut(HFLID,HPLTID,HWLTID,WavelengthID,CamIdIn,PHWPLPOS,HWPLset,WavelengthIndex,WavelengthLocation,paramset,*PPolarizationType,*Pcombine,*Pnpol,*PDataCadence,CameraValues,FID,nFID,framelistSize);
+
   return framelistSize;
 }
 
 
+
 /*------------------------------------------------------------------------------------------------------------------*/
 /*                                                                                                                  */
 /*function that locates all the characters of a string s2 in a string s1                                            */
@@ -715,6 +712,7 @@ int StringLocate(const char *s1,const char *s2)
 /* 0 means pixel not missing                                                                                        */
 /* 1 means pixel missing and needs to be filled                                                                     */
 /* 2 means pixel missing and does not need to be filled                                                             */
+/* the crop mask of each image configuration (HIMGCFID) is built only once per process, by CropMask() in cropmask.c */
 /*                                                                                                                  */
 /*------------------------------------------------------------------------------------------------------------------*/
 
@@ -725,12 +723,6 @@ int MaskCreation(unsigned char *Mask, int nx, int ny, DRMS_Array_t  *BadPixels,
 
   if(nx != 4096 || ny != 4096) return status; //the mask creation function only works on 4096x4096 images
 
-  char *filename="/home/production/img_cnfg_ids"; //image configuration ID file
-  const int minid=80;
-  const int maxid=124;
-  const int n_tables=1;
-  const int maxtab=256;
-
   int *badpixellist=BadPixels->data; //ASSUMES THE PIXEL LIST IS IN INT
   int  nBadPixels=BadPixels->axis[0]; //number of bad pixels in the list
   int *cosmicraylist=NULL;
@@ -743,328 +735,193 @@ int MaskCreation(unsigned char *Mask, int nx, int ny, DRMS_Array_t  *BadPixels,
     } 
   else ncosmic = -1;
 
-  int x_orig,y_orig,x_dir,y_dir;
-  int skip, take, skip_x, skip_y;
-  int datum, nsx, nss, nlin,nq,nqq,nsy;
-  int idn=-1;
-  
-  int *id=NULL, *tab=NULL, *nrows=NULL, *ncols=NULL, *rowstr=NULL, *colstr=NULL, *config=NULL;
-  id    =(int *)(malloc(maxtab*sizeof(int)));
-  if(id == NULL)
-    {
-      printf("Error: memory could not be allocated to id\n");
-      return 1;
-      //exit(EXIT_FAILURE);
-    }
-  tab   =(int *)(malloc(maxtab*sizeof(int)));
-  if(tab == NULL)
-    {
-      printf("Error: memory could not be allocated to tab\n");
-      return 1;
-      //exit(EXIT_FAILURE);
-    }
-  nrows =(int *)(malloc(maxtab*sizeof(int)));
-  if(nrows == NULL)
-    {
-      printf("Error: memory could not be allocated to nrows\n");
-      return 1;
-      //exit(EXIT_FAILURE);
-    }
-  ncols =(int *)(malloc(maxtab*sizeof(int)));
-  if(ncols == NULL)
-    {
-      printf("Error: memory could not be allocated to ncols\n");
-      return 1;
-      //exit(EXIT_FAILURE);
-    }
-  rowstr=(int *)(malloc(maxtab*sizeof(int)));
-  if(rowstr == NULL)
-    {
-      printf("Error: memory could not be allocated to rowstr\n");
-      return 1;
-      //exit(EXIT_FAILURE);
-    }
-  colstr=(int *)(malloc(maxtab*sizeof(int)));
-  if(colstr == NULL)
-    {
-      printf("Error: memory could not be allocated to colstr\n");
-      return 1;
-      //exit(EXIT_FAILURE);
-    }
-  config=(int *)(malloc(maxtab*sizeof(int)));
-  if(config == NULL)
-    {
-      printf("Error: memory could not be allocated to config\n");
-      return 1;
-      //exit(EXIT_FAILURE);
-    }
-
+  const unsigned char *CropArea=NULL;
+  int k;
 
-  int skipt[4*2048];
-  int taket[4*2048];
+  status=CropMask(HIMGCFID,nx,ny,&CropArea); //crop mask of the image configuration, built only once per process
+  if(status == 0)
+    {
+      //NEED TO FILL THE NANs INSIDE THE CROP TABLE
+      for(k=0;k<nx*ny;++k)
+	{
+	  Mask[k]=CropArea[k];
+	  if(Mask[k] == 0 && isnan(image[k])) Mask[k] = 1;
+	}
 
-  int **kx=NULL;
-  int *kkx=NULL;
+      //NEED TO FILL THE BAD PIXELS INSIDE THE CROP TABLE (FROM THE BAD PIXEL LIST)
+      if(ncosmic != -1 && nbadperm != -1) nBadPixels = nbadperm;//the cosmic-ray hit list is not missing and NBADPERM is a valid keyword
+      if(nBadPixels > 0)
+	{     
+	  for (k=0;k<nBadPixels;++k)
+	    {
+	      if(Mask[badpixellist[k]] == 0) Mask[badpixellist[k]] = 1; //pixel not in the crop area and in the bad pixel list: needs to be filled
+	    }
+	}
 
-  kx=(int **)(malloc(9*sizeof(int *)));
-  if(kx == NULL)
-    {
-      printf("Error: memory could not be allocated to kx\n");
-      return 1;
-      //exit(EXIT_FAILURE);
-    }
 
-  //define different readout modes
-  int kx0[11]={4,0,0,1,0,1,1,0,1,1,1}; //EFGH
-  kx[0]=kx0;
-  int kx1[7]={2,1,0,1,1,1,2}; //FG
-  kx[2]=kx1;
-  int kx2[7]={2,0,1,0,0,1,2} ;//HE
-  kx[4]=kx2;
-  int kx3[7]={2,0,0,1,0,2,1}; //EF
-  kx[1]=kx3;
-  int kx4[7]={2,1,1,0,1,2,1}; //GH
-  kx[3]=kx4;
-  int kx5[7]={1,0,0,2,2}; //E
-  kx[5]=kx5;
-  int kx6[5]={1,1,0,2,2}; //F
-  kx[6]=kx6;
-  int kx7[5]={1,1,1,2,2}; //G
-  kx[7]=kx7;
-  int kx8[5]={1,0,1,2,2}; //H
-  kx[8]=kx8;
-
-  char **filename_table=NULL;
-  filename_table=(char **)(malloc(n_tables*sizeof(char *)));
-  if(filename_table == NULL)
-    {
-      printf("Error: memory could not be allocated to filename_table\n");
-      return 1;
-      //exit(EXIT_FAILURE);
+      //NEED TO CORRECT THE COSMIC-RAY HITS INSIDE THE CROP TABLE (FROM THE COSMIC RAY HIT LIST)
+      if(ncosmic > 0)
+	{     
+	  for (k=0;k<ncosmic;++k)
+	    {
+	      if(Mask[cosmicraylist[k]] == 0) Mask[cosmicraylist[k]] = 1; //pixel not in the crop area and in the cosmic-ray hit list: needs to be filled
+	    }
+	}
     }
-  
-  char *filename_croptable="/home/cvsuser/cvsroot/EGSE/tables/crop/crop6";
-  filename_table[0]=filename_croptable;
- 
-  int i,j,k;
-  int ix, jx;
-  int n_config;
-  char string[256];
-  char strng[5];
 
+  return status;
+}
 
-  FILE *config_file=NULL;
-  FILE *crop_table=NULL;
 
-   
-  config_file=fopen(filename, "r");
-  
-  if (config_file != NULL){
-    fgets(string, 256, config_file);
-    fgets(string, 256, config_file);
-    fgets(string, 256, config_file);
-     
 
-    n_config=0;
-    fscanf(config_file, "%d", &datum);
-    id[n_config]=datum;
+//temporal interpolation of one slot (wavelength and polarization) of the framelist, set up by the main thread and run concurrently with the other slots
+struct slotinterp {
+  float         **images;                                            //gapfilled level 1 filtergrams used by do_interpolate()
+  char          **ierrors;
+  struct keyword *KeyInterp;
+  struct keyword  KeyInterpOut;                                      //own copy for each slot, passed to do_interpolate()
+  int             ntemp;                                             //number of filtergrams used (ActualTempIntNum)
+  int             status;                                            //-1 if not set up, 1 if not enough filtergrams, otherwise status of do_interpolate()
+  int             quality;                                           //QUALITY once the slot is set up
+  double          elapsed;                                           //time elapsed in do_interpolate()
+};
 
 
-    do {
-      
-      fscanf(config_file, "%s", string);
-      
-      config[n_config]=0; //default change
-      if (string[0] == '4')config[n_config]=0;
-      if (string[0] == '2') if (string[7] == 'E')config[n_config]=1;
-      if (string[0] == '2') if (string[7] == 'F')config[n_config]=2;
-      if (string[0] == '2') if (string[7] == 'G')config[n_config]=3;
-      if (string[0] == '2') if (string[7] == 'H')config[n_config]=4;
-      if (string[0] == '1') if (string[7] == 'E')config[n_config]=5;
-      if (string[0] == '1') if (string[7] == 'F')config[n_config]=6;
-      if (string[0] == '1') if (string[7] == 'G')config[n_config]=7;
-      if (string[0] == '1') if (string[7] == 'H')config[n_config]=8;
-
-
-      fscanf(config_file, "%s", string);
-      
-      fscanf(config_file, "%s", string);
-      
-      fscanf(config_file, "%s", string);
-      
-      if (string[0] == 'N') tab[n_config]=-1;
-      if (string[0] == 'c') tab[n_config]=0;
+//numerical keywords of the level 1 records read in one query (keyvector.c), in the order of Lev1KeyNames[] in DoIt()
+enum lev1key {LEV1_FSN,LEV1_TOBS,LEV1_HWL1POS,LEV1_HWL2POS,LEV1_HWL3POS,LEV1_HWL4POS,LEV1_HPL1POS,LEV1_HPL2POS,LEV1_HPL3POS,LEV1_FID,LEV1_HCAMID,LEV1_HCFTID,
+	      LEV1_HFTSACID,LEV1_CRPIX1,LEV1_CRPIX2,LEV1_X0LF,LEV1_Y0LF,LEV1_RSUN,LEV1_CROTA2,LEV1_CRLTOBS,LEV1_DSUNOBS,LEV1_HIMGCFID,LEV1_CDELT1,LEV1_OBSVR,
+	      LEV1_OBSVW,LEV1_OBSVN,LEV1_CARROT,LEV1_CRLNOBS,LEV1_HWLTID,LEV1_HPLTID,LEV1_EXPTIME,LEV1_NBADPERM,LEV1_QUALITY,LEV1_CALVER32,LEV1_CAMERA,NLEV1KEYS};
 
-      fscanf(config_file, "%s", string);
-	
-      fscanf(config_file, "%d", &datum);
-      
-      fscanf(config_file, "%d", &datum);
-      
-      fscanf(config_file, "%s", string);
-      
-      fscanf(config_file, "%d", &datum);
-      nrows[n_config]=datum;
-      
-      fscanf(config_file, "%d", &datum);
-      ncols[n_config]=datum;
-      
-      fscanf(config_file, "%d", &datum);
-      rowstr[n_config]=datum;
-      
-      fscanf(config_file, "%d", &datum);
-      colstr[n_config]=datum;
-      
-      fscanf(config_file, "%d", &datum);
-      
-      fscanf(config_file, "%d", &datum);
-      
-      
-      
-      ++n_config;
-      fscanf(config_file, "%d", &datum);
-      id[n_config]=datum;
 
-      
-      
-      //fgets(string, 256, config_file);
-    }
-    while (!feof(config_file) && n_config < maxtab);
-    
-    fclose(config_file);
-  }
-  
+/*------------------------------------------------------------------------------------------------------------------*/
+/*                                                                                                                  */
+/* Functions given to the prefetch thread (lev1prefetch.c) so that it also corrects for the non-linearity of the    */
+/* cameras, masks, and gapfills the level 1 filtergrams it reads in advance: the filtergrams of the next target     */
+/* times are then processed while the main thread computes the observables of the current target time               */
+/* Lev1GapfillStage() is called by the main thread (it opens the cosmic-ray hit list, with the DRMS library)        */
+/* Lev1GapfillPrepare() is called by the prefetch thread (same processing as the main thread, without the DRMS)     */
+/* not used with the rotational flat fields (the pzt flat field can change during the run)                          */
+/* the prefetch thread has its own copy of const_param: the source of Richard's functions is not in this tree,      */
+/* so nothing guarantees that do_gapfill() does not write in it while the main thread calls do_gapfill() or         */
+/* do_interpolate()                                                                                                 */
+/* the do_gapfill() calls of the prefetch thread run with nthreads OpenMP threads (a quarter of the threads of the  */
+/* module), which the main thread does not use, so that the two threads together do not run more threads than the   */
+/* node is sized for                                                                                                */
+/*                                                                                                                  */
+/*------------------------------------------------------------------------------------------------------------------*/
 
-  //printf("reading done\n");
-  
-  for (i=0; i<n_config; ++i) if (id[i] == HIMGCFID) idn=i;
-  
-  skip_x=ncols[idn]/2;
-  skip_y=nrows[idn]/2;
-  
-  //printf("skip %d %d\n", skip_x, skip_y);
+struct lev1gapfill {
+  char           *CosmicRaySeries;                                   //name of the series containing the cosmic-ray hits
+  char           *COUNTS;                                            //keyword with the number of cosmic-ray hits
+  int            *FSN;
+  int            *HIMGCFID;
+  int            *NBADPERM;
+  float          *EXPTIME;
+  int             inLinearity;                                       //correct for non-linearity of cameras?
+  double         *nonlin;                                            //non-linearity coefficients of the camera
+  struct initial *const_param;                                       //parameters for Richard's functions, initialized for the prefetch thread only
+  unsigned char  *Mask;                                              //4096x4096 mask of the prefetch thread
+  int             nthreads;                                          //number of OpenMP threads of the prefetch thread
+};
 
-  kkx=kx[config[idn]];
-  nq=kkx[0];
-  nlin=kkx[2*nq+3-2]*ny/2;
-  nss=kkx[2*nq+3-1]*nx/2;
-  
-  //printf("len %d %d %d\n", nlin, nss, nq);
-    
-  if (idn == -1)
-    {printf("Error: invalid HIMGCFID\n"); status=2;}
-  else
+//reads the list of cosmic-ray hits of the filtergram of slot (main thread)
+//returns 1 if the list cannot be read (the filtergram is then not read in advance, and the main thread reports the error)
+int Lev1GapfillStage(struct lev1slot *slot,DRMS_Record_t *record,void *data)
+{
+  struct lev1gapfill *gapfill=(struct lev1gapfill *)data;
+  DRMS_RecordSet_t *rectemp=NULL;
+  DRMS_Segment_t *segin=NULL;
+  char query[512];
+  int  status,count;
+
+  sprintf(query,"%s[][%d]",gapfill->CosmicRaySeries,gapfill->FSN[slot->index]);
+  rectemp=drms_open_records(drms_env,query,&status);
+  if(status == DRMS_SUCCESS && rectemp != NULL && rectemp->n != 0)
     {
-      if (tab[idn] != -1)
-	{
-	  filename_croptable=filename_table[tab[idn]];
-	  crop_table=fopen(filename_croptable, "r");
-	  
-	  //for (k=0; k<23; ++k) 
-	  fscanf(crop_table, "%d", &datum); //read header
-	  
-	  fscanf(crop_table, "%d", &datum);
-	  fscanf(crop_table, "%d", &nqq);
-	  
-	  for (j=0; j<nqq; ++j)
-	    {
-	      fscanf(crop_table, "%d", &skip);
-	      fscanf(crop_table, "%d", &take);
-	      skipt[j]=skip;
-	      taket[j]=take;
-	    }
-	  fclose(crop_table);
-	}
+      count=drms_getkey_int(rectemp->records[0],gapfill->COUNTS,&status);
+      if(status != DRMS_SUCCESS || count == -1) slot->quality = slot->quality | QUAL_NOCOSMICRAY;
       else
 	{
-	  printf("no crop table\n");
-	  
-	  for (k=0; k<nq; ++k)
-	    for (j=0; j<nlin; ++j)
-	      {
-		skipt[k*nss+j]=0;
-		taket[k*nss+j]=nss;
-	      }
-	}
-      
-      nsx=nss-skip_x;
-      nsy=nlin-skip_y;
-      
-      
-      
-      for (k=0; k<nq; ++k)
-	{
-	  x_orig=kkx[k*2+1]*nx - kkx[k*2+1];
-	  y_orig=kkx[k*2+2]*ny - kkx[k*2+2];
-	  x_dir=-(kkx[k*2+1])*2+1;
-	  y_dir=-(kkx[k*2+2])*2+1;
-	  
-	  
-	  for (j=0; j<skip_y; ++j) for (i=0; i<nss; ++i) Mask[(y_orig+y_dir*j)*nx+x_orig+x_dir*i]=2;   //fill edge rows with NAN
-	  for (j=0; j<nlin; ++j) for (i=0; i<skip_x; ++i) Mask[(y_orig+y_dir*j)*nx+x_orig+x_dir*i]=2;  //fill edge columns with NAN
-	  
-	  
-	  for (j=0; j<nsy; ++j)
+	  segin=drms_segment_lookupnum(rectemp->records[0],0);
+	  slot->cosmicrays=SegmentRead(segin,segin->info->type,&status);
+	  if(status != DRMS_SUCCESS || slot->cosmicrays == NULL)
 	    {
-	      jx=j+skip_y;
-	      
-	      for (i=0; i<minval(skipt[k*nss+j],nss); ++i){ix=i+skip_x; Mask[(y_orig+y_dir*jx)*nx+x_orig+x_dir*ix]=2;} //pixel OUTSIDE THE CROP TABLE: missing but does not need to be filled
-	      for (i=skipt[k*nss+j]; i<minval(skipt[k*nss+j]+taket[k*nss+j],nss); ++i){ix=i+skip_x; Mask[(y_orig+y_dir*jx)*nx+x_orig+x_dir*ix]=0;} //pixel INSIDE THE CROP TABLE not missing and does not need to be filled
-	      for (i=(skipt[k*nss+j]+taket[k*nss+j]); i<nss; ++i){ix=i+skip_x; Mask[(y_orig+y_dir*jx)*nx+x_orig+x_dir*ix]=2;}
+	      drms_close_records(rectemp,DRMS_FREE_RECORD);
+	      return 1;
 	    }
 	}
+    }
+  else
+    {
+      printf("Unable to open the series %s for FSN %d\n",query,gapfill->FSN[slot->index]);
+      slot->quality = slot->quality | QUAL_NOCOSMICRAY;
+    }
+  if(rectemp != NULL) drms_close_records(rectemp,DRMS_FREE_RECORD);
 
-      //NEED TO FILL THE NANs INSIDE THE CROP TABLE
-      for(k=0;k<nx*ny;++k)
+  return 0;
+}
+
+//corrects, masks, and gapfills the filtergram of slot (prefetch thread)
+//returns 1 if the mask cannot be created. slot->ierror stays NULL if the filtergram is not prepared (image not 4096x4096)
+int Lev1GapfillPrepare(struct lev1slot *slot,void *data)
+{
+  struct lev1gapfill *gapfill=(struct lev1gapfill *)data;
+  float *image=slot->image->data;
+  float  tempvalue,exptime=gapfill->EXPTIME[slot->index];
+  double *c=gapfill->nonlin;
+  int    i,status;
+
+  if(slot->image->axis[0] != 4096 || slot->image->axis[1] != 4096) return 0;
+  omp_set_num_threads(gapfill->nthreads);                            //share of the threads reserved for the prefetch thread (sets the team size of this thread only)
+  slot->ierror=drms_array_create(DRMS_TYPE_CHAR,2,slot->image->axis,NULL,&status);
+  if(status != DRMS_SUCCESS || slot->ierror == NULL)
+    {
+      slot->ierror=NULL;
+      return 0;
+    }
+
+  if(gapfill->inLinearity == 1)
+    {
+      for(i=0;i<4096*4096;++i)
 	{
-	  if(Mask[k] == 0)
-	    {
-	      if(isnan(image[k])) Mask[k] = 1;
-	    }
+	  //remove non-linearity of cameras
+	  tempvalue = image[i]*exptime;
+	  tempvalue = (c[0]+c[1]*tempvalue+c[2]*tempvalue*tempvalue+c[3]*tempvalue*tempvalue*tempvalue)+tempvalue;
+	  image[i]  = tempvalue/exptime;
 	}
+    }
 
-      //NEED TO FILL THE BAD PIXELS INSIDE THE CROP TABLE (FROM THE BAD PIXEL LIST)
-      if(ncosmic != -1 && nbadperm != -1) nBadPixels = nbadperm;//the cosmic-ray hit list is not missing and NBADPERM is a valid keyword
-      if(nBadPixels > 0)
-	{     
-	  for (k=0;k<nBadPixels;++k)
-	    {
-	      if(Mask[badpixellist[k]] == 0) Mask[badpixellist[k]] = 1; //pixel not in the crop area and in the bad pixel list: needs to be filled
-	    }
-	}
+  status=MaskCreation(gapfill->Mask,4096,4096,slot->badpixels,gapfill->HIMGCFID[slot->index],image,slot->cosmicrays,gapfill->NBADPERM[slot->index]);
+  drms_free_array(slot->badpixels);
+  slot->badpixels=NULL;
+  if(slot->cosmicrays != NULL) drms_free_array(slot->cosmicrays);
+  slot->cosmicrays=NULL;
+  if(status != 0) return 1;
 
+  status=do_gapfill(image,gapfill->Mask,gapfill->const_param,slot->ierror->data,4096,4096);
+  if(status != 0) slot->quality = slot->quality | QUAL_NOGAPFILL;
 
-      //NEED TO CORRECT THE COSMIC-RAY HITS INSIDE THE CROP TABLE (FROM THE COSMIC RAY HIT LIST)
-      if(ncosmic > 0)
-	{     
-	  for (k=0;k<ncosmic;++k)
-	    {
-	      if(Mask[cosmicraylist[k]] == 0) Mask[cosmicraylist[k]] = 1; //pixel not in the crop area and in the cosmic-ray hit list: needs to be filled
-	    }
-	}
+  return 0;
+}
 
-      status=0;
-      
+//stores in the frame cache the filtergram prepared by the prefetch thread (frame), used at target time usetime, and sets its QUALITY bits
+//returns 1 if its mask could not be created
+int Lev1GapfillStore(struct framecache *cache,struct lev1slot *frame,TIME usetime,int *QUALITY,int *QUALITYlev1)
+{
+  if(frame->statusprepare != 0)
+    {
+      printf("Error: unable to create a mask for the gap filling function for level 1 filtergram FSN = %d\n",cache->frame[frame->index].fsn);
+      drms_free_array(frame->image);
+      drms_free_array(frame->ierror);
+      return 1;
     }
-  
-  free(id);
-  free(nrows);
-  free(ncols);
-  free(rowstr);
-  free(colstr);
-  free(config);
-  free(kx);
-  free(filename_table);
-  id=NULL;
-  nrows=NULL;
-  ncols=NULL;
-  rowstr=NULL;
-  colstr=NULL;
-  config=NULL;
-  kx=NULL;
-  filename_table=NULL;
+  printf("segment was read and gapfilled in advance for FSN %d\n",cache->frame[frame->index].fsn);
+  if((frame->quality & QUAL_NOGAPFILL) == QUAL_NOGAPFILL) printf("Error: gapfilling code did not work on level 1 filtergram FSN = %d\n",cache->frame[frame->index].fsn);
+  *QUALITY = *QUALITY | frame->quality;
+  QUALITYlev1[frame->index] = QUALITYlev1[frame->index] | frame->quality;
+  FrameCacheStore(cache,frame->index,frame->image,frame->ierror,usetime);
 
-  return status;
+  return 0;
 }
 
 
@@ -1095,6 +952,36 @@ int heightformation(int FID, double OBSVR, float *CDELT1, float *RSUN, float *CR
 }
 
 
+//LATEST LEVEL 1 RECORD ARRIVED (NRT MODE)
+//puts in latest the latest T_OBS of the records of series between TimeBegin and TimeEnd, or TimeBegin-1 if there is none
+//returns the status of the query (DRMS_SUCCESS if it succeeded)
+int Lev1LatestTOBS(DRMS_Env_t *env,const char *series,TIME TimeBegin,TIME TimeEnd,TIME *latest)
+{
+  DRMS_Array_t *arr=NULL;
+  char   query[512],timeBegin[64],timeEnd[64];
+  double *tobs;
+  int    i,status=0;
+
+  *latest=TimeBegin-1.0;
+  sprint_time(timeBegin,TimeBegin,"TAI",0);
+  sprint_time(timeEnd,TimeEnd,"TAI",0);
+  snprintf(query,512,"%s[%s-%s]",series,timeBegin,timeEnd);          //T_OBS IS THE FIRST PRIME KEY OF LEVEL 1 DATA
+  arr=drms_record_getvector(env,query,"T_OBS",DRMS_TYPE_DOUBLE,0,&status);
+  if(status != DRMS_SUCCESS)
+    {
+      printf("Error: the query %s of the latest level 1 records failed (status %d)\n",query,status);
+      if(arr != NULL) drms_free_array(arr);
+      return status;
+    }
+  if(arr == NULL) return DRMS_SUCCESS;                               //no record yet
+  tobs=arr->data;
+  for(i=0;i<arr->axis[1];++i) if(tobs[i] > *latest) *latest=tobs[i];
+  drms_free_array(arr);
+
+  return DRMS_SUCCESS;
+}
+
+
 //FUNCTION TO RETURN THE VERSION NUMBER OF THE OBSERVABLES CODE
 
 char *observables_version() // Returns CVS version of Observables
@@ -1139,6 +1026,14 @@ int DoIt(void)
   char *dpath              = cmdparams_get_str(&cmdparams,"dpath",         NULL);      //directory where the source code is located
   int   inLinearity        = cmdparams_get_int(&cmdparams,Linearity,       NULL);      //Correct for non-linearity of cameras? yes=1, no=0 (default)
   int   unusual            = cmdparams_get_int(&cmdparams,Unusual,         NULL);      //unusual sequences? yes=1, no=0. Use only when trying to produce side camera observables
+  int   InverseTables      = cmdparams_get_int(&cmdparams,InverseIn,       NULL);      //Dopplergrams computed by Dopplergram() with inverse look-up tables? yes=1, no=0 (default)
+  int   Observables        = cmdparams_get_int(&cmdparams,ObservablesIn,   NULL);      //bitmask of the level 1.5 observables to produce
+  int   PrefetchSlots      = cmdparams_get_int(&cmdparams,PrefetchIn,      NULL);      //maximum number of level 1 filtergrams read in advance (0=no prefetch)
+  int   Lookahead          = cmdparams_get_int(&cmdparams,LookaheadIn,     NULL);      //number of target times whose level 1 filtergrams are read and gapfilled in advance
+  int   FrameCacheMB       = cmdparams_get_int(&cmdparams,FrameCacheIn,    NULL);      //maximum memory (in MB) used by the frame cache (0=no maximum)
+  int   PageHours          = cmdparams_get_int(&cmdparams,PageIn,          NULL);      //number of hours of target times whose level 1 records are opened at once (0=the whole time range)
+  int   Follow             = cmdparams_get_int(&cmdparams,FollowIn,        NULL);      //nrt mode: number of seconds between two checks for new level 1 records (0=no nrt mode)
+  int   WriterSlots        = cmdparams_get_int(&cmdparams,WriterIn,        NULL);      //maximum number of level 1.5 segments queued for the writer thread (0=no writer thread)
 
   //THE FOLLOWING VARIABLES SHOULD BE SET AUTOMATICALLY BY OTHER PROGRAMS.
   char *CODEVERSION =NULL;                                                             //version of the l.o.s. observable code
@@ -1207,7 +1102,55 @@ int DoIt(void)
       //exit(EXIT_FAILURE);
     }
 
-  printf("COMMAND LINE PARAMETERS:\n inRecquery = %s \n inRecquery2 = %s \ninLev = %s \n outLev = %s \n WavelengthID = %d \n QuickLook = %d \n CamId = %d \n DataCadence = %f \n smooth= %d \n rotational = %d \n dpath = %s linearity = %d\n",inRecQuery,inRecQuery2,inLev,outLev,WavelengthID,QuickLook,CamId,DataCadence,inSmoothTables,inRotationalFlat,dpath,inLinearity);
+  if(InverseTables != 0 && InverseTables != 1)                                         //check that the choice of the Dopplergram routine is valid (must be either 0 or 1)
+    {
+      printf("The parameter inverse must be either 0 or 1\n");
+      return 1;
+    }
+
+  if((Observables & ~LEV15_ALL) != 0 || (Observables & LEV15_ALL) == 0)                //check that the selection of observables is valid (bitmask between 1 and 31)
+    {
+      printf("The parameter observables must be between 1 and %d\n",LEV15_ALL);
+      return 1;
+    }
+
+  if(PrefetchSlots < 0)                                                                //check that the size of the prefetch buffer is valid
+    {
+      printf("The parameter prefetch must be positive or 0\n");
+      return 1;
+    }
+
+  if(Lookahead < 0)                                                                    //check that the number of target times processed in advance is valid
+    {
+      printf("The parameter lookahead must be positive or 0\n");
+      return 1;
+    }
+
+  if(FrameCacheMB < 0)                                                                 //check that the memory budget of the frame cache is valid
+    {
+      printf("The parameter framecache must be positive or 0\n");
+      return 1;
+    }
+
+  if(PageHours < 0)                                                                    //check that the length of the pages of target times is valid
+    {
+      printf("The parameter page must be positive or 0\n");
+      return 1;
+    }
+
+  if(Follow < 0 || (Follow > 0 && QuickLook != 1))                                     //check that the nrt mode is only requested for quicklook observables
+    {
+      printf("The parameter follow must be positive or 0, and can only be used with quicklook=1\n");
+      return 1;
+    }
+
+  if(WriterSlots < 0)                                                                  //check that the size of the writer buffer is valid
+    {
+      printf("The parameter writer must be positive or 0\n");
+      return 1;
+    }
+
+  printf("COMMAND LINE PARAMETERS:\n inRecquery = %s \n inRecquery2 = %s \ninLev = %s \n outLev = %s \n WavelengthID = %d \n QuickLook = %d \n CamId = %d \n DataCadence = %f \n smooth= %d \n rotational = %d \n dpath = %s linearity = %d\n inverse = %d\n observables = %d\n prefetch = %d\n lookahead = %d\n framecache = %d\n page = %d\n follow = %d\n writer = %d\n",inRecQuery,inRecQuery2,inLev,outLev,WavelengthID,QuickLook,CamId,DataCadence,inSmoothTables,inRotationalFlat,dpath,inLinearity,InverseTables,Observables,PrefetchSlots,Lookahead,FrameCacheMB,PageHours,Follow,WriterSlots);
 
   // Main Parameters                                                                                                    
   //*****************************************************************************************************************
@@ -1249,6 +1192,9 @@ int DoIt(void)
   TIME  TREC_EPOCH0= sscan_time("1993.01.01_00:00:00_TAI");
   TIME  temptime=0.0, temptime2=0.0;
   TIME  TimeBegin,TimeEnd,TimeBegin2,TimeEnd2,TargetTime,PreviousTargetTime;
+  TIME  PageBegin,PageEnd;                                           //time range of the target times of the current page
+  int   PagesLev1=0;                                                 //number of pages for which level 1 records were found
+  TIME  FollowEnd=0.0;                                               //nrt mode: ending time requested by the user (TimeEnd is then the last target time whose level 1 records have all arrived)
   TIME *internTOBS=NULL;                                             //array containing the time T_OBS of each filtergram opened, in seconds elapsed since a given date
   TIME  trec;					                     //trec is the slot time
   TIME  tobs;					                     //tobs is the nominal time. For now, we will always have tobs=trec
@@ -1272,7 +1218,6 @@ int DoIt(void)
   char  TargetISS[]="CLOSED";
   char  source[64000];
   char  recnums[MaxNString];
-  char  HMIFlatField0[MaxNString];
   char  *HMIFlatField;                                               //pzt flafields applied to hmi.lev1 records
 
   int  *keyL=NULL;
@@ -1298,10 +1243,11 @@ int DoIt(void)
   int  *HPLTID=NULL;
   int  *HIMGCFID=NULL;                                               //image configuration, used to produce the Mask for gap filling
   int  *KeywordMissing=NULL;
-  int  *SegmentRead=NULL;                                            //Array that provides the status of the level 1 filtergrams
-                                                                     //SegmentRead[i]=0 if the segment of the filtergram i is not in memory
-                                                                     //SegmentRead[i]=1 if the segment of the filtergram i is in memory and fine
-                                                                     //SegmentRead[i]=-1 if the segment of the filtergram i is missing or corrupt
+  struct framecache Frames;                                          //gapfilled level 1 filtergrams kept in memory. Frames.frame[i].state provides the status of the level 1 filtergram i:
+                                                                     //FRAME_NOTREAD if the segment of the filtergram i is not in memory
+                                                                     //FRAME_CACHED if the segment of the filtergram i is in memory and fine
+                                                                     //FRAME_CORRUPT if the segment of the filtergram i is missing or corrupt
+  struct flatfieldcache Flats;                                       //pzt and rotational flat fields kept in memory, when rotational=1
   int  *HCAMID=NULL;                                                 //front or side camera?
   int   TargetWavelength=0;                                          //index of the filtergram level 1 with the wavelength WavelengthID and that is closest to TargetTime
   int  *IndexFiltergram=NULL;                                        //an array that will contain the indeces of level 1 filtergrams with wavelength=WavelengthID 
@@ -1321,7 +1267,7 @@ int DoIt(void)
   int   WavelengthIndex[MaxNumFiltergrams], WavelengthLocation[MaxNumFiltergrams], *OrganizeFramelist=NULL,  *OrganizeFramelist2=NULL, *FramelistArray=NULL, *SegmentStatus=NULL;
   int   FIDValues[MaxNumFiltergrams];
   int  CameraValues[MaxNumFiltergrams];
-  int  FiltergramLocation, Needed;
+  int  FiltergramLocation;
   int Lev1pWanted=0;                                                 //do we need to produce and save level 1p data?
   int Lev1dWanted=0;                                                 //do we need to produce and save level 1d data?
   int Lev15Wanted=0;                                                 //do we need to produce and save level 1.5 data?
@@ -1336,6 +1282,7 @@ int DoIt(void)
   int combine;                                                       //do we need to combine the front and side camera to produce the desired output? 
   int ThresholdPol;                                                  //minimum number of filtergrams for the temporal interpolation (2 if quicklook=0, and 1 if quicklook=1)
   int nthreads;
+  int PrefetchThreads;                                               //OpenMP threads reserved for the do_gapfill() calls of the prefetch thread
   int CARROTint;
   int camera,fidfilt;
   int ngood;
@@ -1350,7 +1297,6 @@ int DoIt(void)
   int *QUALITYin=NULL;
   int *QUALITYlev1=NULL;
   int COSMICCOUNT=0;
-  int initialrun=0;
   int totalTempIntNum;
   int *CAMERA=NULL;
 
@@ -1369,13 +1315,17 @@ int DoIt(void)
   DRMS_RecordSet_t *rectemp  = NULL;                                 //record for the temperatures
   DRMS_RecordSet_t *recpoly  = NULL;                                 //record for polynomial coefficients
   DRMS_RecordSet_t *recpoly2 = NULL; 
-  DRMS_RecordSet_t *recflat  = NULL;                                 //record for the pzt flatfield
-  DRMS_RecordSet_t *recflatrot= NULL;                                //record for the rotational flatfield
 
   DRMS_Array_t *arrayL0=NULL;
   DRMS_Array_t *arrayL1=NULL;
   DRMS_Array_t *arrayL2=NULL;
-  DRMS_Array_t *rotationalflats=NULL;
+  DRMS_Array_t *arrayLK0=NULL;                                       //keywords of the look-up table series, read once per run
+  DRMS_Array_t *arrayLK1=NULL;                                       //T_REC of the look-up table series, read once per run
+
+  //CACHE OF THE LOOK-UP TABLES AND POLYNOMIAL COEFFICIENTS ACROSS TARGET TIMES (THE TABLES ONLY CHANGE AT RETUNES)
+  int lookupkey[7]={-1,-1,-1,-1,-1,-1,-1};                           //FSN_REC, CamId, HCME1, HCMWB, HCMPOL, HCMNB, and NC of the look-up tables in arrintable
+  int coeffkey[3]={-1,-1,-1};                                        //FSN_REC of the look-up tables and indices temp and temp2 of the polynomial coefficients in coeffcache
+  double coeffcache[8];                                              //polynomial coefficients of the records temp and temp2
 
   double diftime=0.0;
   double coeff[4],coeff2[4];                                         //polynomial coefficients for the correction of the Doppler velocity returned by the MDI-like algorithm
@@ -1545,8 +1495,15 @@ int DoIt(void)
   strcpy(QueryFlatField,"");
 
   double minimum,maximum,median,mean,sigma,skewness,kurtosis;        //for Keh-Cheng's statistics functions
+  struct imagestats statsLev15[6],statsLev15R[6];                    //statistics of the level 1.5 observables on the entire images, and within 99% of RSUN
+  float  *imagesLev15[6];
+  double rangemin15[5],rangemax15[5];                                //range of values that can be stored in the segments of the level 1.5 observables
+  double intmax15[5]={32767.,2147483647.,32767.,32767.,32767.};      //the magnetogram segment is of type int, the other ones of type short
 
   struct initial const_param;                                        //structure containing the parameters for Richard's functions
+  struct initial const_paramPrefetch;                                //copy of const_param for the prefetch thread
+  struct initial *const_paramSlots=NULL;                             //copies of const_param for the OpenMP threads 1, 2, ... of the concurrent do_interpolate() calls
+  int   const_paramPrefetchInit=0,nconst_paramSlots=0;               //is const_paramPrefetch initialized? number of copies in const_paramSlots
   struct keyword *KeyInterp=NULL;                                    //pointer to a list of structures containing some keywords needed by the temporal interpolation code
   struct keyword KeyInterpOut;			                     
   struct parameterDoppler DopplerParameters;                         //structure to provide some parameters defined in HMIparam.h to Dopplergram()
@@ -1558,14 +1515,24 @@ int DoIt(void)
   DRMS_Array_t  *CosmicRays= NULL;                                   //list of cosmic ray hits
   DRMS_Array_t  *arrin[TempIntNum];                                  //arrays that will contain pointers to the segments of the filtergrams needed for temporal interpolation
   DRMS_Array_t  *arrerrors[TempIntNum];                              //arrays that will contain pointers to the error maps returned by the gapfilling code
-  DRMS_Array_t  **Segments=NULL;                                     //pointer to pointers to structures that will contain the segments of the level 1 filtergrams
-  DRMS_Array_t  **Ierror=NULL;                                       //for gapfilling code
+  DRMS_Array_t  *FrameImage=NULL;                                    //segment of the level 1 filtergram being read and gapfilled, before it is stored in the frame cache
+  DRMS_Array_t  *BadPixelsPrefetch=NULL;                             //list of bad pixels read by the prefetch thread
+  struct lev1prefetch Prefetch;                                      //prefetch thread and buffer of the level 1 filtergrams read in advance
+  struct lev15writer  Writer;                                        //writer thread and buffer of the level 1.5 segments written in the background
+  int  *PrefetchList=NULL;                                           //record indices of the level 1 filtergrams to read in advance, in the order in which they are needed
+  int   nPrefetch=0,nPrefetchNext=0;                                 //number of filtergrams in PrefetchList, and position in PrefetchList of the first one not yet requested
+  int   Prefetched=0,statusBadPixels;
+  struct lev1slot PrefetchFrame;                                     //filtergram handed over by the prefetch thread
+  struct lev1gapfill Gapfill;                                        //parameters of the correction and gapfilling done by the prefetch thread
+  struct keyvector Lev1Keys;                                         //numerical keywords of the level 1 records, read in one query
+  const char *Lev1KeyNames[NLEV1KEYS]={FSNS,TOBSS,HWL1POSS,HWL2POSS,HWL3POSS,HWL4POSS,HPL1POSS,HPL2POSS,HPL3POSS,FIDS,HCAMIDS,HCFTIDS,"HFTSACID",CRPIX1S,CRPIX2S,X0LFS,Y0LFS,
+				       RSUNS,CROTA2S,CRLTOBSS,DSUNOBSS,HIMGCFIDS,CDELT1S,OBSVRS,OBSVWS,OBSVNS,CARROTS,CRLNOBSS,HWLTIDS,HPLTIDS,"EXPTIME",NBADPERMS,QUALITYS,CALVER32S,CAMERAS};
+  DRMS_Array_t  *FrameError=NULL;                                    //for gapfilling code
   DRMS_Array_t  **arrLev1d= NULL;                                    //pointer to pointer to an array that will contain a lev1d data produced by Richard's function
   DRMS_Array_t  **arrLev1p= NULL;                                    //pointer to pointer to an array that will contain a lev1p data produced by Jesper's function
   DRMS_Array_t  **arrLev15= NULL;                                    //pointer to pointer to an array that will contain a lev1.5 data produced by Seb's function		                 
   DRMS_Array_t  *arrintable= NULL;		                     
-  DRMS_Array_t  *flatfield=NULL;                                     //pzt flatfield used for hmi.lev1 records
-  DRMS_Array_t  *flatfieldrot=NULL;                                  //rotational flat field
+  DRMS_Array_t  *arrinverse= NULL;                                   //inverse look-up tables, to locate the brackets of the look-up tables in Dopplergram()
 
 
   DRMS_Type_t type1d = DRMS_TYPE_FLOAT;                              //type of the level 1d data produced by Richard's function
@@ -1581,8 +1548,9 @@ int DoIt(void)
   DRMS_Record_t *rec = NULL;
 
   double t0,t1;
-  double *keyF=NULL;
-  double TSTARTFLAT=0.0, TSTOPFLAT=0.0;
+  struct slotinterp *Slots=NULL;                                     //temporal interpolations of the slots of the framelist at the current target time
+  int   nSlotInterp,nSlotThreads,MaxActiveLevels;                    //number of slots interpolated concurrently, number of threads of each, and saved OpenMP nesting level
+  int   QualityInterp;                                               //QUALITY bits set by the temporal interpolations of the slots already written
 
   //VALUES USED PRIOR TO JANUARY 15, 2014:
   //to remove non-linearity of cameras (values from sun_lin.pro, from hmi_ground.lev0[1420880-1420945])
@@ -1612,7 +1580,15 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
   //nthreads=omp_get_num_procs();                                      //number of threads supported by the machine where the code is running
   //omp_set_num_threads(nthreads);                                     //set the number of threads to the maximum value
   nthreads=omp_get_max_threads();
-  printf("NUMBER OF THREADS USED BY OPEN MP= %d\n",nthreads);
+  PrefetchThreads=0;
+  if(PrefetchSlots > 0 && inRotationalFlat == 0 && nthreads > 1)      //the prefetch thread gapfills: a quarter of the threads is reserved for its do_gapfill() calls
+    {
+      PrefetchThreads=nthreads/4;
+      if(PrefetchThreads < 1) PrefetchThreads=1;
+      nthreads-=PrefetchThreads;
+      omp_set_num_threads(nthreads);                                 //the parallel regions of the main thread use the other threads
+    }
+  printf("NUMBER OF THREADS USED BY OPEN MP= %d (AND %d FOR THE PREFETCH THREAD)\n",nthreads,PrefetchThreads);
 
   //Checking the number of command-line parameters inLev and outLev
   /******************************************************************************************************************/
@@ -1747,6 +1723,13 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
       return 1;//exit(EXIT_FAILURE);
     }
 
+  if(Follow > 0 && TestLevIn[0] != 1)
+    {
+      printf("Error: the parameter follow can only be used with level 1 input data\n");
+      return 1;
+    }
+  FollowEnd=TimeEnd;
+
 
   //initialization of Richard's and Jesper's codes
   //*************************************************************************************
@@ -1965,28 +1948,84 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
     }
 
 
-  /***********************************************************************************************************************/
-  /*                                                                                                                     */
-  /*                                                                                                                     */
-  /* IF INPUT IS LEVEL 1 FILTERGRAMS                                                                                     */
-  /*                                                                                                                     */  
-  /*                                                                                                                     */
-  /***********************************************************************************************************************/
+  //THE TIME T_REC IS SLOTTED, SO HERE ARE THE INFO WE NEED TO DETERMINE THE PROPER SLOT:
+  TREC_STEP  = DataCadence;
+  //TREC_EPOCH0= 0.0; //value given to all the DRMS series that are slotted and corresponding to 1977.01.01_00:00:00_TAI or 1976.12.31_23:59:45_UTC (make sure all the .jsd files have the same TREC_EPOCH)
+  TargetTime = (TIME)floor((TimeBegin-TREC_EPOCH0+TREC_STEP/2.0)/TREC_STEP)*TREC_STEP+TREC_EPOCH0;  //WE LOCATE THE SLOT TIME CLOSEST TO THE BEGINNING TIME REQUIRED BY THE USER
+  if(TargetTime < TimeBegin) TargetTime+=TREC_STEP;
 
+  PreviousTargetTime=TargetTime;
 
-  if ( TestLevIn[0]==1 )                                             //input data are level 1 filtergrams (level 0 data that have been flat-fielded and dark frame removed)
+  //THE TARGET TIMES ARE PROCESSED BY PAGES OF PageHours HOURS: THE LEVEL 1 RECORDS NEEDED BY THE TARGET TIMES OF A PAGE
+  //ARE OPENED WHEN THE PAGE STARTS AND CLOSED WHEN IT ENDS, SO THAT THE MEMORY USED DOES NOT DEPEND ON THE LENGTH OF THE RUN
+  PageBegin=TimeBegin;
+  FlatFieldCacheCreate(&Flats,HMIRotationalFlats);                   //the flat fields are kept across pages
+  status=Lev15WriterStart(&Writer,Lev15Wanted ? WriterSlots : 0);    //the writer thread writes the level 1.5 segments of a target time while the next one is processed
+  if(status != 0) return 1;
+
+ NextPage:
+  //NRT MODE: THE TARGET TIMES ARE PROCESSED AS SOON AS THE LEVEL 1 RECORDS THEY NEED HAVE ARRIVED (UP TO TempIntNum*DataCadence/2+TimeCaution AFTER THEM,
+  //THE TIME RANGE OPENED FOR A PAGE). THE LEVEL 1 SERIES IS CHECKED EVERY Follow SECONDS, AND TimeEnd IS THE LAST TARGET TIME THAT CAN BE PROCESSED
+  if(Follow > 0)
     {
-
-      //the requested time range [timeBegin,timeEnd] must be increased to take into account
-      //the fact that the temporal interpolation scheme requires data points before and after
+      status=Lev1LatestTOBS(drms_env,HMISeriesLev10,TargetTime,FollowEnd+(TIME)TempIntNum*DataCadence/2.+TimeCaution,&temptime);
+      if(status != DRMS_SUCCESS)
+	{
+	  Lev15WriterStop(&Writer);
+	  return 1;//exit(EXIT_FAILURE);
+	}
+      TimeEnd=temptime-(TIME)TempIntNum*DataCadence/2.-TimeCaution;
+      if(TimeEnd < TargetTime && TargetTime <= FollowEnd)
+	{
+	  sprint_time(timeBegin2,TargetTime,"TAI",0);
+	  printf("NRT MODE: WAITING FOR THE LEVEL 1 RECORDS OF THE TARGET TIME %s\n",timeBegin2);
+	}
+      while(TimeEnd < TargetTime && TargetTime <= FollowEnd)
+	{
+	  //the transaction is committed before waiting, so that no transaction (and no database lock) stays open while the module sleeps
+	  drms_server_end_transaction(drms_env,0,0);
+	  sleep(Follow);
+	  drms_server_begin_transaction(drms_env);
+	  status=Lev1LatestTOBS(drms_env,HMISeriesLev10,TargetTime,FollowEnd+(TIME)TempIntNum*DataCadence/2.+TimeCaution,&temptime);
+	  if(status != DRMS_SUCCESS)
+	    {
+	      Lev15WriterStop(&Writer);
+	      return 1;//exit(EXIT_FAILURE);
+	    }
+	  TimeEnd=temptime-(TIME)TempIntNum*DataCadence/2.-TimeCaution;
+	}
+      TimeEnd=minval(TimeEnd,FollowEnd);
+    }
+
+  if(TestLevIn[0] == 1 && PageHours > 0) PageEnd=minval(TargetTime+(TIME)PageHours*3600.0-DataCadence/2.0,TimeEnd);
+  else PageEnd=TimeEnd;
+  sprint_time(timeBegin2,PageEnd,"TAI",0);
+  printf("PAGE OF TARGET TIMES ENDING AT %s\n",timeBegin2);
+
+
+  /***********************************************************************************************************************/
+  /*                                                                                                                     */
+  /*                                                                                                                     */
+  /* IF INPUT IS LEVEL 1 FILTERGRAMS                                                                                     */
+  /*                                                                                                                     */  
+  /*                                                                                                                     */
+  /***********************************************************************************************************************/
+
+
+  if ( TestLevIn[0]==1 )                                             //input data are level 1 filtergrams (level 0 data that have been flat-fielded and dark frame removed)
+    {
+
+      //the requested time range [timeBegin,timeEnd] must be increased to take into account
+      //the fact that the temporal interpolation scheme requires data points before and after
       //the first and last times wanted, and also we must add an extra time because of the
       //small difference there will be between SDO time and Earth time and because of the framelist length
       //**************************************************************************************************
 
-      TimeBegin2=TimeBegin-(TIME)TempIntNum*DataCadence/2.-TimeCaution;
-      TimeEnd2  =TimeEnd  +(TIME)TempIntNum*DataCadence/2.+TimeCaution;
+      TimeBegin2=PageBegin-(TIME)TempIntNum*DataCadence/2.-TimeCaution;
+      TimeEnd2  =PageEnd  +(TIME)TempIntNum*DataCadence/2.+TimeCaution;
       sprint_time(timeBegin2,TimeBegin2,"TAI",0);                   //convert the time from TIME format to a string with TAI type (UTC IS THE DEFAULT ZONE WHEN THE TYPE IS ABSENT)
       sprint_time(timeEnd2,TimeEnd2,"TAI",0);
+      strcpy(HMISeriesLev1,HMISeriesLev10);                         //the time range changes with each page
       strcat(HMISeriesLev1,"[");                                    //T_OBS IS THE FIRST PRIME KEY OF LEVEL 1 DATA
       strcat(HMISeriesLev1,timeBegin2);
       strcat(HMISeriesLev1,"-");
@@ -2001,10 +2040,11 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
       if (status == DRMS_SUCCESS && recLev1 != NULL && recLev1->n > 0)//successful opening of the input records (all these conditions are needed because the DRMS may claim it managed to open some records but the number of records might actually be 0. BUG?)
 	{
 	  nRecs1 = recLev1->n;                                      //number of level 1 records opened  
+	  ++PagesLev1;
 
 	  if(nRecs1 >= nRecmax)                                     //make sure this number of records does not exceed the maximum value allowed
 	    {
-	      printf("Too many records requested\n");
+	      printf("Too many records requested: the parameter page should be decreased\n");
 	      return 1;//exit(EXIT_FAILURE);
 	    }
 	  
@@ -2119,32 +2159,22 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	      printf("Error: memory could not be allocated to Y0\n");
 	      return 1;//exit(EXIT_FAILURE);
 	    }
-	  SegmentRead= (int *)malloc(nRecs1*sizeof(int));
-	  if(SegmentRead == NULL)
-	    {
-	      printf("Error: memory could not be allocated to SegmentRead\n");
-	      return 1;//exit(EXIT_FAILURE);
-	    }
+	  status=FrameCacheCreate(&Frames,nRecs1,(long long)FrameCacheMB*1048576LL);
+	  if(status != 0) return 1;//exit(EXIT_FAILURE);
 	  KeywordMissing= (int *)malloc(nRecs1*sizeof(int));
 	  if(KeywordMissing == NULL)
 	    {
 	      printf("Error: memory could not be allocated to KeywordMissing\n");
 	      return 1;//exit(EXIT_FAILURE);
 	    }
-	  Segments   = (DRMS_Array_t **)malloc(nRecs1*sizeof(DRMS_Array_t *));
-	  if(Segments == NULL)
+	  PrefetchList = (int *)malloc(nRecs1*sizeof(int));
+	  if(PrefetchList == NULL)
 	    {
-	      printf("Error: memory could not be allocated to Segments\n");
+	      printf("Error: memory could not be allocated to PrefetchList\n");
 	      return 1;//exit(EXIT_FAILURE);
 	    }
-	  for(i=0;i<nRecs1;i++) Segments[i]=NULL;
-	  Ierror   = (DRMS_Array_t **)malloc(nRecs1*sizeof(DRMS_Array_t *));
-	  if(Ierror == NULL)
-	    {
-	      printf("Error: memory could not be allocated to Ierror\n");
-	      return 1;//exit(EXIT_FAILURE);
-	    }
-	  for(i=0;i<nRecs1;i++) Ierror[i]=NULL;
+	  status=Lev1PrefetchStart(&Prefetch,PrefetchSlots,type1d);             //the prefetch thread reads the image segments into type1d data
+	  if(status != 0) return 1;
 	  IndexFiltergram = (int *)malloc(nRecs1*sizeof(int));     //array that will contain the record index of the filtergrams with the same wavelength as WavelengthID
 	  if(IndexFiltergram == NULL)
 	    {
@@ -2267,6 +2297,39 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	      printf("Error: memory could not be allocated to CAMERA\n");
 	      return 1;//exit(EXIT_FAILURE);
 	    }
+	  Gapfill.Mask = NULL;
+	  if(PrefetchSlots > 0 && inRotationalFlat == 0)                     //the prefetch thread also corrects and gapfills the filtergrams it reads
+	    {
+	      Gapfill.Mask = (unsigned char *)malloc(4096*4096*sizeof(unsigned char));
+	      if(Gapfill.Mask == NULL)
+		{
+		  printf("Error: memory could not be allocated to the mask of the prefetch thread\n");
+		  return 1;//exit(EXIT_FAILURE);
+		}
+	      Gapfill.CosmicRaySeries = CosmicRaySeries;
+	      Gapfill.COUNTS          = COUNTS;
+	      Gapfill.FSN             = FSN;
+	      Gapfill.HIMGCFID        = HIMGCFID;
+	      Gapfill.NBADPERM        = NBADPERM;
+	      Gapfill.EXPTIME         = EXPTIME;
+	      Gapfill.inLinearity     = inLinearity;
+	      if(CamId == LIGHT_FRONT) Gapfill.nonlin = nonlinf; else Gapfill.nonlin = nonlins;
+	      if(const_paramPrefetchInit == 0)
+		{
+		  strcpy(dpath2,dpath);
+		  strcat(dpath2,"/../../../");
+		  status = initialize_interpol(&const_paramPrefetch,&initfiles,4096,4096,dpath2);
+		  if(status != 0)
+		    {
+		      printf("Error: could not initialize the gapfilling routine of the prefetch thread\n");
+		      return 1;//exit(EXIT_FAILURE);
+		    }
+		  const_paramPrefetchInit=1;
+		}
+	      Gapfill.const_param     = &const_paramPrefetch;
+	      Gapfill.nthreads        = PrefetchThreads;
+	      Lev1PrefetchPrepare(&Prefetch,Lev1GapfillStage,Lev1GapfillPrepare,&Gapfill);
+	    }
 
 
 
@@ -2275,29 +2338,30 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	  //***********************************************************************************************************************
 
 	  t0=dsecnd();
+	  KeyVectorRead(drms_env,HMISeriesLev1,recLev1,NLEV1KEYS,Lev1KeyNames,&Lev1Keys);
 
 	  k=0;
 	  for(i=0;i<nRecs1;++i)  //loop over all the opened level 1 records
 	    {	  
-	      FSN[i]        = drms_getkey_int(recLev1->records[i] ,FSNS            ,&statusA[0]); //not actually needed, just for debugging purpose
+	      FSN[i]        = KeyVectorInt(&Lev1Keys,LEV1_FSN,recLev1,i,&statusA[0]); //not actually needed, just for debugging purpose
 
 	      //IMPORTANT KEYWORDS: IF ABSENT, THE CODE WON'T PRODUCE AN OBSERVABLE
-	      internTOBS[i] = drms_getkey_time(recLev1->records[i],TOBSS           ,&statusA[1]);
-	      HWL1POS[i]    = drms_getkey_int(recLev1->records[i] ,HWL1POSS        ,&statusA[2]);
-	      HWL2POS[i]    = drms_getkey_int(recLev1->records[i] ,HWL2POSS        ,&statusA[3]); 
-	      HWL3POS[i]    = drms_getkey_int(recLev1->records[i] ,HWL3POSS        ,&statusA[4]); 
- 	      HWL4POS[i]    = drms_getkey_int(recLev1->records[i] ,HWL4POSS        ,&statusA[5]);
-	      HPL1POS[i]    = drms_getkey_int(recLev1->records[i] ,HPL1POSS        ,&statusA[6]);
-	      HPL2POS[i]    = drms_getkey_int(recLev1->records[i] ,HPL2POSS        ,&statusA[7]);
-	      HPL3POS[i]    = drms_getkey_int(recLev1->records[i] ,HPL3POSS        ,&statusA[8]);
-	      FID[i]        = drms_getkey_int(recLev1->records[i] ,FIDS            ,&statusA[9]);
-	      HCAMID[i]     = drms_getkey_int(recLev1->records[i] ,HCAMIDS         ,&statusA[10]);
+	      internTOBS[i] = KeyVectorTime(&Lev1Keys,LEV1_TOBS,recLev1,i,&statusA[1]);
+	      HWL1POS[i]    = KeyVectorInt(&Lev1Keys,LEV1_HWL1POS,recLev1,i,&statusA[2]);
+	      HWL2POS[i]    = KeyVectorInt(&Lev1Keys,LEV1_HWL2POS,recLev1,i,&statusA[3]); 
+	      HWL3POS[i]    = KeyVectorInt(&Lev1Keys,LEV1_HWL3POS,recLev1,i,&statusA[4]); 
+ 	      HWL4POS[i]    = KeyVectorInt(&Lev1Keys,LEV1_HWL4POS,recLev1,i,&statusA[5]);
+	      HPL1POS[i]    = KeyVectorInt(&Lev1Keys,LEV1_HPL1POS,recLev1,i,&statusA[6]);
+	      HPL2POS[i]    = KeyVectorInt(&Lev1Keys,LEV1_HPL2POS,recLev1,i,&statusA[7]);
+	      HPL3POS[i]    = KeyVectorInt(&Lev1Keys,LEV1_HPL3POS,recLev1,i,&statusA[8]);
+	      FID[i]        = KeyVectorInt(&Lev1Keys,LEV1_FID,recLev1,i,&statusA[9]);
+	      HCAMID[i]     = KeyVectorInt(&Lev1Keys,LEV1_HCAMID,recLev1,i,&statusA[10]);
 	      if(HCAMID[i] != LIGHT_SIDE && HCAMID[i] != LIGHT_FRONT) statusA[11]=1;              //we have a dark frame, and this is an error
-	      CFINDEX[i]    = drms_getkey_int(recLev1->records[i] ,HCFTIDS         ,&statusA[11]);
+	      CFINDEX[i]    = KeyVectorInt(&Lev1Keys,LEV1_HCFTID,recLev1,i,&statusA[11]);
 
 
 	      //TRIVIAL KEYWORDS: IF ABSENT, NO BIG DEAL
-	      HFLID[i]      = drms_getkey_int(recLev1->records[i] ,"HFTSACID"      ,&statusA[12]);
+	      HFLID[i]      = KeyVectorInt(&Lev1Keys,LEV1_HFTSACID,recLev1,i,&statusA[12]);
 	      
 	      //SOME SEQUENCES NEED TO COMBINE FRONT AND SIDE CAMERAS TO PRODUCE I,Q,U,V BUT TAKE TWICE THE SAME SEQUENCE ON THE
 	      //FRONT CAMERA. IN THESE CASES, THE FID OF THE SECOND HALF OF THE SEQUENCE NEEDS TO BE CHANGED FOR THE CODE
@@ -2325,16 +2389,16 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 		}
 	      IMGTYPE[i]    = drms_getkey_string(recLev1->records[i],IMGTYPES       ,&statusA[13]);
 
-	      X0[i]         = (float)drms_getkey_double(recLev1->records[i],CRPIX1S, &statusA[14]);
+	      X0[i]         = (float)KeyVectorDouble(&Lev1Keys,LEV1_CRPIX1,recLev1,i, &statusA[14]);
 	      if(statusA[14] == DRMS_SUCCESS && !isnan(X0[i])) X0[i]=X0[i]-1.0;                   //BECAUSE CRPIX1 STARTS AT 1
 	      else statusA[14] = 1;
 	      //if(isnan(X0[i])) statusA[14] = 0;//we can still use the filtergram even if CRPIX1 is crap (this filtergram will just be discarded later if needed)
-	      Y0[i]         = (float)drms_getkey_double(recLev1->records[i],CRPIX2S,&statusA[15]);
+	      Y0[i]         = (float)KeyVectorDouble(&Lev1Keys,LEV1_CRPIX2,recLev1,i,&statusA[15]);
 	      if(statusA[15] == DRMS_SUCCESS && !isnan(Y0[i])) Y0[i]=Y0[i]-1.0;                   //BECAUSE CRPIX2 STARTS AT 1
 	      else statusA[15] = 1;
 
-	      X0LF = (float)drms_getkey_double(recLev1->records[i],X0LFS, &status);
-	      Y0LF = (float)drms_getkey_double(recLev1->records[i],Y0LFS, &status2);
+	      X0LF = (float)KeyVectorDouble(&Lev1Keys,LEV1_X0LF,recLev1,i, &status);
+	      Y0LF = (float)KeyVectorDouble(&Lev1Keys,LEV1_Y0LF,recLev1,i, &status2);
 	      if(status != DRMS_SUCCESS || status2 != DRMS_SUCCESS || isnan(X0LF) || isnan(Y0LF)) //returns NaN during eclipses
 		{
 		  statusA[14]=1;
@@ -2345,9 +2409,9 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 		}
 
 	      //if(isnan(Y0[i])) statusA[15] = 0;//we can still use the filtergram even if CRPIX2 is crap (this filtergram will just be discarded later if needed)
-	      RSUN[i]       = (float)drms_getkey_double(recLev1->records[i],RSUNS   ,&statusA[16]);
+	      RSUN[i]       = (float)KeyVectorDouble(&Lev1Keys,LEV1_RSUN,recLev1,i,&statusA[16]);
 	      //if(isnan(RSUN[i])) statusA[16]=0;//we can still use the filtergram even if R_SUN is crap (this filtergram will just be discarded later if needed)
-	      CROTA2[i]     = (float)drms_getkey_double(recLev1->records[i],CROTA2S ,&statusA[17]);
+	      CROTA2[i]     = (float)KeyVectorDouble(&Lev1Keys,LEV1_CROTA2,recLev1,i,&statusA[17]);
 
 
 	      //CHECK FOR WRONG VALUES OF CROTA2 (ABSURD VALUES CAN BE SET IN LEV 1 RECORDS IF THE ANCILLARY DATA HAVE NOT BEEN RECEIVED)
@@ -2361,28 +2425,28 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	      if(statusA[17] == DRMS_SUCCESS && !isnan(CROTA2[i])) CROTA2[i]=-CROTA2[i];          //BECAUSE CROTA2 IS THE NEGATIVE OF THE P-ANGLE
 	      else statusA[17] = 1;
 
-	      CRLTOBS[i]    = (float)drms_getkey_double(recLev1->records[i],CRLTOBSS,&statusA[18]);
+	      CRLTOBS[i]    = (float)KeyVectorDouble(&Lev1Keys,LEV1_CRLTOBS,recLev1,i,&statusA[18]);
 	      if(isnan(CRLTOBS[i])) statusA[18] = 1;
-	      DSUNOBS[i]    =        drms_getkey_double(recLev1->records[i],DSUNOBSS,&statusA[19]);
+	      DSUNOBS[i]    =        KeyVectorDouble(&Lev1Keys,LEV1_DSUNOBS,recLev1,i,&statusA[19]);
 	      if(isnan(DSUNOBS[i])) statusA[19] = 1;
-	      HIMGCFID[i]   = drms_getkey_int(recLev1->records[i] ,HIMGCFIDS        ,&statusA[20]);
+	      HIMGCFID[i]   = KeyVectorInt(&Lev1Keys,LEV1_HIMGCFID,recLev1,i,&statusA[20]);
 	      if(isnan(HIMGCFID[i])) statusA[20] = 1;
-	      CDELT1[i]     = (float)drms_getkey_double(recLev1->records[i] ,CDELT1S,&statusA[21]);
+	      CDELT1[i]     = (float)KeyVectorDouble(&Lev1Keys,LEV1_CDELT1,recLev1,i,&statusA[21]);
 	      if(isnan(CDELT1[i])) statusA[21] = 1;
-	      OBSVR[i]      =       drms_getkey_double(recLev1->records[i] ,OBSVRS ,&statusA[22]);
+	      OBSVR[i]      =       KeyVectorDouble(&Lev1Keys,LEV1_OBSVR,recLev1,i,&statusA[22]);
 	      if(isnan(OBSVR[i])) statusA[22] = 1;
-	      OBSVW[i]      =       drms_getkey_double(recLev1->records[i] ,OBSVWS ,&statusA[23]);
+	      OBSVW[i]      =       KeyVectorDouble(&Lev1Keys,LEV1_OBSVW,recLev1,i,&statusA[23]);
 	      if(isnan(OBSVW[i])) statusA[23] = 1;
-	      OBSVN[i]      =       drms_getkey_double(recLev1->records[i] ,OBSVNS ,&statusA[24]);
+	      OBSVN[i]      =       KeyVectorDouble(&Lev1Keys,LEV1_OBSVN,recLev1,i,&statusA[24]);
 	      if(isnan(OBSVN[i])) statusA[24] = 1;
-	      CARROT[i]     = drms_getkey_int(recLev1->records[i] ,CARROTS          ,&statusA[25]);
-	      SegmentRead[i]= 0;  //initialization: segment not in memory
+	      CARROT[i]     = KeyVectorInt(&Lev1Keys,LEV1_CARROT,recLev1,i,&statusA[25]);
+	      Frames.frame[i].fsn=FSN[i];
 	      KeywordMissing[i]=0;//no keyword is nissing, a priori
-	      CRLNOBS[i]    = (float)drms_getkey_double(recLev1->records[i] ,CRLNOBSS,&statusA[26]);
+	      CRLNOBS[i]    = (float)KeyVectorDouble(&Lev1Keys,LEV1_CRLNOBS,recLev1,i,&statusA[26]);
 	      if(isnan(CRLNOBS[i])) statusA[26] = 1;
 	      statusA[27]=0;
-	      HWLTID[i]     = drms_getkey_int(recLev1->records[i] ,HWLTIDS           ,&statusA[28]);
-	      HPLTID[i]     = drms_getkey_int(recLev1->records[i] ,HPLTIDS           ,&statusA[29]);
+	      HWLTID[i]     = KeyVectorInt(&Lev1Keys,LEV1_HWLTID,recLev1,i,&statusA[28]);
+	      HPLTID[i]     = KeyVectorInt(&Lev1Keys,LEV1_HPLTID,recLev1,i,&statusA[29]);
 	      HWLTNSET[i]    = (char *)malloc(7*sizeof(char *));                                  //6 because HWLTNSET is either OPEN or CLOSED, i.e. 6 characters + \0 
 	      if(HWLTNSET[i] == NULL)
 		{
@@ -2390,21 +2454,21 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 		  return 1;//exit(EXIT_FAILURE);
 		}
 	      HWLTNSET[i]   = drms_getkey_string(recLev1->records[i] ,HWLTNSETS      ,&statusA[30]); //status of ISS loop: open or close
-	      EXPTIME[i]    = (float)drms_getkey_double(recLev1->records[i],"EXPTIME",&statusA[31]);
+	      EXPTIME[i]    = (float)KeyVectorDouble(&Lev1Keys,LEV1_EXPTIME,recLev1,i,&statusA[31]);
 
-	      NBADPERM[i]   = drms_getkey_int(recLev1->records[i] ,NBADPERMS         ,&statusA[32]);
+	      NBADPERM[i]   = KeyVectorInt(&Lev1Keys,LEV1_NBADPERM,recLev1,i,&statusA[32]);
 	      if(statusA[32] != DRMS_SUCCESS) NBADPERM[i]=-1;
-	      QUALITYin[i]  = drms_getkey_int(recLev1->records[i] ,QUALITYS          ,&statusA[33]);
+	      QUALITYin[i]  = KeyVectorInt(&Lev1Keys,LEV1_QUALITY,recLev1,i,&statusA[33]);
 	      if(statusA[33] != DRMS_SUCCESS) KeywordMissing[i]=1; //enough to have the record rejected
 	      //WE TEST WHETHER THE DATA SEGMENT IS MISSING
 	      if( (QUALITYin[i] & Q_MISSING_SEGMENT) == Q_MISSING_SEGMENT)
 		{
 		  statusA[33]=1;
-		  SegmentRead[i]= -1;
+		  FrameCacheDrop(&Frames,i,FRAME_CORRUPT);
 		  KeywordMissing[i]=1;
 		}
 
-	      CALVER32[i]   = (long long)drms_getkey_int(recLev1->records[i] ,CALVER32S,&statusA[34]);
+	      CALVER32[i]   = (long long)KeyVectorInt(&Lev1Keys,LEV1_CALVER32,recLev1,i,&statusA[34]);
 	      if(statusA[34] != DRMS_SUCCESS)
 		{
 		  CALVER32[i]=CALVER_DEFAULT; //following Phil's email of August 28, 2012
@@ -2415,7 +2479,7 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 		  printf("Error: CALVER32[%d] is different from CALVER32[0]\n",i);
 		  return 1;
 		}
-	      CAMERA[i]  = drms_getkey_int(recLev1->records[i],CAMERAS,&statusA[35]); //Phil required a test on CAMERA on 12/20/2012
+	      CAMERA[i]  = KeyVectorInt(&Lev1Keys,LEV1_CAMERA,recLev1,i,&statusA[35]); //Phil required a test on CAMERA on 12/20/2012
 	      if(CAMERA[i] == -2147483648 || statusA[35] != DRMS_SUCCESS) KeywordMissing[i]=1;//missing CAMERA keyword
 
 	      //CORRECTION OF R_SUN and CRPIX1 FOR LIMB FINDER ARTIFACTS
@@ -2477,7 +2541,7 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 		  strcpy(HWLTNSET[i],"NONE");
 		  EXPTIME[i]    = MISSINGKEYWORD;
 
-		  //SegmentRead[i]= -1;
+		  //FrameCacheDrop(&Frames,i,FRAME_CORRUPT);
 		  KeywordMissing[i]=1;
 		}
 	      else//no keyword is missing
@@ -2490,10 +2554,12 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 		}
 	      
 	    }//end for(i=0;i<nRecs1;++i) 
+	  KeyVectorFree(&Lev1Keys);
 	  t1=dsecnd();
 	  printf("TIME ELAPSED TO READ THE KEYWORDS OF ALL LEVEL 1 RECORDS: %f\n",t1-t0);
 
 	  nIndexFiltergram=k;
+	  TargetWavelength=0;                                       //IndexFiltergram changes with each page
 	  if(nIndexFiltergram == 0) //no filtergram was found with the target wavelength in the open records
 	    {
 	      printf("Error: no filtergram was found with the wavelength %d in the requested level 1 records %s\n",WavelengthID,HMISeriesLev1);
@@ -2504,10 +2570,14 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	} 
       else
 	{
-	  //if there are no level 1 records in the time interval specified by the user, the code exits with an error message
-	  //no fake level 1.5 records are created
-	  printf("Error: no level 1 records in the time interval requested %s\n",HMISeriesLev1);
-	  return 1;//exit(EXIT_FAILURE);
+	  //if there are no level 1 records in the time range of the page, the target times of the page get empty level 1.5 records
+	  //(QUAL_TARGETFILTERGRAMMISSING) and the run goes on with the next page: the code only exits with an error message
+	  //if no page of the run has level 1 records (see the end of the run)
+	  printf("Warning: no level 1 records in the time interval requested %s\n",HMISeriesLev1);
+	  if(recLev1 != NULL) status=drms_close_records(recLev1,DRMS_FREE_RECORD); //the DRMS may return a set of 0 records
+	  recLev1=NULL;
+	  nRecs1=0;
+	  nIndexFiltergram=0;
 	}    
 
     }
@@ -2525,48 +2595,10 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
   /******************************************************************************************************************************************/
 
 
-  //THE TIME T_REC IS SLOTTED, SO HERE ARE THE INFO WE NEED TO DETERMINE THE PROPER SLOT:
-  TREC_STEP  = DataCadence;
-  //TREC_EPOCH0= 0.0; //value given to all the DRMS series that are slotted and corresponding to 1977.01.01_00:00:00_TAI or 1976.12.31_23:59:45_UTC (make sure all the .jsd files have the same TREC_EPOCH)
-  TargetTime = (TIME)floor((TimeBegin-TREC_EPOCH0+TREC_STEP/2.0)/TREC_STEP)*TREC_STEP+TREC_EPOCH0;  //WE LOCATE THE SLOT TIME CLOSEST TO THE BEGINNING TIME REQUIRED BY THE USER
-  if(TargetTime < TimeBegin) TargetTime+=TREC_STEP;
-  initialrun=1;
-  PreviousTargetTime=TargetTime;
-
   //NEED TO ADD A FUNCTION TO SWITCH FROM SDO TIME TO EARTH TIME?
   
-  while(TargetTime <= TimeEnd)
+  while(TargetTime <= PageEnd)
     {
-     
-      //additional tests when rotational flat field is required
-      if(inRotationalFlat == 1) 
-	{
-
-	  //check that the run does not straddle 2 days
-	  if(floor(TargetTime/86400.0) != floor(PreviousTargetTime/86400.0) )
-	    {
-	      printf("Error: the new target time is for a different day than the previous target time: you are not allowed to change day when applying a rotational flat field\n");
-	      return 1;
-	    }
-
-	  //check that TargetTime is still within the range of the rotational flat field used
-	  if(initialrun != 1)
-	    {
-	      if(TargetTime < TSTARTFLAT || TargetTime > TSTOPFLAT)
-		{
-		  printf("Error: the target time is not within the time range for which the rotation flat field used is valid\n");
-		  sprint_time(timeBegin2,TSTARTFLAT,"TAI",0);                   //convert the time TargetTime from TIME format to a string with TAI type
-		  printf("\n TSTART OF FLAT FIELD = %s\n",timeBegin2);
-		  sprint_time(timeBegin2,TSTOPFLAT,"TAI",0);                   //convert the time TargetTime from TIME format to a string with TAI type
-		  printf("\n TSTOP OF FLAT FIELD = %s\n",timeBegin2);
-		  sprint_time(timeBegin2,TargetTime,"TAI",0);                   //convert the time TargetTime from TIME format to a string with TAI type
-		  printf("\n TARGET TIME = %s\n",timeBegin2);
-		  return 1;
-		}
-	    }
-
-	}
-
 
       sprint_time(timeBegin2,TargetTime,"TAI",0);                   //convert the time TargetTime from TIME format to a string with TAI type
       printf("\n TARGET TIME = %s\n",timeBegin2);
@@ -2747,7 +2779,9 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	    }
 
 
-	  if(SegmentRead[temp] == 0)            //data segment of the target filtergram not already in memory
+	  FrameImage=NULL;
+	  FrameError=NULL;
+	  if(Frames.frame[temp].state == FRAME_NOTREAD) //data segment of the target filtergram not already in memory
 	    {
 
 	      //***************************************************************************
@@ -2756,159 +2790,71 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 
 	      if(inRotationalFlat == 1)                                               //rotation flatfield wanted instead of pzt flatfield
 		{
-
-		  HMIFlatField    = (char *)malloc(MaxNString*sizeof(char *));
-		  if(HMIFlatField == NULL)
-		    {
-		      printf("Error: memory could not be allocated to HMIFlatField\n");
-		      return 1;//exit(EXIT_FAILURE);
-		    }
-
 		  HMIFlatField    = drms_getkey_string(recLev1->records[temp],FLATREC,&status);  //read the pzt flatfield used
 		  if (status != DRMS_SUCCESS)
 		    {
 		      printf("Error: could not read the FLAT_REC keyword for the target filtergram FSN= %d",FSN[temp]);
 		      return 1;
 		    }
-		  else
-		    {
-		      printf("PZT FLAT FIELD USED ON TARGET FILTERGRAM= %s\n",HMIFlatField);
-		      if(initialrun == 1)
-			{
-			  strcpy(HMIFlatField0,HMIFlatField); //if this is the first timestep of this run of the observables code
-
-			  //access the pzt flatfield
-			  recflat  = drms_open_records(drms_env,HMIFlatField,&status);
-			  if (status != DRMS_SUCCESS || recflat == NULL || recflat->n == 0)
-			    {
-			      printf("Error: record missing or corrupt for the flat field query %s\n",HMIFlatField);
-			      return 1;
-			    }
-			  segin     = drms_segment_lookup(recflat->records[0],"flatfield");
-			  flatfield = drms_segment_read(segin,type1d,&status); 
-			  if (status != DRMS_SUCCESS || flatfield == NULL)
-			  {
-			    printf("Error: could not read the data segment for the flat field query %s\n",HMIFlatField);
-			    return 1;
-			  }
-			  pztflat  = flatfield->data;
-			  status=drms_close_records(recflat,DRMS_FREE_RECORD);
-
-			  //access the rotational flatfield
-			  char keylist[]="T_START,T_STOP";
-			  int unique = 0;
-			  rotationalflats = drms_record_getvector(drms_env,HMIRotationalFlats,keylist,DRMS_TYPE_DOUBLE,unique,&status);
-			  if(status != DRMS_SUCCESS)
-			    {
-			      printf("Error: cannot read a list of keywords in the rotation flat-field series\n");
-			      return 1;
-			    }
-			  printf("DIMENSIONS OF ROTATIONAL FLAT-FIELD SERIES= %d %d\n",rotationalflats->axis[0],rotationalflats->axis[1]);
-			  int n0,n1;
-			  n1  =rotationalflats->axis[1]; //number of rotational flat-field records found
-			  n0  =rotationalflats->axis[0]; //number of keywords read (should be 2)
-			  keyF=rotationalflats->data;
-
-			  i=0;
-			  while(TargetTime > keyF[i] && TargetTime > keyF[n1+i])
-			    {
-			      i++;
-			    }
-
-			  if(TargetTime >= keyF[i] && TargetTime <= keyF[n1+i]) //we want this record
-			    {
-			      //we build the query for the rotational flatfield 
-			      TSTARTFLAT=keyF[i];
-			      TSTOPFLAT =keyF[n1+i];
-			      sprint_time(query,keyF[i],"TAI",1);
-			      strcpy(QueryFlatField,HMIRotationalFlats); 
-			      strcat(QueryFlatField,"[");
-			      if(CamId == LIGHT_SIDE)  strcat(QueryFlatField,"1"); 
-			      if(CamId == LIGHT_FRONT) strcat(QueryFlatField,"2");
-			      strcat(QueryFlatField,"][");
-			      strcat(QueryFlatField,query);
-			      strcat(QueryFlatField,"]");
-			      printf("QUERY FOR ROTATIONAL FLAT FIELD= %s\n",QueryFlatField);
-			      //we read the rotational flat field
-			      recflatrot  = drms_open_records(drms_env,QueryFlatField,&status);
-			      if (status != DRMS_SUCCESS || recflatrot == NULL || recflatrot->n == 0)
-				{
-				  printf("Error: record missing or corrupt for the rotational flat field query %s\n",QueryFlatField);
-				  return 1;
-				}
-			      segin     = drms_segment_lookup(recflatrot->records[0],"flatfield");
-			      flatfieldrot = drms_segment_read(segin,type1d,&status); 
-			      if (status != DRMS_SUCCESS || flatfieldrot == NULL)
-				{
-				  printf("Error: could not read the data segment for the rotational flat field query %s\n",QueryFlatField);
-				  return 1;
-				}
-			      rotflat  = flatfieldrot->data;
-			      
-			    }
-			  else //no rotational flafield record exists for the target time 
-			    {
-			      printf("Error: no rotational flat field record exists for the target time %s\n",timeBegin2);
-			      return 1;
-			    }
-
-			  drms_free_array(rotationalflats);
-			  rotationalflats=NULL;
-			}//if(initialrun == 1)
-		      else if(strcmp(HMIFlatField,HMIFlatField0) != 0) //if the pzt flatfield changes during a run of the observables code
-			{
-			  printf("Warning: the hmi.flatfield record used to produce the level 1 records changed during the run of the observables code\n");
-			  printf("The new hmi,flatfield record used is: %s\n",HMIFlatField);
-			  //access the pzt flatfield
-			  recflat  = drms_open_records(drms_env,HMIFlatField,&status);
-			  if (status != DRMS_SUCCESS || recflat == NULL || recflat->n == 0)
-			    {
-			      printf("Error: record missing or corrupt for the flat field query %s\n",HMIFlatField);
-			      return 1;
-			    }
-			  drms_free_array(flatfield);
-			  strcpy(HMIFlatField0,HMIFlatField);
-			  segin     = drms_segment_lookup(recflat->records[0],"flatfield");
-			  flatfield = drms_segment_read(segin,type1d,&status); 
-			  if (status != DRMS_SUCCESS || flatfield == NULL)
-			  {
-			    printf("Error: could not read the data segment for the flat field query %s\n",HMIFlatField);
-			    return 1;
-			  }
-			  pztflat  = flatfield->data;
-			  status=drms_close_records(recflat,DRMS_FREE_RECORD);
-			}
-
-		    }
+		  printf("PZT FLAT FIELD USED ON TARGET FILTERGRAM= %s\n",HMIFlatField);
+		  pztflat = FlatFieldPzt(&Flats,drms_env,HMIFlatField);                       //read only once, then kept in memory
 		  free(HMIFlatField);
+		  if(pztflat == NULL) return 1;
+		  rotflat = FlatFieldRotational(&Flats,drms_env,(HCAMID[temp] == LIGHT_SIDE) ? 1 : 2,internTOBS[temp]); //flat field of the validity interval that contains the filtergram
+		  if(rotflat == NULL) return 1;
 		}//if(inRotationalFlat == 1)
 	      
 	      //*************************************************************************************
 
 	      
-	      //read the data segment of the target filtergram
+	      //read the data segment of the target filtergram (unless the prefetch thread read it at the previous target time)
 	      printf("READ SEGMENT OF TARGET FILTERGRAM\n"); 
- 	      segin           = drms_segment_lookupnum(recLev1->records[temp],0);     //locating the first segment of the level 1 filtergram (SHOULD HAVE ONLY 2 SEGMENTS, AND THE IMAGE SHOULD BE THE FIRST ONE)
-	      Segments[temp]  = drms_segment_read(segin,type1d, &status);             //reading the segment into memory (and converting it into type1d data: FLOAT. the -32768 become NAN)
-	      if (status != DRMS_SUCCESS || Segments[temp] == NULL)
+	      BadPixelsPrefetch=NULL;
+	      Prefetched=Lev1PrefetchGet(&Prefetch,temp,&PrefetchFrame);
+	      if(Prefetched && PrefetchFrame.ierror != NULL)                           //read and gapfilled in advance by the prefetch thread: now in the frame cache
 		{
-		  printf("Error: the code could not read the segment of the level 1 filtergram %d\n",FSN[temp]);
-		  return 1;
-		  //Segments[temp]=NULL;
-		  //SegmentRead[temp]=-1;
-		  //image = NULL;
-		  //if(Lev15Wanted) CreateEmptyRecord=1; goto NextTargetTime;
+		  status=Lev1GapfillStore(&Frames,&PrefetchFrame,TargetTime,&QUALITY,QUALITYlev1);
+		  if(status != 0) return 1;
+		}
+	      else
+		{
+		  if(Prefetched)
+		    {
+		      FrameImage        = PrefetchFrame.image;                           //only read by the prefetch thread
+		      BadPixelsPrefetch = PrefetchFrame.badpixels;
+		      status            = PrefetchFrame.statusimage;
+		      statusBadPixels   = PrefetchFrame.statusbad;
+		      if(PrefetchFrame.cosmicrays != NULL) drms_free_array(PrefetchFrame.cosmicrays);
+		    }
+		  else
+		    {
+		      segin           = drms_segment_lookupnum(recLev1->records[temp],0);     //locating the first segment of the level 1 filtergram (SHOULD HAVE ONLY 2 SEGMENTS, AND THE IMAGE SHOULD BE THE FIRST ONE)
+		      FrameImage      = SegmentRead(segin,type1d, &status);             //reading the segment into memory (and converting it into type1d data: FLOAT. the -32768 become NAN)
+		    }
+		  if (status != DRMS_SUCCESS || FrameImage == NULL)
+		    {
+		      printf("Error: the code could not read the segment of the level 1 filtergram %d\n",FSN[temp]);
+		      return 1;
+		      //FrameImage=NULL;
+		      //FrameCacheDrop(&Frames,temp,FRAME_CORRUPT);
+		      //image = NULL;
+		      //if(Lev15Wanted) CreateEmptyRecord=1; goto NextTargetTime;
+		    }
 		} 
 	    }
 
-	  if(SegmentRead[temp] == -1)           //data segment is missing or corrupted
+	  if(Frames.frame[temp].state == FRAME_CORRUPT) //data segment is missing or corrupted
 	    {
 	      //if(Lev15Wanted) CreateEmptyRecord=1; goto NextTargetTime;
 	      image = NULL;
 	    }
+	  else if(Frames.frame[temp].state == FRAME_CACHED)
+	    {
+	      image  = Frames.frame[temp].image->data;
+	    }
 	  else
 	    {
-	      image  = Segments[temp]->data;
+	      image  = FrameImage->data;
 	    }     
 
 	  printf("FSN OF TARGET FILTERGRAM = %d %d\n",FSN[temp],HCAMID[temp]);
@@ -2932,8 +2878,8 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	  if(!strcmp(TargetISS,"OPEN")) QUALITY = QUALITY | QUAL_ISSTARGET;
 	  if( (QUALITYin[temp] & Q_ACS_ECLP) == Q_ACS_ECLP) QUALITY = QUALITY | QUAL_ECLIPSE;
 
-	  axisin[0]       = 4096;//Segments[temp]->axis[0] ; //dimensions of the level 1 target filtergram
-	  axisin[1]       = 4096;//Segments[temp]->axis[1] ;
+	  axisin[0]       = 4096;//FrameImage->axis[0] ; //dimensions of the level 1 target filtergram
+	  axisin[1]       = 4096;//FrameImage->axis[1] ;
 	  axisout[0]      = axisin[0];                //dimensions of the level 1d filtergram = dimensions of level 1 filtergram
 	  axisout[1]      = axisin[1];
 	  Nelem           = axisin[0]*axisin[1];
@@ -2990,14 +2936,13 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	  if(KeywordMissing[j] == 1 || KeywordMissing[i] == 1)
 	    {
 	      printf("Error: some keywords are missing/corrupted to interpolate OBS_VR, OBS_VW, OBS_VN, CRLN_OBS, CROTA2, and CAR_ROT at target time %s \n",timeBegin2);
-	      if(SegmentRead[temp])
+	      if(FrameImage != NULL)            //target filtergram read at this target time, but not gapfilled
 		{
-		  drms_free_array(Segments[temp]);
-		  Segments[temp]=NULL;
-		  if(Ierror[temp] != NULL) drms_free_array(Ierror[temp]);
-		  Ierror[temp]=NULL;
-		  SegmentRead[temp]=0;
+		  drms_free_array(FrameImage);
+		  FrameImage=NULL;
 		}
+	      if(BadPixelsPrefetch != NULL) drms_free_array(BadPixelsPrefetch);
+	      BadPixelsPrefetch=NULL;
 	      QUALITY = QUALITY | QUAL_NOINTERPOLATEDKEYWORDS;
 	      if(Lev15Wanted) CreateEmptyRecord=1; goto NextTargetTime;
 	    }
@@ -3089,16 +3034,14 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	  /*if(axisin[0] <= 0 || axisin[1] <= 0 || axisin[0] > 4096 || axisin[1] > 4096)
 	    {
 	      printf("Error: dimensions of segment of level 1 data record FSN = %d at target time %s are not within permitted limits\n",FSN[temp],timeBegin2);
-	      drms_free_array(Segments[temp]);
-	      Segments[temp]=NULL;
-	      if(Ierror[temp] != NULL) drms_free_array(Ierror[temp]);
-	      Ierror[temp]=NULL;
-	      SegmentRead[temp]=-1;             //-1 indicates a problem with the segment
+	      drms_free_array(FrameImage);
+	      FrameImage=NULL;
+	      FrameCacheDrop(&Frames,temp,FRAME_CORRUPT); //indicates a problem with the segment
 	      if(Lev15Wanted) CreateEmptyRecord=1; goto NextTargetTime;
 	      }*/ 
 
 	  //gapfilling of the target filtergram just read
-	  if(SegmentRead[temp] == 0  && image != NULL)
+	  if(Frames.frame[temp].state == FRAME_NOTREAD && image != NULL)
 	    {
 
 	      if(inRotationalFlat == 1)
@@ -3148,14 +3091,20 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	      segin           = drms_segment_lookup(recLev1->records[temp],"bad_pixel_list");
 	      printf("READ BAD PIXEL LIST OF TARGET FILTERGRAM FSN = %d\n",FSN[temp]);
 	      BadPixels       = NULL;
-	      BadPixels       = drms_segment_read(segin,segin->info->type,&status);   //reading the segment into memory (and converting it into type1d data)
+	      if(Prefetched)
+		{
+		  BadPixels   = BadPixelsPrefetch;                                  //already read by the prefetch thread
+		  status      = statusBadPixels;
+		  BadPixelsPrefetch=NULL;
+		}
+	      else BadPixels  = SegmentRead(segin,segin->info->type,&status);   //reading the segment into memory (and converting it into type1d data)
 	      if(status != DRMS_SUCCESS || BadPixels == NULL)
 		{
 		  printf("Error: cannot read the list of bad pixels of level 1 filtergram FSN = %d at target time %s \n",FSN[temp],timeBegin2);
 		  return 1;
-		  //drms_free_array(Segments[temp]);
-		  //Segments[temp]=NULL;
-		  //SegmentRead[temp]=-1; 
+		  //drms_free_array(FrameImage);
+		  //FrameImage=NULL;
+		  //FrameCacheDrop(&Frames,temp,FRAME_CORRUPT); 
 		  //if(Lev15Wanted) CreateEmptyRecord=1; goto NextTargetTime;
 		}
 	      else
@@ -3183,7 +3132,7 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 			}
 		      else
 			{
-			  CosmicRays = drms_segment_read(segin,segin->info->type,&status);
+			  CosmicRays = SegmentRead(segin,segin->info->type,&status);
 			  if(status != DRMS_SUCCESS || CosmicRays == NULL)
 			    {
 			      printf("Error: the list of cosmic-ray hits could not be read for FSN %d\n",FSN[temp]);
@@ -3234,26 +3183,26 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 		  if(status != 0)
 		    {
 		      printf("Error: unable to create a mask for the gap filling function for level 1 filtergram FSN = %d at target time %s\n",FSN[temp],timeBegin2);
-		      drms_free_array(Segments[temp]);
-		      Segments[temp]=NULL;
-		      SegmentRead[temp]=-1;
+		      drms_free_array(FrameImage);
+		      FrameImage=NULL;
+		      FrameCacheDrop(&Frames,temp,FRAME_CORRUPT);
 		      //if(Lev15Wanted) CreateEmptyRecord=1; goto NextTargetTime;
 		    }
 		  else
 		    {
-		      Ierror[temp] = drms_array_create(typeEr,2,axisout,NULL,&status);
-		      if(status != DRMS_SUCCESS || Ierror[temp] == NULL)
+		      FrameError = drms_array_create(typeEr,2,axisout,NULL,&status);
+		      if(status != DRMS_SUCCESS || FrameError == NULL)
 			{
 			  printf("Error: unable to create an array for Ierror at target time %s\n",timeBegin2);
-			  drms_free_array(Segments[temp]);
-			  Segments[temp]=NULL;
-			  Ierror[temp]=NULL;
-			  SegmentRead[temp]=-1; 
+			  drms_free_array(FrameImage);
+			  FrameImage=NULL;
+			  FrameError=NULL;
+			  FrameCacheDrop(&Frames,temp,FRAME_CORRUPT); 
 			  //if(Lev15Wanted) CreateEmptyRecord=1; goto NextTargetTime;
 			}   
 		      else
 			{
-			  ierror = Ierror[temp]->data;
+			  ierror = FrameError->data;
 			  printf("GAP FILLING THE TARGET FILTERGRAM\n");
 			  t0=dsecnd();
 			  status = do_gapfill(image,Mask,&const_param,ierror,axisin[0],axisin[1]); //then call the gapfilling function
@@ -3265,11 +3214,13 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 			      QUALITY = QUALITY | QUAL_NOGAPFILL;
 			      QUALITYlev1[temp] = QUALITYlev1[temp] | QUAL_NOGAPFILL;
 			    }
-			  SegmentRead[temp]=1;
+			  FrameCacheStore(&Frames,temp,FrameImage,FrameError,TargetTime); //the frame cache now owns the arrays
+			  FrameImage=NULL;
+			  FrameError=NULL;
 			}
 		    }
 		}
-	    }//end of if(SegmentRead[temp] == 0)
+	    }//end of if(Frames.frame[temp].state == FRAME_NOTREAD)
 
 
 	  //We call the function framelistInfo() to obtain data regarding the observable sequence that was used
@@ -3648,37 +3599,36 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	  OrganizeFramelist2=NULL;
 
 
-	  //looking for filtergrams whose segment is already in memory but that are not needed anymore, and delete them
+	  //the filtergrams already in memory that are needed at this target time are marked as used (the frame cache does not evict them),
+	  //and the filtergrams in memory that are not needed at this target time are deleted
 	  //**************************************************************************************************************
 
 	  printf("LOOKING FOR FILTERGRAMS ALREADY IN MEMORY BUT THAT ARE NOT NEEDED ANYMORE\n");
-	  for(ii=0;ii<nRecs1;++ii) //loop over all the opened records (TRY TO FIND A FASTER WAY TO DO THAT ?) 
-	    {
-	      if(SegmentRead[ii] == 1) //segment has already been read and is currently in memory
-		{
-		  Needed=0; //segment not needed a priori
-
-		  for(k=0;k<framelistSize*TempIntNum;++k)
-		    {
-		      if (FramelistArray[k] == ii)
-			{
-			  Needed=1; //Ah, my bad!!! The segment is actually needed
-			  break;
-			}
-		    }
+	  for(k=0;k<framelistSize*TempIntNum;++k) if(FramelistArray[k] != -1 && Frames.frame[FramelistArray[k]].state == FRAME_CACHED) FrameCacheUse(&Frames,FramelistArray[k],TargetTime);
+	  if(FrameCacheExpire(&Frames,FramelistArray,framelistSize*TempIntNum) != 0) return 1;
 
-		  if(Needed == 0)//we delete the segment
-		    {
-		      drms_free_array(Segments[ii]);
-		      drms_free_array(Ierror[ii]);
-		      Segments[ii]= NULL;
-		      Ierror[ii]  = NULL;
-		      SegmentRead[ii] = 0;
-		    }
+	  //list of the filtergrams to read in advance: the ones needed at this target time and not in memory, in the order in which they are used below,
+	  //followed by the filtergrams expected for the next Lookahead target times (same cameras and CFINDEX, within the temporal interpolation window of TargetTime+Lookahead*DataCadence)
+	  //the prefetch thread reads (and, without rotational flat field, gapfills) them while the filtergrams before them are gapfilled, and while the observables are computed
+	  //*******************************************************************************************************************************************************
 
-		}
-	      
+	  nPrefetch=0;
+	  for(k=0;k<framelistSize;++k) for(i=0;i<TempIntNum;++i)
+	    {
+	      temp=FramelistArray[k+framelistSize*i];
+	      if(temp != -1 && Frames.frame[temp].state == FRAME_NOTREAD) PrefetchList[nPrefetch++]=temp;
+	    }
+	  for(ii=0;ii<nRecs1;++ii)
+	    {
+	      if(Frames.frame[ii].state != FRAME_NOTREAD || KeywordMissing[ii] == 1 || CFINDEX[ii] != TargetCFINDEX) continue;
+	      if(internTOBS[ii] <= TargetTime || (internTOBS[ii]-TargetTime-(double)Lookahead*DataCadence) > MaxSearchDistanceR) continue;
+	      for(k=0;k<framelistSize*TempIntNum;++k) if(FramelistArray[k] != -1 && HCAMID[FramelistArray[k]] == HCAMID[ii]) break;
+	      if(k == framelistSize*TempIntNum) continue;                   //camera not used at this target time
+	      for(k=0;k<nPrefetch;++k) if(PrefetchList[k] == ii) break;
+	      if(k == nPrefetch) PrefetchList[nPrefetch++]=ii;
 	    }
+	  Lev1PrefetchRetain(&Prefetch,PrefetchList,nPrefetch);             //frees the filtergrams read in advance that are not needed anymore
+	  nPrefetchNext=Lev1PrefetchQueue(&Prefetch,PrefetchList,nPrefetch,0,recLev1);
 	  
 	  /******************************************************************************************************************************/ 
 	  /*for each type of filtergram                                                                                                 */
@@ -3865,10 +3815,59 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 
 
 
+	  //THE LEVEL 1D FILTERGRAMS ARE PRODUCED IN THREE STEPS: FOR EACH SLOT OF THE FRAMELIST (WAVELENGTH AND POLARIZATION), THE LEVEL 1 FILTERGRAMS ARE
+	  //READ AND GAPFILLED, AND THE TEMPORAL INTERPOLATION IS SET UP; THEN THE TEMPORAL INTERPOLATIONS OF ALL THE SLOTS ARE RUN CONCURRENTLY; AND THEN THE
+	  //KEYWORDS AND SEGMENTS OF THE LEVEL 1D RECORDS ARE SET AND WRITTEN, SLOT BY SLOT
+	  //******************************************************************************************************************************************************
+
+	  //TARGET VALUES FOR TEMPORAL AND SPATIAL INTERPOLATION: THE OUTPUT GEOMETRY IS THE SAME FOR ALL THE SLOTS, AND IS COMPUTED ONCE PER TARGET TIME
+	  //(THE RESAMPLING MAPS THEMSELVES ARE BUILT INSIDE do_interpolate(), FOR EACH INPUT FILTERGRAM, WHICH IS USED BY ONLY ONE SLOT AT A GIVEN TARGET TIME)
+	  RSUNint=RSUNAVG;//WARNING: RESIZING COMPLETELY TURNED OFF !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+	  KeyInterpOut.rsun=RSUNint;
+
+	  if(combine == 0) //test CRPIX1 and CRPIX2 ONLY if we don't combine both cameras, because there is a shift of about 5 pixels between them
+	    {
+	      KeyInterpOut.xx0 =X0AVG;
+	      KeyInterpOut.yy0 =Y0AVG;
+	    }
+	  else //when combining, using the median of X0 and Y0 is dangerous because there is a 5 pixels or so difference between front and side, and if 1 image is missing the median values will swing wildly by 5 pixels
+	    {
+	      if(CamId == LIGHT_FRONT)
+		{
+		  KeyInterpOut.xx0 =X0AVGF;
+		  KeyInterpOut.yy0 =Y0AVGF;			  
+		}
+	      else
+		{
+		  KeyInterpOut.xx0 =X0AVGS;
+		  KeyInterpOut.yy0 =Y0AVGS;
+		}
+	    }
+
+	  KeyInterpOut.dist=(float)DSUNOBSint;
+	  KeyInterpOut.b0  =CRLTOBSint/180.*M_PI;     //Richard's code expects the b-angle in radians!!!
+	  KeyInterpOut.p0  =CROTA2int/180.*M_PI;      //Richard's code expects the p-angle in radians!!!
+	  tobs = TargetTime+(DSUNOBSint-1.0)/2.00398880422056639358e-03;        //observation time, which is equal to the slot time for level 1.5 data corrected for the SDO distance from 1 AU, the speed of light is given in AU/s
+	  KeyInterpOut.time=tobs;		      
+	  KeyInterpOut.focus=TargetCFINDEX;
+
+	  Slots = (struct slotinterp *)malloc(framelistSize*sizeof(struct slotinterp));
+	  if(Slots == NULL)
+	    {
+	      printf("Error: memory could not be allocated to Slots\n");
+	      return 1;//exit(EXIT_FAILURE);
+	    }
+
 	  for(k=0;k<framelistSize;++k)
 	    {
 	      
 	      ActualTempIntNum=TempIntNum;
+	      Slots[k].images   =NULL;
+	      Slots[k].ierrors  =NULL;
+	      Slots[k].KeyInterp=NULL;
+	      Slots[k].ntemp    =0;
+	      Slots[k].status   =-1;                                               //no temporal interpolation for this slot (yet)
+	      Slots[k].elapsed  =0.0;
 
 	      //Read the segments of the level 1 filtergrams needed to obtain the level 1d data, and do their gapfilling
 	      //***************************************************************************************************
@@ -3879,78 +3878,110 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 		  if(temp != -1)                          //if the filtergram can be used
 		    {
 
+		      //FILTERGRAM READ IN ADVANCE BY THE PREFETCH THREAD (AND ALREADY GAPFILLED, IN WHICH CASE IT IS NOW IN THE FRAME CACHE)
+		      Prefetched=0;
+		      if(Frames.frame[temp].state == FRAME_NOTREAD)
+			{
+			  Prefetched=Lev1PrefetchGet(&Prefetch,temp,&PrefetchFrame);
+			  if(Prefetched && PrefetchFrame.ierror != NULL)
+			    {
+			      status=Lev1GapfillStore(&Frames,&PrefetchFrame,TargetTime,&QUALITY,QUALITYlev1);
+			      if(status != 0) return 1;
+			      Prefetched=0;
+			      nPrefetchNext=Lev1PrefetchQueue(&Prefetch,PrefetchList,nPrefetch,nPrefetchNext,recLev1); //a slot of the prefetch buffer was freed
+			    }
+			}
+
 		      //FILTERGRAM CAN, A PRIORI, BE READ
-		      if(SegmentRead[temp] != -1)         //if the segment is not corrupted
+		      if(Frames.frame[temp].state != FRAME_CORRUPT) //if the segment is not corrupted
 			{
 			  //DATA SEGMENT IS NOT ALREADY IN MEMORY AND NEEDS TO BE READ
-			  if(SegmentRead[temp] == 0) 
+			  if(Frames.frame[temp].state == FRAME_NOTREAD) 
 			    {
 			      printf("segment needs to be read for FSN %d %d\n",FSN[temp],HCAMID[temp]);
-			      segin   = drms_segment_lookupnum(recLev1->records[temp], 0);
-			      Segments[temp] = drms_segment_read(segin,type1d, &status); //pointer toward the segment (convert the data into type1d)
-			      if (status != DRMS_SUCCESS || Segments[temp] == NULL)
+			      BadPixelsPrefetch=NULL;
+			      if(Prefetched)
+				{
+				  FrameImage        = PrefetchFrame.image;                       //only read by the prefetch thread
+				  BadPixelsPrefetch = PrefetchFrame.badpixels;
+				  status            = PrefetchFrame.statusimage;
+				  statusBadPixels   = PrefetchFrame.statusbad;
+				  if(PrefetchFrame.cosmicrays != NULL) drms_free_array(PrefetchFrame.cosmicrays);
+				}
+			      else
+				{
+				  segin   = drms_segment_lookupnum(recLev1->records[temp], 0);
+				  FrameImage = SegmentRead(segin,type1d, &status); //pointer toward the segment (convert the data into type1d)
+				}
+			      nPrefetchNext=Lev1PrefetchQueue(&Prefetch,PrefetchList,nPrefetch,nPrefetchNext,recLev1); //a slot of the prefetch buffer was freed
+			      if (status != DRMS_SUCCESS || FrameImage == NULL)
 				{
 				  printf("Error: could not read the segment of level 1 record FSN =  %d at target time %s\n",FSN[temp],timeBegin2); //if there is a problem  
 				  return 1;
 				  //ActualTempIntNum-=1; //we will use one less filtergram for the temporal interpolation
 				  //arrin[i] = NULL;
 				  //arrerrors[i] = NULL;
-				  //Segments[temp] = NULL;
-				  //Ierror[temp] = NULL;
-				  //SegmentRead[temp]=-1;
+				  //FrameImage = NULL;
+				  //FrameError = NULL;
+				  //FrameCacheDrop(&Frames,temp,FRAME_CORRUPT);
 				}  
 			      else
 				{
-				  Ierror[temp] = drms_array_create(typeEr,2,axisout,NULL,&status);
-				  if(status != DRMS_SUCCESS || Ierror[temp] == NULL)
+				  FrameError = drms_array_create(typeEr,2,axisout,NULL,&status);
+				  if(status != DRMS_SUCCESS || FrameError == NULL)
 				    {
 				      printf("Error: could not create an array for Ierror at target time %s\n",timeBegin2); //if there is a problem
-				      drms_free_array(Segments[temp]);
-				      Segments[temp]=NULL;
-				      Ierror[temp]=NULL;
-				      SegmentRead[temp]=-1; 
+				      drms_free_array(FrameImage);
+				      if(BadPixelsPrefetch != NULL) drms_free_array(BadPixelsPrefetch);
+				      FrameImage=NULL;
+				      FrameError=NULL;
+				      FrameCacheDrop(&Frames,temp,FRAME_CORRUPT); 
 				      ActualTempIntNum-=1; //we will use one less filtergram for the temporal interpolation
 				      arrin[i] = NULL;
 				      arrerrors[i] = NULL;
 				    }    
 				  else
 				    {
-				      arrin[i] = Segments[temp];
-				      arrerrors[i] = Ierror[temp];
+				      arrin[i] = FrameImage;
+				      arrerrors[i] = FrameError;
 				      if(arrin[i]->axis[0] != axisin[0]  || arrin[i]->axis[1] != axisin[1]) //segment does not have the same size as the segment of the target filtergram (PROBLEM HERE: I CURRENTLY DON'T CHECK IF A SEGMENT ALREADY IN MEMORY HAS THE SAME SIZE AS THE TARGET FILTERGRAM)
 					{
 					  printf("Error: level 1 record FSN = %d at target time %s has a segment with dimensions %d x %d instead of %d x %d\n",FSN[temp],timeBegin2,arrin[i]->axis[0],arrin[i]->axis[1],axisin[0],axisin[1]);
-					  drms_free_array(Segments[temp]);
-					  drms_free_array(Ierror[temp]);
+					  drms_free_array(FrameImage);
+					  drms_free_array(FrameError);
+					  if(BadPixelsPrefetch != NULL) drms_free_array(BadPixelsPrefetch);
 					  ActualTempIntNum-=1; //we will use one less filtergram for the temporal interpolation
 					  arrin[i] = NULL;
 					  arrerrors[i] = NULL;
-					  Segments[temp]=NULL;
-					  Ierror[temp]=NULL;
-					  SegmentRead[temp]=-1;
+					  FrameImage=NULL;
+					  FrameError=NULL;
+					  FrameCacheDrop(&Frames,temp,FRAME_CORRUPT);
 					}
 				      else
 					{
-					  SegmentRead[temp]=1; //now the segment for this record is in memory
+					  FrameCacheStore(&Frames,temp,FrameImage,FrameError,TargetTime); //now the segment for this record is in memory (the arrays are gapfilled below, in place)
+					  FrameImage=NULL;
+					  FrameError=NULL;
 
 					  //call gapfilling code of Richard and Jesper
 					  //*******************************************************************
 					  //segin           = drms_segment_lookupnum(recLev1->records[temp],1);     //locating the second segment of the level 1 filtergram (list of bad pixels)
 					  segin           = drms_segment_lookup(recLev1->records[temp],"bad_pixel_list");
 					  BadPixels       = NULL;
-					  BadPixels       = drms_segment_read(segin,segin->info->type,&status);   //reading the segment into memory (and converting it into type1d data)
+					  if(Prefetched)
+					    {
+					      BadPixels   = BadPixelsPrefetch;                                  //already read by the prefetch thread
+					      status      = statusBadPixels;
+					    }
+					  else BadPixels  = SegmentRead(segin,segin->info->type,&status);   //reading the segment into memory (and converting it into type1d data)
 					  if(status != DRMS_SUCCESS || BadPixels == NULL)
 					    {
 					      printf("Error: cannot read the list of bad pixels of level 1 filtergram FSN= %d\n",FSN[temp]);
 					      return 1;
 					      //ActualTempIntNum-=1; //we will use one less filtergram for the temporal interpolation
-					      //drms_free_array(Segments[temp]);
-					      //drms_free_array(Ierror[temp]);
+					      //FrameCacheDrop(&Frames,temp,FRAME_CORRUPT);
 					      //arrin[i] = NULL;
 					      //arrerrors[i] = NULL;
-					      //Segments[temp]=NULL;
-					      //Ierror[temp]=NULL;
-					      //SegmentRead[temp]=-1; 
 					    }
 					  else
 					    {
@@ -3977,7 +4008,7 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 						    }
 						  else
 						    {
-						      CosmicRays = drms_segment_read(segin,segin->info->type,&status);
+						      CosmicRays = SegmentRead(segin,segin->info->type,&status);
 						      if(status != DRMS_SUCCESS || CosmicRays == NULL)
 							{
 							  printf("Error: the list of cosmic-ray hits could not be read for FSN %d\n",FSN[temp]);
@@ -4003,7 +4034,7 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 						      //}
 						}
 					      
-					      image  = Segments[temp]->data;
+					      image  = arrin[i]->data;
 
 					      //*************************************************************
 					      // applying rotational flat field
@@ -4012,43 +4043,18 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 					      if(inRotationalFlat == 1)
 						{
 
-						  HMIFlatField    = (char *)malloc(MaxNString*sizeof(char *));
-						  if(HMIFlatField == NULL)
-						    {
-						      printf("Error: memory could not be allocated to HMIFlatField\n");
-						      return 1;//exit(EXIT_FAILURE);
-						    }
 						  HMIFlatField    = drms_getkey_string(recLev1->records[temp],FLATREC,&status);  //read the pzt flatfield used
 						  if (status != DRMS_SUCCESS)
 						    {
 						      printf("Error: could not read the FLAT_REC keyword for the target filtergram FSN= %d",FSN[temp]);
 						      return 1;
 						    }
+						  pztflat = FlatFieldPzt(&Flats,drms_env,HMIFlatField);                       //read only once, then kept in memory
+						  free(HMIFlatField);
+						  if(pztflat == NULL) return 1;
+						  rotflat = FlatFieldRotational(&Flats,drms_env,(HCAMID[temp] == LIGHT_SIDE) ? 1 : 2,internTOBS[temp]); //flat field of the validity interval that contains the filtergram
+						  if(rotflat == NULL) return 1;
 
-
-						  if(strcmp(HMIFlatField,HMIFlatField0) != 0) //if the pzt flatfield changes during a run of the osbervables code
-						    {
-						      printf("Warning: the hmi.flatfield record used to produce the level 1 records changed during the run of the observables code\n");
-						      //access the pzt flatfield
-						      recflat  = drms_open_records(drms_env,HMIFlatField,&status);
-						      if (status != DRMS_SUCCESS || recflat == NULL || recflat->n == 0)
-							{
-							  printf("Error: record missing or corrupt for the flat field query %s\n",HMIFlatField);
-							  return 1;
-							}
-						      drms_free_array(flatfield);
-						      strcpy(HMIFlatField0,HMIFlatField);
-						      segin     = drms_segment_lookup(recflat->records[0],"flatfield");
-						      flatfield = drms_segment_read(segin,type1d,&status); 
-						      if (status != DRMS_SUCCESS || flatfield == NULL)
-							{
-							  printf("Error: could not read the data segment for the flat field query %s\n",HMIFlatField);
-							  return 1;
-							}
-						      pztflat  = flatfield->data;
-						      status=drms_close_records(recflat,DRMS_FREE_RECORD);
-						    }
-						  
 						  if(inLinearity == 1)
 						    {
 						      printf("applying rotational flat field and correcting for non-linearity of camera on record FSN=%d\n",FSN[temp]);
@@ -4073,7 +4079,6 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 							}
 						    }
 						  
-						  free(HMIFlatField);
 
 						}//if(inRotationalFlat == 1)
 					      else
@@ -4134,15 +4139,15 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 					}
 				    }
 				}
-			    }//if(SegmentRead[temp] == 0)
+			    }//if(Frames.frame[temp].state == FRAME_NOTREAD)
 			  else                          //SEGMENT IS ALREAD IN MEMORY AND DOES NOT NEED TO BE READ
 			    {
 			      printf("segment is already in memory for FSN %d %d\n",FSN[temp],HCAMID[temp]);
-			      arrin[i] = Segments[temp];
-			      arrerrors[i] = Ierror[temp];
+			      arrin[i] = Frames.frame[temp].image;
+			      arrerrors[i] = Frames.frame[temp].ierror;
 			    }
 			  
-			}//if(SegmentRead[temp] != -1)
+			}//if(Frames.frame[temp].state != FRAME_CORRUPT)
 		      else                              //SEGMENT CANNOT BE READ OR A KEYWORD OR MORE IS MISSING OR CORRUPTED
 			{
 			  printf("Error: the filtergram FSN = %d has corrupted/missing keyword(s), or a corrupted/missing data segment, at target time %s\n",FSN[temp],timeBegin2);
@@ -4290,39 +4295,8 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 		    } //ii should be equal to ActualTempIntNum
 
 
-		  //TARGET VALUES FOR TEMPORAL AND SPATIAL INTERPOLATION
-		  RSUNint=RSUNAVG;//WARNING: RESIZING COMPLETELY TURNED OFF !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
-		  KeyInterpOut.rsun=RSUNint;
-
-		  if(combine == 0) //test CRPIX1 and CRPIX2 ONLY if we don't combine both cameras, because there is a shift of about 5 pixels between them
-		    {
-		      KeyInterpOut.xx0 =X0AVG;
-		      KeyInterpOut.yy0 =Y0AVG;
-		    }
-		  else //when combining, using the median of X0 and Y0 is dangerous because there is a 5 pixels or so difference between front and side, and if 1 image is missing the median values will swing wildly by 5 pixels
-		    {
-		      if(CamId == LIGHT_FRONT)
-			{
-			  KeyInterpOut.xx0 =X0AVGF;
-			  KeyInterpOut.yy0 =Y0AVGF;			  
-			}
-		      else
-			{
-			  KeyInterpOut.xx0 =X0AVGS;
-			  KeyInterpOut.yy0 =Y0AVGS;
-			}
-		    }
-
-		  KeyInterpOut.dist=(float)DSUNOBSint;
-		  KeyInterpOut.b0  =CRLTOBSint/180.*M_PI;     //Richard's code expects the b-angle in radians!!!
-		  KeyInterpOut.p0  =CROTA2int/180.*M_PI;      //Richard's code expects the p-angle in radians!!!
-		  tobs = TargetTime+(DSUNOBSint-1.0)/2.00398880422056639358e-03;        //observation time, which is equal to the slot time for level 1.5 data corrected for the SDO distance from 1 AU, the speed of light is given in AU/s
-		  KeyInterpOut.time=tobs;		      
-		  KeyInterpOut.focus=TargetCFINDEX;
-		  
-
 		  //TEMPORAL INTERPOLATION, DE-ROTATION, UN-DISTORTION (FROM RICHARD)
-		  printf("Calling temporal interpolation, de-rotation, and un-distortion code\n");
+		  printf("Setting up temporal interpolation, de-rotation, and un-distortion of slot %d\n",k);
 
 		  totalTempIntNum += ActualTempIntNum;
 		  printf("ACTUALTEMPINT= %d, TOTALTEMPINTNUM= %d\n",ActualTempIntNum,totalTempIntNum);
@@ -4343,20 +4317,118 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 		    {
 		      for(ii=0;ii<ActualTempIntNum;++ii) printf("KEYWORDS IN: %f %f %f %f %f %f %f %d %d\n",KeyInterp[ii].rsun,KeyInterp[ii].xx0,KeyInterp[ii].yy0,KeyInterp[ii].dist,KeyInterp[ii].b0,KeyInterp[ii].p0,KeyInterp[ii].time,KeyInterp[ii].focus, KeyInterp[ii].camera);
 		      printf("KEYWORDS OUT: %f %f %f %f %f %f %f %d %d\n",KeyInterpOut.rsun,KeyInterpOut.xx0,KeyInterpOut.yy0,KeyInterpOut.dist,KeyInterpOut.b0,KeyInterpOut.p0,KeyInterpOut.time,KeyInterpOut.focus,KeyInterpOut.camera);
-		      
-		      t0=dsecnd();
-		      strcpy(dpath2,dpath);
-		      strcat(dpath2,"/../../../");
-		      status=do_interpolate(images,ierrors,arrLev1d[k]->data,KeyInterp,&KeyInterpOut,&const_param,ActualTempIntNum,axisin[0],axisin[1],-1.0,dpath2);
-		      t1=dsecnd();
-		      printf("TIME ELAPSED IN DO_INTERPOLATE: %f\n",t1-t0);
+		      Slots[k].status=0;                                             //do_interpolate() will be called for this slot
 		    }
 		  else
 		    {
 		      printf("Error: ActualTempIntNum <ThresholdPol\n");
 		      QUALITY = QUALITY | QUAL_NOTENOUGHINTERPOLANTS;
-		      status = 1;
+		      Slots[k].status=1;
+		    }
+
+		  Slots[k].images      =images;                                   //the slot now owns these arrays
+		  Slots[k].ierrors     =ierrors;
+		  Slots[k].KeyInterp   =KeyInterp;
+		  Slots[k].KeyInterpOut=KeyInterpOut;
+		  Slots[k].ntemp       =ActualTempIntNum;
+		  images=NULL;
+		  ierrors=NULL;
+		  KeyInterp=NULL;
+		}//if(ActualTempIntNum >= 2)
+	      else
+		{
+		  printf("Error: not enough valid level 1 filtergrams to produce a level 1d filtergram at target time %s\n",timeBegin2);
+		  drms_free_array(arrLev1d[k]);
+		  arrLev1d[k]=NULL;
+		  QUALITY = QUALITY | QUAL_NOTENOUGHINTERPOLANTS;
+		  //WHAT ELSE TO DO????
+		}
+	      
+	      
+
+	      Slots[k].quality=QUALITY;                                            //QUALITY of the level 1d record of this slot, before the temporal interpolations
+
+	    }//end of for(k=0;k<framelistSize;++k)
+
+
+	  //TEMPORAL INTERPOLATION, DE-ROTATION, UN-DISTORTION OF ALL THE SLOTS, RUN CONCURRENTLY
+	  //each do_interpolate() call runs on its own thread, with a share of the threads for its own parallel loops (nested parallelism)
+	  //********************************************************************************************************************************
+
+	  strcpy(dpath2,dpath);
+	  strcat(dpath2,"/../../../");
+	  nSlotInterp=0;
+	  for(k=0;k<framelistSize;++k) if(Slots[k].status == 0) nSlotInterp+=1;
+	  if(nSlotInterp > 0)
+	    {
+	      nSlotThreads=nthreads/nSlotInterp;
+	      if(nSlotThreads < 1) nSlotThreads=1;
+	      //each OpenMP thread of the loop has its own copy of const_param (thread 0 uses const_param itself): the source of Richard's
+	      //functions is not in this tree, so nothing guarantees that concurrent do_interpolate() calls do not write in it
+	      i=(nSlotInterp < nthreads ? nSlotInterp : nthreads)-1;
+	      if(i > nconst_paramSlots)
+		{
+		  const_paramSlots=(struct initial *)realloc(const_paramSlots,i*sizeof(struct initial));
+		  if(const_paramSlots == NULL)
+		    {
+		      printf("Error: memory could not be allocated to the copies of const_param\n");
+		      return 1;//exit(EXIT_FAILURE);
+		    }
+		  for(;nconst_paramSlots<i;++nconst_paramSlots)
+		    {
+		      status = initialize_interpol(&const_paramSlots[nconst_paramSlots],&initfiles,4096,4096,dpath2);
+		      if(status != 0)
+			{
+			  printf("Error: could not initialize the temporal interpolation routine of thread %d\n",nconst_paramSlots+1);
+			  return 1;//exit(EXIT_FAILURE);
+			}
 		    }
+		}
+
+	      MaxActiveLevels=omp_get_max_active_levels();
+	      omp_set_max_active_levels(2);
+	      printf("Calling temporal interpolation, de-rotation, and un-distortion code on %d slots concurrently, with %d threads each\n",nSlotInterp,nSlotThreads);
+	      t0=dsecnd();
+#pragma omp parallel for schedule(dynamic,1) num_threads(nSlotInterp < nthreads ? nSlotInterp : nthreads)
+	      for(k=0;k<framelistSize;++k)
+		{
+		  double tslot;
+		  int    tid=omp_get_thread_num();
+		  if(Slots[k].status != 0) continue;
+		  omp_set_num_threads(nSlotThreads);                                 //threads of the parallel regions of this do_interpolate() call
+		  tslot=dsecnd();
+		  Slots[k].status=do_interpolate(Slots[k].images,Slots[k].ierrors,arrLev1d[k]->data,Slots[k].KeyInterp,&Slots[k].KeyInterpOut,(tid == 0) ? &const_param : &const_paramSlots[tid-1],Slots[k].ntemp,axisin[0],axisin[1],-1.0,dpath2);
+		  Slots[k].elapsed=dsecnd()-tslot;
+		}
+	      t1=dsecnd();
+	      omp_set_max_active_levels(MaxActiveLevels);
+	      printf("TIME ELAPSED IN DO_INTERPOLATE FOR ALL SLOTS: %f\n",t1-t0);
+
+	      //per-slot timings, one line per slot: target time, slot index, FID, number of filtergrams interpolated, status, time elapsed in do_interpolate() (in seconds)
+	      for(k=0;k<framelistSize;++k) if(Slots[k].ntemp >= ThresholdPol)
+		{
+		  for(i=0;i<TempIntNum;++i) if(FramelistArray[k+framelistSize*i] != -1) break;
+		  printf("SLOT TIMING: %s %d %d %d %d %f\n",timeBegin2,k,i < TempIntNum ? FID[FramelistArray[k+framelistSize*i]] : -1,Slots[k].ntemp,Slots[k].status,Slots[k].elapsed);
+		}
+	    }
+
+
+	  //KEYWORDS AND SEGMENTS OF THE LEVEL 1D RECORDS, IN THE ORDER OF THE SLOTS
+	  //************************************************************************
+
+	  QualityInterp=0;
+	  for(k=0;k<framelistSize;++k)
+	    {
+	      if(Slots[k].status != -1)                                            //if the temporal interpolation of this slot was set up
+		{
+		  images          =Slots[k].images;
+		  ierrors         =Slots[k].ierrors;
+		  KeyInterp       =Slots[k].KeyInterp;
+		  KeyInterpOut    =Slots[k].KeyInterpOut;
+		  ActualTempIntNum=Slots[k].ntemp;
+		  status          =Slots[k].status;
+		  QUALITY         =Slots[k].quality | QualityInterp;              //same QUALITY as if the slots were interpolated one after another
+		  if(Slots[k].ntemp >= ThresholdPol) printf("TIME ELAPSED IN DO_INTERPOLATE: %f\n",Slots[k].elapsed);
 
 		  printf("End temporal interpolation, de-rotation, and un-distortion\n");
 		  if (status != 0)
@@ -4365,6 +4437,7 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 		      drms_free_array(arrLev1d[k]);
 		      arrLev1d[k] = NULL;		      
 		      QUALITY = QUALITY | QUAL_INTERPOLATIONFAILED;
+		      QualityInterp = QualityInterp | QUAL_INTERPOLATIONFAILED;
 		    }
 		  else
 		    {
@@ -4464,8 +4537,8 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 			  arrLev1d[k]->bzero=segout->bzero;
 			  arrLev1d[k]->bscale=segout->bscale; //because BSCALE in the jsd file is not necessarily 1
 			  arrLev1d[k]->israw=0;
-			  status=drms_segment_write(segout,arrLev1d[k],0);
-			  if(status != DRMS_SUCCESS)
+			  status=Lev15WriterWrite(&Writer,segout,arrLev1d[k]);   //written by the writer thread, which writes all the segments
+			  if(status != 0)
 			    {
 			      printf("Error: a call to drms_segment_write failed\n");
 			      return 1;
@@ -4480,18 +4553,11 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 		  ierrors=NULL;
 		  free(KeyInterp);
 		  KeyInterp=NULL;
-		}//if(ActualTempIntNum >= 2)
-	      else
-		{
-		  printf("Error: not enough valid level 1 filtergrams to produce a level 1d filtergram at target time %s\n",timeBegin2);
-		  drms_free_array(arrLev1d[k]);
-		  arrLev1d[k]=NULL;
-		  QUALITY = QUALITY | QUAL_NOTENOUGHINTERPOLANTS;
-		  //WHAT ELSE TO DO????
 		}
-	      
-	      
 	    }//end of for(k=0;k<framelistSize;++k)
+	  if(framelistSize > 0) QUALITY = Slots[framelistSize-1].quality | QualityInterp;
+	  free(Slots);
+	  Slots=NULL;
       
       
 	  free(FramelistArray);
@@ -4781,7 +4847,7 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 		  if(recLev1d->records[i] != NULL)
 		    {
 		      segin   = drms_segment_lookupnum(recLev1d->records[i], 0);
-		      arrLev1d[i] = drms_segment_read(segin,type1d,&status); //pointer toward the segment
+		      arrLev1d[i] = SegmentRead(segin,type1d,&status); //pointer toward the segment
 		      if(status != DRMS_SUCCESS || arrLev1d[i] == NULL)
 			{
 			  printf("Error: could not read the segment for level 1d data index %d at target time %s \n",i,timeBegin2);
@@ -4876,27 +4942,7 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	      return 1;//exit(EXIT_FAILURE);
 	    }
 	  
-	  for(i=0;i<nSegs1p;++i)
-	    {
-	      arrLev1p[i] = drms_array_create(type1p,2,axisout,NULL,&status);
-	      if(status != DRMS_SUCCESS || arrLev1p[i] == NULL)
-		{
-		  printf("Error: cannot create an array for a level 1p data at target time %s\n",timeBegin2);
-		  /*for(ii=0;ii<nRecs1d;++ii)
-		    {
-		      if(arrLev1d[ii] != NULL)
-			{
-			  drms_free_array(arrLev1d[ii]);
-			  arrLev1d[ii]=NULL;
-			  Segments1d=0;
-			}
-		    }
-		  Segments1p=0;
-		  QUALITY = QUALITY | QUAL_NOLEV1PARRAY;
-		  if(Lev15Wanted) CreateEmptyRecord=1; goto NextTargetTime;*/
-		  return 1;//exit(EXIT_FAILURE); //we exit because this is a DRMS failure, not a problem with the data
-		}
-	    }
+	  for(i=0;i<nSegs1p;++i) arrLev1p[i]=NULL;                  //the level 1p arrays of a wavelength are created just before polcal() produces them
 	  
 	  images = (float **)malloc(npol*sizeof(float *));
 	  if(images == NULL)
@@ -5052,7 +5098,30 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 		  i+=1;
 		}		      	      
 	      
-	      for(i=0;i<npolout;++i) imagesout[i]=arrLev1p[k*npolout+i]->data;
+	      //the level 1p arrays of wavelength k are created only now, once the level 1d filtergrams of the previous wavelengths have been
+	      //released, so that the level 1d and level 1p arrays of all the wavelengths are not in memory at the same time
+	      for(i=0;i<npolout;++i)
+		{
+		  arrLev1p[k*npolout+i] = drms_array_create(type1p,2,axisout,NULL,&status);
+		  if(status != DRMS_SUCCESS || arrLev1p[k*npolout+i] == NULL)
+		    {
+		      printf("Error: cannot create an array for a level 1p data at target time %s\n",timeBegin2);
+		      /*for(ii=0;ii<nRecs1d;++ii)
+			{
+			  if(arrLev1d[ii] != NULL)
+			    {
+			      drms_free_array(arrLev1d[ii]);
+			      arrLev1d[ii]=NULL;
+			      Segments1d=0;
+			    }
+			}
+		      Segments1p=0;
+		      QUALITY = QUALITY | QUAL_NOLEV1PARRAY;
+		      if(Lev15Wanted) CreateEmptyRecord=1; goto NextTargetTime;*/
+		      return 1;//exit(EXIT_FAILURE); //we exit because this is a DRMS failure, not a problem with the data
+		    }
+		  imagesout[i]=arrLev1p[k*npolout+i]->data;
+		}
 
 
 	      //Calling Jesper's code
@@ -5064,6 +5133,14 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	      t1=dsecnd();
 	      printf("TIME ELAPSED IN POLCAL: %f\n",t1-t0);
 
+	      //the level 1d filtergrams of wavelength k are not needed anymore (they were already written if Lev1dWanted): we release them now,
+	      //before the level 1p arrays of the next wavelength are created
+	      for(ii=0;ii<nRecs1d;++ii) if (arrLev1d[ii] != NULL && WhichWavelength(fid[ii]) == k)
+		{
+		  drms_free_array(arrLev1d[ii]);
+		  arrLev1d[ii]=NULL;
+		}
+
 	      //Putting output images in the proper records
 	      //**************************************************************
 	      	
@@ -5076,8 +5153,8 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 		      arrLev1p[k*npolout+i]->bzero=segout->bzero;
 		      arrLev1p[k*npolout+i]->bscale=segout->bscale; //because BSCALE in the jsd file is not 1
 		      arrLev1p[k*npolout+i]->israw=0;
-		      status=drms_segment_write(segout,arrLev1p[k*npolout+i], 0);        //write the file containing the data (WE ASSUME THAT imagesout ARE IN THE ORDER I,Q,U,V AND LCP followed by RCP)
-		      if(status != DRMS_SUCCESS)
+		      status=Lev15WriterWrite(&Writer,segout,arrLev1p[k*npolout+i]);     //write the file containing the data, with the writer thread (WE ASSUME THAT imagesout ARE IN THE ORDER I,Q,U,V AND LCP followed by RCP)
+		      if(status != 0)
 			{
 			  printf("Error: a call to drms_segment_write failed\n");
 			  return 1;
@@ -5343,7 +5420,7 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	      for(i=0;i<nSegs1p;++i)
 		{
 		  segin   = drms_segment_lookupnum(recLev1p->records[0],i);
-		  arrLev1p[i] = drms_segment_read(segin,type1p,&status); //pointer toward the segment. THE SEGMENTS ARE READ FROM LEV 1P DATA SERIES, SO ARE ORDERED IN I0 LCP,RCP, I1 LCP,RCP, I2... AND ARE CONVERTED INTO TYPE 1p
+		  arrLev1p[i] = SegmentRead(segin,type1p,&status); //pointer toward the segment. THE SEGMENTS ARE READ FROM LEV 1P DATA SERIES, SO ARE ORDERED IN I0 LCP,RCP, I1 LCP,RCP, I2... AND ARE CONVERTED INTO TYPE 1p
 		  if(status != DRMS_SUCCESS || arrLev1p[i] == NULL)
 		    {
 		      printf("Error: could not read the segment for level 1p data index %d at target time %s \n",i,timeBegin2);
@@ -5480,28 +5557,39 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 
 	  int NBC,WBC,E1C,POLC,NC,CAMERAUSED,FSNLOOKUP;
 
-	  arrayL0 = drms_record_getvector(drms_env,HMISeriesLookup, keylist, typeLO, unique, &status);
-	  if(status != DRMS_SUCCESS)
+	  //the keywords of the look-up table series are only read for the first target time
+	  if(arrayLK0 == NULL)
 	    {
-	      printf("Error: cannot read a list of keywords in the look-up table series\n");
-	      QUALITY = QUALITY | QUAL_NOLOOKUPKEYWORD;
-	      CreateEmptyRecord=1; goto NextTargetTime;
+	      arrayLK0 = drms_record_getvector(drms_env,HMISeriesLookup, keylist, typeLO, unique, &status);
+	      if(status != DRMS_SUCCESS || arrayLK0 == NULL)
+		{
+		  printf("Error: cannot read a list of keywords in the look-up table series\n");
+		  if(arrayLK0 != NULL) drms_free_array(arrayLK0);
+		  arrayLK0=NULL;
+		  QUALITY = QUALITY | QUAL_NOLOOKUPKEYWORD;
+		  CreateEmptyRecord=1; goto NextTargetTime;
+		}
 	    }
-	  printf("DIMENSIONS= %d %d\n",arrayL0->axis[0],arrayL0->axis[1]);
-	  keyL=arrayL0->data;
-	  arrayL1 = drms_record_getvector(drms_env,HMISeriesLookup,TRECS,DRMS_TYPE_DOUBLE , unique, &status); //WARNING: FOR WHATEVER REASON T_REC AS TO BE READ AS A DOUBLE AND NOT A TIME, OTHERWISE: SEGMENTATION FAULT!
-	  if(status != DRMS_SUCCESS)
+	  printf("DIMENSIONS= %d %d\n",arrayLK0->axis[0],arrayLK0->axis[1]);
+	  keyL=arrayLK0->data;
+	  if(arrayLK1 == NULL)
 	    {
-	      printf("Error: cannot read a list of keywords in the look-up table series\n");
-	      QUALITY = QUALITY | QUAL_NOLOOKUPKEYWORD;
-	      CreateEmptyRecord=1; goto NextTargetTime;
+	      arrayLK1 = drms_record_getvector(drms_env,HMISeriesLookup,TRECS,DRMS_TYPE_DOUBLE , unique, &status); //WARNING: FOR WHATEVER REASON T_REC AS TO BE READ AS A DOUBLE AND NOT A TIME, OTHERWISE: SEGMENTATION FAULT!
+	      if(status != DRMS_SUCCESS || arrayLK1 == NULL)
+		{
+		  printf("Error: cannot read a list of keywords in the look-up table series\n");
+		  if(arrayLK1 != NULL) drms_free_array(arrayLK1);
+		  arrayLK1=NULL;
+		  QUALITY = QUALITY | QUAL_NOLOOKUPKEYWORD;
+		  CreateEmptyRecord=1; goto NextTargetTime;
+		}
 	    }
 
-	  timeL=arrayL1->data;
+	  timeL=arrayLK1->data;
 
-	  n1=arrayL0->axis[1]; //number of look-up table records found
-	  n0=arrayL0->axis[0]; //number of keywords read (should be 7)
-     	  if(n1 != arrayL1->axis[1])
+	  n1=arrayLK0->axis[1]; //number of look-up table records found
+	  n0=arrayLK0->axis[0]; //number of keywords read (should be 7)
+     	  if(n1 != arrayLK1->axis[1])
 	    {
 	      printf("Error: The number of look-up table records identified by T_REC is not the same as the number of records identified by HWL4POS,HWL3POS,HWL2POS,HWL1POS, and NWL\n");
 	      QUALITY = QUALITY | QUAL_NOLOOKUPRECORD;
@@ -5575,13 +5663,24 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 
 	  printf("QUERY= %s\n",HMILookup);
 
-	  drms_free_array(arrayL0);
-	  arrayL0=NULL;
-	  drms_free_array(arrayL1);
-	  arrayL1=NULL;
 	  free(count);
 	  count=NULL;
 
+	  if(lookupkey[0] == FSNLOOKUP && lookupkey[1] == CamId && lookupkey[2] == HCME1T && lookupkey[3] == HCMWBT && lookupkey[4] == HCMPOLT && lookupkey[5] == HCMNBT && lookupkey[6] == NC && arrintable != NULL && (arrinverse != NULL || InverseTables == 0))
+	    {
+	      printf("look-up table record already in memory\n");
+	      goto LookupTableRead;
+	    }
+
+	  //a different look-up table is needed: the previous one is released
+	  for(i=0;i<7;++i) lookupkey[i]=-1;
+	  if(arrintable != NULL) drms_free_array(arrintable);
+	  arrintable=NULL;
+	  if(arrinverse != NULL) drms_free_array(arrinverse);
+	  arrinverse=NULL;
+	  if(lookup != NULL) status=drms_close_records(lookup,DRMS_FREE_RECORD);
+	  lookup=NULL;
+
 	  lookup  = drms_open_records(drms_env,HMILookup,&status); 
 	  if (status == DRMS_SUCCESS && lookup != NULL)
 	    {
@@ -5606,7 +5705,7 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	    }
 	  
 	  segin     = drms_segment_lookupnum(lookup->records[0], 0);
-	  arrintable= drms_segment_read(segin, segin->info->type, &status);
+	  arrintable= SegmentRead(segin, segin->info->type, &status);
 	  if (status != DRMS_SUCCESS || arrintable == NULL)
 	    {
 	      printf("Error: unable to read the data segment of the look-up table record\n"); //if there is a problem
@@ -5616,6 +5715,50 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	    } 
 	  else printf("look-up table record read\n");
 
+	  //the inverse look-up tables (only used by Dopplergram(), inverse=1) are read from the segment "inverse" if the look-up table series has one, otherwise they are computed from the look-up tables
+	  segin     = (InverseTables == 1) ? drms_segment_lookup(lookup->records[0],"inverse") : NULL;
+	  if(segin != NULL)
+	    {
+	      arrinverse= SegmentRead(segin, segin->info->type, &status);
+	      if (status != DRMS_SUCCESS || arrinverse == NULL)
+		{
+		  printf("WARNING: unable to read the inverse look-up tables, they will be computed\n");
+		  if(arrinverse != NULL) drms_free_array(arrinverse);
+		  arrinverse=NULL;
+		}
+	      else if(arrinverse->axis[0] != arrintable->axis[0]+2*NINVHEADER)
+		{
+		  printf("WARNING: the inverse look-up tables do not have the current format, they will be computed\n");
+		  drms_free_array(arrinverse);
+		  arrinverse=NULL;
+		}
+	    }
+	  if(arrinverse == NULL && InverseTables == 1)
+	    {
+	      int axisinv[3]={arrintable->axis[0]+2*NINVHEADER,arrintable->axis[1],arrintable->axis[2]}; //ninv=ntest
+	      arrinverse= drms_array_create(DRMS_TYPE_FLOAT,3,axisinv,NULL,&status);
+	      if(status != DRMS_SUCCESS || arrinverse == NULL)
+		{
+		  printf("Error: cannot create an array for the inverse look-up tables\n");
+		  return 1;
+		}
+	      t0=dsecnd();
+	      status=InverseLookup(arrintable->data,arrintable->axis[0]/2,arrintable->axis[1],arrintable->axis[2],dvtest,arrintable->axis[0]/2,arrinverse->data);
+	      t1=dsecnd();
+	      if(status != 0) printf("WARNING: the look-up tables are not monotone at %d nodes\n",status);
+	      printf("TIME ELAPSED TO COMPUTE THE INVERSE LOOK-UP TABLES: %f\n",t1-t0);
+	    }
+
+	  lookupkey[0]=FSNLOOKUP;
+	  lookupkey[1]=CamId;
+	  lookupkey[2]=HCME1T;
+	  lookupkey[3]=HCMWBT;
+	  lookupkey[4]=HCMPOLT;
+	  lookupkey[5]=HCMNBT;
+	  lookupkey[6]=NC;
+
+	LookupTableRead: ;
+
 
 	  //reading the appropriate polynomial coefficients for the correction of the Doppler velocity
 	  //*******************************************************************************************
@@ -5623,32 +5766,32 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	  int FSNDIFF;
 	  char keylistCoeff[]="COEFF0,COEFF1,COEFF2,COEFF3";
 
-	  arrayL0 = drms_record_getvector(drms_env,HMISeriesCoeffs, keylistCoeff, DRMS_TYPE_DOUBLE, unique, &status);
-	  if(status != DRMS_SUCCESS)
+	  //the keywords of the polynomial coefficient series are only read for the first target time
+	  if(arrayL0 == NULL || arrayL1 == NULL || arrayL2 == NULL)
 	    {
-	      printf("Error: cannot read a list of keywords in the polynomial coefficient series\n");
-	      QUALITY = QUALITY | QUAL_NOCOEFFKEYWORD;
-	      CreateEmptyRecord=1; goto NextTargetTime;
-	    }
-	  TIME *keyt=NULL;
-	  keyt=arrayL0->data;
-	  
-	  arrayL1 = drms_record_getvector(drms_env,HMISeriesCoeffs,TRECS,DRMS_TYPE_DOUBLE, unique, &status); //WARNING: FOR WHATEVER REASON T_REC AS TO BE READ AS A DOUBLE AND NOT A TIME, OTHERWISE: SEGMENTATION FAULT!
-	  if(status != DRMS_SUCCESS)
-	    {
-	      printf("Error: cannot read a list of keywords in the polynomial coefficient series\n");
-	      QUALITY = QUALITY | QUAL_NOCOEFFKEYWORD;
-	      CreateEmptyRecord=1; goto NextTargetTime;
+	      if(arrayL0 != NULL) drms_free_array(arrayL0);
+	      if(arrayL1 != NULL) drms_free_array(arrayL1);
+	      if(arrayL2 != NULL) drms_free_array(arrayL2);
+	      arrayL1=NULL;
+	      arrayL2=NULL;
+	      arrayL0 = drms_record_getvector(drms_env,HMISeriesCoeffs, keylistCoeff, DRMS_TYPE_DOUBLE, unique, &status);
+	      if(status == DRMS_SUCCESS) arrayL1 = drms_record_getvector(drms_env,HMISeriesCoeffs,TRECS,DRMS_TYPE_DOUBLE, unique, &status); //WARNING: FOR WHATEVER REASON T_REC AS TO BE READ AS A DOUBLE AND NOT A TIME, OTHERWISE: SEGMENTATION FAULT!
+	      if(status == DRMS_SUCCESS) arrayL2 = drms_record_getvector(drms_env,HMISeriesCoeffs,CALFSNS,DRMS_TYPE_INT, unique, &status); 
+	      if(status != DRMS_SUCCESS || arrayL0 == NULL || arrayL1 == NULL || arrayL2 == NULL)
+		{
+		  printf("Error: cannot read a list of keywords in the polynomial coefficient series\n");
+		  if(arrayL0 != NULL) drms_free_array(arrayL0);
+		  if(arrayL1 != NULL) drms_free_array(arrayL1);
+		  if(arrayL2 != NULL) drms_free_array(arrayL2);
+		  arrayL0=NULL;
+		  arrayL1=NULL;
+		  arrayL2=NULL;
+		  QUALITY = QUALITY | QUAL_NOCOEFFKEYWORD;
+		  CreateEmptyRecord=1; goto NextTargetTime;
+		}
+	      coeffkey[0]=-1;
 	    }
 	  timeL=arrayL1->data;
-	  
-	  arrayL2 = drms_record_getvector(drms_env,HMISeriesCoeffs,CALFSNS,DRMS_TYPE_INT, unique, &status); 
-	  if(status != DRMS_SUCCESS)
-	    {
-	      printf("Error: cannot read a list of keywords in the polynomial coefficient series\n");
-	      QUALITY = QUALITY | QUAL_NOCOEFFKEYWORD;
-	      CreateEmptyRecord=1; goto NextTargetTime;
-	    }
 	  FSNL=arrayL2->data;
 	  
 	  n1=arrayL0->axis[1]; //number of polynomial coefficient records found
@@ -5733,6 +5876,18 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	  printf("Indeces of the retrieved polynomial record %d %d %d\n",temp,temp2,n1);
 	  printf("Keyword values of the retrieved polynomial record: %d\n",FSNL[temp]-FSNLOOKUP);
 	  
+	  if(coeffkey[0] == FSNLOOKUP && coeffkey[1] == temp && coeffkey[2] == temp2)
+	    {
+	      printf("polynomial coefficient records already in memory\n");
+	      for(i=0;i<4;++i)
+		{
+		  coeff[i] =coeffcache[i];
+		  coeff2[i]=coeffcache[4+i];
+		}
+	      goto CoefficientsRead;
+	    }
+	  coeffkey[0]=-1;
+
 	  //WE BUILD THE FIRST QUERY FOR THE POLYNOMIAL COEFFICIENTS
 	  sprint_time(query,timeL[temp],"TAI",1);
 	  strcpy(HMICoeffs,HMISeriesCoeffs); 
@@ -5834,6 +5989,16 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	    }
 	  else recpoly2 = NULL;
 
+	  for(i=0;i<4;++i)
+	    {
+	      coeffcache[i]  =coeff[i];
+	      coeffcache[4+i]=coeff2[i];
+	    }
+	  coeffkey[0]=FSNLOOKUP;
+	  coeffkey[1]=temp;
+	  coeffkey[2]=temp2;
+
+	CoefficientsRead:
  
 	  printf("Polynomial coefficient values: %e %e %e %e\n",coeff[0],coeff[1],coeff[2],coeff[3]);
 
@@ -5847,12 +6012,6 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	    }
 
 
-	  drms_free_array(arrayL0);
-	  arrayL0=NULL;
-	  drms_free_array(arrayL1);
-	  arrayL1=NULL;
-	  drms_free_array(arrayL2);
-	  arrayL2=NULL;
 	  free(count);
 	  count=NULL;
 
@@ -5876,15 +6035,22 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	  
 	  nRecs15   = 6; //Dopplergram, l.o.s. magnetogram, linewidth, linedepth, continuum intensity, and UNCORRECTED (RAW) Dopplergram
 	  
-	  recLev15a = drms_create_records(drms_env,1,HMISeriesLev15a,DRMS_PERMANENT,&statusA[0]); //RECORD FOR DOPPLERGRAM
-	  recLev15b = drms_create_records(drms_env,1,HMISeriesLev15b,DRMS_PERMANENT,&statusA[1]); //RECORD FOR MAGNETOGRAM
-	  recLev15c = drms_create_records(drms_env,1,HMISeriesLev15c,DRMS_PERMANENT,&statusA[2]); //RECORD FOR LINEDEPTH
-	  recLev15d = drms_create_records(drms_env,1,HMISeriesLev15d,DRMS_PERMANENT,&statusA[3]); //RECORD FOR LINEWIDTH
-	  recLev15e = drms_create_records(drms_env,1,HMISeriesLev15e,DRMS_PERMANENT,&statusA[4]); //RECORD FOR CONTINUUM
-	  printf("Observables will be saved in the following series:\n %s \n %s \n %s \n %s \n %s \n",HMISeriesLev15a,HMISeriesLev15b,HMISeriesLev15c,HMISeriesLev15d,HMISeriesLev15e);
-
-
-	  if ( (statusA[0]+statusA[1]+statusA[2]+statusA[3]+statusA[4]) != DRMS_SUCCESS || recLev15a == NULL || recLev15b == NULL || recLev15c == NULL|| recLev15d == NULL || recLev15e == NULL)
+	  //only the records of the observables selected by the user are created
+	  for(i=0;i<5;++i) statusA[i]=DRMS_SUCCESS;
+	  if(Observables & LEV15_DOPPLERGRAM) recLev15a = drms_create_records(drms_env,1,HMISeriesLev15a,DRMS_PERMANENT,&statusA[0]); //RECORD FOR DOPPLERGRAM
+	  if(Observables & LEV15_MAGNETOGRAM) recLev15b = drms_create_records(drms_env,1,HMISeriesLev15b,DRMS_PERMANENT,&statusA[1]); //RECORD FOR MAGNETOGRAM
+	  if(Observables & LEV15_LINEDEPTH)   recLev15c = drms_create_records(drms_env,1,HMISeriesLev15c,DRMS_PERMANENT,&statusA[2]); //RECORD FOR LINEDEPTH
+	  if(Observables & LEV15_LINEWIDTH)   recLev15d = drms_create_records(drms_env,1,HMISeriesLev15d,DRMS_PERMANENT,&statusA[3]); //RECORD FOR LINEWIDTH
+	  if(Observables & LEV15_CONTINUUM)   recLev15e = drms_create_records(drms_env,1,HMISeriesLev15e,DRMS_PERMANENT,&statusA[4]); //RECORD FOR CONTINUUM
+	  printf("Observables will be saved in the following series:\n");
+	  if(recLev15a != NULL) printf(" %s \n",HMISeriesLev15a);
+	  if(recLev15b != NULL) printf(" %s \n",HMISeriesLev15b);
+	  if(recLev15c != NULL) printf(" %s \n",HMISeriesLev15c);
+	  if(recLev15d != NULL) printf(" %s \n",HMISeriesLev15d);
+	  if(recLev15e != NULL) printf(" %s \n",HMISeriesLev15e);
+
+
+	  if ( (statusA[0]+statusA[1]+statusA[2]+statusA[3]+statusA[4]) != DRMS_SUCCESS || (recLev15a == NULL && (Observables & LEV15_DOPPLERGRAM)) || (recLev15b == NULL && (Observables & LEV15_MAGNETOGRAM)) || (recLev15c == NULL && (Observables & LEV15_LINEDEPTH)) || (recLev15d == NULL && (Observables & LEV15_LINEWIDTH)) || (recLev15e == NULL && (Observables & LEV15_CONTINUUM)))
 	    {
 	      printf("Could not create a record for one or several level 1.5 data series, at target time %s\n",timeBegin2); 
 	      /*recLev15a=NULL;
@@ -5896,7 +6062,7 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	      CreateEmptyRecord=1; goto NextTargetTime;*/
 	      return 1;//exit(EXIT_FAILURE);
 	    }
-	  if(recLev15a->n == 0 || recLev15b->n == 0 || recLev15c->n == 0 || recLev15d->n == 0 || recLev15e->n == 0)
+	  if((recLev15a != NULL && recLev15a->n == 0) || (recLev15b != NULL && recLev15b->n == 0) || (recLev15c != NULL && recLev15c->n == 0) || (recLev15d != NULL && recLev15d->n == 0) || (recLev15e != NULL && recLev15e->n == 0))
 	    {
 	      printf("Could not create a record for one or several level 1.5 data series, at target time %s\n",timeBegin2); 
 	      /*recLev15a=NULL;
@@ -5918,7 +6084,9 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 		}
 	  for (i=0;i<nRecs15;++i)
 	    {
-	      arrLev15[i] = drms_array_create(type15,2,axisout,NULL,&status);
+	      arrLev15[i] = NULL;
+	      if(InverseTables == 1 && !(Observables & (1 << (i % 5)))) continue; //observable not selected (the raw Dopplergram, i=5, goes with the Dopplergram). Dopplergram_largercrop() needs all the arrays
+	      arrLev15[i] = Lev15WriterArray(&Writer,type15,axisout,&status); //array of a previous target time already written, or new array
 	      if(status != DRMS_SUCCESS || arrLev15[i] == NULL)
 		{
 		  printf("Error: cannot create an array for a level 1.5 data at target time %s\n",timeBegin2);
@@ -6006,7 +6174,16 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 
 	  t0=dsecnd();
 
-	  Dopplergram_largercrop(arrLev1p,arrLev15,nSegs1p,arrintable,RSUNint,X0AVG,Y0AVG,DopplerParameters,MISSVALS,&SATVALS,cdelt1,TargetTime); //ASSUMES arrLev1p ARE IN THE ORDER I0 LCP, I0 RCP, I1 LCP, I1 RCP, I2 LCP, I2 RCP, I3 LCP, I3 RCP, I4 LCP, I4 RCP, AND I5 LCP, I5 RCP
+	  if(InverseTables == 1) Dopplergram(arrLev1p,arrLev15,nSegs1p,arrintable,arrinverse,RSUNint,X0AVG,Y0AVG,DopplerParameters,MISSVALS,&SATVALS,cdelt1,TargetTime,Observables,NULL); //brackets of the look-up tables located with the inverse look-up tables, crop at Rsun+50 pixels. ASSUMES arrLev1p ARE IN THE ORDER I0 LCP, I0 RCP, I1 LCP, I1 RCP, I2 LCP, I2 RCP, I3 LCP, I3 RCP, I4 LCP, I4 RCP, AND I5 LCP, I5 RCP
+	  else
+	    {
+	      Dopplergram_largercrop(arrLev1p,arrLev15,nSegs1p,arrintable,RSUNint,X0AVG,Y0AVG,DopplerParameters,MISSVALS,&SATVALS,cdelt1,TargetTime); //ASSUMES arrLev1p ARE IN THE ORDER I0 LCP, I0 RCP, I1 LCP, I1 RCP, I2 LCP, I2 RCP, I3 LCP, I3 RCP, I4 LCP, I4 RCP, AND I5 LCP, I5 RCP
+	      for(i=0;i<nRecs15;++i) if(!(Observables & (1 << (i % 5))) && arrLev15[i] != NULL) //observables computed but not selected: not written
+		{
+		  drms_free_array(arrLev15[i]);
+		  arrLev15[i]=NULL;
+		}
+	    }
 	  //else Dopplergram2(arrLev1p,arrLev15,nSegs1p,arrintable,RSUNint,X0AVG,Y0AVG,DopplerParameters,MISSVALS,&SATVALS,cdelt1); //uses bi-cubic interpolation
 	  t1=dsecnd();
 	  printf("TIME ELAPSED IN DOPPLERGRAM(): %f\n",t1-t0);
@@ -6014,404 +6191,329 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	  printf("KEYWORDS OF Dopplergram() %f %f %f\n",RSUNint,X0AVG,Y0AVG);
 	  printf("%f %f %f %f %f %f %f %f %d %d %d %f %f %f \n", DopplerParameters.FSRNB,DopplerParameters.FSRWB,DopplerParameters.FSRE1,DopplerParameters.FSRE2,DopplerParameters.FSRE3,DopplerParameters.FSRE4,DopplerParameters.FSRE5,DopplerParameters.dlamdv,DopplerParameters.maxVtest,DopplerParameters.maxNx,DopplerParameters.ntest,DopplerParameters.dvtest,DopplerParameters.MISSINGDATA,DopplerParameters.MISSINGRESULT);
 
-	  //WRITING DATA SEGMENTS
-	  t0=dsecnd();
-	  segout = drms_segment_lookupnum(recLev15a->records[0], 0);
-	  arrLev15[0]->bzero=segout->bzero;
-	  arrLev15[0]->bscale=segout->bscale; //because BSCALE in the jsd file is not 1
-	  arrLev15[0]->israw=0;
-	  status=drms_segment_write(segout,arrLev15[0], 0);
-	  if(status != DRMS_SUCCESS)
+	  //SCALING OF THE DATA SEGMENTS (BSCALE AND BZERO OF THE OUTPUT SERIES)
+	  if(Observables & LEV15_DOPPLERGRAM)
 	    {
-	      printf("Error: a call to drms_segment_write failed\n");
-	      return 1;
-	    } 
-
-	  segout = drms_segment_lookupnum(recLev15b->records[0], 0);
-	  arrLev15[1]->bzero=segout->bzero;
-	  arrLev15[1]->bscale=segout->bscale; //because BSCALE in the jsd file is not 1
-	  arrLev15[1]->israw=0;
-	  status=drms_segment_write(segout,arrLev15[1], 0);
-	  if(status != DRMS_SUCCESS)
-	    {
-	      printf("Error: a call to drms_segment_write failed\n");
-	      return 1;
-	    } 
+	      segout = drms_segment_lookupnum(recLev15a->records[0], 0);
+	      arrLev15[0]->bzero=segout->bzero;
+	      arrLev15[0]->bscale=segout->bscale; //because BSCALE in the jsd file is not 1
+	      arrLev15[0]->israw=0;
+	    }
 
-	  segout = drms_segment_lookupnum(recLev15c->records[0], 0);
-	  arrLev15[2]->bzero=segout->bzero;
-	  arrLev15[2]->bscale=segout->bscale; //because BSCALE in the jsd file is not 1
-	  arrLev15[2]->israw=0;
-	  status=drms_segment_write(segout,arrLev15[2], 0);
-	  if(status != DRMS_SUCCESS)
+	  if(Observables & LEV15_MAGNETOGRAM)
 	    {
-	      printf("Error: a call to drms_segment_write failed\n");
-	      return 1;
-	    } 
+	      segout = drms_segment_lookupnum(recLev15b->records[0], 0);
+	      arrLev15[1]->bzero=segout->bzero;
+	      arrLev15[1]->bscale=segout->bscale; //because BSCALE in the jsd file is not 1
+	      arrLev15[1]->israw=0;
+	    }
 
-	  segout = drms_segment_lookupnum(recLev15d->records[0], 0);
-	  arrLev15[3]->bzero=segout->bzero;
-	  arrLev15[3]->bscale=segout->bscale; //because BSCALE in the jsd file is not 1
-	  arrLev15[3]->israw=0;
-	  status=drms_segment_write(segout,arrLev15[3], 0);
-	  if(status != DRMS_SUCCESS)
-	    {
-	      printf("Error: a call to drms_segment_write failed\n");
-	      return 1;
-	    } 
-			  
-	  segout = drms_segment_lookupnum(recLev15e->records[0], 0);
-	  arrLev15[4]->bzero=segout->bzero;
-	  arrLev15[4]->bscale=segout->bscale; //because BSCALE in the jsd file is not 1
-	  arrLev15[4]->israw=0;
-	  status=drms_segment_write(segout,arrLev15[4], 0);  
-	  if(status != DRMS_SUCCESS)
+	  if(Observables & LEV15_LINEDEPTH)
 	    {
-	      printf("Error: a call to drms_segment_write failed\n");
-	      return 1;
-	    } 
-
-	  t1=dsecnd();
-	  printf("TIME ELAPSED TO WRITE THE LEVEL 1.5 SEGMENTS: %f\n",t1-t0);
-
-	  //CALCULATE MEDIAN VELOCITY OVER 99% OF SOLAR RADIUS FOR UNCORRECTED (RAW) DOPPLERGRAM
+	      segout = drms_segment_lookupnum(recLev15c->records[0], 0);
+	      arrLev15[2]->bzero=segout->bzero;
+	      arrLev15[2]->bscale=segout->bscale; //because BSCALE in the jsd file is not 1
+	      arrLev15[2]->israw=0;
+	    }
 
-	  image0=(float *)arrLev15[5]->data;
-	  	  
-	  for(i=0;i<axisout[0]*axisout[1];++i)
+	  if(Observables & LEV15_LINEWIDTH)
 	    {
-	      row   =i / axisout[0];
-	      column=i % axisout[0];
-	      distance = sqrt(((float)row-Y0AVG)*((float)row-Y0AVG)+((float)column-X0AVG)*((float)column-X0AVG)); //distance in pixels
-	      if(distance > 0.99*RSUNint)
-		{
-		  image0[i]=NAN;
-		}
+	      segout = drms_segment_lookupnum(recLev15d->records[0], 0);
+	      arrLev15[3]->bzero=segout->bzero;
+	      arrLev15[3]->bscale=segout->bscale; //because BSCALE in the jsd file is not 1
+	      arrLev15[3]->israw=0;
 	    }
-	  status=fstats(axisout[0]*axisout[1],arrLev15[5]->data,&minimum,&maximum,&median,&mean,&sigma,&skewness,&kurtosis,&ngood); //ngood is the number of points that are not NANs
-	  if(status != 0) printf("Error: the statistics function did not run properly at target time %s\n",timeBegin2);
-	  statusA[2]= drms_setkey_float(recLev15a->records[0],RAWMEDNS,(float)median);
-	  if(statusA[2] != 0)
+			  
+	  if(Observables & LEV15_CONTINUUM)
 	    {
-	      printf("WARNING: could not set some of the keywords modified by the temporal interpolation subroutine for the Dopplergram at target time %s %f\n",timeBegin2,(float)median);
+	      segout = drms_segment_lookupnum(recLev15e->records[0], 0);
+	      arrLev15[4]->bzero=segout->bzero;
+	      arrLev15[4]->bscale=segout->bscale; //because BSCALE in the jsd file is not 1
+	      arrLev15[4]->israw=0;
 	    }
 
-	  //SETTING OTHER KEYWORDS FOR DOPPLERGRAMS
+	  //STATISTICS OF THE OBSERVABLES (NB: NANS ARE AVOIDED), ON THE ENTIRE IMAGES AND OVER 99% OF SOLAR RADIUS, ALL COMPUTED AT ONCE
 
 	  t0=dsecnd();
-	  drms_copykeys(recLev15a->records[0],recLev1p->records[0],1,kDRMS_KeyClass_Explicit);
-	  //call Keh-Cheng's functions for the statistics (NB: this function avoids NANs, but other than that calculates the different quantities on the ENTIRE image)
-	  status=fstats(axisout[0]*axisout[1],arrLev15[0]->data,&minimum,&maximum,&median,&mean,&sigma,&skewness,&kurtosis,&ngood); //ngood is the number of points that are not NANs
-	  if(status != 0)
-	    {
-	      printf("Error: the statistics function did not run properly at target time %s\n",timeBegin2);
-	    }
-
-	  image=arrLev15[0]->data;
-	  for(i=0;i<axisout[0]*axisout[1];i++) if (image[i] > (32767.*arrLev15[0]->bscale+arrLev15[0]->bzero) || image[i] < (-32768.*arrLev15[0]->bscale+arrLev15[0]->bzero))
+	  for(i=0;i<nRecs15;++i) imagesLev15[i] = (arrLev15[i] != NULL) ? (float *)arrLev15[i]->data : NULL;
+	  for(i=0;i<5;++i) if(arrLev15[i] != NULL)
 	    {
-	      MISSVALS[0]+=1; //because drms_segment_write() sets these values to NaN
-	      ngood -= 1;
+	      rangemin15[i]=(-intmax15[i]-1.)*arrLev15[i]->bscale+arrLev15[i]->bzero; //values out of this range are set to NaN by drms_segment_write()
+	      rangemax15[i]=intmax15[i]*arrLev15[i]->bscale+arrLev15[i]->bzero;
 	    }
+	  status=ImageStatistics(5,imagesLev15,axisout[0],axisout[1],X0AVG,Y0AVG,0.0,rangemin15,rangemax15,statsLev15);                   //entire images, without the raw Dopplergram
+	  if(status != 0) printf("Error: the statistics function did not run properly at target time %s\n",timeBegin2);
+	  status=ImageStatistics(nRecs15,imagesLev15,axisout[0],axisout[1],X0AVG,Y0AVG,0.99*RSUNint,NULL,NULL,statsLev15R);          //within 99% of RSUN, with the raw Dopplergram
+	  if(status != 0) printf("Error: the statistics function did not run properly at target time %s\n",timeBegin2);
 
+	  //MEDIAN VELOCITY OVER 99% OF SOLAR RADIUS FOR UNCORRECTED (RAW) DOPPLERGRAM
 
-	  //statusA[0]=   drms_setkey_int(recLev15a->records[0],TOTVALSS,axisout[0]*axisout[1]);
-	  statusA[0]=   drms_setkey_int(recLev15a->records[0],TOTVALSS,ngood+MISSVALS[0]);
-	  statusA[1]=   drms_setkey_int(recLev15a->records[0],DATAVALSS,ngood);
-	  //statusA[2]=   drms_setkey_int(recLev15a->records[0],MISSVALSS,axisout[0]*axisout[1]-ngood);
-	  statusA[2]=   drms_setkey_int(recLev15a->records[0],MISSVALSS,MISSVALS[0]);
-	  statusA[3]= drms_setkey_float(recLev15a->records[0],DATAMINS,(float)minimum);
-	  statusA[4]= drms_setkey_float(recLev15a->records[0],DATAMAXS,(float)maximum);
-	  statusA[5]= drms_setkey_float(recLev15a->records[0],DATAMEDNS,(float)median);
-	  statusA[6]= drms_setkey_float(recLev15a->records[0],DATAMEANS,(float)mean);
-	  statusA[7]= drms_setkey_float(recLev15a->records[0],DATARMSS,(float)sigma);
-	  statusA[8]= drms_setkey_float(recLev15a->records[0],DATASKEWS,(float)skewness);
-	  statusA[9]= drms_setkey_float(recLev15a->records[0],DATAKURTS,(float)kurtosis);
-	  statusA[10]=drms_setkey_int(recLev15a->records[0],CALFSNS,FSNLOOKUP);
-	  statusA[11]=drms_setkey_string(recLev15a->records[0],LUTQUERYS,HMILookup);
-	  sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
-	  statusA[12]= drms_setkey_string(recLev15a->records[0],DATES,DATEOBS); 
-	  statusA[13]= drms_setkey_int(recLev15a->records[0],QUALITYS,QUALITY);                //Quality word 
-   	  statusA[14]= drms_setkey_int(recLev15a->records[0],SATVALSS,SATVALS); //saturated values
-	  statusA[15]= drms_setkey_string(recLev15a->records[0],SOURCES,source); 
-	  statusA[16]= drms_setkey_int(recLev15a->records[0],QUALLEV1S,QUALITYLEV1);
-	  statusA[17]= drms_setkey_string(recLev15a->records[0],COMMENTS,COMMENT);
-	  statusA[18]=0;
-	  if(CALVER64 != -11) statusA[18]= drms_setkey_longlong(recLev15a->records[0],CALVER64S,CALVER64); 
-
-	  TotalStatus=0;
-	  for(i=0;i<19;++i) TotalStatus+=statusA[i];
-	  if(TotalStatus != 0)
+	  if(Observables & LEV15_DOPPLERGRAM)
 	    {
-	      printf("WARNING: could not set some of the keywords modified by the temporal interpolation subroutine for the Dopplergram at target time %s\n",timeBegin2);
+	      statusA[2]= drms_setkey_float(recLev15a->records[0],RAWMEDNS,(float)statsLev15R[5].median);
+	      if(statusA[2] != 0)
+		{
+		  printf("WARNING: could not set some of the keywords modified by the temporal interpolation subroutine for the Dopplergram at target time %s %f\n",timeBegin2,(float)statsLev15R[5].median);
+		}
 	    }
 
-	  //SETTING KEYWORDS FOR MAGNETOGRAMS
+	  //SETTING OTHER KEYWORDS FOR DOPPLERGRAMS
 
-	  drms_copykeys(recLev15b->records[0],recLev1p->records[0],1,kDRMS_KeyClass_Explicit);	
-	  //call Keh-Cheng's functions for the statistics (NB: this function avoids NANs, but other than that calculates the different quantities on the ENTIRE image)
-	  status=fstats(axisout[0]*axisout[1],arrLev15[1]->data,&minimum,&maximum,&median,&mean,&sigma,&skewness,&kurtosis,&ngood); //ngood is the number of points that are not NANs
-	  if(status != 0)
-	    {
-	      printf("Error: the statistics function did not run properly at target time %s\n",timeBegin2);
-	    }
+	  if(Observables & LEV15_DOPPLERGRAM)
+	    {
+	      drms_copykeys(recLev15a->records[0],recLev1p->records[0],1,kDRMS_KeyClass_Explicit);
+	      MISSVALS[0]+=statsLev15[0].nout; //because drms_segment_write() sets these values to NaN
+	      ngood=statsLev15[0].ngood-statsLev15[0].nout;
+
+
+	      //statusA[0]=   drms_setkey_int(recLev15a->records[0],TOTVALSS,axisout[0]*axisout[1]);
+	      statusA[0]=   drms_setkey_int(recLev15a->records[0],TOTVALSS,ngood+MISSVALS[0]);
+	      statusA[1]=   drms_setkey_int(recLev15a->records[0],DATAVALSS,ngood);
+	      //statusA[2]=   drms_setkey_int(recLev15a->records[0],MISSVALSS,axisout[0]*axisout[1]-ngood);
+	      statusA[2]=   drms_setkey_int(recLev15a->records[0],MISSVALSS,MISSVALS[0]);
+	      statusA[3]= drms_setkey_float(recLev15a->records[0],DATAMINS,(float)statsLev15[0].minimum);
+	      statusA[4]= drms_setkey_float(recLev15a->records[0],DATAMAXS,(float)statsLev15[0].maximum);
+	      statusA[5]= drms_setkey_float(recLev15a->records[0],DATAMEDNS,(float)statsLev15[0].median);
+	      statusA[6]= drms_setkey_float(recLev15a->records[0],DATAMEANS,(float)statsLev15[0].mean);
+	      statusA[7]= drms_setkey_float(recLev15a->records[0],DATARMSS,(float)statsLev15[0].sigma);
+	      statusA[8]= drms_setkey_float(recLev15a->records[0],DATASKEWS,(float)statsLev15[0].skewness);
+	      statusA[9]= drms_setkey_float(recLev15a->records[0],DATAKURTS,(float)statsLev15[0].kurtosis);
+	      statusA[10]=drms_setkey_int(recLev15a->records[0],CALFSNS,FSNLOOKUP);
+	      statusA[11]=drms_setkey_string(recLev15a->records[0],LUTQUERYS,HMILookup);
+	      sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
+	      statusA[12]= drms_setkey_string(recLev15a->records[0],DATES,DATEOBS); 
+	      statusA[13]= drms_setkey_int(recLev15a->records[0],QUALITYS,QUALITY);                //Quality word 
+	      statusA[14]= drms_setkey_int(recLev15a->records[0],SATVALSS,SATVALS); //saturated values
+	      statusA[15]= drms_setkey_string(recLev15a->records[0],SOURCES,source); 
+	      statusA[16]= drms_setkey_int(recLev15a->records[0],QUALLEV1S,QUALITYLEV1);
+	      statusA[17]= drms_setkey_string(recLev15a->records[0],COMMENTS,COMMENT);
+	      statusA[18]=0;
+	      if(CALVER64 != -11) statusA[18]= drms_setkey_longlong(recLev15a->records[0],CALVER64S,CALVER64); 
 
-	  image=arrLev15[1]->data;
-	  for(i=0;i<axisout[0]*axisout[1];i++) if (image[i] > (2147483647.*arrLev15[1]->bscale+arrLev15[1]->bzero) || image[i] < (-2147483648.*arrLev15[1]->bscale+arrLev15[1]->bzero))
-	    {
-	      MISSVALS[1]+=1;
-	      ngood -= 1;
+	      TotalStatus=0;
+	      for(i=0;i<19;++i) TotalStatus+=statusA[i];
+	      if(TotalStatus != 0)
+		{
+		  printf("WARNING: could not set some of the keywords modified by the temporal interpolation subroutine for the Dopplergram at target time %s\n",timeBegin2);
+		}
 	    }
 
+	  //SETTING KEYWORDS FOR MAGNETOGRAMS
 
-	  statusA[0]=   drms_setkey_int(recLev15b->records[0],TOTVALSS,ngood+MISSVALS[1]);
-	  statusA[1]=   drms_setkey_int(recLev15b->records[0],DATAVALSS,ngood);
-	  statusA[2]=   drms_setkey_int(recLev15b->records[0],MISSVALSS,MISSVALS[1]);
-	  statusA[3]= drms_setkey_float(recLev15b->records[0],DATAMINS,(float)minimum);
-	  statusA[4]= drms_setkey_float(recLev15b->records[0],DATAMAXS,(float)maximum);
-	  statusA[5]= drms_setkey_float(recLev15b->records[0],DATAMEDNS,(float)median);
-	  statusA[6]= drms_setkey_float(recLev15b->records[0],DATAMEANS,(float)mean);
-	  statusA[7]= drms_setkey_float(recLev15b->records[0],DATARMSS,(float)sigma);
-	  statusA[8]= drms_setkey_float(recLev15b->records[0],DATASKEWS,(float)skewness);
-	  statusA[9]= drms_setkey_float(recLev15b->records[0],DATAKURTS,(float)kurtosis);
-	  statusA[10]=drms_setkey_int(recLev15b->records[0],CALFSNS,FSNLOOKUP);
-	  statusA[11]=drms_setkey_string(recLev15b->records[0],LUTQUERYS,HMILookup);
-	  sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
-	  statusA[12]= drms_setkey_string(recLev15b->records[0],DATES,DATEOBS); 
-	  statusA[13]= drms_setkey_int(recLev15b->records[0],QUALITYS,QUALITY); //Quality word    
-   	  statusA[14]= drms_setkey_int(recLev15b->records[0],SATVALSS,SATVALS); //saturated values
-	  statusA[15]= drms_setkey_string(recLev15b->records[0],SOURCES,source); 
-	  statusA[16]= drms_setkey_int(recLev15b->records[0],QUALLEV1S,QUALITYLEV1);
-	  statusA[17]= drms_setkey_string(recLev15b->records[0],COMMENTS,COMMENT);
-	  statusA[18]=0;
-	  if(CALVER64 != -11) statusA[18]= drms_setkey_longlong(recLev15b->records[0],CALVER64S,CALVER64); 
+	  if(Observables & LEV15_MAGNETOGRAM)
+	    {
+	      drms_copykeys(recLev15b->records[0],recLev1p->records[0],1,kDRMS_KeyClass_Explicit);	
+	      MISSVALS[1]+=statsLev15[1].nout;
+	      ngood=statsLev15[1].ngood-statsLev15[1].nout;
+
+
+	      statusA[0]=   drms_setkey_int(recLev15b->records[0],TOTVALSS,ngood+MISSVALS[1]);
+	      statusA[1]=   drms_setkey_int(recLev15b->records[0],DATAVALSS,ngood);
+	      statusA[2]=   drms_setkey_int(recLev15b->records[0],MISSVALSS,MISSVALS[1]);
+	      statusA[3]= drms_setkey_float(recLev15b->records[0],DATAMINS,(float)statsLev15[1].minimum);
+	      statusA[4]= drms_setkey_float(recLev15b->records[0],DATAMAXS,(float)statsLev15[1].maximum);
+	      statusA[5]= drms_setkey_float(recLev15b->records[0],DATAMEDNS,(float)statsLev15[1].median);
+	      statusA[6]= drms_setkey_float(recLev15b->records[0],DATAMEANS,(float)statsLev15[1].mean);
+	      statusA[7]= drms_setkey_float(recLev15b->records[0],DATARMSS,(float)statsLev15[1].sigma);
+	      statusA[8]= drms_setkey_float(recLev15b->records[0],DATASKEWS,(float)statsLev15[1].skewness);
+	      statusA[9]= drms_setkey_float(recLev15b->records[0],DATAKURTS,(float)statsLev15[1].kurtosis);
+	      statusA[10]=drms_setkey_int(recLev15b->records[0],CALFSNS,FSNLOOKUP);
+	      statusA[11]=drms_setkey_string(recLev15b->records[0],LUTQUERYS,HMILookup);
+	      sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
+	      statusA[12]= drms_setkey_string(recLev15b->records[0],DATES,DATEOBS); 
+	      statusA[13]= drms_setkey_int(recLev15b->records[0],QUALITYS,QUALITY); //Quality word    
+	      statusA[14]= drms_setkey_int(recLev15b->records[0],SATVALSS,SATVALS); //saturated values
+	      statusA[15]= drms_setkey_string(recLev15b->records[0],SOURCES,source); 
+	      statusA[16]= drms_setkey_int(recLev15b->records[0],QUALLEV1S,QUALITYLEV1);
+	      statusA[17]= drms_setkey_string(recLev15b->records[0],COMMENTS,COMMENT);
+	      statusA[18]=0;
+	      if(CALVER64 != -11) statusA[18]= drms_setkey_longlong(recLev15b->records[0],CALVER64S,CALVER64); 
 
-	  TotalStatus=0;
-	  for(i=0;i<19;++i) TotalStatus+=statusA[i];
-	  if(TotalStatus != 0)
-	    {
-	      printf("WARNING: could not set some of the keywords modified by the temporal interpolation subroutine for the magnetogram at target time %s\n",timeBegin2);
+	      TotalStatus=0;
+	      for(i=0;i<19;++i) TotalStatus+=statusA[i];
+	      if(TotalStatus != 0)
+		{
+		  printf("WARNING: could not set some of the keywords modified by the temporal interpolation subroutine for the magnetogram at target time %s\n",timeBegin2);
+		}
 	    }
 
 	  //SETTING KEYWORDS FOR LINEDEPTH
 	
-	  drms_copykeys(recLev15c->records[0],recLev1p->records[0],1,kDRMS_KeyClass_Explicit);
-	  //call Keh-Cheng's functions for the statistics (NB: this function avoids NANs, but other than that calculates the different quantities on the ENTIRE image)
-	  status=fstats(axisout[0]*axisout[1],arrLev15[2]->data,&minimum,&maximum,&median,&mean,&sigma,&skewness,&kurtosis,&ngood); //ngood is the number of points that are not NANs
-	  if(status != 0)
-	    {
-	      printf("Error: the statistics function did not run properly at target time %s\n",timeBegin2);
-	    }
-
-	  image=arrLev15[2]->data;
-	  for(i=0;i<axisout[0]*axisout[1];i++) if (image[i] > (32767.*arrLev15[2]->bscale+arrLev15[2]->bzero) || image[i] < (-32768.*arrLev15[2]->bscale+arrLev15[2]->bzero))
-	    {
-	      MISSVALS[2]+=1;
-	      ngood -= 1;
-	    }
-
-
-	  statusA[0]=   drms_setkey_int(recLev15c->records[0],TOTVALSS,ngood+MISSVALS[2]);
-	  statusA[1]=   drms_setkey_int(recLev15c->records[0],DATAVALSS,ngood);
-	  statusA[2]=   drms_setkey_int(recLev15c->records[0],MISSVALSS,MISSVALS[2]);
-	  statusA[3]= drms_setkey_float(recLev15c->records[0],DATAMINS,(float)minimum);
-	  statusA[4]= drms_setkey_float(recLev15c->records[0],DATAMAXS,(float)maximum);
-	  statusA[5]= drms_setkey_float(recLev15c->records[0],DATAMEDNS,(float)median);
-	  statusA[6]= drms_setkey_float(recLev15c->records[0],DATAMEANS,(float)mean);
-	  statusA[7]= drms_setkey_float(recLev15c->records[0],DATARMSS,(float)sigma);
-	  statusA[8]= drms_setkey_float(recLev15c->records[0],DATASKEWS,(float)skewness);
-	  statusA[9]= drms_setkey_float(recLev15c->records[0],DATAKURTS,(float)kurtosis);
-	  statusA[10]=drms_setkey_int(recLev15c->records[0],CALFSNS,FSNLOOKUP);
-	  statusA[11]=drms_setkey_string(recLev15c->records[0],LUTQUERYS,HMILookup);
-	  sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
-	  statusA[12]= drms_setkey_string(recLev15c->records[0],DATES,DATEOBS); 
-	  statusA[13]= drms_setkey_int(recLev15c->records[0],QUALITYS,QUALITY);                //Quality word    
-   	  statusA[14]= drms_setkey_int(recLev15c->records[0],SATVALSS,SATVALS); //saturated values
-	  statusA[15]= drms_setkey_string(recLev15c->records[0],SOURCES,source); 
-	  statusA[16]= drms_setkey_int(recLev15c->records[0],QUALLEV1S,QUALITYLEV1);
-	  statusA[17]= drms_setkey_string(recLev15c->records[0],COMMENTS,COMMENT);
-	  statusA[18]=0;
-	  if(CALVER64 != -11) statusA[18]= drms_setkey_longlong(recLev15c->records[0],CALVER64S,CALVER64); 
+	  if(Observables & LEV15_LINEDEPTH)
+	    {
+	      drms_copykeys(recLev15c->records[0],recLev1p->records[0],1,kDRMS_KeyClass_Explicit);
+	      MISSVALS[2]+=statsLev15[2].nout;
+	      ngood=statsLev15[2].ngood-statsLev15[2].nout;
+
+
+	      statusA[0]=   drms_setkey_int(recLev15c->records[0],TOTVALSS,ngood+MISSVALS[2]);
+	      statusA[1]=   drms_setkey_int(recLev15c->records[0],DATAVALSS,ngood);
+	      statusA[2]=   drms_setkey_int(recLev15c->records[0],MISSVALSS,MISSVALS[2]);
+	      statusA[3]= drms_setkey_float(recLev15c->records[0],DATAMINS,(float)statsLev15[2].minimum);
+	      statusA[4]= drms_setkey_float(recLev15c->records[0],DATAMAXS,(float)statsLev15[2].maximum);
+	      statusA[5]= drms_setkey_float(recLev15c->records[0],DATAMEDNS,(float)statsLev15[2].median);
+	      statusA[6]= drms_setkey_float(recLev15c->records[0],DATAMEANS,(float)statsLev15[2].mean);
+	      statusA[7]= drms_setkey_float(recLev15c->records[0],DATARMSS,(float)statsLev15[2].sigma);
+	      statusA[8]= drms_setkey_float(recLev15c->records[0],DATASKEWS,(float)statsLev15[2].skewness);
+	      statusA[9]= drms_setkey_float(recLev15c->records[0],DATAKURTS,(float)statsLev15[2].kurtosis);
+	      statusA[10]=drms_setkey_int(recLev15c->records[0],CALFSNS,FSNLOOKUP);
+	      statusA[11]=drms_setkey_string(recLev15c->records[0],LUTQUERYS,HMILookup);
+	      sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
+	      statusA[12]= drms_setkey_string(recLev15c->records[0],DATES,DATEOBS); 
+	      statusA[13]= drms_setkey_int(recLev15c->records[0],QUALITYS,QUALITY);                //Quality word    
+	      statusA[14]= drms_setkey_int(recLev15c->records[0],SATVALSS,SATVALS); //saturated values
+	      statusA[15]= drms_setkey_string(recLev15c->records[0],SOURCES,source); 
+	      statusA[16]= drms_setkey_int(recLev15c->records[0],QUALLEV1S,QUALITYLEV1);
+	      statusA[17]= drms_setkey_string(recLev15c->records[0],COMMENTS,COMMENT);
+	      statusA[18]=0;
+	      if(CALVER64 != -11) statusA[18]= drms_setkey_longlong(recLev15c->records[0],CALVER64S,CALVER64); 
 
-	  TotalStatus=0;
-	  for(i=0;i<19;++i) TotalStatus+=statusA[i];
-	  if(TotalStatus != 0)
-	    {
-	      printf("WARNING: could not set some of the keywords modified by the temporal interpolation subroutine for the linedepth at target time %s\n",timeBegin2);
+	      TotalStatus=0;
+	      for(i=0;i<19;++i) TotalStatus+=statusA[i];
+	      if(TotalStatus != 0)
+		{
+		  printf("WARNING: could not set some of the keywords modified by the temporal interpolation subroutine for the linedepth at target time %s\n",timeBegin2);
+		}
 	    }
 
 	  //SETTING KEYWORDS FOR LINEWIDTH
 	
 
-	  drms_copykeys(recLev15d->records[0],recLev1p->records[0],1,kDRMS_KeyClass_Explicit);
-	  //call Keh-Cheng's functions for the statistics (NB: this function avoids NANs, but other than that calculates the different quantities on the ENTIRE image)
-	  status=fstats(axisout[0]*axisout[1],arrLev15[3]->data,&minimum,&maximum,&median,&mean,&sigma,&skewness,&kurtosis,&ngood); //ngood is the number of points that are not NANs
-	  if(status != 0)
-	    {
-	      printf("Error: the statistics function did not run properly at target time %s\n",timeBegin2);
+	  if(Observables & LEV15_LINEWIDTH)
+	    {
+	      drms_copykeys(recLev15d->records[0],recLev1p->records[0],1,kDRMS_KeyClass_Explicit);
+	      MISSVALS[3]+=statsLev15[3].nout;
+	      ngood=statsLev15[3].ngood-statsLev15[3].nout;
+
+
+	      statusA[0]=   drms_setkey_int(recLev15d->records[0],TOTVALSS,ngood+MISSVALS[3]);
+	      statusA[1]=   drms_setkey_int(recLev15d->records[0],DATAVALSS,ngood);
+	      statusA[2]=   drms_setkey_int(recLev15d->records[0],MISSVALSS,MISSVALS[3]);
+	      statusA[3]= drms_setkey_float(recLev15d->records[0],DATAMINS,(float)statsLev15[3].minimum);
+	      statusA[4]= drms_setkey_float(recLev15d->records[0],DATAMAXS,(float)statsLev15[3].maximum);
+	      statusA[5]= drms_setkey_float(recLev15d->records[0],DATAMEDNS,(float)statsLev15[3].median);
+	      statusA[6]= drms_setkey_float(recLev15d->records[0],DATAMEANS,(float)statsLev15[3].mean);
+	      statusA[7]= drms_setkey_float(recLev15d->records[0],DATARMSS,(float)statsLev15[3].sigma);
+	      statusA[8]= drms_setkey_float(recLev15d->records[0],DATASKEWS,(float)statsLev15[3].skewness);
+	      statusA[9]= drms_setkey_float(recLev15d->records[0],DATAKURTS,(float)statsLev15[3].kurtosis);
+	      statusA[10]=drms_setkey_int(recLev15d->records[0],CALFSNS,FSNLOOKUP);
+	      statusA[11]=drms_setkey_string(recLev15d->records[0],LUTQUERYS,HMILookup);
+	      sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
+	      statusA[12]= drms_setkey_string(recLev15d->records[0],DATES,DATEOBS); 
+	      statusA[13]= drms_setkey_int(recLev15d->records[0],QUALITYS,QUALITY);                //Quality word    
+	      statusA[14]= drms_setkey_int(recLev15d->records[0],SATVALSS,SATVALS); //saturated values
+	      statusA[15]= drms_setkey_string(recLev15d->records[0],SOURCES,source); 
+	      statusA[16]= drms_setkey_int(recLev15d->records[0],QUALLEV1S,QUALITYLEV1);
+	      statusA[17]= drms_setkey_string(recLev15d->records[0],COMMENTS,COMMENT);
+	      statusA[18]=0;
+	      if(CALVER64 != -11) statusA[18]= drms_setkey_longlong(recLev15d->records[0],CALVER64S,CALVER64); 
+
+	      TotalStatus=0;
+	      for(i=0;i<19;++i) TotalStatus+=statusA[i];
+	      if(TotalStatus != 0)
+		{
+		  printf("WARNING: could not set some of the keywords modified by the temporal interpolation subroutine for the linewidth at target time %s\n",timeBegin2);
+		}
 	    }
 
+	  //SETTING KEYWORDS FOR CONTINUUM INTENSITY
+	
+	  if(Observables & LEV15_CONTINUUM)
+	    {
+	      drms_copykeys(recLev15e->records[0],recLev1p->records[0],1,kDRMS_KeyClass_Explicit);
+	      MISSVALS[4]+=statsLev15[4].nout;
+	      ngood=statsLev15[4].ngood-statsLev15[4].nout;
+
+
+	      statusA[0]=   drms_setkey_int(recLev15e->records[0],TOTVALSS,ngood+MISSVALS[4]);
+	      statusA[1]=   drms_setkey_int(recLev15e->records[0],DATAVALSS,ngood);
+	      statusA[2]=   drms_setkey_int(recLev15e->records[0],MISSVALSS,MISSVALS[4]);
+	      statusA[3]= drms_setkey_float(recLev15e->records[0],DATAMINS,(float)statsLev15[4].minimum);
+	      statusA[4]= drms_setkey_float(recLev15e->records[0],DATAMAXS,(float)statsLev15[4].maximum);
+	      statusA[5]= drms_setkey_float(recLev15e->records[0],DATAMEDNS,(float)statsLev15[4].median);
+	      statusA[6]= drms_setkey_float(recLev15e->records[0],DATAMEANS,(float)statsLev15[4].mean);
+	      statusA[7]= drms_setkey_float(recLev15e->records[0],DATARMSS,(float)statsLev15[4].sigma);
+	      statusA[8]= drms_setkey_float(recLev15e->records[0],DATASKEWS,(float)statsLev15[4].skewness);
+	      statusA[9]= drms_setkey_float(recLev15e->records[0],DATAKURTS,(float)statsLev15[4].kurtosis);
+	      statusA[10]=drms_setkey_int(recLev15e->records[0],CALFSNS,FSNLOOKUP);
+	      statusA[11]=drms_setkey_string(recLev15e->records[0],LUTQUERYS,HMILookup);
+	      sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
+	      statusA[12]= drms_setkey_string(recLev15e->records[0],DATES,DATEOBS); 
+	      statusA[13]= drms_setkey_int(recLev15e->records[0],QUALITYS,QUALITY);                //Quality word    
+	      statusA[14]= drms_setkey_int(recLev15e->records[0],SATVALSS,SATVALS); //saturated values
+	      statusA[15]= drms_setkey_string(recLev15e->records[0],SOURCES,source); 
+	      statusA[16]= drms_setkey_int(recLev15e->records[0],QUALLEV1S,QUALITYLEV1);
+	      statusA[17]= drms_setkey_string(recLev15e->records[0],COMMENTS,COMMENT);
+	      statusA[18]=0;
+	      if(CALVER64 != -11) statusA[18]= drms_setkey_longlong(recLev15e->records[0],CALVER64S,CALVER64); 
 
-	  image=arrLev15[3]->data;
-	  for(i=0;i<axisout[0]*axisout[1];i++) if (image[i] > (32767.*arrLev15[3]->bscale+arrLev15[3]->bzero) || image[i] < (-32768.*arrLev15[3]->bscale+arrLev15[3]->bzero))
-	    {
-	      MISSVALS[3]+=1;
-	      ngood -= 1;
+	      TotalStatus=0;
+	      for(i=0;i<19;++i) TotalStatus+=statusA[i];
+	      if(TotalStatus != 0)
+		{
+		  printf("WARNING: could not set some of the keywords modified by the temporal interpolation subroutine for the continuum intensity at target time %s\n",timeBegin2);
+		}
 	    }
 
+	  //SETTING EXTRA STATISTICS KEYWORDS (WITHIN 99% OF RSUN)
 
-	  statusA[0]=   drms_setkey_int(recLev15d->records[0],TOTVALSS,ngood+MISSVALS[3]);
-	  statusA[1]=   drms_setkey_int(recLev15d->records[0],DATAVALSS,ngood);
-	  statusA[2]=   drms_setkey_int(recLev15d->records[0],MISSVALSS,MISSVALS[3]);
-	  statusA[3]= drms_setkey_float(recLev15d->records[0],DATAMINS,(float)minimum);
-	  statusA[4]= drms_setkey_float(recLev15d->records[0],DATAMAXS,(float)maximum);
-	  statusA[5]= drms_setkey_float(recLev15d->records[0],DATAMEDNS,(float)median);
-	  statusA[6]= drms_setkey_float(recLev15d->records[0],DATAMEANS,(float)mean);
-	  statusA[7]= drms_setkey_float(recLev15d->records[0],DATARMSS,(float)sigma);
-	  statusA[8]= drms_setkey_float(recLev15d->records[0],DATASKEWS,(float)skewness);
-	  statusA[9]= drms_setkey_float(recLev15d->records[0],DATAKURTS,(float)kurtosis);
-	  statusA[10]=drms_setkey_int(recLev15d->records[0],CALFSNS,FSNLOOKUP);
-	  statusA[11]=drms_setkey_string(recLev15d->records[0],LUTQUERYS,HMILookup);
-	  sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
-	  statusA[12]= drms_setkey_string(recLev15d->records[0],DATES,DATEOBS); 
-	  statusA[13]= drms_setkey_int(recLev15d->records[0],QUALITYS,QUALITY);                //Quality word    
-   	  statusA[14]= drms_setkey_int(recLev15d->records[0],SATVALSS,SATVALS); //saturated values
-	  statusA[15]= drms_setkey_string(recLev15d->records[0],SOURCES,source); 
-	  statusA[16]= drms_setkey_int(recLev15d->records[0],QUALLEV1S,QUALITYLEV1);
-	  statusA[17]= drms_setkey_string(recLev15d->records[0],COMMENTS,COMMENT);
-	  statusA[18]=0;
-	  if(CALVER64 != -11) statusA[18]= drms_setkey_longlong(recLev15d->records[0],CALVER64S,CALVER64); 
-
-	  TotalStatus=0;
-	  for(i=0;i<19;++i) TotalStatus+=statusA[i];
-	  if(TotalStatus != 0)
+	  for(i=0;i<40;++i) statusA[i]=0; //the keywords of the observables not selected are not set
+	  if(Observables & LEV15_DOPPLERGRAM)
 	    {
-	      printf("WARNING: could not set some of the keywords modified by the temporal interpolation subroutine for the linewidth at target time %s\n",timeBegin2);
+	      statusA[0]= drms_setkey_float(recLev15a->records[0],DATAMINS2,(float)statsLev15R[0].minimum);
+	      statusA[1]= drms_setkey_float(recLev15a->records[0],DATAMAXS2,(float)statsLev15R[0].maximum);
+	      statusA[2]= drms_setkey_float(recLev15a->records[0],DATAMEDNS2,(float)statsLev15R[0].median);
+	      statusA[3]= drms_setkey_float(recLev15a->records[0],DATAMEANS2,(float)statsLev15R[0].mean);
+	      statusA[4]= drms_setkey_float(recLev15a->records[0],DATARMSS2,(float)statsLev15R[0].sigma);
+	      statusA[5]= drms_setkey_float(recLev15a->records[0],DATASKEWS2,(float)statsLev15R[0].skewness);
+	      statusA[6]= drms_setkey_float(recLev15a->records[0],DATAKURTS2,(float)statsLev15R[0].kurtosis);
 	    }
-
-	  //SETTING KEYWORDS FOR CONTINUUM INTENSITY
-	
-	  drms_copykeys(recLev15e->records[0],recLev1p->records[0],1,kDRMS_KeyClass_Explicit);
-	  //call Keh-Cheng's functions for the statistics (NB: this function avoids NANs, but other than that calculates the different quantities on the ENTIRE image)
-	  status=fstats(axisout[0]*axisout[1],arrLev15[4]->data,&minimum,&maximum,&median,&mean,&sigma,&skewness,&kurtosis,&ngood); //ngood is the number of points that are not NANs
-	  if(status != 0)
+	  if(Observables & LEV15_MAGNETOGRAM)
 	    {
-	      printf("Error: the statistics function did not run properly at target time %s\n",timeBegin2);
+	      statusA[7]= drms_setkey_float(recLev15b->records[0],DATAMINS2,(float)statsLev15R[1].minimum);
+	      statusA[8]= drms_setkey_float(recLev15b->records[0],DATAMAXS2,(float)statsLev15R[1].maximum);
+	      statusA[9]= drms_setkey_float(recLev15b->records[0],DATAMEDNS2,(float)statsLev15R[1].median);
+	      statusA[10]= drms_setkey_float(recLev15b->records[0],DATAMEANS2,(float)statsLev15R[1].mean);
+	      statusA[11]= drms_setkey_float(recLev15b->records[0],DATARMSS2,(float)statsLev15R[1].sigma);
+	      statusA[12]= drms_setkey_float(recLev15b->records[0],DATASKEWS2,(float)statsLev15R[1].skewness);
+	      statusA[13]= drms_setkey_float(recLev15b->records[0],DATAKURTS2,(float)statsLev15R[1].kurtosis);
 	    }
-
-	  image=arrLev15[4]->data;
-	  for(i=0;i<axisout[0]*axisout[1];i++) if (image[i] > (32767.*arrLev15[4]->bscale+arrLev15[4]->bzero) || image[i] < (-32768.*arrLev15[4]->bscale+arrLev15[4]->bzero))
+	  if(Observables & LEV15_LINEDEPTH)
 	    {
-	      MISSVALS[4]+=1;
-	      ngood -= 1;
+	      statusA[14]= drms_setkey_float(recLev15c->records[0],DATAMINS2,(float)statsLev15R[2].minimum);
+	      statusA[15]= drms_setkey_float(recLev15c->records[0],DATAMAXS2,(float)statsLev15R[2].maximum);
+	      statusA[16]= drms_setkey_float(recLev15c->records[0],DATAMEDNS2,(float)statsLev15R[2].median);
+	      statusA[17]= drms_setkey_float(recLev15c->records[0],DATAMEANS2,(float)statsLev15R[2].mean);
+	      statusA[18]= drms_setkey_float(recLev15c->records[0],DATARMSS2,(float)statsLev15R[2].sigma);
+	      statusA[19]= drms_setkey_float(recLev15c->records[0],DATASKEWS2,(float)statsLev15R[2].skewness);
+	      statusA[20]= drms_setkey_float(recLev15c->records[0],DATAKURTS2,(float)statsLev15R[2].kurtosis);
 	    }
-
-
-	  statusA[0]=   drms_setkey_int(recLev15e->records[0],TOTVALSS,ngood+MISSVALS[4]);
-	  statusA[1]=   drms_setkey_int(recLev15e->records[0],DATAVALSS,ngood);
-	  statusA[2]=   drms_setkey_int(recLev15e->records[0],MISSVALSS,MISSVALS[4]);
-	  statusA[3]= drms_setkey_float(recLev15e->records[0],DATAMINS,(float)minimum);
-	  statusA[4]= drms_setkey_float(recLev15e->records[0],DATAMAXS,(float)maximum);
-	  statusA[5]= drms_setkey_float(recLev15e->records[0],DATAMEDNS,(float)median);
-	  statusA[6]= drms_setkey_float(recLev15e->records[0],DATAMEANS,(float)mean);
-	  statusA[7]= drms_setkey_float(recLev15e->records[0],DATARMSS,(float)sigma);
-	  statusA[8]= drms_setkey_float(recLev15e->records[0],DATASKEWS,(float)skewness);
-	  statusA[9]= drms_setkey_float(recLev15e->records[0],DATAKURTS,(float)kurtosis);
-	  statusA[10]=drms_setkey_int(recLev15e->records[0],CALFSNS,FSNLOOKUP);
-	  statusA[11]=drms_setkey_string(recLev15e->records[0],LUTQUERYS,HMILookup);
-	  sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
-	  statusA[12]= drms_setkey_string(recLev15e->records[0],DATES,DATEOBS); 
-	  statusA[13]= drms_setkey_int(recLev15e->records[0],QUALITYS,QUALITY);                //Quality word    
-   	  statusA[14]= drms_setkey_int(recLev15e->records[0],SATVALSS,SATVALS); //saturated values
-	  statusA[15]= drms_setkey_string(recLev15e->records[0],SOURCES,source); 
-	  statusA[16]= drms_setkey_int(recLev15e->records[0],QUALLEV1S,QUALITYLEV1);
-	  statusA[17]= drms_setkey_string(recLev15e->records[0],COMMENTS,COMMENT);
-	  statusA[18]=0;
-	  if(CALVER64 != -11) statusA[18]= drms_setkey_longlong(recLev15e->records[0],CALVER64S,CALVER64); 
-
-	  TotalStatus=0;
-	  for(i=0;i<19;++i) TotalStatus+=statusA[i];
-	  if(TotalStatus != 0)
+	  if(Observables & LEV15_LINEWIDTH)
 	    {
-	      printf("WARNING: could not set some of the keywords modified by the temporal interpolation subroutine for the continuum intensity at target time %s\n",timeBegin2);
+	      statusA[21]= drms_setkey_float(recLev15d->records[0],DATAMINS2,(float)statsLev15R[3].minimum);
+	      statusA[22]= drms_setkey_float(recLev15d->records[0],DATAMAXS2,(float)statsLev15R[3].maximum);
+	      statusA[23]= drms_setkey_float(recLev15d->records[0],DATAMEDNS2,(float)statsLev15R[3].median);
+	      statusA[24]= drms_setkey_float(recLev15d->records[0],DATAMEANS2,(float)statsLev15R[3].mean);
+	      statusA[25]= drms_setkey_float(recLev15d->records[0],DATARMSS2,(float)statsLev15R[3].sigma);
+	      statusA[26]= drms_setkey_float(recLev15d->records[0],DATASKEWS2,(float)statsLev15R[3].skewness);
+	      statusA[27]= drms_setkey_float(recLev15d->records[0],DATAKURTS2,(float)statsLev15R[3].kurtosis);
 	    }
-
-	  //CALCULATION OF STATISTICS KEYWORDS WITHIN 99% OF RSUN
-	  image0=(float *)arrLev15[0]->data;
-	  image1=(float *)arrLev15[1]->data;
-	  image2=(float *)arrLev15[2]->data;
-	  image3=(float *)arrLev15[3]->data;
-	  image4=(float *)arrLev15[4]->data;
-	  	  
-	  for(i=0;i<axisout[0]*axisout[1];++i)
+	  if(Observables & LEV15_CONTINUUM)
 	    {
-	      row   =i / axisout[0];
-	      column=i % axisout[0];
-	      distance = sqrt(((float)row-Y0AVG)*((float)row-Y0AVG)+((float)column-X0AVG)*((float)column-X0AVG)); //distance in pixels
-	      if(distance > 0.99*RSUNint)
-		{
-		  image0[i]=NAN;
-		  image1[i]=NAN;
-		  image2[i]=NAN;
-		  image3[i]=NAN;
-		  image4[i]=NAN;
-		}
+	      statusA[28]= drms_setkey_float(recLev15e->records[0],DATAMINS2,(float)statsLev15R[4].minimum);
+	      statusA[29]= drms_setkey_float(recLev15e->records[0],DATAMAXS2,(float)statsLev15R[4].maximum);
+	      statusA[30]= drms_setkey_float(recLev15e->records[0],DATAMEDNS2,(float)statsLev15R[4].median);
+	      statusA[31]= drms_setkey_float(recLev15e->records[0],DATAMEANS2,(float)statsLev15R[4].mean);
+	      statusA[32]= drms_setkey_float(recLev15e->records[0],DATARMSS2,(float)statsLev15R[4].sigma);
+	      statusA[33]= drms_setkey_float(recLev15e->records[0],DATASKEWS2,(float)statsLev15R[4].skewness);
+	      statusA[34]= drms_setkey_float(recLev15e->records[0],DATAKURTS2,(float)statsLev15R[4].kurtosis);
 	    }
-	  
-	  //SETTING EXTRA STATISTICS KEYWORDS
 
-	  //call Keh-Cheng's functions for the statistics (NB: this function avoids NANs, but other than that calculates the different quantities on the ENTIRE image)
-	  status=fstats(axisout[0]*axisout[1],arrLev15[0]->data,&minimum,&maximum,&median,&mean,&sigma,&skewness,&kurtosis,&ngood); //ngood is the number of points that are not NANs
-	  if(status != 0) printf("Error: the statistics function did not run properly at target time %s\n",timeBegin2);
-	  statusA[0]= drms_setkey_float(recLev15a->records[0],DATAMINS2,(float)minimum);
-	  statusA[1]= drms_setkey_float(recLev15a->records[0],DATAMAXS2,(float)maximum);
-	  statusA[2]= drms_setkey_float(recLev15a->records[0],DATAMEDNS2,(float)median);
-	  statusA[3]= drms_setkey_float(recLev15a->records[0],DATAMEANS2,(float)mean);
-	  statusA[4]= drms_setkey_float(recLev15a->records[0],DATARMSS2,(float)sigma);
-	  statusA[5]= drms_setkey_float(recLev15a->records[0],DATASKEWS2,(float)skewness);
-	  statusA[6]= drms_setkey_float(recLev15a->records[0],DATAKURTS2,(float)kurtosis);
-	  status=fstats(axisout[0]*axisout[1],arrLev15[1]->data,&minimum,&maximum,&median,&mean,&sigma,&skewness,&kurtosis,&ngood); //ngood is the number of points that are not NANs
-	  if(status != 0) printf("Error: the statistics function did not run properly at target time %s\n",timeBegin2);
-	  statusA[7]= drms_setkey_float(recLev15b->records[0],DATAMINS2,(float)minimum);
-	  statusA[8]= drms_setkey_float(recLev15b->records[0],DATAMAXS2,(float)maximum);
-	  statusA[9]= drms_setkey_float(recLev15b->records[0],DATAMEDNS2,(float)median);
-	  statusA[10]= drms_setkey_float(recLev15b->records[0],DATAMEANS2,(float)mean);
-	  statusA[11]= drms_setkey_float(recLev15b->records[0],DATARMSS2,(float)sigma);
-	  statusA[12]= drms_setkey_float(recLev15b->records[0],DATASKEWS2,(float)skewness);
-	  statusA[13]= drms_setkey_float(recLev15b->records[0],DATAKURTS2,(float)kurtosis);
-	  status=fstats(axisout[0]*axisout[1],arrLev15[2]->data,&minimum,&maximum,&median,&mean,&sigma,&skewness,&kurtosis,&ngood); //ngood is the number of points that are not NANs
-	  if(status != 0) printf("Error: the statistics function did not run properly at target time %s\n",timeBegin2);
-	  statusA[14]= drms_setkey_float(recLev15c->records[0],DATAMINS2,(float)minimum);
-	  statusA[15]= drms_setkey_float(recLev15c->records[0],DATAMAXS2,(float)maximum);
-	  statusA[16]= drms_setkey_float(recLev15c->records[0],DATAMEDNS2,(float)median);
-	  statusA[17]= drms_setkey_float(recLev15c->records[0],DATAMEANS2,(float)mean);
-	  statusA[18]= drms_setkey_float(recLev15c->records[0],DATARMSS2,(float)sigma);
-	  statusA[19]= drms_setkey_float(recLev15c->records[0],DATASKEWS2,(float)skewness);
-	  statusA[20]= drms_setkey_float(recLev15c->records[0],DATAKURTS2,(float)kurtosis);
-	  status=fstats(axisout[0]*axisout[1],arrLev15[3]->data,&minimum,&maximum,&median,&mean,&sigma,&skewness,&kurtosis,&ngood); //ngood is the number of points that are not NANs
-	  if(status != 0) printf("Error: the statistics function did not run properly at target time %s\n",timeBegin2);
-	  statusA[21]= drms_setkey_float(recLev15d->records[0],DATAMINS2,(float)minimum);
-	  statusA[22]= drms_setkey_float(recLev15d->records[0],DATAMAXS2,(float)maximum);
-	  statusA[23]= drms_setkey_float(recLev15d->records[0],DATAMEDNS2,(float)median);
-	  statusA[24]= drms_setkey_float(recLev15d->records[0],DATAMEANS2,(float)mean);
-	  statusA[25]= drms_setkey_float(recLev15d->records[0],DATARMSS2,(float)sigma);
-	  statusA[26]= drms_setkey_float(recLev15d->records[0],DATASKEWS2,(float)skewness);
-	  statusA[27]= drms_setkey_float(recLev15d->records[0],DATAKURTS2,(float)kurtosis);
-	  status=fstats(axisout[0]*axisout[1],arrLev15[4]->data,&minimum,&maximum,&median,&mean,&sigma,&skewness,&kurtosis,&ngood); //ngood is the number of points that are not NANs
-	  if(status != 0) printf("Error: the statistics function did not run properly at target time %s\n",timeBegin2);
-	  statusA[28]= drms_setkey_float(recLev15e->records[0],DATAMINS2,(float)minimum);
-	  statusA[29]= drms_setkey_float(recLev15e->records[0],DATAMAXS2,(float)maximum);
-	  statusA[30]= drms_setkey_float(recLev15e->records[0],DATAMEDNS2,(float)median);
-	  statusA[31]= drms_setkey_float(recLev15e->records[0],DATAMEANS2,(float)mean);
-	  statusA[32]= drms_setkey_float(recLev15e->records[0],DATARMSS2,(float)sigma);
-	  statusA[33]= drms_setkey_float(recLev15e->records[0],DATASKEWS2,(float)skewness);
-	  statusA[34]= drms_setkey_float(recLev15e->records[0],DATAKURTS2,(float)kurtosis);
-
-	  statusA[35]= drms_setkey_string(recLev15a->records[0],HISTORYS,HISTORY);
-	  statusA[36]= drms_setkey_string(recLev15b->records[0],HISTORYS,HISTORY);
-	  statusA[37]= drms_setkey_string(recLev15c->records[0],HISTORYS,HISTORY);
-	  statusA[38]= drms_setkey_string(recLev15d->records[0],HISTORYS,HISTORY);
-	  statusA[39]= drms_setkey_string(recLev15e->records[0],HISTORYS,HISTORY);
+	  if(recLev15a != NULL) statusA[35]= drms_setkey_string(recLev15a->records[0],HISTORYS,HISTORY);
+	  if(recLev15b != NULL) statusA[36]= drms_setkey_string(recLev15b->records[0],HISTORYS,HISTORY);
+	  if(recLev15c != NULL) statusA[37]= drms_setkey_string(recLev15c->records[0],HISTORYS,HISTORY);
+	  if(recLev15d != NULL) statusA[38]= drms_setkey_string(recLev15d->records[0],HISTORYS,HISTORY);
+	  if(recLev15e != NULL) statusA[39]= drms_setkey_string(recLev15e->records[0],HISTORYS,HISTORY);
 
 	  TotalStatus=0;
 	  for(i=0;i<35;++i) TotalStatus+=statusA[i];
@@ -6422,6 +6524,23 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	  t1=dsecnd();
 	  printf("TIME ELAPSED TO SET LEV 1.5 KEYWORDS AND CALCULATE STATISTICS KEYWORDS: %f\n",t1-t0);
 
+	  //WRITING DATA SEGMENTS: THE ARRAYS ARE HANDED OVER TO THE WRITER THREAD, WHICH WRITES THEM WHILE THE NEXT TARGET TIME IS PROCESSED
+	  //(ALL THE KEYWORDS OF THE LEVEL 1.5 RECORDS ARE SET: THE MAIN THREAD DOES NOT TOUCH THESE RECORDS ANYMORE UNTIL THEY ARE INSERTED BY Lev15WriterCommit())
+	  t0=dsecnd();
+	  status=0;
+	  if(Observables & LEV15_DOPPLERGRAM) status+=Lev15WriterQueue(&Writer,drms_segment_lookupnum(recLev15a->records[0],0),arrLev15[0]);
+	  if(Observables & LEV15_MAGNETOGRAM) status+=Lev15WriterQueue(&Writer,drms_segment_lookupnum(recLev15b->records[0],0),arrLev15[1]);
+	  if(Observables & LEV15_LINEDEPTH)   status+=Lev15WriterQueue(&Writer,drms_segment_lookupnum(recLev15c->records[0],0),arrLev15[2]);
+	  if(Observables & LEV15_LINEWIDTH)   status+=Lev15WriterQueue(&Writer,drms_segment_lookupnum(recLev15d->records[0],0),arrLev15[3]);
+	  if(Observables & LEV15_CONTINUUM)   status+=Lev15WriterQueue(&Writer,drms_segment_lookupnum(recLev15e->records[0],0),arrLev15[4]);
+	  for(i=0;i<5;++i) arrLev15[i]=NULL;                                //the arrays now belong to the writer (the raw Dopplergram, i=5, is not written)
+	  if(status != 0)
+	    {
+	      printf("Error: a call to drms_segment_write failed\n");
+	      return 1;
+	    }
+	  printf("TIME ELAPSED TO QUEUE THE LEVEL 1.5 SEGMENTS: %f\n",dsecnd()-t0);
+
 	}//end of producing the level 1.5 data
       
       
@@ -6506,49 +6625,28 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
       if(Lev15Wanted)
 	{
 
-	  if(arrintable != NULL)
-	    {
-	      drms_free_array(arrintable);
-	    }
-	  arrintable=NULL;
-	  if(lookup != NULL) status=drms_close_records(lookup,DRMS_FREE_RECORD);
-	  lookup = NULL;
+	  //the look-up tables (arrintable, arrinverse, lookup) and the keywords of the look-up table and polynomial coefficient series are kept for the next target time
 	  if(recpoly != NULL) status=drms_close_records(recpoly,DRMS_FREE_RECORD);
 	  recpoly= NULL;
 	  if(recpoly2 != NULL) status=drms_close_records(recpoly2,DRMS_FREE_RECORD);
 	  recpoly2= NULL;
-	  if(arrayL0 != NULL)
-	    {
-	      drms_free_array(arrayL0);
-	      arrayL0=NULL;
-	    }
-	  if(arrayL1 != NULL)
-	    {
-	      drms_free_array(arrayL1);
-	      arrayL1=NULL;
-	    }
-	  if(arrayL2 != NULL)
-	    {
-	      drms_free_array(arrayL2);
-	      arrayL2=NULL;
-	    }
 	  if(count != NULL)
 	    {
 	      free(count);
 	      count=NULL;
 	    }
 
-	  if(recLev15a != NULL)
+	  if(recLev15a != NULL || recLev15b != NULL || recLev15c != NULL || recLev15d != NULL || recLev15e != NULL) //only the records of the selected observables were created
 	    {
-	      printf("recLev15a != NULL\n");
+	      printf("recLev15 != NULL\n");
 	      if(CreateEmptyRecord != 1)
 		{
 		  printf("Inserting record for the observables\n");
-		  status=drms_close_records(recLev15a,DRMS_INSERT_RECORD);
-		  status=drms_close_records(recLev15b,DRMS_INSERT_RECORD);
-		  status=drms_close_records(recLev15c,DRMS_INSERT_RECORD);
-		  status=drms_close_records(recLev15d,DRMS_INSERT_RECORD);
-		  status=drms_close_records(recLev15e,DRMS_INSERT_RECORD);
+		  if(recLev15a != NULL) Lev15WriterClose(&Writer,recLev15a);
+		  if(recLev15b != NULL) Lev15WriterClose(&Writer,recLev15b);
+		  if(recLev15c != NULL) Lev15WriterClose(&Writer,recLev15c);
+		  if(recLev15d != NULL) Lev15WriterClose(&Writer,recLev15d);
+		  if(recLev15e != NULL) Lev15WriterClose(&Writer,recLev15e);
 		  recLev15a=NULL;
 		  recLev15b=NULL;
 		  recLev15c=NULL;
@@ -6563,121 +6661,154 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 		  if(CamId  == LIGHT_FRONT) camera=2; //front camera
 
 		  QUALITY= QUALITY | QUAL_NODATA;
+		  if(recLev15a != NULL)
+		    {
+		      statusA[0] = drms_setkey_time(recLev15a->records[0],TRECS,TargetTime);               //TREC is the slot time
+		      //statusA[1] = drms_setkey_time(recLev15a->records[0],TOBSS,tobs);               //TOBS is the observation time
+		      statusA[2] = drms_setkey_int(recLev15a->records[0],CAMERAS,camera);            
+		      statusA[3] = drms_setkey_int(recLev15a->records[0],QUALITYS,QUALITY); 
+		      sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
+		      statusA[4]= drms_setkey_string(recLev15a->records[0],DATES,DATEOBS); 
+		    }
+
+		  if(recLev15b != NULL)
+		    {
+		      statusA[0] = drms_setkey_time(recLev15b->records[0],TRECS,TargetTime);               //TREC is the slot time
+		      //statusA[1] = drms_setkey_time(recLev15b->records[0],TOBSS,tobs);               //TOBS is the observation time
+		      statusA[2] = drms_setkey_int(recLev15b->records[0],CAMERAS,camera);            
+		      statusA[3] = drms_setkey_int(recLev15b->records[0],QUALITYS,QUALITY); 
+		      sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
+		      statusA[4]= drms_setkey_string(recLev15b->records[0],DATES,DATEOBS); 
+		    }
+
+		  if(recLev15c != NULL)
+		    {
+		      statusA[0] = drms_setkey_time(recLev15c->records[0],TRECS,TargetTime);               //TREC is the slot time
+		      //statusA[1] = drms_setkey_time(recLev15c->records[0],TOBSS,tobs);               //TOBS is the observation time
+		      statusA[2] = drms_setkey_int(recLev15c->records[0],CAMERAS,camera);            
+		      statusA[3] = drms_setkey_int(recLev15c->records[0],QUALITYS,QUALITY); 
+		      sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
+		      statusA[4]= drms_setkey_string(recLev15c->records[0],DATES,DATEOBS); 
+		    }
+
+		  if(recLev15d != NULL)
+		    {
+		      statusA[0] = drms_setkey_time(recLev15d->records[0],TRECS,TargetTime);               //TREC is the slot time
+		      //statusA[1] = drms_setkey_time(recLev15d->records[0],TOBSS,tobs);               //TOBS is the observation time
+		      statusA[2] = drms_setkey_int(recLev15d->records[0],CAMERAS,camera);            
+		      statusA[3] = drms_setkey_int(recLev15d->records[0],QUALITYS,QUALITY); 
+		      sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
+		      statusA[4]= drms_setkey_string(recLev15d->records[0],DATES,DATEOBS); 
+		    }
+
+		  if(recLev15e != NULL)
+		    {
+		      statusA[0] = drms_setkey_time(recLev15e->records[0],TRECS,TargetTime);               //TREC is the slot time
+		      //statusA[1] = drms_setkey_time(recLev15e->records[0],TOBSS,tobs);               //TOBS is the observation time
+		      statusA[2] = drms_setkey_int(recLev15e->records[0],CAMERAS,camera);            
+		      statusA[3] = drms_setkey_int(recLev15e->records[0],QUALITYS,QUALITY); 
+		      sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
+		      statusA[4]= drms_setkey_string(recLev15e->records[0],DATES,DATEOBS); 
+		    }
+
+
+		  if(recLev15a != NULL) Lev15WriterClose(&Writer,recLev15a);
+		  if(recLev15b != NULL) Lev15WriterClose(&Writer,recLev15b);
+		  if(recLev15c != NULL) Lev15WriterClose(&Writer,recLev15c);
+		  if(recLev15d != NULL) Lev15WriterClose(&Writer,recLev15d);
+		  if(recLev15e != NULL) Lev15WriterClose(&Writer,recLev15e);
+		  recLev15a=NULL;
+		  recLev15b=NULL;
+		  recLev15c=NULL;
+		  recLev15d=NULL;
+		  recLev15e=NULL;
+		}
+	      for (i=0;i<nRecs15;++i) if(arrLev15[i] != NULL)
+		{
+		  drms_free_array(arrLev15[i]);
+		  arrLev15[i]=NULL;
+		}
+	      if(arrLev15 != NULL) free(arrLev15);
+	      arrLev15=NULL;
+	    }
+	  else //no level 1.5 record was created
+	    {
+
+	      if(Observables & LEV15_DOPPLERGRAM) recLev15a = drms_create_records(drms_env,1,HMISeriesLev15a,DRMS_PERMANENT,&statusA[0]); //RECORD FOR DOPPLERGRAM
+	      if(Observables & LEV15_MAGNETOGRAM) recLev15b = drms_create_records(drms_env,1,HMISeriesLev15b,DRMS_PERMANENT,&statusA[1]); //RECORD FOR MAGNETOGRAM
+	      if(Observables & LEV15_LINEDEPTH)   recLev15c = drms_create_records(drms_env,1,HMISeriesLev15c,DRMS_PERMANENT,&statusA[2]); //RECORD FOR LINEDEPTH
+	      if(Observables & LEV15_LINEWIDTH)   recLev15d = drms_create_records(drms_env,1,HMISeriesLev15d,DRMS_PERMANENT,&statusA[3]); //RECORD FOR LINEWIDTH
+	      if(Observables & LEV15_CONTINUUM)   recLev15e = drms_create_records(drms_env,1,HMISeriesLev15e,DRMS_PERMANENT,&statusA[4]); //RECORD FOR CONTINUUM
+	      
+	      if(CamId  == LIGHT_SIDE && camera != 3)  camera=1; //side camera to accommodate FTS=58312
+	      if(CamId  == LIGHT_FRONT) camera=2; //front camera
+
+	      printf("Warning: creating empty lev1.5 record\n");
+	      QUALITY= QUALITY | QUAL_NODATA;    
+	      if(recLev15a != NULL)
+		{
 		  statusA[0] = drms_setkey_time(recLev15a->records[0],TRECS,TargetTime);               //TREC is the slot time
 		  //statusA[1] = drms_setkey_time(recLev15a->records[0],TOBSS,tobs);               //TOBS is the observation time
 		  statusA[2] = drms_setkey_int(recLev15a->records[0],CAMERAS,camera);            
 		  statusA[3] = drms_setkey_int(recLev15a->records[0],QUALITYS,QUALITY); 
 		  sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
 		  statusA[4]= drms_setkey_string(recLev15a->records[0],DATES,DATEOBS); 
+		}
 
+	      if(recLev15b != NULL)
+		{
 		  statusA[0] = drms_setkey_time(recLev15b->records[0],TRECS,TargetTime);               //TREC is the slot time
 		  //statusA[1] = drms_setkey_time(recLev15b->records[0],TOBSS,tobs);               //TOBS is the observation time
 		  statusA[2] = drms_setkey_int(recLev15b->records[0],CAMERAS,camera);            
 		  statusA[3] = drms_setkey_int(recLev15b->records[0],QUALITYS,QUALITY); 
 		  sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
 		  statusA[4]= drms_setkey_string(recLev15b->records[0],DATES,DATEOBS); 
+		}
 
+	      if(recLev15c != NULL)
+		{
 		  statusA[0] = drms_setkey_time(recLev15c->records[0],TRECS,TargetTime);               //TREC is the slot time
 		  //statusA[1] = drms_setkey_time(recLev15c->records[0],TOBSS,tobs);               //TOBS is the observation time
 		  statusA[2] = drms_setkey_int(recLev15c->records[0],CAMERAS,camera);            
 		  statusA[3] = drms_setkey_int(recLev15c->records[0],QUALITYS,QUALITY); 
 		  sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
 		  statusA[4]= drms_setkey_string(recLev15c->records[0],DATES,DATEOBS); 
+		}
 
+	      if(recLev15d != NULL)
+		{
 		  statusA[0] = drms_setkey_time(recLev15d->records[0],TRECS,TargetTime);               //TREC is the slot time
 		  //statusA[1] = drms_setkey_time(recLev15d->records[0],TOBSS,tobs);               //TOBS is the observation time
 		  statusA[2] = drms_setkey_int(recLev15d->records[0],CAMERAS,camera);            
 		  statusA[3] = drms_setkey_int(recLev15d->records[0],QUALITYS,QUALITY); 
 		  sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
 		  statusA[4]= drms_setkey_string(recLev15d->records[0],DATES,DATEOBS); 
+		}
 
+	      if(recLev15e != NULL)
+		{
 		  statusA[0] = drms_setkey_time(recLev15e->records[0],TRECS,TargetTime);               //TREC is the slot time
 		  //statusA[1] = drms_setkey_time(recLev15e->records[0],TOBSS,tobs);               //TOBS is the observation time
 		  statusA[2] = drms_setkey_int(recLev15e->records[0],CAMERAS,camera);            
 		  statusA[3] = drms_setkey_int(recLev15e->records[0],QUALITYS,QUALITY); 
 		  sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
 		  statusA[4]= drms_setkey_string(recLev15e->records[0],DATES,DATEOBS); 
-
-
-		  status=drms_close_records(recLev15a,DRMS_INSERT_RECORD);
-		  status=drms_close_records(recLev15b,DRMS_INSERT_RECORD);
-		  status=drms_close_records(recLev15c,DRMS_INSERT_RECORD);
-		  status=drms_close_records(recLev15d,DRMS_INSERT_RECORD);
-		  status=drms_close_records(recLev15e,DRMS_INSERT_RECORD);
-		  recLev15a=NULL;
-		  recLev15b=NULL;
-		  recLev15c=NULL;
-		  recLev15d=NULL;
-		  recLev15e=NULL;
-		}
-	      for (i=0;i<nRecs15;++i) if(arrLev15[i] != NULL)
-		{
-		  drms_free_array(arrLev15[i]);
-		  arrLev15[i]=NULL;
 		}
-	      if(arrLev15 != NULL) free(arrLev15);
-	      arrLev15=NULL;
-	    }
-	  else //recLev15a == NULL
-	    {
-
-	      recLev15a = drms_create_records(drms_env,1,HMISeriesLev15a,DRMS_PERMANENT,&statusA[0]); //RECORD FOR DOPPLERGRAM
-	      recLev15b = drms_create_records(drms_env,1,HMISeriesLev15b,DRMS_PERMANENT,&statusA[1]); //RECORD FOR MAGNETOGRAM
-	      recLev15c = drms_create_records(drms_env,1,HMISeriesLev15c,DRMS_PERMANENT,&statusA[2]); //RECORD FOR LINEDEPTH
-	      recLev15d = drms_create_records(drms_env,1,HMISeriesLev15d,DRMS_PERMANENT,&statusA[3]); //RECORD FOR LINEWIDTH
-	      recLev15e = drms_create_records(drms_env,1,HMISeriesLev15e,DRMS_PERMANENT,&statusA[4]); //RECORD FOR CONTINUUM
-	      
-	      if(CamId  == LIGHT_SIDE && camera != 3)  camera=1; //side camera to accommodate FTS=58312
-	      if(CamId  == LIGHT_FRONT) camera=2; //front camera
-
-	      printf("Warning: creating empty lev1.5 record\n");
-	      QUALITY= QUALITY | QUAL_NODATA;    
-	      statusA[0] = drms_setkey_time(recLev15a->records[0],TRECS,TargetTime);               //TREC is the slot time
-	      //statusA[1] = drms_setkey_time(recLev15a->records[0],TOBSS,tobs);               //TOBS is the observation time
-	      statusA[2] = drms_setkey_int(recLev15a->records[0],CAMERAS,camera);            
-	      statusA[3] = drms_setkey_int(recLev15a->records[0],QUALITYS,QUALITY); 
-	      sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
-	      statusA[4]= drms_setkey_string(recLev15a->records[0],DATES,DATEOBS); 
-
-	      statusA[0] = drms_setkey_time(recLev15b->records[0],TRECS,TargetTime);               //TREC is the slot time
-	      //statusA[1] = drms_setkey_time(recLev15b->records[0],TOBSS,tobs);               //TOBS is the observation time
-	      statusA[2] = drms_setkey_int(recLev15b->records[0],CAMERAS,camera);            
-	      statusA[3] = drms_setkey_int(recLev15b->records[0],QUALITYS,QUALITY); 
-	      sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
-	      statusA[4]= drms_setkey_string(recLev15b->records[0],DATES,DATEOBS); 
-
-	      statusA[0] = drms_setkey_time(recLev15c->records[0],TRECS,TargetTime);               //TREC is the slot time
-	      //statusA[1] = drms_setkey_time(recLev15c->records[0],TOBSS,tobs);               //TOBS is the observation time
-	      statusA[2] = drms_setkey_int(recLev15c->records[0],CAMERAS,camera);            
-	      statusA[3] = drms_setkey_int(recLev15c->records[0],QUALITYS,QUALITY); 
-	      sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
-	      statusA[4]= drms_setkey_string(recLev15c->records[0],DATES,DATEOBS); 
-
-	      statusA[0] = drms_setkey_time(recLev15d->records[0],TRECS,TargetTime);               //TREC is the slot time
-	      //statusA[1] = drms_setkey_time(recLev15d->records[0],TOBSS,tobs);               //TOBS is the observation time
-	      statusA[2] = drms_setkey_int(recLev15d->records[0],CAMERAS,camera);            
-	      statusA[3] = drms_setkey_int(recLev15d->records[0],QUALITYS,QUALITY); 
-	      sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
-	      statusA[4]= drms_setkey_string(recLev15d->records[0],DATES,DATEOBS); 
-
-	      statusA[0] = drms_setkey_time(recLev15e->records[0],TRECS,TargetTime);               //TREC is the slot time
-	      //statusA[1] = drms_setkey_time(recLev15e->records[0],TOBSS,tobs);               //TOBS is the observation time
-	      statusA[2] = drms_setkey_int(recLev15e->records[0],CAMERAS,camera);            
-	      statusA[3] = drms_setkey_int(recLev15e->records[0],QUALITYS,QUALITY); 
-	      sprint_time(DATEOBS,CURRENT_SYSTEM_TIME,"UTC",1);
-	      statusA[4]= drms_setkey_string(recLev15e->records[0],DATES,DATEOBS); 
 	      
-	      status=drms_close_records(recLev15a,DRMS_INSERT_RECORD);
-	      status=drms_close_records(recLev15b,DRMS_INSERT_RECORD);
-	      status=drms_close_records(recLev15c,DRMS_INSERT_RECORD);
-	      status=drms_close_records(recLev15d,DRMS_INSERT_RECORD);
-	      status=drms_close_records(recLev15e,DRMS_INSERT_RECORD);
+	      if(recLev15a != NULL) Lev15WriterClose(&Writer,recLev15a);
+	      if(recLev15b != NULL) Lev15WriterClose(&Writer,recLev15b);
+	      if(recLev15c != NULL) Lev15WriterClose(&Writer,recLev15c);
+	      if(recLev15d != NULL) Lev15WriterClose(&Writer,recLev15d);
+	      if(recLev15e != NULL) Lev15WriterClose(&Writer,recLev15e);
 	      recLev15a=NULL;
 	      recLev15b=NULL;
 	      recLev15c=NULL;
 	      recLev15d=NULL;
 	      recLev15e=NULL;           
 	    }
+
+	  //the records whose segments have been written by the writer thread are inserted, in the order of the target times
+	  if(Lev15WriterCommit(&Writer,0) != 0) return 1;
 		 
 	  QUALITY=0;
 	  CreateEmptyRecord=0;
@@ -6685,15 +6816,18 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
      
       PreviousTargetTime=TargetTime;
       TargetTime+=DataCadence;  //this way I avoid taking as the next TargetFID the filtergram just next to the current TargetFID (because LCP and RCP are grouped together) 
-      initialrun=0;
-    }//end while(TargetTime <= TimeEnd)
+
+    }//end while(TargetTime <= PageEnd)
 
 
   if (TestLevIn[0]==1) //input data are level 1 filtergrams
     {
       printf("FREEING GENERAL ARRAYS\n");
-      if(recLev1->n > 0)
+      if(recLev1 != NULL)                                                //NULL if the page had no level 1 records
 	{
+	  Lev1PrefetchStop(&Prefetch);                                       //before closing the records whose segments the prefetch thread reads
+	  free(PrefetchList);
+	  if(Gapfill.Mask != NULL) free(Gapfill.Mask);
 	  status=drms_close_records(recLev1,DRMS_FREE_RECORD);  
 	  recLev1=NULL;
 	  free(internTOBS);
@@ -6715,17 +6849,9 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	  free(DSUNOBS);
 	  free(X0);
 	  free(Y0);
-	  free(SegmentRead);
 	  free(KeywordMissing);
-	  free(Segments);
-	  //free the pzt and rotational flat fields of the target filtergram, if needed
-	  if(inRotationalFlat == 1)
-	    {
-	      drms_free_array(flatfield);
-	      drms_free_array(flatfieldrot);
-	      status=drms_close_records(recflatrot,DRMS_FREE_RECORD);
-	    }
-	  free(Ierror);  
+	  FrameCacheReport(&Frames);
+	  FrameCacheFree(&Frames);                                           //frees the filtergrams still in memory
 	  free(IndexFiltergram);
 	  free(FSN);
 	  free(CFINDEX);
@@ -6744,9 +6870,83 @@ char Lev1pSegName[60][5]={"I0","Q0","U0","V0","I1","Q1","U1","V1","I2","Q2","U2"
 	}
     }
 
+  if(Lev15WriterCommit(&Writer,1) != 0) return 1;                   //the level 1.5 segments of the page are written and their records inserted
+
+  if(Follow > 0)                                                     //nrt mode: the level 1.5 records of the page are committed now, not at the end of the run
+    {
+      //new look-up table and polynomial coefficient records may arrive during the run: the keywords of these series and the look-up
+      //tables cached across target times are read again at the next page, and the look-up table record is not kept open across the transactions
+      if(arrintable != NULL) drms_free_array(arrintable);
+      arrintable=NULL;
+      if(arrinverse != NULL) drms_free_array(arrinverse);
+      arrinverse=NULL;
+      if(lookup != NULL) status=drms_close_records(lookup,DRMS_FREE_RECORD);
+      lookup=NULL;
+      if(arrayLK0 != NULL) drms_free_array(arrayLK0);
+      if(arrayLK1 != NULL) drms_free_array(arrayLK1);
+      if(arrayL0  != NULL) drms_free_array(arrayL0);
+      if(arrayL1  != NULL) drms_free_array(arrayL1);
+      if(arrayL2  != NULL) drms_free_array(arrayL2);
+      arrayLK0=NULL;
+      arrayLK1=NULL;
+      arrayL0=NULL;
+      arrayL1=NULL;
+      arrayL2=NULL;
+      for(i=0;i<7;++i) lookupkey[i]=-1;
+      coeffkey[0]=-1;
+
+      drms_server_end_transaction(drms_env,0,0);
+      drms_server_begin_transaction(drms_env);
+      sprint_time(timeBegin2,PreviousTargetTime,"TAI",0);
+      printf("NRT MODE: RECORDS COMMITTED UP TO THE TARGET TIME %s\n",timeBegin2);
+    }
+
+  if(TargetTime <= TimeEnd || (Follow > 0 && TargetTime <= FollowEnd)) //next page of target times
+    {
+      PageBegin=TargetTime;
+      goto NextPage;
+    }
+
+  if(TestLevIn[0] == 1 && PagesLev1 == 0)                            //no page of the run had level 1 records
+    {
+      printf("Error: no level 1 records in the time interval requested %s[%s-%s]\n",HMISeriesLev10,timeBegin,timeEnd);
+      Lev15WriterStop(&Writer);
+      return 1;//exit(EXIT_FAILURE);
+    }
+
+  if(TestLevIn[0]==1)
+    {
+      CropMaskFree();                                                //frees the crop masks
+      FramelistCacheFree();                                          //frees the framelists decoded by framelistInfo()
+    }
+  FlatFieldCacheReport(&Flats);
+  FlatFieldCacheFree(&Flats);                                        //frees the pzt and rotational flat fields
+  if(Lev15WriterStop(&Writer) != 0) return 1;                        //stops the writer thread (all the segments are already written)
+
+  //release the look-up tables and keywords cached across target times
+  if(arrintable != NULL) drms_free_array(arrintable);
+  arrintable=NULL;
+  if(arrinverse != NULL) drms_free_array(arrinverse);
+  arrinverse=NULL;
+  if(lookup != NULL) status=drms_close_records(lookup,DRMS_FREE_RECORD);
+  lookup=NULL;
+  if(arrayLK0 != NULL) drms_free_array(arrayLK0);
+  if(arrayLK1 != NULL) drms_free_array(arrayLK1);
+  if(arrayL0  != NULL) drms_free_array(arrayL0);
+  if(arrayL1  != NULL) drms_free_array(arrayL1);
+  if(arrayL2  != NULL) drms_free_array(arrayL2);
+  arrayLK0=NULL;
+  arrayLK1=NULL;
+  arrayL0=NULL;
+  arrayL1=NULL;
+  arrayL2=NULL;
+
   if(TestLevIn[0]==1)
     {
       free_interpol(&const_param);
+      if(const_paramPrefetchInit == 1) free_interpol(&const_paramPrefetch);
+      for(i=0;i<nconst_paramSlots;++i) free_interpol(&const_paramSlots[i]);
+      if(const_paramSlots != NULL) free(const_paramSlots);
     }
 
   if(Lev1pWanted || (Lev15Wanted && TestLevIn[2]==0))
@@ -12,6 +12,7 @@
 #include <math.h>
 #include <HMIparam.h>           //contains definitions for some HMI filter parameters
 #include <mkl.h>
+#include "keyvector.h"   //keywords of the input records read in one query
 
 char *module_name    = "correction_velocities";   //name of the module
 #define kRecSetIn      "begin"        //beginning time for which an output is wanted. MANDATORY PARAMETER.
@@ -74,6 +75,10 @@ void lininterp1f(double *yinterp, double *xv, double *yv, double *x, double ydef
 } 
 
 
+//keywords of the input records read in one query (keyvector.c), in the order of VKeyNames[] in DoIt()
+enum vkey {V_TREC,V_OBSVR,V_RAWMEDN,V_QUALITY,V_CALFSN,V_CROTA2,V_MISSVAL,NVKEYS};
+
+
 /*------------------------------------------------------------------------------------------------------*/
 /*                                                                                                      */
 /*  MAIN PROGRAM                                                                                        */
@@ -115,6 +120,7 @@ int DoIt(void) {
   char *NDATAS   = "NDATA";
   char *CROTA2S  = "CROTA2";
   char *MISSVALS = "MISSVALS";
+  const char *VKeyNames[NVKEYS]={TRECS,OBSVRS,RAWMEDNS,QUALITYS,CALFSNS,CROTA2S,MISSVALS};
 
   double *RAWMEDN=NULL;
   double *OBSVR=NULL;
@@ -133,6 +139,7 @@ int DoIt(void) {
   int error=0,status=0;
 
   DRMS_RecordSet_t *recLev1  = NULL;   
+  struct keyvector VKeys;                //keywords of the input records
 
   TIME TREC;
 
@@ -191,20 +198,22 @@ int DoIt(void) {
       return 1;//exit(EXIT_FAILURE);
     }
 
+  KeyVectorRead(drms_env,HMISeriesLev1,recLev1,NVKEYS,VKeyNames,&VKeys); //T_REC identifies the records
+
   nsample=nRecs1;
   j=0;
   for(i=0;i<nRecs1;++i)
     {
-      OBSVR[j]  = drms_getkey_double(recLev1->records[i],OBSVRS,  &status);
-      RAWMEDN[j]= drms_getkey_double(recLev1->records[i],RAWMEDNS,&status);
-      QUALITY[j]= drms_getkey_int(recLev1->records[i],QUALITYS,&status);
+      OBSVR[j]  = KeyVectorDouble(&VKeys,V_OBSVR,recLev1,i,&status);
+      RAWMEDN[j]= KeyVectorDouble(&VKeys,V_RAWMEDN,recLev1,i,&status);
+      QUALITY[j]= KeyVectorInt(&VKeys,V_QUALITY,recLev1,i,&status);
       //NB: THE POLYNOMIAL FIT IS RAWMEDN-OBS_VR AS A FUNCTION OF RAWMEDN, NOT OBS_VR
       temp      = RAWMEDN[j];
       RAWMEDN[j]= RAWMEDN[j]-OBSVR[j]; //we want to fit the difference RAWMEDN-OBSVR as a function of RAWMEDN
       OBSVR[j]  = temp/6500.;          //to make the polynomial fit better; DESPITE THE NAME, OBSVR IS ACTUALLY RAWMEDN
-      CALFSN[j] = drms_getkey_int(recLev1->records[i],CALFSNS,&status);
-      CROTA2[j] = drms_getkey_float(recLev1->records[i],CROTA2S,&status);
-      MISSVAL[j]= drms_getkey_int(recLev1->records[i],MISSVALS,&status);
+      CALFSN[j] = KeyVectorInt(&VKeys,V_CALFSN,recLev1,i,&status);
+      CROTA2[j] = KeyVectorFloat(&VKeys,V_CROTA2,recLev1,i,&status);
+      MISSVAL[j]= KeyVectorInt(&VKeys,V_MISSVAL,recLev1,i,&status);
 
       if(isnan(RAWMEDN[j]) || isnan(OBSVR[j]) || (QUALITY[j] & QUAL_ISSTARGET) == QUAL_ISSTARGET || fabs(RAWMEDN[j]-OBSVR[j]) > 1000. || (QUALITY[j] & QUAL_ECLIPSE) == QUAL_ECLIPSE || fabs(CROTA2[j]-180.) > 5.0 || MISSVAL[j] > 10000) 
 	{
@@ -239,6 +248,7 @@ int DoIt(void) {
 
       j++;
     } //UM, what happen if the last record is a NAN?
+  KeyVectorFree(&VKeys);
 
 
   printf("NUMBER OF DATA REJECTED: %d %d\n",nRecs1-nsample,nsample);
@@ -0,0 +1,287 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Crop masks of the HMI level 1 filtergrams (see cropmask.h)                              */
+/* from the MaskCreation() function of Richard, modified by Sebastien                      */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "cropmask.h"
+
+#define minval(x,y) (((x) < (y)) ? (x) : (y))
+
+#define CROPMASK_MAXTAB  256           //maximum number of image configurations
+#define CROPMASK_MAXROW  (4*2048)      //maximum number of rows in the crop table
+
+struct cropmask {
+  int            HIMGCFID;
+  int            nx,ny;
+  unsigned char *mask;
+};
+
+static pthread_mutex_t CropMaskMutex=PTHREAD_MUTEX_INITIALIZER;
+
+//image configurations (from CROPMASK_CONFIG), parsed once
+static int ConfigRead=0;
+static int nConfig=0;
+static int ConfigId[CROPMASK_MAXTAB+1],ConfigTab[CROPMASK_MAXTAB],ConfigMode[CROPMASK_MAXTAB],ConfigRows[CROPMASK_MAXTAB],ConfigCols[CROPMASK_MAXTAB];
+
+//crop table (from CROPMASK_TABLE), parsed once
+static int TableRead=0;
+static int TableSkip[CROPMASK_MAXROW],TableTake[CROPMASK_MAXROW];
+
+//crop masks already built
+static int nMasks=0;
+static struct cropmask Masks[CROPMASK_MAXTAB];
+
+
+//reads the image configuration file
+static void CropMaskReadConfig(void)
+{
+  FILE *config_file=NULL;
+  char string[256];
+  int  datum;
+
+  ConfigRead=1;
+  nConfig=0;
+  config_file=fopen(CROPMASK_CONFIG,"r");
+  if(config_file == NULL)
+    {
+      printf("Error: the image configuration file %s could not be opened\n",CROPMASK_CONFIG);
+      return;
+    }
+
+  fgets(string, 256, config_file);
+  fgets(string, 256, config_file);
+  fgets(string, 256, config_file);
+
+  fscanf(config_file, "%d", &datum);
+  ConfigId[nConfig]=datum;
+
+  do {
+    fscanf(config_file, "%s", string);
+
+    ConfigMode[nConfig]=0; //default change
+    if (string[0] == '4')ConfigMode[nConfig]=0;
+    if (string[0] == '2') if (string[7] == 'E')ConfigMode[nConfig]=1;
+    if (string[0] == '2') if (string[7] == 'F')ConfigMode[nConfig]=2;
+    if (string[0] == '2') if (string[7] == 'G')ConfigMode[nConfig]=3;
+    if (string[0] == '2') if (string[7] == 'H')ConfigMode[nConfig]=4;
+    if (string[0] == '1') if (string[7] == 'E')ConfigMode[nConfig]=5;
+    if (string[0] == '1') if (string[7] == 'F')ConfigMode[nConfig]=6;
+    if (string[0] == '1') if (string[7] == 'G')ConfigMode[nConfig]=7;
+    if (string[0] == '1') if (string[7] == 'H')ConfigMode[nConfig]=8;
+
+    fscanf(config_file, "%s", string);
+    fscanf(config_file, "%s", string);
+    fscanf(config_file, "%s", string);
+    if (string[0] == 'N') ConfigTab[nConfig]=-1;
+    if (string[0] == 'c') ConfigTab[nConfig]=0;
+
+    fscanf(config_file, "%s", string);
+    fscanf(config_file, "%d", &datum);
+    fscanf(config_file, "%d", &datum);
+    fscanf(config_file, "%s", string);
+
+    fscanf(config_file, "%d", &datum);
+    ConfigRows[nConfig]=datum;
+    fscanf(config_file, "%d", &datum);
+    ConfigCols[nConfig]=datum;
+    fscanf(config_file, "%d", &datum);                                      //row start
+    fscanf(config_file, "%d", &datum);                                      //column start
+    fscanf(config_file, "%d", &datum);
+    fscanf(config_file, "%d", &datum);
+
+    ++nConfig;
+    fscanf(config_file, "%d", &datum);
+    ConfigId[nConfig]=datum;
+  }
+  while (!feof(config_file) && nConfig < CROPMASK_MAXTAB);
+
+  fclose(config_file);
+}
+
+
+//reads the crop table
+//returns 1 if it cannot be read
+static int CropMaskReadTable(void)
+{
+  FILE *crop_table=NULL;
+  int  datum,nqq,j;
+
+  crop_table=fopen(CROPMASK_TABLE,"r");
+  if(crop_table == NULL)
+    {
+      printf("Error: the crop table %s could not be opened\n",CROPMASK_TABLE);
+      return 1;
+    }
+
+  fscanf(crop_table, "%d", &datum); //read header
+  fscanf(crop_table, "%d", &datum);
+  fscanf(crop_table, "%d", &nqq);
+  if(nqq > CROPMASK_MAXROW) nqq=CROPMASK_MAXROW;
+  for (j=0; j<nqq; ++j)
+    {
+      fscanf(crop_table, "%d", &TableSkip[j]);
+      fscanf(crop_table, "%d", &TableTake[j]);
+    }
+  fclose(crop_table);
+  TableRead=1;
+
+  return 0;
+}
+
+
+//builds the crop mask of the image configuration idn (index in the configuration file)
+//returns NULL if the memory cannot be allocated or the crop table cannot be read
+static unsigned char *CropMaskBuild(int idn,int nx,int ny)
+{
+  int x_orig,y_orig,x_dir,y_dir;
+  int skip_x,skip_y,nss,nlin,nq,nsy;
+  int i,j,k,ix,jx;
+  int *skipt=TableSkip,*taket=TableTake;
+  int *kkx=NULL;
+  unsigned char *Mask=NULL;
+
+  //define different readout modes
+  static int kx0[11]={4,0,0,1,0,1,1,0,1,1,1}; //EFGH
+  static int kx1[7]={2,1,0,1,1,1,2}; //FG
+  static int kx2[7]={2,0,1,0,0,1,2} ;//HE
+  static int kx3[7]={2,0,0,1,0,2,1}; //EF
+  static int kx4[7]={2,1,1,0,1,2,1}; //GH
+  static int kx5[7]={1,0,0,2,2}; //E
+  static int kx6[5]={1,1,0,2,2}; //F
+  static int kx7[5]={1,1,1,2,2}; //G
+  static int kx8[5]={1,0,1,2,2}; //H
+  static int *kx[9]={kx0,kx3,kx1,kx4,kx2,kx5,kx6,kx7,kx8};
+
+  skip_x=ConfigCols[idn]/2;
+  skip_y=ConfigRows[idn]/2;
+
+  kkx=kx[ConfigMode[idn]];
+  nq=kkx[0];
+  nlin=kkx[2*nq+3-2]*ny/2;
+  nss=kkx[2*nq+3-1]*nx/2;
+
+  if (ConfigTab[idn] != -1)
+    {
+      if(!TableRead && CropMaskReadTable() != 0) return NULL;
+    }
+  else
+    {
+      printf("no crop table\n");
+      skipt=(int *)malloc(CROPMASK_MAXROW*sizeof(int));
+      taket=(int *)malloc(CROPMASK_MAXROW*sizeof(int));
+      if(skipt == NULL || taket == NULL)
+	{
+	  printf("Error: memory could not be allocated to the crop table\n");
+	  free(skipt);
+	  free(taket);
+	  return NULL;
+	}
+      for (k=0; k<nq; ++k)
+	for (j=0; j<nlin; ++j)
+	  {
+	    skipt[k*nss+j]=0;
+	    taket[k*nss+j]=nss;
+	  }
+    }
+
+  Mask=(unsigned char *)malloc(nx*ny*sizeof(unsigned char));
+  if(Mask == NULL) printf("Error: memory could not be allocated to the crop mask\n");
+  else
+    {
+      memset(Mask,2,nx*ny);
+
+      nsy=nlin-skip_y;
+
+      for (k=0; k<nq; ++k)
+	{
+	  x_orig=kkx[k*2+1]*nx - kkx[k*2+1];
+	  y_orig=kkx[k*2+2]*ny - kkx[k*2+2];
+	  x_dir=-(kkx[k*2+1])*2+1;
+	  y_dir=-(kkx[k*2+2])*2+1;
+
+	  for (j=0; j<skip_y; ++j) for (i=0; i<nss; ++i) Mask[(y_orig+y_dir*j)*nx+x_orig+x_dir*i]=2;   //fill edge rows with NAN
+	  for (j=0; j<nlin; ++j) for (i=0; i<skip_x; ++i) Mask[(y_orig+y_dir*j)*nx+x_orig+x_dir*i]=2;  //fill edge columns with NAN
+
+	  for (j=0; j<nsy; ++j)
+	    {
+	      jx=j+skip_y;
+
+	      for (i=0; i<minval(skipt[k*nss+j],nss); ++i){ix=i+skip_x; Mask[(y_orig+y_dir*jx)*nx+x_orig+x_dir*ix]=2;} //pixel OUTSIDE THE CROP TABLE: missing but does not need to be filled
+	      for (i=skipt[k*nss+j]; i<minval(skipt[k*nss+j]+taket[k*nss+j],nss); ++i){ix=i+skip_x; Mask[(y_orig+y_dir*jx)*nx+x_orig+x_dir*ix]=0;} //pixel INSIDE THE CROP TABLE not missing and does not need to be filled
+	      for (i=(skipt[k*nss+j]+taket[k*nss+j]); i<nss; ++i){ix=i+skip_x; Mask[(y_orig+y_dir*jx)*nx+x_orig+x_dir*ix]=2;}
+	    }
+	}
+    }
+
+  if(skipt != TableSkip)
+    {
+      free(skipt);
+      free(taket);
+    }
+
+  return Mask;
+}
+
+
+//provides in *mask the crop mask (nx x ny, 0 inside the crop area and 2 outside) of the image configuration HIMGCFID
+//returns 0 if successful, 1 if the mask could not be built, 2 if HIMGCFID is not a valid image configuration
+int CropMask(int HIMGCFID,int nx,int ny,const unsigned char **mask)
+{
+  int i,idn=-1,status=0;
+
+  *mask=NULL;
+  pthread_mutex_lock(&CropMaskMutex);
+
+  for(i=0;i<nMasks;++i) if(Masks[i].HIMGCFID == HIMGCFID && Masks[i].nx == nx && Masks[i].ny == ny)
+    {
+      *mask=Masks[i].mask;
+      break;
+    }
+
+  if(*mask == NULL)
+    {
+      if(!ConfigRead) CropMaskReadConfig();
+      for(i=0;i<nConfig;++i) if(ConfigId[i] == HIMGCFID) idn=i;
+      if(idn == -1)
+	{
+	  printf("Error: invalid HIMGCFID\n");
+	  status=2;
+	}
+      else if(nMasks == CROPMASK_MAXTAB) status=1;
+      else
+	{
+	  Masks[nMasks].mask=CropMaskBuild(idn,nx,ny);
+	  if(Masks[nMasks].mask == NULL) status=1;
+	  else
+	    {
+	      Masks[nMasks].HIMGCFID=HIMGCFID;
+	      Masks[nMasks].nx=nx;
+	      Masks[nMasks].ny=ny;
+	      *mask=Masks[nMasks].mask;
+	      nMasks+=1;
+	    }
+	}
+    }
+
+  pthread_mutex_unlock(&CropMaskMutex);
+
+  return status;
+}
+
+
+//frees the crop masks
+void CropMaskFree(void)
+{
+  int i;
+
+  pthread_mutex_lock(&CropMaskMutex);
+  for(i=0;i<nMasks;++i) free(Masks[i].mask);
+  nMasks=0;
+  pthread_mutex_unlock(&CropMaskMutex);
+}
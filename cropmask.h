@@ -0,0 +1,25 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Crop masks of the HMI level 1 filtergrams, used by MaskCreation() in HMI_observables.c, */
+/* HMI_IQUV_averaging.c, undistort_lev1.c, and phasemaps_test_voigt.c                      */
+/*                                                                                         */
+/* the image configuration file (img_cnfg_ids) and the crop table are parsed only once per */
+/* process, and the crop mask of an image configuration (HIMGCFID) is built the first time */
+/* it is needed: 0 inside the crop area, 2 outside (pixel missing and does not need to be  */
+/* filled). MaskCreation() then copies this mask and marks the NANs of the image, the bad  */
+/* pixels, and the cosmic-ray hits                                                         */
+/*                                                                                         */
+/* CropMask() can be called by several threads at once                                     */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#ifndef CROPMASK_H
+#define CROPMASK_H
+
+#define CROPMASK_CONFIG "/home/production/img_cnfg_ids"                //image configuration ID file
+#define CROPMASK_TABLE  "/home/cvsuser/cvsroot/EGSE/tables/crop/crop6" //crop table
+
+int  CropMask(int HIMGCFID,int nx,int ny,const unsigned char **mask);
+void CropMaskFree(void);
+
+#endif
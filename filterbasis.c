@@ -0,0 +1,97 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Trig-free synthesis of the HMI filter transmission profiles (see filterbasis.h)         */
+/* the inner loops are written so that the compiler vectorizes them (omp simd):            */
+/* compile with AVX2 (-mavx2 -mfma) or AVX-512 (-xCORE-AVX512) to get packed FMAs          */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "filterbasis.h"
+
+
+//computes the cos/sin basis for the wavelength grid lam[nlam]
+//returns 0 if successful, 1 otherwise
+int filterbasis_init(struct filterbasis *basis,double *lam,int nlam,double *FSR)
+{
+  int element,j;
+  double omega;
+
+  basis->nlam=nlam;
+  for(element=0;element<NBASIS;++element)
+    {
+      basis->cosb[element]=(double *)malloc(nlam*sizeof(double));
+      basis->sinb[element]=(double *)malloc(nlam*sizeof(double));
+      if(basis->cosb[element] == NULL || basis->sinb[element] == NULL)
+	{
+	  printf("Error: unable to allocate memory to the filter basis\n");
+	  return 1;
+	}
+      omega=2.0*M_PI/FSR[element];
+      for(j=0;j<nlam;++j)
+	{
+	  basis->cosb[element][j]=cos(omega*lam[j]);
+	  basis->sinb[element][j]=sin(omega*lam[j]);
+	}
+    }
+
+  return 0;
+}
+
+
+void filterbasis_free(struct filterbasis *basis)
+{
+  int element;
+
+  for(element=0;element<NBASIS;++element)
+    {
+      free(basis->cosb[element]);
+      free(basis->sinb[element]);
+      basis->cosb[element]=NULL;
+      basis->sinb[element]=NULL;
+    }
+}
+
+
+//non-tunable profile: lyot[j]=blocker[j]*product over E2,E3,E4,E5 of (1+contrast*cos(2 pi/FSR*lam[j]+phase))/2
+//contrast[4] and phase[4] are in the order E2, E3, E4, E5
+void filterbasis_lyot(struct filterbasis *basis,double *blocker,double *contrast,double *phase,double *lyot)
+{
+  int j;
+  int nlam=basis->nlam;
+  double c2=0.5*contrast[0]*cos(phase[0]),s2=-0.5*contrast[0]*sin(phase[0]);
+  double c3=0.5*contrast[1]*cos(phase[1]),s3=-0.5*contrast[1]*sin(phase[1]);
+  double c4=0.5*contrast[2]*cos(phase[2]),s4=-0.5*contrast[2]*sin(phase[2]);
+  double c5=0.5*contrast[3]*cos(phase[3]),s5=-0.5*contrast[3]*sin(phase[3]);
+  double * restrict C2=basis->cosb[3], * restrict S2=basis->sinb[3];
+  double * restrict C3=basis->cosb[4], * restrict S3=basis->sinb[4];
+  double * restrict C4=basis->cosb[5], * restrict S4=basis->sinb[5];
+  double * restrict C5=basis->cosb[6], * restrict S5=basis->sinb[6];
+  double * restrict B =blocker;
+  double * restrict out=lyot;
+
+#pragma omp simd
+  for(j=0;j<nlam;++j) out[j]=B[j]*(0.5+c2*C2[j]+s2*S2[j])*(0.5+c3*C3[j]+s3*S3[j])*(0.5+c4*C4[j]+s4*S4[j])*(0.5+c5*C5[j]+s5*S5[j]);
+}
+
+
+//tunable profile: filter[j]=scale*lyot[j]*product over NB,WB,E1 of (1+contrast*cos(2 pi/FSR*lam[j]+phase))/2
+//contrast[3] and phase[3] are in the order NB, WB, E1 (phase includes the tuning phase of the HCM)
+void filterbasis_tunable(struct filterbasis *basis,double *lyot,double *contrast,double *phase,double scale,double *filter)
+{
+  int j;
+  int nlam=basis->nlam;
+  double cNB=0.5*contrast[0]*cos(phase[0]),sNB=-0.5*contrast[0]*sin(phase[0]);
+  double cWB=0.5*contrast[1]*cos(phase[1]),sWB=-0.5*contrast[1]*sin(phase[1]);
+  double cE1=0.5*contrast[2]*cos(phase[2]),sE1=-0.5*contrast[2]*sin(phase[2]);
+  double * restrict CNB=basis->cosb[0], * restrict SNB=basis->sinb[0];
+  double * restrict CWB=basis->cosb[1], * restrict SWB=basis->sinb[1];
+  double * restrict CE1=basis->cosb[2], * restrict SE1=basis->sinb[2];
+  double * restrict L  =lyot;
+  double * restrict out=filter;
+
+#pragma omp simd
+  for(j=0;j<nlam;++j) out[j]=scale*L[j]*(0.5+cNB*CNB[j]+sNB*SNB[j])*(0.5+cWB*CWB[j]+sWB*SWB[j])*(0.5+cE1*CE1[j]+sE1*SE1[j]);
+}
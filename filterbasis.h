@@ -0,0 +1,33 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Trig-free synthesis of the HMI filter transmission profiles                            */
+/* used by lookup.c and lookup_Iripple.c                                                   */
+/*                                                                                         */
+/* the transmission of an element with free spectral range FSR, contrast K and phase phi  */
+/* is (1+K*cos(2 pi/FSR*lam+phi))/2. With the angle-addition formula this becomes:         */
+/* 0.5 + 0.5*K*cos(phi)*cos(2 pi/FSR*lam) - 0.5*K*sin(phi)*sin(2 pi/FSR*lam)               */
+/* the cos/sin of 2 pi/FSR*lam only depend on the wavelength grid, and are computed once   */
+/* per run, so that the profiles at each pixel are obtained with multiply-adds only        */
+/*                                                                                         */
+/* ELEMENT INDICES ARE THOSE OF FSR[] IN HMIparam.h:                                       */
+/* 0=NB Michelson, 1=WB Michelson, 2=E1, 3=E2, 4=E3, 5=E4, 6=E5                            */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#ifndef FILTERBASIS_H
+#define FILTERBASIS_H
+
+#define NBASIS 7                       //number of filter elements (3 tunable + 4 non-tunable)
+
+struct filterbasis {
+  int nlam;                            //number of wavelength points
+  double *cosb[NBASIS];                //cos(2 pi/FSR[element]*lam[j])
+  double *sinb[NBASIS];                //sin(2 pi/FSR[element]*lam[j])
+};
+
+int  filterbasis_init(struct filterbasis *basis,double *lam,int nlam,double *FSR);
+void filterbasis_free(struct filterbasis *basis);
+void filterbasis_lyot(struct filterbasis *basis,double *blocker,double *contrast,double *phase,double *lyot);
+void filterbasis_tunable(struct filterbasis *basis,double *lyot,double *contrast,double *phase,double scale,double *filter);
+
+#endif
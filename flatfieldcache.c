@@ -0,0 +1,162 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Pzt and rotational flat fields kept in memory (see flatfieldcache.h)                    */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "flatfieldcache.h"
+#include "segmentio.h"
+
+void FlatFieldCacheCreate(struct flatfieldcache *cache,const char *series)
+{
+  memset(cache,0,sizeof(struct flatfieldcache));
+  strncpy(cache->series,series,255);
+}
+
+
+//returns the flat field of query if it is in memory (and marks it as used), NULL otherwise
+static float *FlatFieldFind(struct flatfieldcache *cache,const char *query)
+{
+  int i;
+
+  cache->clock+=1;
+  for(i=0;i<cache->nflats;++i) if(!strcmp(cache->flats[i].query,query))
+    {
+      cache->flats[i].lastuse=cache->clock;
+      cache->hits+=1;
+      return cache->flats[i].flat->data;
+    }
+
+  return NULL;
+}
+
+
+//reads the segment "flatfield" of the record query, and keeps it in memory (instead of the least recently used flat field if the cache is full)
+//returns NULL if the record or its segment cannot be read
+static float *FlatFieldRead(struct flatfieldcache *cache,DRMS_Env_t *env,const char *query,int camera,TIME tstart,TIME tstop)
+{
+  DRMS_RecordSet_t *recflat=NULL;
+  DRMS_Segment_t   *segin=NULL;
+  DRMS_Array_t     *flatfield=NULL;
+  int i,j,status;
+
+  recflat = drms_open_records(env,query,&status);
+  if (status != DRMS_SUCCESS || recflat == NULL || recflat->n == 0)
+    {
+      printf("Error: record missing or corrupt for the flat field query %s\n",query);
+      if(recflat != NULL) drms_close_records(recflat,DRMS_FREE_RECORD);
+      return NULL;
+    }
+  segin     = drms_segment_lookup(recflat->records[0],"flatfield");
+  flatfield = SegmentRead(segin,DRMS_TYPE_FLOAT,&status);
+  drms_close_records(recflat,DRMS_FREE_RECORD);
+  if (status != DRMS_SUCCESS || flatfield == NULL)
+    {
+      printf("Error: could not read the data segment for the flat field query %s\n",query);
+      if(flatfield != NULL) drms_free_array(flatfield);
+      return NULL;
+    }
+  printf("FLAT FIELD READ: %s\n",query);
+
+  if(cache->nflats < FLATFIELD_MAXFLATS) j=cache->nflats++;
+  else
+    {
+      j=0;
+      for(i=1;i<cache->nflats;++i) if(cache->flats[i].lastuse < cache->flats[j].lastuse) j=i;
+      printf("FLAT FIELD RELEASED: %s\n",cache->flats[j].query);
+      drms_free_array(cache->flats[j].flat);
+    }
+
+  strncpy(cache->flats[j].query,query,255);
+  cache->flats[j].query[255]='\0';
+  cache->flats[j].camera =camera;
+  cache->flats[j].tstart =tstart;
+  cache->flats[j].tstop  =tstop;
+  cache->flats[j].flat   =flatfield;
+  cache->flats[j].lastuse=cache->clock;
+  cache->reads+=1;
+
+  return flatfield->data;
+}
+
+
+//returns the pzt flat field of the record query (the FLAT_REC keyword of a level 1 filtergram), or NULL if it cannot be read
+float *FlatFieldPzt(struct flatfieldcache *cache,DRMS_Env_t *env,const char *query)
+{
+  float *flat;
+
+  flat=FlatFieldFind(cache,query);
+  if(flat == NULL) flat=FlatFieldRead(cache,env,query,0,0.0,0.0);
+
+  return flat;
+}
+
+
+//returns the rotational flat field of camera (1=side, 2=front) valid at time t, or NULL if there is none or it cannot be read
+float *FlatFieldRotational(struct flatfieldcache *cache,DRMS_Env_t *env,int camera,TIME t)
+{
+  char   query[256],timestring[64];
+  double *keyF;
+  int    i,n1,status;
+
+  cache->clock+=1;
+  for(i=0;i<cache->nflats;++i) if(cache->flats[i].camera == camera && t >= cache->flats[i].tstart && t <= cache->flats[i].tstop)
+    {
+      cache->flats[i].lastuse=cache->clock;
+      cache->hits+=1;
+      return cache->flats[i].flat->data;
+    }
+
+  //read the validity intervals of the rotational flat fields
+  if(cache->intervals == NULL)
+    {
+      cache->intervals = drms_record_getvector(env,cache->series,"T_START,T_STOP",DRMS_TYPE_DOUBLE,0,&status);
+      if(status != DRMS_SUCCESS || cache->intervals == NULL)
+	{
+	  printf("Error: cannot read a list of keywords in the rotation flat-field series\n");
+	  if(cache->intervals != NULL) drms_free_array(cache->intervals);
+	  cache->intervals=NULL;
+	  return NULL;
+	}
+      printf("DIMENSIONS OF ROTATIONAL FLAT-FIELD SERIES= %d %d\n",cache->intervals->axis[0],cache->intervals->axis[1]);
+    }
+  n1  =cache->intervals->axis[1]; //number of rotational flat-field records found
+  keyF=cache->intervals->data;
+
+  i=0;
+  while(i < n1 && t > keyF[i] && t > keyF[n1+i]) i++;
+  if(i == n1 || t < keyF[i] || t > keyF[n1+i]) //no rotational flatfield record exists for time t
+    {
+      sprint_time(timestring,t,"TAI",0);
+      printf("Error: no rotational flat field record exists for the time %s\n",timestring);
+      return NULL;
+    }
+
+  //we build the query for the rotational flatfield
+  sprint_time(timestring,keyF[i],"TAI",1);
+  snprintf(query,256,"%s[%d][%s]",cache->series,camera,timestring);
+  printf("QUERY FOR ROTATIONAL FLAT FIELD= %s\n",query);
+
+  return FlatFieldRead(cache,env,query,camera,keyF[i],keyF[n1+i]);
+}
+
+
+void FlatFieldCacheReport(struct flatfieldcache *cache)
+{
+  printf("FLAT FIELD CACHE: %ld hits, %ld flat fields read\n",cache->hits,cache->reads);
+}
+
+
+//frees the flat fields and the validity intervals
+void FlatFieldCacheFree(struct flatfieldcache *cache)
+{
+  int i;
+
+  for(i=0;i<cache->nflats;++i) drms_free_array(cache->flats[i].flat);
+  cache->nflats=0;
+  if(cache->intervals != NULL) drms_free_array(cache->intervals);
+  cache->intervals=NULL;
+}
@@ -0,0 +1,52 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Flat fields used to replace the pzt flat field of the level 1 filtergrams by a          */
+/* rotational flat field, in HMI_observables.c and HMI_IQUV_averaging.c                    */
+/*                                                                                         */
+/* FlatFieldPzt() provides the pzt flat field of a FLAT_REC query, and                     */
+/* FlatFieldRotational() the rotational flat field of a camera that is valid at a given    */
+/* time (the record of the rotational flat-field series whose T_START and T_STOP bracket   */
+/* this time). The T_START and T_STOP of the series are read in one query, the first time  */
+/* a rotational flat field is needed                                                       */
+/*                                                                                         */
+/* each flat field is read only once and kept in memory, so that it serves all the         */
+/* filtergrams of its validity interval; when a filtergram is after T_STOP, the flat field */
+/* of the next interval is read. At most FLATFIELD_MAXFLATS flat fields are kept: the      */
+/* least recently used one is released to make room for a new one                          */
+/*                                                                                         */
+/* these functions are only called by the main thread                                      */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#ifndef FLATFIELDCACHE_H
+#define FLATFIELDCACHE_H
+
+#include "drms.h"
+
+#define FLATFIELD_MAXFLATS 6           //pzt and rotational flat fields of both cameras, and the next rotational flat fields at the end of an interval
+
+struct flatfield {
+  char          query[256];            //query of the flat-field record
+  int           camera;                //1 (side) or 2 (front) for a rotational flat field, 0 for a pzt flat field
+  TIME          tstart,tstop;          //validity interval of a rotational flat field
+  DRMS_Array_t *flat;
+  long          lastuse;
+};
+
+struct flatfieldcache {
+  char              series[256];       //series of the rotational flat fields
+  DRMS_Array_t     *intervals;         //T_START and T_STOP of the records of series (NULL until they are needed)
+  int               nflats;
+  struct flatfield  flats[FLATFIELD_MAXFLATS];
+  long              clock;             //number of flat fields requested
+  long              hits;              //flat fields found in memory
+  long              reads;             //flat fields read
+};
+
+void   FlatFieldCacheCreate(struct flatfieldcache *cache,const char *series);
+float *FlatFieldPzt(struct flatfieldcache *cache,DRMS_Env_t *env,const char *query);
+float *FlatFieldRotational(struct flatfieldcache *cache,DRMS_Env_t *env,int camera,TIME t);
+void   FlatFieldCacheReport(struct flatfieldcache *cache);
+void   FlatFieldCacheFree(struct flatfieldcache *cache);
+
+#endif
@@ -0,0 +1,159 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Cache of the gapfilled level 1 filtergrams (see framecache.h)                           */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "drms.h"
+#include "framecache.h"
+
+
+//creates a cache of nframes frames, all FRAME_NOTREAD
+int FrameCacheCreate(struct framecache *cache,int nframes,long long budget)
+{
+  int i;
+
+  cache->frame=(struct frame *)malloc(nframes*sizeof(struct frame));
+  if(cache->frame == NULL)
+    {
+      printf("Error: memory could not be allocated to the frame cache\n");
+      return 1;
+    }
+  for(i=0;i<nframes;++i)
+    {
+      cache->frame[i].fsn    =-1;
+      cache->frame[i].state  =FRAME_NOTREAD;
+      cache->frame[i].image  =NULL;
+      cache->frame[i].ierror =NULL;
+      cache->frame[i].lastuse=0.0;
+      cache->frame[i].bytes  =0;
+    }
+  cache->nframes    =nframes;
+  cache->budget     =budget;
+  cache->bytes      =0;
+  cache->maxbytes   =0;
+  cache->hits       =0;
+  cache->misses     =0;
+  cache->evictions  =0;
+  cache->expirations=0;
+
+  return 0;
+}
+
+
+//stores the gapfilled filtergram and error map of frame i, read and used at target time usetime (the cache now owns the arrays)
+//then evicts the least recently used frames, not used at usetime, until the memory is within budget
+void FrameCacheStore(struct framecache *cache,int i,DRMS_Array_t *image,DRMS_Array_t *ierror,TIME usetime)
+{
+  struct frame *frame=&cache->frame[i];
+  int k,oldest;
+
+  if(frame->state == FRAME_CACHED) FrameCacheDrop(cache,i,FRAME_NOTREAD);
+  frame->image  =image;
+  frame->ierror =ierror;
+  frame->state  =FRAME_CACHED;
+  frame->lastuse=usetime;
+  frame->bytes  =0;
+  if(image  != NULL) frame->bytes+=drms_array_size(image);
+  if(ierror != NULL) frame->bytes+=drms_array_size(ierror);
+  cache->bytes+=frame->bytes;
+  if(cache->bytes > cache->maxbytes) cache->maxbytes=cache->bytes;
+  cache->misses+=1;
+
+  while(cache->budget > 0 && cache->bytes > cache->budget)
+    {
+      oldest=-1;
+      for(k=0;k<cache->nframes;++k) if(cache->frame[k].state == FRAME_CACHED && cache->frame[k].lastuse < usetime)
+	{
+	  if(oldest == -1 || cache->frame[k].lastuse < cache->frame[oldest].lastuse) oldest=k;
+	}
+      if(oldest == -1) break;                                                          //all the frames in memory are used at this target time
+      printf("frame cache: evicting FSN %d, last used at %f\n",cache->frame[oldest].fsn,cache->frame[oldest].lastuse);
+      FrameCacheDrop(cache,oldest,FRAME_NOTREAD);
+      cache->evictions+=1;
+    }
+}
+
+
+//frame i, already in memory, is used at target time usetime (a hit is counted only once per target time)
+void FrameCacheUse(struct framecache *cache,int i,TIME usetime)
+{
+  if(cache->frame[i].lastuse != usetime) cache->hits+=1;
+  cache->frame[i].lastuse=usetime;
+}
+
+
+//frees the arrays of frame i, if in memory, and sets its state to FRAME_NOTREAD or FRAME_CORRUPT
+void FrameCacheDrop(struct framecache *cache,int i,int state)
+{
+  struct frame *frame=&cache->frame[i];
+
+  if(frame->state == FRAME_CACHED)
+    {
+      if(frame->image  != NULL) drms_free_array(frame->image);
+      if(frame->ierror != NULL) drms_free_array(frame->ierror);
+      cache->bytes-=frame->bytes;
+    }
+  frame->image =NULL;
+  frame->ierror=NULL;
+  frame->bytes =0;
+  frame->state =state;
+}
+
+
+//releases the frames in memory that are not in needed[0..nneeded-1], the list of filtergrams of the current target time (-1 for a missing filtergram)
+//returns 1 if the memory cannot be allocated (no frame is released then)
+int FrameCacheExpire(struct framecache *cache,int *needed,int nneeded)
+{
+  char *keep;
+  int   i;
+
+  keep=(char *)calloc(cache->nframes,sizeof(char));
+  if(keep == NULL)
+    {
+      printf("Error: memory could not be allocated in FrameCacheExpire()\n");
+      return 1;
+    }
+  for(i=0;i<nneeded;++i) if(needed[i] >= 0 && needed[i] < cache->nframes) keep[needed[i]]=1;
+  for(i=0;i<cache->nframes;++i) if(cache->frame[i].state == FRAME_CACHED && keep[i] == 0)
+    {
+      FrameCacheDrop(cache,i,FRAME_NOTREAD);
+      cache->expirations+=1;
+    }
+  free(keep);
+
+  return 0;
+}
+
+
+
+//releases all the frames in memory (e.g. when the target time starts over with other filtergrams)
+void FrameCacheFlush(struct framecache *cache)
+{
+  int i;
+
+  for(i=0;i<cache->nframes;++i) if(cache->frame[i].state == FRAME_CACHED)
+    {
+      FrameCacheDrop(cache,i,FRAME_NOTREAD);
+      cache->expirations+=1;
+    }
+}
+
+void FrameCacheReport(struct framecache *cache)
+{
+  printf("FRAME CACHE: %ld hits, %ld misses (frames read and gapfilled), %ld evictions, %ld expirations, %f MB in memory, %f MB at most (budget: %f MB)\n",cache->hits,cache->misses,cache->evictions,cache->expirations,(double)cache->bytes/1048576.0,(double)cache->maxbytes/1048576.0,(double)cache->budget/1048576.0);
+}
+
+
+//frees all the frames and the cache
+void FrameCacheFree(struct framecache *cache)
+{
+  int i;
+
+  for(i=0;i<cache->nframes;++i) FrameCacheDrop(cache,i,FRAME_NOTREAD);
+  free(cache->frame);
+  cache->frame  =NULL;
+  cache->nframes=0;
+}
@@ -0,0 +1,59 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Cache of the gapfilled level 1 filtergrams, used by HMI_observables.c and               */
+/* HMI_IQUV_averaging.c                                                                    */
+/*                                                                                         */
+/* the frames are the level 1 filtergrams opened by the module, indexed by record index    */
+/* and identified by their FSN (set by the caller). A frame holds the flatfielded and      */
+/* gapfilled image and the error map of the gapfilling code, so that a filtergram used by  */
+/* the temporal interpolations of several target times is read and gapfilled only once     */
+/*                                                                                         */
+/* each frame records the last target time at which it was used. The frames that are not  */
+/* in the list of filtergrams of the current target time are released by                  */
+/* FrameCacheExpire(); and if budget > 0, the least recently used frames are evicted       */
+/* whenever the memory used by the cache exceeds budget bytes. The frames used at the      */
+/* current target time are never evicted (the budget can then be exceeded)                 */
+/* FrameCacheFlush() releases all the frames, e.g. when the target time starts over       */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+#include "drms.h"
+
+#define FRAME_NOTREAD   0              //segment not in memory (the former SegmentRead[i]=0)
+#define FRAME_CACHED    1              //segment in memory and gapfilled (SegmentRead[i]=1)
+#define FRAME_CORRUPT  -1              //segment or keywords missing or corrupt (SegmentRead[i]=-1)
+
+struct frame {
+  int           fsn;
+  int           state;
+  DRMS_Array_t *image;                 //flatfielded and gapfilled filtergram
+  DRMS_Array_t *ierror;                //error map returned by the gapfilling code
+  TIME          lastuse;               //last target time at which the frame was used
+  long long     bytes;
+};
+
+struct framecache {
+  int           nframes;
+  struct frame *frame;
+  long long     budget;                //maximum memory used by the cached frames, in bytes (0=no maximum)
+  long long     bytes;                 //memory currently used by the cached frames
+  long long     maxbytes;              //maximum memory used during the run
+  long          hits;                  //frames found in memory
+  long          misses;                //frames read and gapfilled
+  long          evictions;             //frames evicted to stay within budget
+  long          expirations;           //frames released because they fell behind the temporal window
+};
+
+int  FrameCacheCreate(struct framecache *cache,int nframes,long long budget);
+void FrameCacheStore(struct framecache *cache,int i,DRMS_Array_t *image,DRMS_Array_t *ierror,TIME usetime);
+void FrameCacheUse(struct framecache *cache,int i,TIME usetime);
+void FrameCacheDrop(struct framecache *cache,int i,int state);
+int  FrameCacheExpire(struct framecache *cache,int *needed,int nneeded);
+void FrameCacheFlush(struct framecache *cache);
+void FrameCacheReport(struct framecache *cache);
+void FrameCacheFree(struct framecache *cache);
+
+#endif
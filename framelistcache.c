@@ -0,0 +1,292 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Observable sequence tables and framelists already decoded (see framelistcache.h)        */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "framelistcache.h"
+
+#define FRAMELIST_BUCKETS 64           //size of the hash table of the framelists
+
+struct framelist {
+  int               HFLID,HPLTID,HWLTID,WavelengthID,CamId;
+  int               framelistSize;
+  int               nFID;              //number of values of FID, WavelengthLocation, and CameraValues set by framelistInfo()
+  int               paramset;          //1 if PolarizationType, combine, npol, and DataCadence were set by framelistInfo()
+  int               PolarizationType,combine,npol;
+  TIME              DataCadence;
+  int              *FID,*WavelengthLocation,*CameraValues;
+  int              *WavelengthIndex;   //framelistSize values
+  int              *PHWPLPOS;          //7*framelistSize values
+  unsigned char    *HWPLset;           //1 if the value of PHWPLPOS was found in std_flight.w or std_flight.p
+  struct framelist *next;
+};
+
+static struct sequencetables Tables;
+static int                   TablesRead=0;
+static struct framelist     *Framelists[FRAMELIST_BUCKETS];
+
+
+static void SequenceTablesFree(void)
+{
+  free(Tables.sequences);
+  free(Tables.wavelengths);
+  free(Tables.polarizations);
+  memset(&Tables,0,sizeof(Tables));
+  TablesRead=0;
+}
+
+
+//reads the lines of std_flight.w (nvalues=4) or std_flight.p (nvalues=3) after the 6 lines of header
+//returns the number of lines read, or -1 if the file cannot be read
+static int HcmPositionsRead(const char *filename,int nvalues,struct hcmposition **positions)
+{
+  FILE *sequencefile;
+  char  line[256];
+  int   j,n=0,nmax=256;
+  struct hcmposition current,*temp;
+
+  *positions=NULL;
+  sequencefile = fopen(filename,"r");
+  if(sequencefile == NULL)
+    {
+      printf("The file %s does not exist or cannot be read\n",filename);
+      return -1;
+    }
+
+  *positions=(struct hcmposition *)malloc(nmax*sizeof(struct hcmposition));
+  if(*positions == NULL)
+    {
+      printf("Error: memory could not be allocated to the HCM positions\n");
+      fclose(sequencefile);
+      return -1;
+    }
+
+  //as in the former framelistInfo(), a line that sscanf() cannot read keeps the values of the previous line
+  memset(&current,0,sizeof(current));
+  for(j=0;j<6;++j) fgets(line,256,sequencefile);
+  current.index=j;
+  while (fgets(line,256,sequencefile) != NULL)
+    {
+      if(line[0] != '#')
+	{
+	  if(nvalues == 4) sscanf(line,"%d %d %d %d %d",&current.index,&current.pos[0],&current.pos[1],&current.pos[2],&current.pos[3]);
+	  else             sscanf(line,"%d %d %d %d",&current.index,&current.pos[0],&current.pos[1],&current.pos[2]);
+	  if(n == nmax)
+	    {
+	      nmax*=2;
+	      temp=(struct hcmposition *)realloc(*positions,nmax*sizeof(struct hcmposition));
+	      if(temp == NULL)
+		{
+		  printf("Error: memory could not be allocated to the HCM positions\n");
+		  fclose(sequencefile);
+		  return -1;
+		}
+	      *positions=temp;
+	    }
+	  (*positions)[n]=current;
+	  n+=1;
+	}
+    }
+  fclose(sequencefile);
+
+  return n;
+}
+
+
+//returns the observable sequence tables of dpath, read the first time they are needed
+//returns NULL if one of the files cannot be read
+const struct sequencetables *SequenceTables(const char *dpath)
+{
+  FILE *sequencefile;
+  char  dpath2[256];
+  char  line[256];
+  int   nmax=1024;
+  struct sequence current,*temp;
+
+  if(TablesRead && !strcmp(Tables.dpath,dpath)) return &Tables;
+  if(TablesRead)
+    {
+      SequenceTablesFree();
+      FramelistCacheFree();
+    }
+
+  strcpy(dpath2,dpath);
+  strcat(dpath2,"/../Sequences3.txt");
+  sequencefile = fopen(dpath2,"r");
+  if(sequencefile == NULL)
+    {
+      printf("The file %s does not exist or cannot be read\n",dpath2);
+      return NULL;
+    }
+
+  Tables.sequences=(struct sequence *)malloc(nmax*sizeof(struct sequence));
+  if(Tables.sequences == NULL)
+    {
+      printf("Error: memory could not be allocated to the observable sequences\n");
+      fclose(sequencefile);
+      return NULL;
+    }
+
+  //as in the former framelistInfo(), a line that sscanf() cannot read keeps the values of the previous line
+  memset(&current,0,sizeof(current));
+  while (fgets(line,256,sequencefile) != NULL)
+    {
+      sscanf(line,"%d %d %d %f %f %d %d %d %d %d %d %d %d",&current.HFLID,&current.PolarizationTypef,&current.PolarizationTypes,&current.DataCadencef,&current.DataCadences,&current.npolf,&current.npols,&current.combinef,&current.combines,&current.framelistSizef,&current.framelistSizes,&current.FID,&current.CAMERA);
+      if(Tables.nsequences == nmax)
+	{
+	  nmax*=2;
+	  temp=(struct sequence *)realloc(Tables.sequences,nmax*sizeof(struct sequence));
+	  if(temp == NULL)
+	    {
+	      printf("Error: memory could not be allocated to the observable sequences\n");
+	      fclose(sequencefile);
+	      SequenceTablesFree();
+	      return NULL;
+	    }
+	  Tables.sequences=temp;
+	}
+      Tables.sequences[Tables.nsequences]=current;
+      Tables.nsequences+=1;
+    }
+  fclose(sequencefile);
+
+  strcpy(dpath2,dpath);
+  strcat(dpath2,"/../../tables/hmi_mech/std_flight.w");
+  Tables.nwavelengths=HcmPositionsRead(dpath2,4,&Tables.wavelengths);
+  strcpy(dpath2,dpath);
+  strcat(dpath2,"/../../tables/hmi_mech/std_flight.p");
+  if(Tables.nwavelengths >= 0) Tables.npolarizations=HcmPositionsRead(dpath2,3,&Tables.polarizations);
+  if(Tables.nwavelengths < 0 || Tables.npolarizations < 0)
+    {
+      SequenceTablesFree();
+      return NULL;
+    }
+
+  strcpy(Tables.dpath,dpath);
+  TablesRead=1;
+  printf("OBSERVABLE SEQUENCE TABLES READ: %d SEQUENCE LINES, %d WAVELENGTH AND %d POLARIZATION HCM POSITIONS\n",Tables.nsequences,Tables.nwavelengths,Tables.npolarizations);
+
+  return &Tables;
+}
+
+
+static int FramelistHash(int HFLID,int HPLTID,int HWLTID,int WavelengthID,int CamId)
+{
+  unsigned int h=(unsigned int)HFLID;
+
+  h=h*31u+(unsigned int)HPLTID;
+  h=h*31u+(unsigned int)HWLTID;
+  h=h*31u+(unsigned int)WavelengthID;
+  h=h*31u+(unsigned int)CamId;
+
+  return (int)(h % FRAMELIST_BUCKETS);
+}
+
+
+//provides the framelist decoded for these values of HFLID, HPLTID, HWLTID, WavelengthID, and CamId
+//returns framelistSize, or -1 if this framelist was not decoded yet
+int FramelistCacheGet(int HFLID,int HPLTID,int HWLTID,int WavelengthID,int CamId,int *PHWPLPOS,int *WavelengthIndex,int *WavelengthLocation,int *PPolarizationType,int *Pcombine,int *Pnpol,TIME *PDataCadence,int *CameraValues,int *FID)
+{
+  struct framelist *f;
+  int i;
+
+  for(f=Framelists[FramelistHash(HFLID,HPLTID,HWLTID,WavelengthID,CamId)];f != NULL;f=f->next)
+    if(f->HFLID == HFLID && f->HPLTID == HPLTID && f->HWLTID == HWLTID && f->WavelengthID == WavelengthID && f->CamId == CamId) break;
+  if(f == NULL) return -1;
+
+  if(f->paramset)
+    {
+      *Pcombine=f->combine;
+      *Pnpol=f->npol;
+      *PDataCadence=f->DataCadence;
+      *PPolarizationType=f->PolarizationType;
+    }
+  memcpy(FID,f->FID,f->nFID*sizeof(int));
+  memcpy(WavelengthLocation,f->WavelengthLocation,f->nFID*sizeof(int));
+  memcpy(CameraValues,f->CameraValues,f->nFID*sizeof(int));
+  memcpy(WavelengthIndex,f->WavelengthIndex,f->framelistSize*sizeof(int));
+  for(i=0;i<7*f->framelistSize;++i) if(f->HWPLset[i]) PHWPLPOS[i]=f->PHWPLPOS[i];
+
+  return f->framelistSize;
+}
+
+
+//stores the framelist decoded by framelistInfo()
+//the first nFID values of FID, WavelengthLocation, and CameraValues were set, and the values i of PHWPLPOS for which HWPLset[i]=1
+//paramset=1 if PolarizationType, combine, npol, and DataCadence were set (a line of the sequence was found for CamId)
+void FramelistCachePut(int HFLID,int HPLTID,int HWLTID,int WavelengthID,int CamId,int *PHWPLPOS,const unsigned char *HWPLset,int *WavelengthIndex,int *WavelengthLocation,int paramset,int PolarizationType,int combine,int npol,TIME DataCadence,int *CameraValues,int *FID,int nFID,int framelistSize)
+{
+  struct framelist *f;
+  int h;
+
+  f=(struct framelist *)calloc(1,sizeof(struct framelist));
+  if(f == NULL) return;                                              //the framelist will just be decoded again
+  f->FID               =(int *)malloc((nFID+1)*sizeof(int));
+  f->WavelengthLocation=(int *)malloc((nFID+1)*sizeof(int));
+  f->CameraValues      =(int *)malloc((nFID+1)*sizeof(int));
+  f->WavelengthIndex   =(int *)malloc((framelistSize+1)*sizeof(int));
+  f->PHWPLPOS          =(int *)malloc((7*framelistSize+1)*sizeof(int));
+  f->HWPLset           =(unsigned char *)malloc((7*framelistSize+1)*sizeof(unsigned char));
+  if(f->FID == NULL || f->WavelengthLocation == NULL || f->CameraValues == NULL || f->WavelengthIndex == NULL || f->PHWPLPOS == NULL || f->HWPLset == NULL)
+    {
+      free(f->FID);
+      free(f->WavelengthLocation);
+      free(f->CameraValues);
+      free(f->WavelengthIndex);
+      free(f->PHWPLPOS);
+      free(f->HWPLset);
+      free(f);
+      return;
+    }
+
+  f->HFLID           =HFLID;
+  f->HPLTID          =HPLTID;
+  f->HWLTID          =HWLTID;
+  f->WavelengthID    =WavelengthID;
+  f->CamId           =CamId;
+  f->framelistSize   =framelistSize;
+  f->nFID            =nFID;
+  f->paramset        =paramset;
+  f->PolarizationType=PolarizationType;
+  f->combine         =combine;
+  f->npol            =npol;
+  f->DataCadence     =DataCadence;
+  memcpy(f->FID,FID,nFID*sizeof(int));
+  memcpy(f->WavelengthLocation,WavelengthLocation,nFID*sizeof(int));
+  memcpy(f->CameraValues,CameraValues,nFID*sizeof(int));
+  memcpy(f->WavelengthIndex,WavelengthIndex,framelistSize*sizeof(int));
+  memcpy(f->PHWPLPOS,PHWPLPOS,7*framelistSize*sizeof(int));
+  memcpy(f->HWPLset,HWPLset,7*framelistSize*sizeof(unsigned char));
+
+  h=FramelistHash(HFLID,HPLTID,HWLTID,WavelengthID,CamId);
+  f->next=Framelists[h];
+  Framelists[h]=f;
+}
+
+
+//frees the framelists (the sequence tables are kept)
+void FramelistCacheFree(void)
+{
+  struct framelist *f,*next;
+  int h;
+
+  for(h=0;h<FRAMELIST_BUCKETS;++h)
+    {
+      for(f=Framelists[h];f != NULL;f=next)
+	{
+	  next=f->next;
+	  free(f->FID);
+	  free(f->WavelengthLocation);
+	  free(f->CameraValues);
+	  free(f->WavelengthIndex);
+	  free(f->PHWPLPOS);
+	  free(f->HWPLset);
+	  free(f);
+	}
+      Framelists[h]=NULL;
+    }
+}
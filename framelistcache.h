@@ -0,0 +1,54 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Observable sequence tables and framelists already decoded, used by framelistInfo() in   */
+/* HMI_observables.c and HMI_IQUV_averaging.c                                              */
+/*                                                                                         */
+/* SequenceTables() reads the files Sequences3.txt, std_flight.w, and std_flight.p of dpath */
+/* only once per process (again only if dpath changes), and keeps their lines in memory    */
+/* with the values that framelistInfo() used to read from them with fgets() and sscanf()   */
+/*                                                                                         */
+/* the framelist decoded by framelistInfo() for a set of HFLID, HPLTID, HWLTID,            */
+/* WavelengthID, and CamId is stored by FramelistCachePut(), and provided again by         */
+/* FramelistCacheGet() (a lookup in a hash table) the next time these values are requested */
+/*                                                                                         */
+/* these functions are only called by the main thread                                      */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#ifndef FRAMELISTCACHE_H
+#define FRAMELISTCACHE_H
+
+#include "drms.h"
+
+struct sequence {                      //line of Sequences3.txt
+  int   HFLID;
+  int   PolarizationTypef,PolarizationTypes;
+  float DataCadencef,DataCadences;
+  int   npolf,npols;
+  int   combinef,combines;
+  int   framelistSizef,framelistSizes;
+  int   FID;
+  int   CAMERA;
+};
+
+struct hcmposition {                   //line of std_flight.w (HWL1POS to HWL4POS) or std_flight.p (HPL1POS to HPL3POS)
+  int index;
+  int pos[4];
+};
+
+struct sequencetables {
+  char                dpath[256];
+  int                 nsequences;
+  struct sequence    *sequences;
+  int                 nwavelengths;
+  struct hcmposition *wavelengths;
+  int                 npolarizations;
+  struct hcmposition *polarizations;
+};
+
+const struct sequencetables *SequenceTables(const char *dpath);
+int  FramelistCacheGet(int HFLID,int HPLTID,int HWLTID,int WavelengthID,int CamId,int *PHWPLPOS,int *WavelengthIndex,int *WavelengthLocation,int *PPolarizationType,int *Pcombine,int *Pnpol,TIME *PDataCadence,int *CameraValues,int *FID);
+void FramelistCachePut(int HFLID,int HPLTID,int HWLTID,int WavelengthID,int CamId,int *PHWPLPOS,const unsigned char *HWPLset,int *WavelengthIndex,int *WavelengthLocation,int paramset,int PolarizationType,int combine,int npol,TIME DataCadence,int *CameraValues,int *FID,int nFID,int framelistSize);
+void FramelistCacheFree(void);
+
+#endif
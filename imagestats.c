@@ -0,0 +1,308 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Statistics of the level 1.5 observables (see imagestats.h)                              */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <omp.h>
+#include "imagestats.h"
+
+struct moments {                       //number of values, mean, and sums of the powers 2, 3, and 4 of the deviations from the mean
+  double n;
+  double mean;
+  double M2;
+  double M3;
+  double M4;
+  double minimum;
+  double maximum;
+  int    nout;
+};
+
+
+static void InitMoments(struct moments *a)
+{
+  a->n=0.0;
+  a->mean=0.0;
+  a->M2=0.0;
+  a->M3=0.0;
+  a->M4=0.0;
+  a->minimum= INFINITY;
+  a->maximum=-INFINITY;
+  a->nout=0;
+}
+
+
+//adds the values described by b to the ones described by a (pairwise update formulas of Chan, Golub, and LeVeque)
+static void MergeMoments(struct moments *a,struct moments *b)
+{
+  double na=a->n,nb=b->n,n,delta,dn,dn2;
+
+  if(nb == 0.0) return;
+  if(na == 0.0)
+    {
+      *a=*b;
+      return;
+    }
+
+  n     = na+nb;
+  delta = b->mean-a->mean;
+  dn    = delta/n;
+  dn2   = dn*dn;
+
+  //NB: M4 uses the M2 and M3 of a before their update, and M3 the M2 of a before its update
+  a->M4  += b->M4+delta*dn*dn2*na*nb*(na*na-na*nb+nb*nb)+6.0*dn2*(na*na*b->M2+nb*nb*a->M2)+4.0*dn*(na*b->M3-nb*a->M3);
+  a->M3  += b->M3+delta*dn2*na*nb*(na-nb)+3.0*dn*(na*b->M2-nb*a->M2);
+  a->M2  += b->M2+delta*dn*na*nb;
+  a->mean+= nb*dn;
+  a->n    = n;
+  if(b->minimum < a->minimum) a->minimum=b->minimum;
+  if(b->maximum > a->maximum) a->maximum=b->maximum;
+  a->nout+= b->nout;
+}
+
+
+//columns [*colstart,*colend) of row that are at a distance <= radius from (X0,Y0) (all the columns if radius <= 0)
+//the distance is computed in single precision, as in HMI_observables.c, and the span is adjusted at both ends so that the test is exact
+static void RowSpan(int row,int nColumns,float X0,float Y0,double radius,int *colstart,int *colend)
+{
+  float  dy2;
+  double half;
+  int    c0,c1;
+
+  if(radius <= 0.0)
+    {
+      *colstart=0;
+      *colend  =nColumns;
+      return;
+    }
+
+  dy2  = ((float)row-Y0)*((float)row-Y0);
+  half = ((double)dy2 < radius*radius) ? sqrt(radius*radius-(double)dy2) : 0.0;
+  c0   = (int)ceil(X0-half);
+  c1   = (int)floor(X0+half)+1;
+  if(c0 < 0)        c0=0;
+  if(c0 > nColumns) c0=nColumns;
+  if(c1 > nColumns) c1=nColumns;
+  if(c1 < c0)       c1=c0;
+  while(c0 > 0        && (float)sqrt(dy2+((float)(c0-1)-X0)*((float)(c0-1)-X0)) <= radius) c0--;
+  while(c0 < c1       && (float)sqrt(dy2+((float)c0-X0)*((float)c0-X0))         >  radius) c0++;
+  while(c1 < nColumns && (float)sqrt(dy2+((float)c1-X0)*((float)c1-X0))         <= radius) c1++;
+  while(c1 > c0       && (float)sqrt(dy2+((float)(c1-1)-X0)*((float)(c1-1)-X0)) >  radius) c1--;
+
+  *colstart=c0;
+  *colend  =c1;
+}
+
+
+//bin of the histogram of value x (the SAME expression must be used to fill the histogram and to collect the values of a bin)
+static inline int StatsBin(float x,double lo,double scale)
+{
+  int b=(int)(((double)x-lo)*scale);
+  if(b >= STATSNBINS) b=STATSNBINS-1;
+  if(b < 0) b=0;
+  return b;
+}
+
+
+static int CompareFloat(const void *a,const void *b)
+{
+  float x=*(const float *)a,y=*(const float *)b;
+  return (x > y)-(x < y);
+}
+
+
+int ImageStatistics(int nimages,float **images,int nColumns,int nRows,float X0,float Y0,double radius,double *rangemin,double *rangemax,struct imagestats *stats)
+{
+  int    k,row,column,colstart,colend,b,t,nempty=0;
+  int    nthreads=omp_get_max_threads();
+  long   kth[2],first;
+  float  *image,x;
+  double sum,mean,d,d2,lo[nimages],scale[nimages];
+  struct moments total[nimages];
+  int    bin1[nimages],bin2[nimages];  //bins containing the central ranks
+  long   offset[nimages];              //number of values before bin1
+  long   nbuffer[nimages],count[nimages];
+  float  *buffer[nimages];             //values of the bins bin1 to bin2
+  int    *hist=NULL,*histograms=NULL;
+
+  for(k=0;k<nimages;++k) InitMoments(&total[k]);
+
+  /***********************************************************************************************************/
+  /*PASS 1: MOMENTS, MINIMUM, MAXIMUM, AND NUMBER OF VALUES OUT OF RANGE OF ALL THE IMAGES                     */
+  /***********************************************************************************************************/
+
+#pragma omp parallel default(none) private(k,row,column,colstart,colend,image,x,sum,mean,d,d2) shared(nimages,images,nColumns,nRows,X0,Y0,radius,rangemin,rangemax,total)
+  {
+    struct moments local[nimages],rowm;                                //partial sums of each thread, and of one row
+    for(k=0;k<nimages;++k) InitMoments(&local[k]);
+
+#pragma omp for schedule(dynamic,16)
+    for(row=0;row<nRows;++row)
+      {
+	RowSpan(row,nColumns,X0,Y0,radius,&colstart,&colend);
+	for(k=0;k<nimages;++k)
+	  {
+	    if(images[k] == NULL) continue;
+	    image=images[k]+(long)row*nColumns;
+
+	    //two-pass mean and central moments of the row, that stays in cache
+	    InitMoments(&rowm);
+	    sum=0.0;
+	    for(column=colstart;column<colend;++column)
+	      {
+		x=image[column];
+		if(isnan(x)) continue;
+		sum    += x;
+		rowm.n += 1.0;
+		if(x < rowm.minimum) rowm.minimum=x;
+		if(x > rowm.maximum) rowm.maximum=x;
+		if(rangemin != NULL && (x < rangemin[k] || x > rangemax[k])) rowm.nout+=1;
+	      }
+	    if(rowm.n == 0.0) continue;
+	    mean=sum/rowm.n;
+	    for(column=colstart;column<colend;++column)
+	      {
+		x=image[column];
+		if(isnan(x)) continue;
+		d  = (double)x-mean;
+		d2 = d*d;
+		rowm.M2 += d2;
+		rowm.M3 += d2*d;
+		rowm.M4 += d2*d2;
+	      }
+	    rowm.mean=mean;
+	    MergeMoments(&local[k],&rowm);
+	  }
+      }
+
+#pragma omp critical
+    for(k=0;k<nimages;++k) MergeMoments(&total[k],&local[k]);
+  }
+
+  for(k=0;k<nimages;++k)
+    {
+      buffer[k]=NULL;
+      nbuffer[k]=0;
+      count[k]=0;
+      scale[k]=0.0;
+      lo[k]=total[k].minimum;
+      if(images[k] == NULL) continue;
+
+      stats[k].ngood=(int)total[k].n;
+      stats[k].nout =total[k].nout;
+      if(total[k].n == 0.0)
+	{
+	  stats[k].minimum=stats[k].maximum=stats[k].median=stats[k].mean=stats[k].sigma=stats[k].skewness=stats[k].kurtosis=NAN;
+	  nempty+=1;
+	  continue;
+	}
+      stats[k].minimum =total[k].minimum;
+      stats[k].maximum =total[k].maximum;
+      stats[k].mean    =total[k].mean;
+      stats[k].sigma   =(total[k].n > 1.0) ? sqrt(total[k].M2/(total[k].n-1.0)) : 0.0;
+      stats[k].skewness=total[k].M3/total[k].n/(stats[k].sigma*stats[k].sigma*stats[k].sigma);
+      stats[k].kurtosis=total[k].M4/total[k].n/(stats[k].sigma*stats[k].sigma*stats[k].sigma*stats[k].sigma)-3.0;
+      stats[k].median  =total[k].minimum;                              //if all the values are the same
+      if(total[k].maximum > total[k].minimum) scale[k]=(double)STATSNBINS/(total[k].maximum-total[k].minimum);
+    }
+
+  /***********************************************************************************************************/
+  /*PASS 2: HISTOGRAMS, TO LOCATE THE BIN(S) CONTAINING THE MEDIAN                                            */
+  /***********************************************************************************************************/
+
+  hist      =(int *)calloc((size_t)nimages*STATSNBINS,sizeof(int));
+  histograms=(int *)calloc((size_t)nthreads*nimages*STATSNBINS,sizeof(int));
+  if(hist == NULL || histograms == NULL)
+    {
+      printf("Error: unable to allocate memory to the histograms of ImageStatistics()\n");
+      exit(EXIT_FAILURE);
+    }
+
+#pragma omp parallel default(none) private(k,row,column,colstart,colend,image,x,b,t) shared(nimages,images,nColumns,nRows,X0,Y0,radius,lo,scale,hist,histograms,nthreads)
+  {
+    int *local=histograms+(long)omp_get_thread_num()*nimages*STATSNBINS;
+
+#pragma omp for schedule(dynamic,16)
+    for(row=0;row<nRows;++row)
+      {
+	RowSpan(row,nColumns,X0,Y0,radius,&colstart,&colend);
+	for(k=0;k<nimages;++k)
+	  {
+	    if(images[k] == NULL || scale[k] == 0.0) continue;
+	    image=images[k]+(long)row*nColumns;
+	    for(column=colstart;column<colend;++column)
+	      {
+		x=image[column];
+		if(isnan(x)) continue;
+		local[k*STATSNBINS+StatsBin(x,lo[k],scale[k])]+=1;
+	      }
+	  }
+      }
+
+    //sum of the histograms of the threads
+#pragma omp for schedule(static)
+    for(b=0;b<nimages*STATSNBINS;++b) for(t=0;t<nthreads;++t) hist[b]+=histograms[(long)t*nimages*STATSNBINS+b];
+  }
+  free(histograms);
+
+  for(k=0;k<nimages;++k)
+    {
+      if(images[k] == NULL || scale[k] == 0.0) continue;
+      kth[0]=((long)total[k].n-1)/2;                                   //central rank(s), starting at 0
+      kth[1]=(long)total[k].n/2;
+      first=0;
+      for(b=0;b<STATSNBINS && first+hist[k*STATSNBINS+b] <= kth[0];++b) first+=hist[k*STATSNBINS+b];
+      bin1[k]  =b;
+      offset[k]=first;
+      nbuffer[k]=hist[k*STATSNBINS+b];
+      for(;first+nbuffer[k] <= kth[1];) nbuffer[k]+=hist[k*STATSNBINS+(++b)];
+      bin2[k]  =b;
+      buffer[k]=(float *)malloc(nbuffer[k]*sizeof(float));
+      if(buffer[k] == NULL)
+	{
+	  printf("Error: unable to allocate memory to buffer in ImageStatistics()\n");
+	  exit(EXIT_FAILURE);
+	}
+    }
+  free(hist);
+
+  /***********************************************************************************************************/
+  /*PASS 3: EXACT MEDIAN FROM THE VALUES OF THE BIN(S) CONTAINING THE CENTRAL RANK(S)                         */
+  /***********************************************************************************************************/
+
+#pragma omp parallel for default(none) schedule(dynamic,16) private(k,row,column,colstart,colend,image,x,b,first) shared(nimages,images,nColumns,nRows,X0,Y0,radius,lo,scale,bin1,bin2,buffer,count)
+  for(row=0;row<nRows;++row)
+    {
+      RowSpan(row,nColumns,X0,Y0,radius,&colstart,&colend);
+      for(k=0;k<nimages;++k)
+	{
+	  if(buffer[k] == NULL) continue;
+	  image=images[k]+(long)row*nColumns;
+	  for(column=colstart;column<colend;++column)
+	    {
+	      x=image[column];
+	      if(isnan(x)) continue;
+	      b=StatsBin(x,lo[k],scale[k]);
+	      if(b < bin1[k] || b > bin2[k]) continue;
+#pragma omp atomic capture
+	      first=count[k]++;
+	      buffer[k][first]=x;
+	    }
+	}
+    }
+
+  for(k=0;k<nimages;++k)
+    {
+      if(buffer[k] == NULL) continue;
+      qsort(buffer[k],nbuffer[k],sizeof(float),CompareFloat);
+      kth[0]=((long)total[k].n-1)/2-offset[k];
+      kth[1]=(long)total[k].n/2-offset[k];
+      stats[k].median=((double)buffer[k][kth[0]]+(double)buffer[k][kth[1]])/2.0;
+      free(buffer[k]);
+    }
+
+  return nempty;
+}
@@ -0,0 +1,43 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Statistics of the level 1.5 observables, used by HMI_observables.c                      */
+/*                                                                                         */
+/* ImageStatistics() returns the same quantities as Keh-Cheng's fstats() for several       */
+/* images of the same dimensions at once: the moments of all the images are accumulated    */
+/* in a single OpenMP pass (two-pass mean and central moments over each row, which stays   */
+/* in cache, then merged row by row with the pairwise update formulas of Chan et al.), and */
+/* the median is obtained from a histogram of STATSNBINS bins, followed by an exact        */
+/* selection among the values of the bin(s) containing the central rank(s)                */
+/*                                                                                         */
+/* NaNs are ignored. Only the pixels at a distance <= radius from (X0,Y0) are used if      */
+/* radius > 0 (SAME TEST AS THE 99% OF RSUN CROP OF HMI_observables.c), all the pixels     */
+/* otherwise. images[k] == NULL means that image k is skipped                              */
+/*                                                                                         */
+/* DEFINITIONS: sigma = sqrt(M2/(ngood-1)), skewness = M3/ngood/sigma^3,                   */
+/* kurtosis = M4/ngood/sigma^4-3 where Mp is the sum of (value-mean)^p; the median is the  */
+/* average of the two central values if ngood is even                                      */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#ifndef IMAGESTATS_H
+#define IMAGESTATS_H
+
+#define STATSNBINS 16384               //number of bins of the histogram used to locate the median
+
+struct imagestats {
+  double minimum;
+  double maximum;
+  double median;
+  double mean;
+  double sigma;
+  double skewness;
+  double kurtosis;
+  int    ngood;                        //number of values that are not NaN
+  int    nout;                         //number of values (not NaN) outside of [rangemin[k],rangemax[k]]
+};
+
+//rangemin and rangemax may be NULL (nout is then 0)
+//returns 0, or the number of images without any value that is not NaN (their statistics are NaN)
+int ImageStatistics(int nimages,float **images,int nColumns,int nRows,float X0,float Y0,double radius,double *rangemin,double *rangemax,struct imagestats *stats);
+
+#endif
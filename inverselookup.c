@@ -0,0 +1,124 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Inverse look-up tables for the MDI-like algorithm (see inverselookup.h)                 */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <omp.h>
+#include "inverselookup.h"
+
+
+//computes the inverse tables from the look-up tables lookupt of dimensions {2*ntest,nx,ny}
+//inverse must have room for 2*(NINVHEADER+ninv)*nx*ny floats
+//returns the number of nodes at which a table was not monotone (these nodes are flagged and not used by InverseBracket())
+int InverseLookup(float *lookupt,int ntest,int nx,int ny,double dvtest,int ninv,float *inverse)
+{
+  int node,coef,i,k,monotone;
+  int nonmonotone=0;
+  float *table,*inv;
+  double pmin,pmax,scale,p;
+  double vtest[ntest];
+
+  //WARNING: MUST BE THE SAME AS IN lookup.c
+  for(i=0;i<ntest;++i) vtest[i] = dvtest*((double)i-((double)ntest-1.0)/2.0);
+
+#pragma omp parallel for default(none) reduction(+:nonmonotone) private(node,coef,i,k,monotone,table,inv,pmin,pmax,scale,p) shared(lookupt,inverse,ntest,nx,ny,ninv,vtest)
+  for(node=0;node<nx*ny;++node)
+    {
+      for(coef=0;coef<2;++coef)
+	{
+	  table = lookupt+(long)node*2*ntest+coef*ntest;
+	  inv   = inverse+(long)node*2*(NINVHEADER+ninv)+coef*(NINVHEADER+ninv);
+
+	  //the table must be non-decreasing and finite (NaN fails the test) for InverseBracket() to use it
+	  monotone = isfinite(table[0]) ? 1 : 0;
+	  for(i=1;i<ntest && monotone;++i) if(!(table[i] >= table[i-1]) || !isfinite(table[i])) monotone=0;
+	  if(!monotone) nonmonotone+=1;
+
+	  pmin  = (double)table[0];
+	  pmax  = (double)table[ntest-1];
+	  scale = (monotone && pmax > pmin) ? (double)(ninv-1)/(pmax-pmin) : 0.0;
+	  inv[0]= (float)pmin;
+	  inv[1]= (float)pmax;
+	  inv[2]= (float)scale;
+	  inv[3]= (float)monotone;
+
+	  //the returned velocities p of the uniform grid are increasing: we walk along the table only once
+	  //as in Dopplergram(), we use the first interval [table[i],table[i+1]] that brackets p
+	  i=0;
+	  for(k=0;k<ninv;++k)
+	    {
+	      if(scale == 0.0)
+		{
+		  inv[NINVHEADER+k]=(float)vtest[0];
+		  continue;
+		}
+	      p = pmin+(double)k/scale;
+	      while(i < ntest-2 && (double)table[i+1] < p) i++;
+	      if(table[i+1] != table[i]) inv[NINVHEADER+k]=(float)(vtest[i]+(p-(double)table[i])*(vtest[i+1]-vtest[i])/((double)table[i+1]-(double)table[i]));
+	      else inv[NINVHEADER+k]=(float)vtest[i];
+	    }
+	}
+    }
+
+  return nonmonotone;
+}
+
+
+//returns the input velocity corresponding to the returned velocity phase, for one node and one Fourier coefficient
+//(inverse points to the [pmin,pmax,scale,v...] block of that node and coefficient). Saturates at the ends of the table
+float InverseVelocity(float *inverse,int ninv,double phase)
+{
+  double x;
+  int k;
+
+  x = (phase-(double)inverse[0])*(double)inverse[2];
+  if(x <= 0.0)              return inverse[NINVHEADER];
+  if(x >= (double)(ninv-1)) return inverse[NINVHEADER+ninv-1];
+  k = (int)x;
+  x = x-(double)k;
+
+  return inverse[NINVHEADER+k]+(float)x*(inverse[NINVHEADER+k+1]-inverse[NINVHEADER+k]);
+}
+
+
+//finds the interval [poly[k],poly[k+1]] of the look-up table interpolated at a pixel that brackets phase,
+//i.e. poly[k] <= phase < poly[k+1], and returns k (ntest+1 if there is none, or if k >= nscan: the scan of
+//Dopplergram() only covers the intervals below its last coarse step nscan)
+//t1..t4 are the look-up tables of one Fourier coefficient at the 4 neighbors, weighted by xa, xb, ya, and yb as in
+//Dopplergram(), inv1..inv4 the corresponding inverse tables (ninv values each). poly[0] and poly[ntest-1] must already be computed.
+//poly[k] and poly[k+1] are computed here with the same expression as in Dopplergram(), so that the result is the same as
+//with the scan of the look-up tables: the inverse tables only provide the first guess of k.
+//Only valid if the 4 tables are flagged monotone and the 4 weights are >= 0 (the interpolated table is then non-decreasing)
+int InverseBracket(float *inv1,float *inv2,float *inv3,float *inv4,float *t1,float *t2,float *t3,float *t4,float xa,float xb,float ya,float yb,int ninv,int ntest,int nscan,double *vtest,double phase,float *poly)
+{
+  double guess;
+  int k;
+
+  if(!(phase >= (double)poly[0] && phase < (double)poly[ntest-1])) return ntest+1;
+
+  guess = ya*(InverseVelocity(inv1,ninv,phase)*xa+InverseVelocity(inv2,ninv,phase)*xb)+yb*(InverseVelocity(inv3,ninv,phase)*xa+InverseVelocity(inv4,ninv,phase)*xb);
+  guess = floor((guess-vtest[0])/(vtest[1]-vtest[0]));
+  if(guess < 0.0)                  k = 0;
+  else if(guess > (double)(ntest-2)) k = ntest-2;
+  else                             k = (int)guess;
+
+  poly[k]=ya*(t1[k]*xa+t2[k]*xb)+yb*(t3[k]*xa+t4[k]*xb);
+  while(k > 0 && (double)poly[k] > phase)
+    {
+      k--;
+      poly[k]=ya*(t1[k]*xa+t2[k]*xb)+yb*(t3[k]*xa+t4[k]*xb);
+    }
+  poly[k+1]=ya*(t1[k+1]*xa+t2[k+1]*xb)+yb*(t3[k+1]*xa+t4[k+1]*xb);
+  while(k < ntest-2 && (double)poly[k+1] <= phase)
+    {
+      k++;
+      poly[k+1]=ya*(t1[k+1]*xa+t2[k+1]*xb)+yb*(t3[k+1]*xa+t4[k+1]*xb);
+    }
+
+  if(k >= nscan || (double)poly[k] > phase || (double)poly[k+1] <= phase) return ntest+1;
+  return k;
+}
@@ -0,0 +1,32 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Inverse look-up tables for the MDI-like algorithm                                       */
+/* used by lookup.c (to produce them) and by Dopplergram.c (to use them)                   */
+/*                                                                                         */
+/* the look-up tables give, at each node of the 256x256 grid, the velocities returned by   */
+/* the MDI-like algorithm (phases of the 1st and 2nd Fourier coefficients) as a function   */
+/* of the ntest input velocities vtest. The inverse tables give the input velocity as a    */
+/* function of the returned velocity, sampled on a uniform grid between the returned       */
+/* velocities at vtest[0] and vtest[ntest-1]. Dopplergram() still inverts the look-up      */
+/* table interpolated at the pixel, but InverseBracket() uses the inverse tables to guess  */
+/* the interval of the table that brackets the returned velocity, instead of scanning the  */
+/* ntest values: the velocities are the same as with the scan                              */
+/*                                                                                         */
+/* FORMAT: float array of dimensions {2*(NINVHEADER+ninv),nx,ny}; at each node, for the    */
+/* 1st and then the 2nd Fourier coefficient:                                               */
+/* [pmin, pmax, (ninv-1)/(pmax-pmin), monotone, v[0], ..., v[ninv-1]]                      */
+/* monotone is 1 if the look-up table of the node is non-decreasing (and finite), 0 if not */
+/* THE PIXELS NEXT TO A NODE THAT IS NOT MONOTONE ARE INVERTED WITH THE SCAN               */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#ifndef INVERSELOOKUP_H
+#define INVERSELOOKUP_H
+
+#define NINVHEADER 4                   //pmin, pmax, scale factor of the uniform grid, and monotone flag
+
+int   InverseLookup(float *lookupt,int ntest,int nx,int ny,double dvtest,int ninv,float *inverse);
+float InverseVelocity(float *inverse,int ninv,double phase);
+int   InverseBracket(float *inv1,float *inv2,float *inv3,float *inv4,float *t1,float *t2,float *t3,float *t4,float xa,float xb,float ya,float yb,int ninv,int ntest,int nscan,double *vtest,double phase,float *poly);
+
+#endif
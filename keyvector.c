@@ -0,0 +1,170 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Keyword values of a whole record set read in one query (see keyvector.h)                */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "keyvector.h"
+
+static double *KeyVectorIds=NULL;      //record identifiers of the rows returned by the query, used by qsort()
+
+static int KeyVectorCompare(const void *a,const void *b)
+{
+  double x=KeyVectorIds[*(const int *)a],y=KeyVectorIds[*(const int *)b];
+  return (x > y) - (x < y);
+}
+
+
+//reads the keywords names[0..nkeys-1] of the records of query, in the order of the records of recset
+//returns 0 if the values were read in one query, 1 if they will be read record by record
+int KeyVectorRead(DRMS_Env_t *env,const char *query,DRMS_RecordSet_t *recset,int nkeys,const char **names,struct keyvector *keys)
+{
+  DRMS_Array_t *arr=NULL;
+  char   *keylist=NULL;
+  double *data=NULL,*id=NULL;
+  int    *row=NULL,*sorted=NULL;
+  int     i,k,lo,hi,mid,nrows,status=0,length=0,result=1;
+
+  keys->nkeys =nkeys;
+  keys->names =names;
+  keys->nrecs =recset->n;
+  keys->values=NULL;
+
+  for(k=0;k<nkeys;++k) length+=strlen(names[k])+1;
+  keylist=(char *)malloc(length*sizeof(char));
+  if(keylist == NULL)
+    {
+      printf("Error: memory could not be allocated to keylist\n");
+      return 1;
+    }
+  strcpy(keylist,names[0]);
+  for(k=1;k<nkeys;++k)
+    {
+      strcat(keylist,",");
+      strcat(keylist,names[k]);
+    }
+
+  arr=drms_record_getvector(env,query,keylist,DRMS_TYPE_DOUBLE,0,&status);
+  free(keylist);
+  if(status != DRMS_SUCCESS || arr == NULL || arr->axis[0] != nkeys || arr->axis[1] != recset->n)
+    {
+      printf("Warning: the keywords of the query %s could not be read in one query, they are read record by record\n",query);
+      if(arr != NULL) drms_free_array(arr);
+      return 1;
+    }
+  nrows=arr->axis[1];
+  data =arr->data;
+
+  //MATCH THE ROWS OF THE QUERY TO THE RECORDS OF recset WITH THE KEYWORD names[0]
+  id    =(double *)malloc(recset->n*sizeof(double));
+  row   =(int *)malloc(recset->n*sizeof(int));
+  sorted=(int *)malloc(nrows*sizeof(int));
+  keys->values=(double *)malloc((long)nkeys*recset->n*sizeof(double));
+  if(id == NULL || row == NULL || sorted == NULL || keys->values == NULL)
+    {
+      printf("Error: memory could not be allocated to the keyword vectors\n");
+      goto done;
+    }
+
+  for(i=0;i<recset->n;++i)
+    {
+      id[i]=drms_getkey_double(recset->records[i],names[0],&status);
+      if(status != DRMS_SUCCESS || isnan(id[i])) goto done;
+    }
+
+  for(i=0;i<recset->n;++i) if(data[i] != id[i]) break;
+  if(i == recset->n) for(i=0;i<recset->n;++i) row[i]=i;                //the query returned the rows in the order of the records
+  else
+    {
+      for(i=0;i<nrows;++i) sorted[i]=i;
+      KeyVectorIds=data;
+      qsort(sorted,nrows,sizeof(int),KeyVectorCompare);
+      for(i=1;i<nrows;++i) if(data[sorted[i]] == data[sorted[i-1]]) goto done;  //names[0] does not identify the records
+      for(i=0;i<recset->n;++i)
+	{
+	  lo=0;
+	  hi=nrows-1;
+	  while(lo < hi)
+	    {
+	      mid=(lo+hi)/2;
+	      if(data[sorted[mid]] < id[i]) lo=mid+1; else hi=mid;
+	    }
+	  if(data[sorted[lo]] != id[i]) goto done;
+	  row[i]=sorted[lo];
+	}
+    }
+
+  for(k=0;k<nkeys;++k) for(i=0;i<recset->n;++i) keys->values[k*recset->n+i]=data[k*nrows+row[i]];
+  result=0;
+  printf("KEYWORDS OF %d RECORDS READ IN ONE QUERY\n",recset->n);
+
+ done:
+  if(result != 0)
+    {
+      printf("Warning: the keywords of the query %s could not be matched to its records, they are read record by record\n",query);
+      free(keys->values);
+      keys->values=NULL;
+    }
+  free(id);
+  free(row);
+  free(sorted);
+  drms_free_array(arr);
+
+  return result;
+}
+
+
+int KeyVectorInt(struct keyvector *keys,int key,DRMS_RecordSet_t *recset,int rec,int *status)
+{
+  double value;
+
+  if(keys->values == NULL) return drms_getkey_int(recset->records[rec],keys->names[key],status);
+
+  *status=DRMS_SUCCESS;
+  value=keys->values[key*keys->nrecs+rec];
+  if(isnan(value)) return DRMS_MISSING_INT;
+  if(value < -2147483648.0 || value > 2147483647.0)
+    {
+      *status=1;
+      return DRMS_MISSING_INT;
+    }
+  return (int)value;
+}
+
+
+float KeyVectorFloat(struct keyvector *keys,int key,DRMS_RecordSet_t *recset,int rec,int *status)
+{
+  if(keys->values == NULL) return drms_getkey_float(recset->records[rec],keys->names[key],status);
+
+  *status=DRMS_SUCCESS;
+  return (float)keys->values[key*keys->nrecs+rec];
+}
+
+
+double KeyVectorDouble(struct keyvector *keys,int key,DRMS_RecordSet_t *recset,int rec,int *status)
+{
+  if(keys->values == NULL) return drms_getkey_double(recset->records[rec],keys->names[key],status);
+
+  *status=DRMS_SUCCESS;
+  return keys->values[key*keys->nrecs+rec];
+}
+
+
+TIME KeyVectorTime(struct keyvector *keys,int key,DRMS_RecordSet_t *recset,int rec,int *status)
+{
+  if(keys->values == NULL) return drms_getkey_time(recset->records[rec],keys->names[key],status);
+
+  *status=DRMS_SUCCESS;
+  return (TIME)keys->values[key*keys->nrecs+rec];
+}
+
+
+void KeyVectorFree(struct keyvector *keys)
+{
+  free(keys->values);
+  keys->values=NULL;
+}
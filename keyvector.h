@@ -0,0 +1,39 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Keyword values of a whole record set read in one query, used by HMI_observables.c,      */
+/* HMI_IQUV_averaging.c, and correction_velocities.c                                       */
+/*                                                                                         */
+/* KeyVectorRead() reads the numerical keywords names[0..nkeys-1] of all the records of    */
+/* the query with one call to drms_record_getvector(), and stores them in contiguous       */
+/* arrays ordered like the records of recset (the record set opened with the same query).  */
+/* names[0] must identify each record uniquely (e.g. FSN): it is the only keyword read     */
+/* record by record, to match the rows returned by the query to the records of recset      */
+/*                                                                                         */
+/* if the query fails or its rows do not match the records of recset, the values are left  */
+/* unset and KeyVectorInt(), KeyVectorFloat(), KeyVectorDouble(), and KeyVectorTime() fall */
+/* back on drms_getkey_*() for each record, so that the caller can use them in both cases  */
+/* a keyword read from the vector always returns a status DRMS_SUCCESS, except an integer  */
+/* keyword out of the range of an int, which returns DRMS_MISSING_INT and a status 1       */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#ifndef KEYVECTOR_H
+#define KEYVECTOR_H
+
+#include "drms.h"
+
+struct keyvector {
+  int           nkeys;
+  const char  **names;                 //names of the keywords (names[0] identifies the records)
+  int           nrecs;
+  double       *values;                //values[key*nrecs+rec], NULL if the keywords are read record by record
+};
+
+int    KeyVectorRead(DRMS_Env_t *env,const char *query,DRMS_RecordSet_t *recset,int nkeys,const char **names,struct keyvector *keys);
+int    KeyVectorInt(struct keyvector *keys,int key,DRMS_RecordSet_t *recset,int rec,int *status);
+float  KeyVectorFloat(struct keyvector *keys,int key,DRMS_RecordSet_t *recset,int rec,int *status);
+double KeyVectorDouble(struct keyvector *keys,int key,DRMS_RecordSet_t *recset,int rec,int *status);
+TIME   KeyVectorTime(struct keyvector *keys,int key,DRMS_RecordSet_t *recset,int rec,int *status);
+void   KeyVectorFree(struct keyvector *keys);
+
+#endif
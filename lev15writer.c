@@ -0,0 +1,321 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Asynchronous write of the level 1.5 segments (see lev15writer.h)                        */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "drms.h"
+#include "lev15writer.h"
+#include "segmentio.h"
+
+
+//writer thread: writes the queued segments, in the order of the requests
+static void *Lev15WriterThread(void *arg)
+{
+  struct lev15writer *writer=(struct lev15writer *)arg;
+  struct lev15write *slot;
+  int i,status;
+
+  pthread_mutex_lock(&writer->mutex);
+  while(1)
+    {
+      slot=NULL;
+      for(i=0;i<writer->nslots;++i) if(writer->slots[i].state == WRITER_QUEUED && (slot == NULL || writer->slots[i].order < slot->order)) slot=&writer->slots[i];
+      if(slot == NULL)
+	{
+	  if(writer->quit) break;
+	  pthread_cond_wait(&writer->cond,&writer->mutex);
+	  continue;
+	}
+      slot->state=WRITER_WRITING;
+      pthread_mutex_unlock(&writer->mutex);
+
+      status=SegmentWrite(slot->segment,slot->array);
+      if(status != DRMS_SUCCESS) printf("Error: a call to drms_segment_write failed\n");
+
+      pthread_mutex_lock(&writer->mutex);
+      slot->status=status;
+      if(slot->keep == 0)
+	{
+	  if(status != DRMS_SUCCESS) writer->failed=1;
+	  if(writer->npool < writer->nslots) writer->pool[writer->npool++]=slot->array;   //kept for the next target time
+	  else drms_free_array(slot->array);
+	}
+      slot->array=NULL;
+      slot->state=WRITER_FREE;
+      pthread_cond_broadcast(&writer->cond);
+    }
+  pthread_mutex_unlock(&writer->mutex);
+
+  return NULL;
+}
+
+
+//starts the writer thread with a buffer of nslots segments (nslots=0: no writer thread)
+//returns 1 if the thread or the buffer cannot be created
+int Lev15WriterStart(struct lev15writer *writer,int nslots)
+{
+  memset(writer,0,sizeof(struct lev15writer));
+  if(nslots <= 0) return 0;
+
+  writer->slots =(struct lev15write *)calloc(nslots,sizeof(struct lev15write));
+  writer->pool  =(DRMS_Array_t **)calloc(nslots,sizeof(DRMS_Array_t *));
+  writer->closes=(struct lev15close *)calloc(nslots+1,sizeof(struct lev15close));
+  if(writer->slots == NULL || writer->pool == NULL || writer->closes == NULL)
+    {
+      printf("Error: memory could not be allocated to the slots of the writer buffer\n");
+      free(writer->slots);
+      free(writer->pool);
+      free(writer->closes);
+      memset(writer,0,sizeof(struct lev15writer));
+      return 1;
+    }
+  writer->maxcloses=nslots+1;
+  writer->nslots=nslots;
+  pthread_mutex_init(&writer->mutex,NULL);
+  pthread_cond_init(&writer->cond,NULL);
+  if(pthread_create(&writer->thread,NULL,Lev15WriterThread,writer) != 0)
+    {
+      printf("Error: the writer thread could not be created\n");
+      pthread_mutex_destroy(&writer->mutex);
+      pthread_cond_destroy(&writer->cond);
+      free(writer->slots);
+      free(writer->pool);
+      free(writer->closes);
+      memset(writer,0,sizeof(struct lev15writer));
+      return 1;
+    }
+
+  return 0;
+}
+
+
+//returns an array of type type and dimensions axis[0]xaxis[1]: an array already written if one is available, a new one otherwise
+//as with drms_array_create(), the values of the array are not initialized
+DRMS_Array_t *Lev15WriterArray(struct lev15writer *writer,DRMS_Type_t type,int *axis,int *status)
+{
+  DRMS_Array_t *array=NULL;
+  int i;
+
+  if(writer->nslots > 0)
+    {
+      pthread_mutex_lock(&writer->mutex);
+      for(i=0;i<writer->npool;++i) if(writer->pool[i]->type == type && writer->pool[i]->naxis == 2 && writer->pool[i]->axis[0] == axis[0] && writer->pool[i]->axis[1] == axis[1])
+	{
+	  array=writer->pool[i];
+	  writer->pool[i]=writer->pool[--writer->npool];
+	  break;
+	}
+      pthread_mutex_unlock(&writer->mutex);
+      if(array != NULL)
+	{
+	  *status=DRMS_SUCCESS;
+	  return array;
+	}
+    }
+
+  return drms_array_create(type,2,axis,NULL,status);
+}
+
+
+//queues the write of array in segment (keep=1: the array stays the caller's) and returns its slot
+//waits for a free slot if the buffer is full. Returns NULL if the storage unit of the record cannot be located
+static struct lev15write *Lev15WriterSlot(struct lev15writer *writer,DRMS_Segment_t *segment,DRMS_Array_t *array,int keep)
+{
+  struct lev15write *slot;
+  char path[DRMS_MAXPATHLEN];
+  int i;
+
+  if(drms_record_directory(segment->record,path,0) != DRMS_SUCCESS)                  //storage unit of the record, located by the main thread
+    {
+      printf("Error: the storage unit of a record cannot be located\n");
+      return NULL;
+    }
+
+  pthread_mutex_lock(&writer->mutex);
+  while(1)
+    {
+      slot=NULL;
+      for(i=0;i<writer->nslots;++i) if(writer->slots[i].state == WRITER_FREE)
+	{
+	  slot=&writer->slots[i];
+	  break;
+	}
+      if(slot != NULL) break;
+      pthread_cond_wait(&writer->cond,&writer->mutex);                                //buffer full
+    }
+  slot->segment=segment;
+  slot->array  =array;
+  slot->keep   =keep;
+  slot->status =DRMS_SUCCESS;
+  slot->order  =writer->order++;
+  slot->state  =WRITER_QUEUED;
+  pthread_cond_broadcast(&writer->cond);
+  pthread_mutex_unlock(&writer->mutex);
+
+  return slot;
+}
+
+
+//hands array over to the writer thread, to be written in segment (the caller must not use array anymore)
+//waits for a free slot if the buffer is full
+//returns 1 if a write failed (this one, or a previous one), 0 otherwise
+int Lev15WriterQueue(struct lev15writer *writer,DRMS_Segment_t *segment,DRMS_Array_t *array)
+{
+  int status;
+
+  if(writer->nslots == 0)
+    {
+      status=SegmentWrite(segment,array);
+      drms_free_array(array);
+      if(status != DRMS_SUCCESS)
+	{
+	  printf("Error: a call to drms_segment_write failed\n");
+	  return 1;
+	}
+      return 0;
+    }
+
+  if(Lev15WriterSlot(writer,segment,array,0) == NULL)
+    {
+      drms_free_array(array);
+      return 1;
+    }
+
+  pthread_mutex_lock(&writer->mutex);
+  status=writer->failed;
+  pthread_mutex_unlock(&writer->mutex);
+
+  return status;
+}
+
+
+//writes array in segment with the writer thread, after the segments queued before it, and waits for the end of the write
+//(the array stays the caller's). Used for the level 1d and level 1p segments, so that all the segments are written by one thread
+//returns 1 if the write failed, 0 otherwise
+int Lev15WriterWrite(struct lev15writer *writer,DRMS_Segment_t *segment,DRMS_Array_t *array)
+{
+  struct lev15write *slot;
+  int status;
+
+  if(writer->nslots == 0) status=SegmentWrite(segment,array);
+  else
+    {
+      slot=Lev15WriterSlot(writer,segment,array,1);
+      if(slot == NULL) return 1;
+      pthread_mutex_lock(&writer->mutex);
+      while(slot->state != WRITER_FREE) pthread_cond_wait(&writer->cond,&writer->mutex);   //only the main thread queues: the slot is not reused meanwhile
+      status=slot->status;
+      pthread_mutex_unlock(&writer->mutex);
+    }
+  if(status != DRMS_SUCCESS)
+    {
+      printf("Error: a call to drms_segment_write failed\n");
+      return 1;
+    }
+
+  return 0;
+}
+
+
+//the record set records will be inserted by Lev15WriterCommit() once the segments queued until now are written
+void Lev15WriterClose(struct lev15writer *writer,DRMS_RecordSet_t *records)
+{
+  struct lev15close *temp;
+
+  if(writer->nslots == 0)
+    {
+      drms_close_records(records,DRMS_INSERT_RECORD);
+      return;
+    }
+
+  pthread_mutex_lock(&writer->mutex);
+  if(writer->ncloses == writer->maxcloses)
+    {
+      temp=(struct lev15close *)realloc(writer->closes,2*writer->maxcloses*sizeof(struct lev15close));
+      if(temp == NULL)
+	{
+	  pthread_mutex_unlock(&writer->mutex);
+	  Lev15WriterCommit(writer,1);                                                 //no room to defer the insertion: the writes are finished first
+	  drms_close_records(records,DRMS_INSERT_RECORD);
+	  return;
+	}
+      writer->closes=temp;
+      writer->maxcloses*=2;
+    }
+  writer->closes[writer->ncloses].order  =writer->order;
+  writer->closes[writer->ncloses].records=records;
+  writer->ncloses+=1;
+  pthread_mutex_unlock(&writer->mutex);
+}
+
+
+//inserts, in order, the record sets whose segments are written (wait=1: waits until all the queued segments are written and all the record sets inserted)
+//returns 1 if a write failed, 0 otherwise
+int Lev15WriterCommit(struct lev15writer *writer,int wait)
+{
+  DRMS_RecordSet_t *records;
+  long oldest;
+  int  i,busy,failed;
+
+  if(writer->nslots == 0) return 0;
+
+  pthread_mutex_lock(&writer->mutex);
+  while(1)
+    {
+      busy=0;
+      oldest=writer->order;                                                            //order of the oldest segment not written yet
+      for(i=0;i<writer->nslots;++i) if(writer->slots[i].state != WRITER_FREE)
+	{
+	  busy=1;
+	  if(writer->slots[i].order < oldest) oldest=writer->slots[i].order;
+	}
+      if(writer->ncloses > 0 && writer->closes[0].order <= oldest)
+	{
+	  records=writer->closes[0].records;
+	  writer->ncloses-=1;
+	  memmove(writer->closes,writer->closes+1,writer->ncloses*sizeof(struct lev15close));
+	  pthread_mutex_unlock(&writer->mutex);
+	  drms_close_records(records,DRMS_INSERT_RECORD);                              //the DRMS library is only called by the main thread
+	  pthread_mutex_lock(&writer->mutex);
+	  continue;
+	}
+      if(!wait || (!busy && writer->ncloses == 0)) break;
+      pthread_cond_wait(&writer->cond,&writer->mutex);
+    }
+  failed=writer->failed;
+  pthread_mutex_unlock(&writer->mutex);
+
+  return failed;
+}
+
+
+//writes the queued segments, inserts the remaining record sets, and stops the writer thread
+//returns 1 if a write failed, 0 otherwise
+int Lev15WriterStop(struct lev15writer *writer)
+{
+  int i,failed;
+
+  if(writer->nslots == 0) return 0;
+
+  failed=Lev15WriterCommit(writer,1);
+  pthread_mutex_lock(&writer->mutex);
+  writer->quit=1;
+  pthread_cond_broadcast(&writer->cond);
+  pthread_mutex_unlock(&writer->mutex);
+  pthread_join(writer->thread,NULL);
+
+  for(i=0;i<writer->npool;++i) drms_free_array(writer->pool[i]);
+  pthread_mutex_destroy(&writer->mutex);
+  pthread_cond_destroy(&writer->cond);
+  free(writer->slots);
+  free(writer->pool);
+  free(writer->closes);
+  memset(writer,0,sizeof(struct lev15writer));
+
+  return failed;
+}
@@ -0,0 +1,81 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Asynchronous write of the level 1.5 segments, used by HMI_observables.c                 */
+/*                                                                                         */
+/* Lev15WriterQueue() hands an array over to a background thread, which writes it in its   */
+/* segment (drms_segment_write(): scaling by BSCALE and BZERO, compression, and write of   */
+/* the file) while the main thread computes the observables of the next target time. The   */
+/* buffer has nslots slots: Lev15WriterQueue() waits for a free slot when it is full       */
+/*                                                                                         */
+/* a record set given to Lev15WriterClose() is inserted (drms_close_records()) by the main */
+/* thread, in Lev15WriterCommit(), once all the segments queued before it are written, so  */
+/* that the records are inserted in the order of the target times. The written arrays are  */
+/* kept (at most nslots of them) and reused by Lev15WriterArray() for the next target time */
+/*                                                                                         */
+/* THE WRITER THREAD DOES NOT OPEN, CREATE, OR CLOSE RECORDS: the storage unit of a        */
+/* segment is located by the main thread in Lev15WriterQueue(), and the records are closed */
+/* by the main thread. The writer thread only calls drms_segment_write() (through          */
+/* SegmentWrite())                                                                         */
+/*                                                                                         */
+/* ALL THE SEGMENTS OF HMI_observables ARE WRITTEN BY THE WRITER THREAD: the level 1d and  */
+/* level 1p segments too, with Lev15WriterWrite(), which queues the write after the ones   */
+/* already queued and waits for its end (the array stays the caller's): the main thread    */
+/* waits for the level 1d and level 1p writes. DRMS and cfitsio are not assumed to be      */
+/* reentrant: the writes, and the reads of the other threads (see lev1prefetch.h), go      */
+/* through SegmentRead() and SegmentWrite() of segmentio.h, which serialize them with one  */
+/* lock (only the scaling and the conversion of an array are done outside the lock, not    */
+/* its compression)                                                                        */
+/*                                                                                         */
+/* with nslots=0 there is no writer thread: the segments are written and the records       */
+/* closed immediately, by the caller                                                       */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#ifndef LEV15WRITER_H
+#define LEV15WRITER_H
+
+#include <pthread.h>
+#include "drms.h"
+
+#define WRITER_FREE    0               //slot not used
+#define WRITER_QUEUED  1               //write requested, but not started
+#define WRITER_WRITING 2               //being written by the writer thread
+
+struct lev15write {
+  int             state;
+  long            order;               //the slots are written in the order of the requests
+  int             keep;                //1 if the array stays the caller's (Lev15WriterWrite()), 0 if it belongs to the writer
+  int             status;              //status of drms_segment_write()
+  DRMS_Segment_t *segment;
+  DRMS_Array_t   *array;
+};
+
+struct lev15close {
+  long              order;             //order of the requests at the time of Lev15WriterClose()
+  DRMS_RecordSet_t *records;
+};
+
+struct lev15writer {
+  int                nslots;           //0 if there is no writer thread
+  struct lev15write *slots;
+  int                ncloses,maxcloses;
+  struct lev15close *closes;           //record sets waiting for the end of the writes queued before them
+  int                npool;
+  DRMS_Array_t     **pool;             //written arrays, reused by Lev15WriterArray()
+  long               order;
+  int                failed;           //1 if a call to drms_segment_write() failed
+  int                quit;
+  pthread_t          thread;
+  pthread_mutex_t    mutex;
+  pthread_cond_t     cond;
+};
+
+int           Lev15WriterStart(struct lev15writer *writer,int nslots);
+DRMS_Array_t *Lev15WriterArray(struct lev15writer *writer,DRMS_Type_t type,int *axis,int *status);
+int           Lev15WriterQueue(struct lev15writer *writer,DRMS_Segment_t *segment,DRMS_Array_t *array);
+int           Lev15WriterWrite(struct lev15writer *writer,DRMS_Segment_t *segment,DRMS_Array_t *array);
+void          Lev15WriterClose(struct lev15writer *writer,DRMS_RecordSet_t *records);
+int           Lev15WriterCommit(struct lev15writer *writer,int wait);
+int           Lev15WriterStop(struct lev15writer *writer);
+
+#endif
@@ -0,0 +1,279 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Asynchronous read of the level 1 filtergrams (see lev1prefetch.h)                       */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "drms.h"
+#include "lev1prefetch.h"
+#include "segmentio.h"
+
+
+//frees the arrays of a slot
+static void Lev1SlotFree(struct lev1slot *slot)
+{
+  if(slot->image != NULL) drms_free_array(slot->image);
+  if(slot->badpixels != NULL) drms_free_array(slot->badpixels);
+  if(slot->cosmicrays != NULL) drms_free_array(slot->cosmicrays);
+  if(slot->ierror != NULL) drms_free_array(slot->ierror);
+  slot->image=NULL;
+  slot->badpixels=NULL;
+  slot->cosmicrays=NULL;
+  slot->ierror=NULL;
+}
+
+
+//prefetch thread: reads (and prepares) the queued filtergrams, in the order of the requests
+static void *Lev1PrefetchThread(void *arg)
+{
+  struct lev1prefetch *prefetch=(struct lev1prefetch *)arg;
+  struct lev1slot *slot;
+  DRMS_Array_t *image,*badpixels;
+  int statusimage,statusbad;
+  int i;
+
+  pthread_mutex_lock(&prefetch->mutex);
+  while(1)
+    {
+      slot=NULL;
+      for(i=0;i<prefetch->nslots;++i) if(prefetch->slots[i].state == PREFETCH_QUEUED && (slot == NULL || prefetch->slots[i].order < slot->order)) slot=&prefetch->slots[i];
+      if(slot == NULL)
+	{
+	  if(prefetch->quit) break;
+	  pthread_cond_wait(&prefetch->cond,&prefetch->mutex);
+	  continue;
+	}
+      slot->state=PREFETCH_READING;
+      pthread_mutex_unlock(&prefetch->mutex);
+
+      badpixels=NULL;
+      statusbad=DRMS_SUCCESS;
+      image=SegmentRead(slot->segimage,prefetch->type,&statusimage);            //the -32768 become NAN
+      if(statusimage == DRMS_SUCCESS && image != NULL) badpixels=SegmentRead(slot->segbad,slot->segbad->info->type,&statusbad);
+
+      //the main thread only changes the discard flag of a slot being read: the arrays can be filled without the mutex
+      slot->image=image;
+      slot->badpixels=badpixels;
+      slot->statusimage=statusimage;
+      slot->statusbad=statusbad;
+      slot->statusprepare=0;
+      if(prefetch->prepare != NULL && statusimage == DRMS_SUCCESS && image != NULL && statusbad == DRMS_SUCCESS && badpixels != NULL) slot->statusprepare=prefetch->prepare(slot,prefetch->data);
+
+      pthread_mutex_lock(&prefetch->mutex);
+      if(slot->discard)
+	{
+	  Lev1SlotFree(slot);
+	  slot->discard=0;
+	  slot->state=PREFETCH_FREE;
+	}
+      else slot->state=PREFETCH_READY;
+      pthread_cond_broadcast(&prefetch->cond);
+    }
+  pthread_mutex_unlock(&prefetch->mutex);
+
+  return NULL;
+}
+
+
+//starts the prefetch thread with a buffer of nslots filtergrams (no prefetch if nslots <= 0)
+//type is the type into which the image segments are converted
+int Lev1PrefetchStart(struct lev1prefetch *prefetch,int nslots,DRMS_Type_t type)
+{
+  prefetch->nslots=0;
+  prefetch->slots =NULL;
+  prefetch->type  =type;
+  prefetch->order =0;
+  prefetch->quit  =0;
+  prefetch->stage  =NULL;
+  prefetch->prepare=NULL;
+  prefetch->data   =NULL;
+  if(nslots <= 0) return 0;
+
+  prefetch->slots=(struct lev1slot *)calloc(nslots,sizeof(struct lev1slot));
+  if(prefetch->slots == NULL)
+    {
+      printf("Error: memory could not be allocated to the slots of the prefetch buffer\n");
+      return 1;
+    }
+  prefetch->nslots=nslots;
+  pthread_mutex_init(&prefetch->mutex,NULL);
+  pthread_cond_init(&prefetch->cond,NULL);
+  if(pthread_create(&prefetch->thread,NULL,Lev1PrefetchThread,prefetch) != 0)
+    {
+      printf("Error: the prefetch thread could not be created\n");
+      pthread_mutex_destroy(&prefetch->mutex);
+      pthread_cond_destroy(&prefetch->cond);
+      free(prefetch->slots);
+      prefetch->slots =NULL;
+      prefetch->nslots=0;
+      return 1;
+    }
+
+  return 0;
+}
+
+
+//sets the stage and prepare functions (see lev1prefetch.h), with their data (call before the first Lev1PrefetchQueue())
+void Lev1PrefetchPrepare(struct lev1prefetch *prefetch,int (*stage)(struct lev1slot *,DRMS_Record_t *,void *),int (*prepare)(struct lev1slot *,void *),void *data)
+{
+  prefetch->stage  =stage;
+  prefetch->prepare=prepare;
+  prefetch->data   =data;
+}
+
+
+//requests the read of the filtergrams list[next], list[next+1], ..., list[n-1] (record indices in records), as long as there are free slots
+//returns the position in list of the first filtergram not requested (n if they all were)
+//a filtergram whose segments cannot be located or staged, or whose stage function fails, is not requested: its read by the caller will report the error
+int Lev1PrefetchQueue(struct lev1prefetch *prefetch,int *list,int n,int next,DRMS_RecordSet_t *records)
+{
+  struct lev1slot *slot;
+  DRMS_Segment_t *segimage,*segbad;
+  char path[DRMS_MAXPATHLEN];
+  int i,present;
+
+  if(prefetch->nslots == 0) return n;
+
+  for(;next<n;++next)
+    {
+      pthread_mutex_lock(&prefetch->mutex);
+      slot=NULL;
+      present=0;
+      for(i=0;i<prefetch->nslots;++i)
+	{
+	  if(prefetch->slots[i].state != PREFETCH_FREE && prefetch->slots[i].index == list[next] && !prefetch->slots[i].discard) present=1;
+	  if(prefetch->slots[i].state == PREFETCH_FREE && slot == NULL) slot=&prefetch->slots[i];
+	}
+      pthread_mutex_unlock(&prefetch->mutex);
+      if(present) continue;
+      if(slot == NULL) break;                                                          //buffer full
+
+      //the thread only uses FREE slots after they are QUEUED: the slot can be filled without the mutex
+      segimage=drms_segment_lookupnum(records->records[list[next]],0);                 //the image is the first segment of the level 1 filtergram
+      segbad  =drms_segment_lookup(records->records[list[next]],"bad_pixel_list");
+      if(segimage == NULL || segbad == NULL) continue;
+      if(drms_record_directory(records->records[list[next]],path,1) != DRMS_SUCCESS) continue; //staging of the storage unit, by the main thread
+      slot->index     =list[next];
+      slot->image     =NULL;
+      slot->badpixels =NULL;
+      slot->cosmicrays=NULL;
+      slot->ierror    =NULL;
+      slot->quality   =0;
+      if(prefetch->stage != NULL && prefetch->stage(slot,records->records[list[next]],prefetch->data) != 0)
+	{
+	  Lev1SlotFree(slot);
+	  continue;
+	}
+
+      pthread_mutex_lock(&prefetch->mutex);
+      slot->discard  =0;
+      slot->order    =prefetch->order++;
+      slot->segimage =segimage;
+      slot->segbad   =segbad;
+      slot->state    =PREFETCH_QUEUED;
+      pthread_cond_broadcast(&prefetch->cond);
+      pthread_mutex_unlock(&prefetch->mutex);
+    }
+
+  return next;
+}
+
+
+//frees the slots of the filtergrams that are not in list[0..n-1] (the ones being read are freed at the end of their read)
+void Lev1PrefetchRetain(struct lev1prefetch *prefetch,int *list,int n)
+{
+  struct lev1slot *slot;
+  int i,k;
+
+  if(prefetch->nslots == 0) return;
+
+  pthread_mutex_lock(&prefetch->mutex);
+  for(i=0;i<prefetch->nslots;++i)
+    {
+      slot=&prefetch->slots[i];
+      if(slot->state == PREFETCH_FREE) continue;
+      for(k=0;k<n;++k) if(list[k] == slot->index) break;
+      if(k < n)
+	{
+	  slot->discard=0;
+	  continue;
+	}
+      if(slot->state == PREFETCH_READING) slot->discard=1;
+      else
+	{
+	  Lev1SlotFree(slot);
+	  slot->state=PREFETCH_FREE;
+	}
+    }
+  pthread_mutex_unlock(&prefetch->mutex);
+}
+
+
+//hands over the slot of the filtergram of record index index (copied into frame), waiting for the end of its read if needed
+//returns 1 if it was read by the prefetch thread (the caller then owns the arrays of frame, and the statuses are those of drms_segment_read())
+//returns 0 if the filtergram was not requested, or if its read has not started yet (the caller reads it itself, while the thread reads the next one)
+int Lev1PrefetchGet(struct lev1prefetch *prefetch,int index,struct lev1slot *frame)
+{
+  struct lev1slot *slot=NULL;
+  int i;
+
+  if(prefetch->nslots == 0) return 0;
+
+  pthread_mutex_lock(&prefetch->mutex);
+  for(i=0;i<prefetch->nslots;++i) if(prefetch->slots[i].state != PREFETCH_FREE && prefetch->slots[i].index == index && !prefetch->slots[i].discard)
+    {
+      slot=&prefetch->slots[i];
+      break;
+    }
+  if(slot == NULL || slot->state == PREFETCH_QUEUED)
+    {
+      if(slot != NULL)
+	{
+	  Lev1SlotFree(slot);                                                          //list of cosmic-ray hits read by the stage function
+	  slot->state=PREFETCH_FREE;
+	}
+      pthread_mutex_unlock(&prefetch->mutex);
+      return 0;
+    }
+  while(slot->state != PREFETCH_READY) pthread_cond_wait(&prefetch->cond,&prefetch->mutex);
+
+  *frame=*slot;
+  slot->image=NULL;
+  slot->badpixels=NULL;
+  slot->cosmicrays=NULL;
+  slot->ierror=NULL;
+  slot->state=PREFETCH_FREE;
+  pthread_mutex_unlock(&prefetch->mutex);
+
+  return 1;
+}
+
+
+//stops the prefetch thread (the queued reads are cancelled) and frees the filtergrams that were not handed over
+void Lev1PrefetchStop(struct lev1prefetch *prefetch)
+{
+  int i;
+
+  if(prefetch->nslots == 0) return;
+
+  pthread_mutex_lock(&prefetch->mutex);
+  prefetch->quit=1;
+  for(i=0;i<prefetch->nslots;++i) if(prefetch->slots[i].state == PREFETCH_QUEUED)
+    {
+      Lev1SlotFree(&prefetch->slots[i]);
+      prefetch->slots[i].state=PREFETCH_FREE;
+    }
+  pthread_cond_broadcast(&prefetch->cond);
+  pthread_mutex_unlock(&prefetch->mutex);
+  pthread_join(prefetch->thread,NULL);
+
+  for(i=0;i<prefetch->nslots;++i) if(prefetch->slots[i].state == PREFETCH_READY) Lev1SlotFree(&prefetch->slots[i]);
+  pthread_mutex_destroy(&prefetch->mutex);
+  pthread_cond_destroy(&prefetch->cond);
+  free(prefetch->slots);
+  prefetch->slots =NULL;
+  prefetch->nslots=0;
+}
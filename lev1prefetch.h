@@ -0,0 +1,79 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Asynchronous read of the level 1 filtergrams, used by HMI_observables.c                 */
+/*                                                                                         */
+/* a background thread reads in advance (image segment and bad_pixel_list segment) the     */
+/* level 1 filtergrams requested by Lev1PrefetchQueue(), into a bounded buffer of nslots   */
+/* slots, while the main thread gapfills, interpolates, and computes the observables.      */
+/* Lev1PrefetchGet() hands over the arrays of a filtergram (waiting for the end of its     */
+/* read if needed); it returns 0 if the filtergram was not requested, in which case the    */
+/* caller reads it itself                                                                  */
+/*                                                                                         */
+/* THE PREFETCH THREAD DOES NOT TALK TO THE DRMS SERVER OR TO SUMS: the segments are       */
+/* looked up and the storage units are staged by the main thread in Lev1PrefetchQueue(),   */
+/* so that the thread only reads and decompresses files                                    */
+/*                                                                                         */
+/* the segments are read with SegmentRead() of segmentio.h: the reads of the prefetch      */
+/* thread and of the main thread, and the writes of the main thread and of the writer      */
+/* thread (see lev15writer.h), are serialized with one lock, since DRMS and cfitsio are    */
+/* not assumed to be reentrant                                                             */
+/*                                                                                         */
+/* optionally (Lev1PrefetchPrepare()), the caller provides a stage function, called by the */
+/* main thread when a filtergram is requested (e.g. to read its list of cosmic-ray hits),  */
+/* and a prepare function, called by the prefetch thread after the read (e.g. to correct,  */
+/* mask, and gapfill the filtergram). The filtergrams of the next target times are then    */
+/* prepared while the main thread finishes the current one. The prepare function must not  */
+/* call the DRMS library, except to create and free arrays                                 */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#ifndef LEV1PREFETCH_H
+#define LEV1PREFETCH_H
+
+#include <pthread.h>
+#include "drms.h"
+
+#define PREFETCH_FREE    0             //slot not used
+#define PREFETCH_QUEUED  1             //read requested, but not started
+#define PREFETCH_READING 2             //being read by the prefetch thread
+#define PREFETCH_READY   3             //read, waiting for Lev1PrefetchGet()
+
+struct lev1slot {
+  int             index;               //record index of the filtergram
+  int             state;
+  int             discard;             //1 if the filtergram is not needed anymore (freed at the end of its read)
+  long            order;               //the slots are read in the order of the requests
+  DRMS_Segment_t *segimage;
+  DRMS_Segment_t *segbad;
+  DRMS_Array_t   *image;
+  DRMS_Array_t   *badpixels;
+  DRMS_Array_t   *cosmicrays;          //set by the stage function (list of cosmic-ray hits)
+  DRMS_Array_t   *ierror;              //set by the prepare function (NULL if the filtergram was not prepared)
+  int             statusimage;         //status of drms_segment_read() for the image
+  int             statusbad;           //status of drms_segment_read() for the list of bad pixels
+  int             statusprepare;       //status returned by the prepare function
+  int             quality;             //QUALITY bits set by the stage and prepare functions
+};
+
+struct lev1prefetch {
+  int              nslots;             //0 if there is no prefetch thread
+  struct lev1slot *slots;
+  DRMS_Type_t      type;               //type of the image arrays
+  long             order;
+  int              quit;
+  pthread_t        thread;
+  pthread_mutex_t  mutex;
+  pthread_cond_t   cond;
+  int            (*stage)(struct lev1slot *slot,DRMS_Record_t *record,void *data);   //called by the main thread (NULL=none)
+  int            (*prepare)(struct lev1slot *slot,void *data);                       //called by the prefetch thread (NULL=none)
+  void            *data;
+};
+
+int  Lev1PrefetchStart(struct lev1prefetch *prefetch,int nslots,DRMS_Type_t type);
+void Lev1PrefetchPrepare(struct lev1prefetch *prefetch,int (*stage)(struct lev1slot *,DRMS_Record_t *,void *),int (*prepare)(struct lev1slot *,void *),void *data);
+int  Lev1PrefetchQueue(struct lev1prefetch *prefetch,int *list,int n,int next,DRMS_RecordSet_t *records);
+void Lev1PrefetchRetain(struct lev1prefetch *prefetch,int *list,int n);
+int  Lev1PrefetchGet(struct lev1prefetch *prefetch,int index,struct lev1slot *frame);
+void Lev1PrefetchStop(struct lev1prefetch *prefetch);
+
+#endif
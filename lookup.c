@@ -11,6 +11,8 @@
 /* version 3.1 JANUARY 2012                                                                                 */
 /* version 3.2 DECEMBER 2013: support for larger crop radii                                                 */
 /* version 3.3 January 2014: added calibration 13 effective at retune January 15, 2014                      */
+/* version 3.4: the intensities for all the test velocities are computed at once by FFT correlation         */
+/* version 3.5: also produces the inverse look-up tables (segment "inverse"), if the output series has one  */
 /*                                                                                                          */
 /* ASSUMPTION FOR THE LINE PROFILES: they are linear in theta, the angle from disk center                   */
 /*                                                                                                          */
@@ -37,9 +39,16 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <complex.h>   //must be included before fftw3.h so that fftw_complex is the C99 complex type
 #include <omp.h>
+#include <fftw3.h>     //FFTW, for the correlation of the filter profiles with the solar line
 #include <HMIparam.h>  //contains the FSRs of the HMI filter elements
+#include "filterbasis.h"//precomputed cos/sin basis for the filter transmission profiles
+#include "inverselookup.h" //inverse look-up tables for Dopplergram()
+
+#undef I               //I is the complex number (0,1) in complex.h
 
 char *module_name    = "lookup";      //name of the module
 
@@ -130,6 +139,110 @@ double simpson(double *x,double *y,int N)
 } 
 
 
+/*-----------------------------------------------------------------------------*/
+/* FFT-based correlation engine                                                */
+/* BECAUSE dlam=dvtest*dlamdv, THE INTENSITY inten[j] OBSERVED THROUGH FILTER j */
+/* FOR ALL THE TEST VELOCITIES IS A DISCRETE CROSS-CORRELATION OF THE FILTER   */
+/* (RESTRICTED TO [maxshiftlam,nlam-maxshiftlam[) WITH THE SOLAR LINE PROFILE: */
+/* inten[j](shiftlam)=sum_k filters[j][k]*lineprofile[k-shiftlam]             */
+/* WE COMPUTE IT FOR ALL THE 2*maxshiftlam+1 SHIFTS WITH 1 FORWARD AND 1       */
+/* BACKWARD FFT PER FILTER (PLUS 1 FORWARD FFT OF THE LINE PROFILE PER PIXEL)  */
+/* THE FFTW PLANS ARE CREATED ONCE, AND EACH OPENMP THREAD HAS ITS OWN ARRAYS  */
+/*-----------------------------------------------------------------------------*/
+
+struct correlation {
+  int nlam;                //number of wavelength points of the filters and of the line profile
+  int maxshiftlam;         //maximum shift of the line profile (in wavelength points)
+  int nfft;                //size of the FFTs (>= nlam, so that there is no wrap-around)
+  int nthreads;            //number of OpenMP threads
+  double **work;           //real work arrays of size nfft, one per thread
+  fftw_complex **line;     //FFT of the line profile, one per thread
+  fftw_complex **filter;   //FFT of the filter profile, one per thread
+  fftw_plan forward;       //r2c plan of size nfft
+  fftw_plan backward;      //c2r plan of size nfft
+};
+
+//returns 0 if the engine was initialized, 1 otherwise
+int correlation_init(struct correlation *corr,int nlam,int maxshiftlam,int nthreads)
+{
+  int i;
+
+  corr->nlam       = nlam;
+  corr->maxshiftlam= maxshiftlam;
+  corr->nthreads   = nthreads;
+  corr->nfft       = 1;
+  while(corr->nfft < nlam) corr->nfft*=2;
+
+  corr->work  = (double **)malloc(nthreads*sizeof(double *));
+  corr->line  = (fftw_complex **)malloc(nthreads*sizeof(fftw_complex *));
+  corr->filter= (fftw_complex **)malloc(nthreads*sizeof(fftw_complex *));
+  if(corr->work == NULL || corr->line == NULL || corr->filter == NULL) return 1;
+
+  for(i=0;i<nthreads;++i)
+    {
+      corr->work[i]  = (double *)fftw_malloc(corr->nfft*sizeof(double));
+      corr->line[i]  = (fftw_complex *)fftw_malloc((corr->nfft/2+1)*sizeof(fftw_complex));
+      corr->filter[i]= (fftw_complex *)fftw_malloc((corr->nfft/2+1)*sizeof(fftw_complex));
+      if(corr->work[i] == NULL || corr->line[i] == NULL || corr->filter[i] == NULL) return 1;
+    }
+
+  //the plans are created outside of the OpenMP loop (fftw_plan_* is not thread safe), and executed on the arrays of each thread with fftw_execute_dft_*
+  corr->forward = fftw_plan_dft_r2c_1d(corr->nfft,corr->work[0],corr->line[0],FFTW_MEASURE);
+  corr->backward= fftw_plan_dft_c2r_1d(corr->nfft,corr->filter[0],corr->work[0],FFTW_MEASURE);
+  if(corr->forward == NULL || corr->backward == NULL) return 1;
+
+  return 0;
+}
+
+//FFT of the line profile lineprofile[nlam] for thread tid
+void correlation_line(struct correlation *corr,int tid,double *lineprofile)
+{
+  double *work=corr->work[tid];
+
+  memcpy(work,lineprofile,corr->nlam*sizeof(double));
+  memset(work+corr->nlam,0,(corr->nfft-corr->nlam)*sizeof(double));
+  fftw_execute_dft_r2c(corr->forward,work,corr->line[tid]);
+}
+
+//inten[i] for the 2*maxshiftlam+1 shifts shiftlam=i-maxshiftlam (i.e. in the order of vtest) of the line profile last passed to correlation_line()
+void correlation_filter(struct correlation *corr,int tid,double *filter,double *inten)
+{
+  int i;
+  int width        = corr->nlam-2*corr->maxshiftlam;
+  double *work     = corr->work[tid];
+  fftw_complex *F  = corr->filter[tid];
+  fftw_complex *Lf = corr->line[tid];
+  double norm      = 1.0/(double)corr->nfft;
+
+  memcpy(work,filter+corr->maxshiftlam,width*sizeof(double));
+  memset(work+width,0,(corr->nfft-width)*sizeof(double));
+  fftw_execute_dft_r2c(corr->forward,work,F);
+
+  for(i=0;i<corr->nfft/2+1;++i) F[i] = conj(F[i])*Lf[i];   //correlation theorem
+  fftw_execute_dft_c2r(corr->backward,F,work);
+
+  //work[t] = sum_k filter[maxshiftlam+k]*lineprofile[k+t] with t=maxshiftlam-shiftlam
+  for(i=0;i<=2*corr->maxshiftlam;++i) inten[i] = work[2*corr->maxshiftlam-i]*norm;
+}
+
+void correlation_free(struct correlation *corr)
+{
+  int i;
+
+  fftw_destroy_plan(corr->forward);
+  fftw_destroy_plan(corr->backward);
+  for(i=0;i<corr->nthreads;++i)
+    {
+      fftw_free(corr->work[i]);
+      fftw_free(corr->line[i]);
+      fftw_free(corr->filter[i]);
+    }
+  free(corr->work);
+  free(corr->line);
+  free(corr->filter);
+}
+
+
 /*---------------------------------------------------------------------------------------------------------------------------*/
 /*                                                                                                                           */
 /*  MAIN PROGRAM                                                                                                             */
@@ -949,13 +1062,26 @@ int DoIt(void) {
   for(i=0;i<3;++i) cmich[i] = 2.0*M_PI/FSR[i];
 
   int maxshiftlam=round(vtest[ntest-1]*dlamdv/dlam);
+  double contrastL[4],phaseL[4],contrastT3[3],phaseT3[3]; //contrasts and phases of the non-tunable (E2 to E5) and tunable (NB, WB, E1) elements at a given pixel
+
+  struct filterbasis basis;                               //cos/sin of 2 pi/FSR*lam for each element: identical for all the pixels
+  if(filterbasis_init(&basis,lam,nlam,FSR) != 0) exit(EXIT_FAILURE);
+  double intens[N][ntest];        //intensities for all the test velocities, for each filter
+
+  struct correlation corr;
+  printf("Creating the FFT plans of the correlation engine\n");
+  if(2*maxshiftlam+1 != ntest || correlation_init(&corr,nlam,maxshiftlam,nthreads) != 0)
+    {
+      printf("Error: unable to initialize the correlation engine\n");
+      exit(EXIT_FAILURE);
+    }
 	      
   /***********************************************************************************************************/
   /*COMPUTE THE LOOK-UP TABLES FOR EACH PIXEL                                                                */
   /***********************************************************************************************************/
 
-  printf("Computing the look-up tables (can take a few hours or so on n02, with 8 threads)\n");
-#pragma omp parallel for default(none) private(location,iii,i,j,k,values,lineprofile,shiftlam,inten,filters,f1c,f1s,vel1,f2c,f2s,vel2,row,column,FWHM,minimum,wavelength2,lineprofile2,lyot,phaseE2,phaseE3,phaseE4,phaseE5,contrastE2,contrastE3,contrastE4,contrastE5,contrastNB,contrastWB,contrastE1,phaseNB,phaseWB,phaseE1) shared(FSR,blockerint,cosi,sini,cos2i,sin2i,distance,nx2,ny2,ntest,nlam,lam,vtest,dlam,dlamdv,wavelength,N,cmich,phases,pv1,pv2,vel,axisout,nelement,ydefault,minimumCoeffs,FWHMCoeffs,WRONGDISTANCE,BUFFERDISTANCE,HCME1phase,HCMWBphase,HCMNBphase,phaseNT,contrastNT,contrastT,maxshiftlam,wavelengthref,referencenlam,shiftw,solarradiusmax,NOMINALSCALE,templineref)
+  printf("Computing the look-up tables\n");
+#pragma omp parallel for default(none) private(contrastL,phaseL,contrastT3,phaseT3,location,iii,i,j,k,values,lineprofile,shiftlam,inten,intens,tid,filters,f1c,f1s,vel1,f2c,f2s,vel2,row,column,FWHM,minimum,wavelength2,lineprofile2,lyot,phaseE2,phaseE3,phaseE4,phaseE5,contrastE2,contrastE3,contrastE4,contrastE5,contrastNB,contrastWB,contrastE1,phaseNB,phaseWB,phaseE1) shared(basis,FSR,blockerint,cosi,sini,cos2i,sin2i,distance,nx2,ny2,ntest,nlam,lam,vtest,dlam,dlamdv,wavelength,N,cmich,phases,pv1,pv2,vel,axisout,nelement,ydefault,minimumCoeffs,FWHMCoeffs,WRONGDISTANCE,BUFFERDISTANCE,HCME1phase,HCMWBphase,HCMNBphase,phaseNT,contrastNT,contrastT,maxshiftlam,wavelengthref,referencenlam,shiftw,solarradiusmax,NOMINALSCALE,templineref,corr)
   for(iii=0;iii<nx2*ny2;++iii)
     {
       row   =iii / nx2; //nx2= number of columns
@@ -1077,13 +1203,19 @@ int DoIt(void) {
 	  //phaseE4+=shiftw*(FSR[5]/FSR[3])*FSR[5];
 	  //phaseE5+=shiftw*(FSR[6]/FSR[3])*FSR[6];
 	  
-	  for(j=0;j<nlam;++j) lyot[j]=blockerint[j]*(1.+contrastE2*cos(2.0*M_PI/FSR[3]*lam[j]+phaseE2))/2.*(1.+contrastE3*cos(2.0*M_PI/FSR[4]*lam[j]+phaseE3))/2.*(1.+contrastE4*cos(2.0*M_PI/FSR[5]*lam[j]+phaseE4))/2.*(1.+contrastE5*cos(2.0*M_PI/FSR[6]*lam[j]+phaseE5))/2.;
+	  //lyot[j]=blockerint[j]*(1.+contrastE2*cos(2.0*M_PI/FSR[3]*lam[j]+phaseE2))/2.*(1.+contrastE3*cos(2.0*M_PI/FSR[4]*lam[j]+phaseE3))/2.*(1.+contrastE4*cos(2.0*M_PI/FSR[5]*lam[j]+phaseE4))/2.*(1.+contrastE5*cos(2.0*M_PI/FSR[6]*lam[j]+phaseE5))/2.;
+	  contrastL[0]=contrastE2; contrastL[1]=contrastE3; contrastL[2]=contrastE4; contrastL[3]=contrastE5;
+	  phaseL[0]   =phaseE2;    phaseL[1]   =phaseE3;    phaseL[2]   =phaseE4;    phaseL[3]   =phaseE5;
+	  filterbasis_lyot(&basis,blockerint,contrastL,phaseL,lyot);
 	  
 
 	  //TUNABLE TRANSMISSION PROFILE
 	  for(i=0;i<N;i++) 
 	    {
-	      for(j=0;j<nlam;j++) filters[i][j] = lyot[j]*(1.+contrastNB*cos(cmich[0]*lam[j]+HCMNBphase[i]+phaseNB))/2.*(1.+contrastWB*cos(cmich[1]*lam[j]+HCMWBphase[i]+phaseWB))/2.*(1.+contrastE1*cos(cmich[2]*lam[j]-HCME1phase[i]+phaseE1))/2.;
+	      //filters[i][j] = lyot[j]*(1.+contrastNB*cos(cmich[0]*lam[j]+HCMNBphase[i]+phaseNB))/2.*(1.+contrastWB*cos(cmich[1]*lam[j]+HCMWBphase[i]+phaseWB))/2.*(1.+contrastE1*cos(cmich[2]*lam[j]-HCME1phase[i]+phaseE1))/2.;
+	      contrastT3[0]=contrastNB;             contrastT3[1]=contrastWB;             contrastT3[2]=contrastE1;
+	      phaseT3[0]   =HCMNBphase[i]+phaseNB;  phaseT3[1]   =HCMWBphase[i]+phaseWB;  phaseT3[2]   =-HCME1phase[i]+phaseE1;
+	      filterbasis_tunable(&basis,lyot,contrastT3,phaseT3,1.0,filters[i]);
 	    }
 
 	  //Computation of the norm of the filters
@@ -1098,19 +1230,17 @@ int DoIt(void) {
 
 
 
+	  //BECAUSE dlam=dvtest*dlamdv, WE DO NOT NEED TO INTERPOLATE BUT WE CAN JUST SHIFT THE SOLAR LINE FOR DIFFERENT DOPPLER VELOCITIES
+	  //THE INTENSITIES FOR ALL THE SHIFTS shiftlam=round(vtest[i]*dlamdv/dlam) ARE OBTAINED AT ONCE BY FFT CORRELATION
+	  //SIGN CONVENTION: POSITIVE VELOCITIES CORRESPOND TO REDSHIFT (MOVEMENTS AWAY FROM OBSERVER)
+	  tid=omp_get_thread_num();
+	  correlation_line(&corr,tid,lineprofile);
+	  for(j=0;j<N;j++) correlation_filter(&corr,tid,filters[j],intens[j]);
+
 	  //START LOOP OVER THE INPUT VELOCITIES
 	  for(i=0;i<ntest;i++)
 	    {
-
-	      //BECAUSE dlam=dvtest*dlamdv, WE DO NOT NEED TO INTERPOLATE BUT WE CAN JUST SHIFT THE SOLAR LINE FOR DIFFERENT DOPPLER VELOCITIES (SLOW, NEED TO OPTIMIZE)
-	      shiftlam=round(vtest[i]*dlamdv/dlam);//SIGN CONVENTION: POSITIVE VELOCITIES CORRESPOND TO REDSHIFT (MOVEMENTS AWAY FROM OBSERVER)    
- 
-	      for(j=0;j<N;j++)
-		{ 
-		  inten[j] = 0.;
-		  for(k=maxshiftlam;k<nlam-maxshiftlam;k++) inten[j] = inten[j]+filters[j][k]*lineprofile[k-shiftlam]; //shiftlam should correspond at the most to 154.44 mA (+7.5 km/s)
-		  //inten[j] = inten[j]/norm[j];
-		}
+	      for(j=0;j<N;j++) inten[j] = intens[j][i];
 
 
 	      //First and Second Fourier coefficients
@@ -1210,6 +1340,7 @@ int DoIt(void) {
   DRMS_RecordSet_t *dataout = NULL;
   DRMS_Record_t  *recout    = NULL;
   DRMS_Segment_t *segout    = NULL;
+  DRMS_Array_t   *arrinv    = NULL;                           //inverse look-up tables
 
   dataout = drms_create_records(drms_env,1,dsout,DRMS_PERMANENT,&status);
   
@@ -1263,12 +1394,32 @@ int DoIt(void) {
       segout = drms_segment_lookupnum(recout, 0);
       drms_segment_write(segout, arrout, 0);           //write the file containing look-up tables
 
+      //INVERSE LOOK-UP TABLES (velocity as a function of the returned velocity on a uniform grid), USED BY Dopplergram() TO LOCATE THE BRACKETS OF THE LOOK-UP TABLES
+      segout = drms_segment_lookup(recout,"inverse");
+      if(segout != NULL)
+	{
+	  int axisinv[3] = {2*(NINVHEADER+ntest),nx2,ny2};
+	  arrinv = drms_array_create(type,3,axisinv,NULL,&status);
+	  if(status != DRMS_SUCCESS)
+	    {
+	      printf("Error: unable to create array arrinv\n");
+	      exit(EXIT_FAILURE);
+	    }
+	  i = InverseLookup(vel,ntest,nx2,ny2,dvtest,ntest,arrinv->data);
+	  if(i != 0) printf("WARNING: the look-up tables are not monotone at %d nodes\n",i);
+	  drms_segment_write(segout, arrinv, 0);
+	  drms_free_array(arrinv);
+	}
+      else printf("WARNING: the output series has no segment inverse, the inverse look-up tables are not saved\n");
+
       //CLOSE RECORDS
       drms_close_records(dataout, DRMS_INSERT_RECORD); //insert the record in DRMS
     }
   
   drms_free_array(arrin);
   drms_free_array(arrout);
+  correlation_free(&corr);
+  filterbasis_free(&basis);
   free(cosi);
   free(sini);
   free(cos2i);
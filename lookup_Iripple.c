@@ -38,6 +38,7 @@
 #include <math.h>
 #include <omp.h>
 #include <HMIparam.h>  //contains the FSRs of the HMI filter elements
+#include "filterbasis.h"//precomputed cos/sin basis for the filter transmission profiles
 
 char *module_name    = "lookup_Iripple";      //name of the module
 
@@ -1152,13 +1153,17 @@ int DoIt(void) {
   for(i=0;i<3;++i) cmich[i] = 2.0*M_PI/FSR[i];
 
   int maxshiftlam=round(vtest[ntest-1]*dlamdv/dlam);
+  double contrastL[4],phaseL[4],contrastT3[3],phaseT3[3]; //contrasts and phases of the non-tunable (E2 to E5) and tunable (NB, WB, E1) elements at a given pixel
+
+  struct filterbasis basis;                               //cos/sin of 2 pi/FSR*lam for each element: identical for all the pixels
+  if(filterbasis_init(&basis,lam,nlam,FSR) != 0) exit(EXIT_FAILURE);
 	      
   /***********************************************************************************************************/
   /*COMPUTE THE LOOK-UP TABLES FOR EACH PIXEL                                                                */
   /***********************************************************************************************************/
 
   printf("Computing the look-up tables (can take a few hours or so on n02, with 8 threads)\n");
-#pragma omp parallel for default(none) private(location,iii,i,j,k,values,lineprofile,shiftlam,inten,filters,f1c,f1s,vel1,f2c,f2s,vel2,row,column,FWHM,minimum,wavelength2,lineprofile2,lyot,phaseE2,phaseE3,phaseE4,phaseE5,contrastE2,contrastE3,contrastE4,contrastE5,contrastNB,contrastWB,contrastE1,phaseNB,phaseWB,phaseE1,IrippleNB,IrippleWB,IrippleE1) shared(FSR,blockerint,cosi,sini,cos2i,sin2i,distance,nx2,ny2,ntest,nlam,lam,vtest,dlam,dlamdv,wavelength,N,cmich,phases,pv1,pv2,vel,axisout,nelement,ydefault,minimumCoeffs,FWHMCoeffs,WRONGDISTANCE,BUFFERDISTANCE,HCME1phase,HCMWBphase,HCMNBphase,phaseNT,contrastNT,contrastT,maxshiftlam,wavelengthref,referencenlam,solarradiusmax,NOMINALSCALE,templineref,initK1,initK2,initK3,initK4,initK5,initK6,initialE1,initialWB,initialNB)
+#pragma omp parallel for default(none) private(contrastL,phaseL,contrastT3,phaseT3,location,iii,i,j,k,values,lineprofile,shiftlam,inten,filters,f1c,f1s,vel1,f2c,f2s,vel2,row,column,FWHM,minimum,wavelength2,lineprofile2,lyot,phaseE2,phaseE3,phaseE4,phaseE5,contrastE2,contrastE3,contrastE4,contrastE5,contrastNB,contrastWB,contrastE1,phaseNB,phaseWB,phaseE1,IrippleNB,IrippleWB,IrippleE1) shared(basis,FSR,blockerint,cosi,sini,cos2i,sin2i,distance,nx2,ny2,ntest,nlam,lam,vtest,dlam,dlamdv,wavelength,N,cmich,phases,pv1,pv2,vel,axisout,nelement,ydefault,minimumCoeffs,FWHMCoeffs,WRONGDISTANCE,BUFFERDISTANCE,HCME1phase,HCMWBphase,HCMNBphase,phaseNT,contrastNT,contrastT,maxshiftlam,wavelengthref,referencenlam,solarradiusmax,NOMINALSCALE,templineref,initK1,initK2,initK3,initK4,initK5,initK6,initialE1,initialWB,initialNB)
   for(iii=0;iii<nx2*ny2;++iii)
     {
       row   =iii / nx2; //nx2= number of columns
@@ -1227,7 +1232,10 @@ int DoIt(void) {
 	  phaseWB+=0.59*M_PI/180.;
 	  phaseE1+=-3.27*M_PI/180.;
 	  
-	  for(j=0;j<nlam;++j) lyot[j]=blockerint[j]*(1.+contrastE2*cos(2.0*M_PI/FSR[3]*lam[j]+phaseE2))/2.*(1.+contrastE3*cos(2.0*M_PI/FSR[4]*lam[j]+phaseE3))/2.*(1.+contrastE4*cos(2.0*M_PI/FSR[5]*lam[j]+phaseE4))/2.*(1.+contrastE5*cos(2.0*M_PI/FSR[6]*lam[j]+phaseE5))/2.;
+	  //lyot[j]=blockerint[j]*(1.+contrastE2*cos(2.0*M_PI/FSR[3]*lam[j]+phaseE2))/2.*(1.+contrastE3*cos(2.0*M_PI/FSR[4]*lam[j]+phaseE3))/2.*(1.+contrastE4*cos(2.0*M_PI/FSR[5]*lam[j]+phaseE4))/2.*(1.+contrastE5*cos(2.0*M_PI/FSR[6]*lam[j]+phaseE5))/2.;
+	  contrastL[0]=contrastE2; contrastL[1]=contrastE3; contrastL[2]=contrastE4; contrastL[3]=contrastE5;
+	  phaseL[0]   =phaseE2;    phaseL[1]   =phaseE3;    phaseL[2]   =phaseE4;    phaseL[3]   =phaseE5;
+	  filterbasis_lyot(&basis,blockerint,contrastL,phaseL,lyot);
 	  
 
 	  //TUNABLE TRANSMISSION PROFILE
@@ -1239,7 +1247,10 @@ int DoIt(void) {
 	      IrippleWB       = ( 1.0 + (initK3*cos((HCMWBphase[i]+initialWB)/2.0) +initK4*sin((HCMWBphase[i]+initialWB)/2.0)) *(initK3*cos((HCMWBphase[i]+initialWB)/2.0)+initK4*sin((HCMWBphase[i]+initialWB)/2.0))  );
 	      IrippleNB       = ( 1.0 + (initK5*cos((HCMNBphase[i]+initialNB)/2.0) +initK6*sin((HCMNBphase[i]+initialNB)/2.0)) *(initK5*cos((HCMNBphase[i]+initialNB)/2.0)+initK6*sin((HCMNBphase[i]+initialNB)/2.0))  );
 	      
-	      for(j=0;j<nlam;j++) filters[i][j] = lyot[j]*(1.+contrastNB*cos(cmich[0]*lam[j]+HCMNBphase[i]+phaseNB))/2.*(1.+contrastWB*cos(cmich[1]*lam[j]+HCMWBphase[i]+phaseWB))/2.*(1.+contrastE1*cos(cmich[2]*lam[j]-HCME1phase[i]+phaseE1))/2.*IrippleE1*IrippleWB*IrippleNB;
+	      //filters[i][j] = lyot[j]*(1.+contrastNB*cos(cmich[0]*lam[j]+HCMNBphase[i]+phaseNB))/2.*(1.+contrastWB*cos(cmich[1]*lam[j]+HCMWBphase[i]+phaseWB))/2.*(1.+contrastE1*cos(cmich[2]*lam[j]-HCME1phase[i]+phaseE1))/2.*IrippleE1*IrippleWB*IrippleNB;
+	      contrastT3[0]=contrastNB;             contrastT3[1]=contrastWB;             contrastT3[2]=contrastE1;
+	      phaseT3[0]   =HCMNBphase[i]+phaseNB;  phaseT3[1]   =HCMWBphase[i]+phaseWB;  phaseT3[2]   =-HCME1phase[i]+phaseE1;
+	      filterbasis_tunable(&basis,lyot,contrastT3,phaseT3,IrippleE1*IrippleWB*IrippleNB,filters[i]);
 	    }
 
 
@@ -1450,6 +1461,7 @@ int DoIt(void) {
   
   drms_free_array(arrin);
   drms_free_array(arrout);
+  filterbasis_free(&basis);
   free(cosi);
   free(sini);
   free(cos2i);
@@ -0,0 +1,109 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Per-pixel core of the MDI-like algorithm, specialized for N = 5, 6, 8, and 10           */
+/* wavelengths (see mdikernel.h)                                                           */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <math.h>
+#include "mdikernel.h"
+
+
+//weights of the Fourier coefficients: cos(angle), sin(angle), cos(2*angle), and sin(2*angle)
+//N=5: tuning positions {+2,+1,+0,-1,-2}*dtune, angle=tune*2*M_PI/N (SAME AS IN Dopplergram())
+static const double MDIcos_5[5]={-0.80901699437494734,+0.30901699437494745,+1.00000000000000000,+0.30901699437494745,-0.80901699437494734};
+static const double MDIsin_5[5]={+0.58778525229247325,+0.95105651629515353,+0.00000000000000000,-0.95105651629515353,-0.58778525229247325};
+static const double MDIcos2_5[5]={+0.30901699437494723,-0.80901699437494734,+1.00000000000000000,-0.80901699437494734,+0.30901699437494723};
+static const double MDIsin2_5[5]={-0.95105651629515364,+0.58778525229247325,+0.00000000000000000,-0.58778525229247325,+0.95105651629515364};
+
+//N=6: tuning positions {+2.5,+1.5,+0.5,-0.5,-1.5,-2.5}*dtune, angle=tune*2*M_PI/N (SAME AS IN Dopplergram())
+static const double MDIcos_6[6]={-0.86602540378443871,+0.00000000000000000,+0.86602540378443871,+0.86602540378443871,+0.00000000000000000,-0.86602540378443871};
+static const double MDIsin_6[6]={+0.49999999999999994,+1.00000000000000000,+0.49999999999999994,-0.49999999999999994,-1.00000000000000000,-0.49999999999999994};
+static const double MDIcos2_6[6]={+0.50000000000000011,-1.00000000000000000,+0.50000000000000011,+0.50000000000000011,-1.00000000000000000,+0.50000000000000011};
+static const double MDIsin2_6[6]={-0.86602540378443860,+0.00000000000000000,+0.86602540378443860,-0.86602540378443860,+0.00000000000000000,+0.86602540378443860};
+
+//N=8: tuning positions {+2.5,+1.5,+0.5,-0.5,-1.5,-2.5,-3.5,+3.5}*dtune, angle=tune*2*M_PI/N (SAME AS IN Dopplergram())
+static const double MDIcos_8[8]={-0.38268343236508973,+0.38268343236508984,+0.92387953251128674,+0.92387953251128674,+0.38268343236508984,-0.38268343236508973,-0.92387953251128674,-0.92387953251128674};
+static const double MDIsin_8[8]={+0.92387953251128674,+0.92387953251128674,+0.38268343236508978,-0.38268343236508978,-0.92387953251128674,-0.92387953251128674,-0.38268343236508989,+0.38268343236508989};
+static const double MDIcos2_8[8]={-0.70710678118654768,-0.70710678118654746,+0.70710678118654757,+0.70710678118654757,-0.70710678118654746,-0.70710678118654768,+0.70710678118654735,+0.70710678118654735};
+static const double MDIsin2_8[8]={-0.70710678118654746,+0.70710678118654757,+0.70710678118654746,-0.70710678118654746,-0.70710678118654757,+0.70710678118654746,+0.70710678118654768,-0.70710678118654768};
+
+//N=10: tuning positions {+2.5,+1.5,+0.5,-0.5,-1.5,-2.5,-3.5,+3.5,-4.5,+4.5}*dtune, angle=tune*2*M_PI/N (SAME AS IN Dopplergram())
+static const double MDIcos_10[10]={+0.00000000000000000,+0.58778525229247314,+0.95105651629515353,+0.95105651629515353,+0.58778525229247314,+0.00000000000000000,-0.58778525229247303,-0.58778525229247303,-0.95105651629515353,-0.95105651629515353};
+static const double MDIsin_10[10]={+1.00000000000000000,+0.80901699437494745,+0.30901699437494740,-0.30901699437494740,-0.80901699437494745,-1.00000000000000000,-0.80901699437494745,+0.80901699437494745,-0.30901699437494751,+0.30901699437494751};
+static const double MDIcos2_10[10]={-1.00000000000000000,-0.30901699437494734,+0.80901699437494745,+0.80901699437494745,-0.30901699437494734,-1.00000000000000000,-0.30901699437494756,-0.30901699437494756,+0.80901699437494734,+0.80901699437494734};
+static const double MDIsin2_10[10]={+0.00000000000000000,+0.95105651629515364,+0.58778525229247314,-0.58778525229247314,-0.95105651629515364,+0.00000000000000000,+0.95105651629515353,-0.95105651629515353,+0.58778525229247336,-0.58778525229247336};
+
+
+//kernel for NW wavelengths: the loop over the pixels of the block is vectorized, the loop over the wavelengths is unrolled
+#define MDI_KERNEL(NW)                                                                          \
+static void MDIKernel##NW(float **lev1p,long start,int nblock,double pv1,double pv2,double block[MDI_NBLOCK][NPIXBLOCK]) \
+{                                                                                               \
+  int    i,k;                                                                                   \
+  float *L[NW],*R[NW];                                                                          \
+                                                                                                \
+  for(i=0;i<NW;++i)                                                                             \
+    {                                                                                           \
+      L[i]=lev1p[2*i]  +start;                                                                  \
+      R[i]=lev1p[2*i+1]+start;                                                                  \
+    }                                                                                           \
+                                                                                                \
+  _Pragma("omp simd private(i)")                                                                \
+  for(k=0;k<nblock;++k)                                                                         \
+    {                                                                                           \
+      double f1LCPc=0.0,f1RCPc=0.0,f1LCPs=0.0,f1RCPs=0.0;                                       \
+      double f2LCPc=0.0,f2RCPc=0.0,f2LCPs=0.0,f2RCPs=0.0;                                       \
+      double sumL=0.0,sumR=0.0,l,r;                                                             \
+                                                                                                \
+      for(i=0;i<NW;++i)                                                                         \
+	{                                                                                       \
+	  l       = (double)L[i][k];                                                            \
+	  r       = (double)R[i][k];                                                            \
+	  f1LCPc += MDIcos_##NW[i] *l;                                                          \
+	  f1RCPc += MDIcos_##NW[i] *r;                                                          \
+	  f1LCPs += MDIsin_##NW[i] *l;                                                          \
+	  f1RCPs += MDIsin_##NW[i] *r;                                                          \
+	  f2LCPc += MDIcos2_##NW[i]*l;                                                          \
+	  f2RCPc += MDIcos2_##NW[i]*r;                                                          \
+	  f2LCPs += MDIsin2_##NW[i]*l;                                                          \
+	  f2RCPs += MDIsin2_##NW[i]*r;                                                          \
+	  sumL   += l;                                                                          \
+	  sumR   += r;                                                                          \
+	}                                                                                       \
+                                                                                                \
+      block[MDI_F1LCPC][k]=f1LCPc;                                                              \
+      block[MDI_F1RCPC][k]=f1RCPc;                                                              \
+      block[MDI_F1LCPS][k]=f1LCPs;                                                              \
+      block[MDI_F1RCPS][k]=f1RCPs;                                                              \
+      block[MDI_F2LCPC][k]=f2LCPc;                                                              \
+      block[MDI_F2RCPC][k]=f2RCPc;                                                              \
+      block[MDI_F2LCPS][k]=f2LCPs;                                                              \
+      block[MDI_F2RCPS][k]=f2RCPs;                                                              \
+      block[MDI_SUML][k]  =sumL;                                                                \
+      block[MDI_SUMR][k]  =sumR;                                                                \
+      block[MDI_VLCP][k]  =atan2(-f1LCPs,-f1LCPc)*pv1/2.0/M_PI; /*-f1LCPs and -f1LCPc so that the jump is at 180 degrees and not 0 degrees*/ \
+      block[MDI_VRCP][k]  =atan2(-f1RCPs,-f1RCPc)*pv1/2.0/M_PI;                                 \
+      block[MDI_V2LCP][k] =atan2(-f2LCPs,-f2LCPc)*pv2/2.0/M_PI;                                 \
+      block[MDI_V2RCP][k] =atan2(-f2RCPs,-f2RCPc)*pv2/2.0/M_PI;                                 \
+    }                                                                                           \
+}
+
+MDI_KERNEL(5)
+MDI_KERNEL(6)
+MDI_KERNEL(8)
+MDI_KERNEL(10)
+
+
+//returns the kernel specialized for N wavelengths, or NULL if there is none
+MDIKernel MDISelectKernel(int N)
+{
+  switch(N)
+    {
+    case 5:  return MDIKernel5;
+    case 6:  return MDIKernel6;
+    case 8:  return MDIKernel8;
+    case 10: return MDIKernel10;
+    default: return NULL;
+    }
+}
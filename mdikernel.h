@@ -0,0 +1,43 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Per-pixel core of the MDI-like algorithm, specialized for N = 5, 6, 8, and 10           */
+/* wavelengths, used by Dopplergram.c                                                      */
+/*                                                                                         */
+/* a kernel computes, for nblock (<= NPIXBLOCK) adjacent pixels of a row, the First and    */
+/* Second Fourier coefficients of the LCP and RCP intensities, their phases (converted to  */
+/* velocities with pv1 and pv2), and the sums of the intensities                           */
+/* the cos/sin weights of each N are compile-time constants, so that the loop over the     */
+/* wavelengths is fully unrolled and all the accumulators stay in registers                */
+/*                                                                                         */
+/* lev1p: 2*N pointers to the level 1p filtergrams (LCP/RCP back-to-back, in the order     */
+/* I0, I1, I2, ...), start: index of the first pixel of the block (column+row*nColumns)    */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#ifndef MDIKERNEL_H
+#define MDIKERNEL_H
+
+#define NPIXBLOCK 16                   //maximum number of adjacent pixels processed by one call to a kernel
+
+//rows of the block returned by a kernel
+#define MDI_F1LCPC  0                  //First Fourier coefficients
+#define MDI_F1RCPC  1
+#define MDI_F1LCPS  2
+#define MDI_F1RCPS  3
+#define MDI_F2LCPC  4                  //Second Fourier coefficients
+#define MDI_F2RCPC  5
+#define MDI_F2LCPS  6
+#define MDI_F2RCPS  7
+#define MDI_SUML    8                  //sums of the intensities
+#define MDI_SUMR    9
+#define MDI_VLCP   10                  //phases of the Fourier coefficients, in velocity units
+#define MDI_VRCP   11
+#define MDI_V2LCP  12
+#define MDI_V2RCP  13
+#define MDI_NBLOCK 14
+
+typedef void (*MDIKernel)(float **lev1p,long start,int nblock,double pv1,double pv2,double block[MDI_NBLOCK][NPIXBLOCK]);
+
+MDIKernel MDISelectKernel(int N);      //returns NULL if N is not 5, 6, 8, or 10
+
+#endif
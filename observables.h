@@ -0,0 +1,21 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Selection of the level 1.5 observables produced by HMI_observables and Dopplergram()    */
+/*                                                                                         */
+/* each bit selects one observable, in the order of the arrays returned by Dopplergram()   */
+/* (arrLev15[0] to arrLev15[4]). The raw (uncorrected) Dopplergram arrLev15[5] is only     */
+/* used for the RAWMEDN keyword of the Dopplergram, so it is produced with the Dopplergram */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#ifndef OBSERVABLES_H
+#define OBSERVABLES_H
+
+#define LEV15_DOPPLERGRAM  0x1         //Dopplergram (and raw Dopplergram)
+#define LEV15_MAGNETOGRAM  0x2         //l.o.s. magnetogram
+#define LEV15_LINEDEPTH    0x4         //linedepth
+#define LEV15_LINEWIDTH    0x8         //linewidth
+#define LEV15_CONTINUUM    0x10        //continuum intensity
+#define LEV15_ALL          0x1F        //all the observables (default)
+
+#endif
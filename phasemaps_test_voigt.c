@@ -39,6 +39,7 @@
 #include <omp.h>                //Open MP header
 #include <fresize.h>            //from Jesper: to rebin the 4096x4096 images
 #include "interpol_code.h"      //from Richard, for de-rotation and gap-filling
+#include "cropmask.h"      //crop masks of the image configurations
 
 
 char *module_name    = "phasemaps_test_voigt";   //name of the module
@@ -115,6 +116,7 @@ void lininterp1f(double *yinterp, double *xv, double *yv, double *x, double ydef
 /* 0 means pixel not missing                                                                                        */
 /* 1 means pixel missing and needs to be filled                                                                     */
 /* 2 means pixel missing and does not need to be filled                                                             */
+/* the crop mask of each image configuration (HIMGCFID) is built only once per process, by CropMask() in cropmask.c */
 /*                                                                                                                  */
 /*------------------------------------------------------------------------------------------------------------------*/
 
@@ -125,17 +127,12 @@ int MaskCreation(unsigned char *Mask, int nx, int ny, DRMS_Array_t  *BadPixels,
 
   if(nx != 4096 || ny != 4096) return status; //the mask creation function only works on 4096x4096 images
 
-  char *filename="/home/production/img_cnfg_ids"; //image configuration ID file
-  const int minid   =80;
-  const int maxid   =124;
-  const int n_tables=1;
-  const int maxtab  =256;
-
   int *badpixellist=BadPixels->data; //ASSUMES THE PIXEL LIST IS IN INT
   int  nBadPixels=BadPixels->axis[0]; //number of bad pixels in the list
   printf("Number of bad pixels: %d\n",nBadPixels);
   int *cosmicraylist=NULL;
   int  ncosmic=0;
+
   if(CosmicRays != NULL)
     {
       cosmicraylist=CosmicRays->data;
@@ -145,274 +142,18 @@ int MaskCreation(unsigned char *Mask, int nx, int ny, DRMS_Array_t  *BadPixels,
 
   printf("Number of cosmic-ray hits: %d\n",ncosmic);
 
-  int x_orig,y_orig,x_dir,y_dir;
-  int skip, take, skip_x, skip_y;
-  int datum, nsx, nss, nlin,nq,nqq,nsy;
-  int idn=-1;
-  
-  int *id=NULL, *tab=NULL, *nrows=NULL, *ncols=NULL, *rowstr=NULL, *colstr=NULL, *config=NULL;
-  id    =(int *)(malloc(maxtab*sizeof(int)));
-  if(id == NULL)
-    {
-      printf("Error: memory could not be allocated to id\n");
-      exit(EXIT_FAILURE);
-    }
-  tab   =(int *)(malloc(maxtab*sizeof(int)));
-  if(tab == NULL)
-    {
-      printf("Error: memory could not be allocated to tab\n");
-      exit(EXIT_FAILURE);
-    }
-  nrows =(int *)(malloc(maxtab*sizeof(int)));
-  if(nrows == NULL)
-    {
-      printf("Error: memory could not be allocated to nrows\n");
-      exit(EXIT_FAILURE);
-    }
-  ncols =(int *)(malloc(maxtab*sizeof(int)));
-  if(ncols == NULL)
-    {
-      printf("Error: memory could not be allocated to ncols\n");
-      exit(EXIT_FAILURE);
-    }
-  rowstr=(int *)(malloc(maxtab*sizeof(int)));
-  if(rowstr == NULL)
-    {
-      printf("Error: memory could not be allocated to rowstr\n");
-      exit(EXIT_FAILURE);
-    }
-  colstr=(int *)(malloc(maxtab*sizeof(int)));
-  if(colstr == NULL)
-    {
-      printf("Error: memory could not be allocated to colstr\n");
-      exit(EXIT_FAILURE);
-    }
-  config=(int *)(malloc(maxtab*sizeof(int)));
-  if(config == NULL)
-    {
-      printf("Error: memory could not be allocated to config\n");
-      exit(EXIT_FAILURE);
-    }
-
-  int skipt[4*2048];
-  int taket[4*2048];
-
-  int **kx=NULL;
-  int *kkx=NULL;
-
-  kx=(int **)(malloc(9*sizeof(int *)));
-  if(kx == NULL)
-    {
-      printf("Error: memory could not be allocated to kx\n");
-      exit(EXIT_FAILURE);
-    }
-
-  //define different readout modes
-  int kx0[11]={4,0,0,1,0,1,1,0,1,1,1}; //EFGH
-  kx[0]=kx0;
-  int kx1[7]={2,1,0,1,1,1,2}; //FG
-  kx[2]=kx1;
-  int kx2[7]={2,0,1,0,0,1,2} ;//HE
-  kx[4]=kx2;
-  int kx3[7]={2,0,0,1,0,2,1}; //EF
-  kx[1]=kx3;
-  int kx4[7]={2,1,1,0,1,2,1}; //GH
-  kx[3]=kx4;
-  int kx5[7]={1,0,0,2,2}; //E
-  kx[5]=kx5;
-  int kx6[5]={1,1,0,2,2}; //F
-  kx[6]=kx6;
-  int kx7[5]={1,1,1,2,2}; //G
-  kx[7]=kx7;
-  int kx8[5]={1,0,1,2,2}; //H
-  kx[8]=kx8;
-
-  char **filename_table=NULL;
-  filename_table=(char **)(malloc(n_tables*sizeof(char *)));
-  if(filename_table == NULL)
-    {
-      printf("Error: memory could not be allocated to filename_table\n");
-      exit(EXIT_FAILURE);
-    }
-  
-  char *filename_croptable="/home/cvsuser/cvsroot/EGSE/tables/crop/crop6";
-  filename_table[0]=filename_croptable;
- 
-  int i,j,k;
-  int ix, jx;
-  int n_config;
-  char string[256];
-  char strng[5];
-
-
-  FILE *config_file=NULL;
-  FILE *crop_table=NULL;
-
-   
-  config_file=fopen(filename, "r");
-  
-  if (config_file != NULL){
-    fgets(string, 256, config_file);
-    fgets(string, 256, config_file);
-    fgets(string, 256, config_file);
-     
-
-    n_config=0;
-    fscanf(config_file, "%d", &datum);
-    id[n_config]=datum;
-
-    do {
-      
-      fscanf(config_file, "%s", string);
-      
-      config[n_config]=0; //default change
-      if (string[0] == '4')config[n_config]=0;
-      if (string[0] == '2') if (string[7] == 'E')config[n_config]=1;
-      if (string[0] == '2') if (string[7] == 'F')config[n_config]=2;
-      if (string[0] == '2') if (string[7] == 'G')config[n_config]=3;
-      if (string[0] == '2') if (string[7] == 'H')config[n_config]=4;
-      if (string[0] == '1') if (string[7] == 'E')config[n_config]=5;
-      if (string[0] == '1') if (string[7] == 'F')config[n_config]=6;
-      if (string[0] == '1') if (string[7] == 'G')config[n_config]=7;
-      if (string[0] == '1') if (string[7] == 'H')config[n_config]=8;
-
-
-      fscanf(config_file, "%s", string);
-      
-      fscanf(config_file, "%s", string);
-      
-      fscanf(config_file, "%s", string);
-      
-      if (string[0] == 'N') tab[n_config]=-1;
-      if (string[0] == 'c') tab[n_config]=0;
-
-      fscanf(config_file, "%s", string);
-	
-      fscanf(config_file, "%d", &datum);
-      
-      fscanf(config_file, "%d", &datum);
-      
-      fscanf(config_file, "%s", string);
-      
-      fscanf(config_file, "%d", &datum);
-      nrows[n_config]=datum;
-      
-      fscanf(config_file, "%d", &datum);
-      ncols[n_config]=datum;
-      
-      fscanf(config_file, "%d", &datum);
-      rowstr[n_config]=datum;
-      
-      fscanf(config_file, "%d", &datum);
-      colstr[n_config]=datum;
-      
-      fscanf(config_file, "%d", &datum);
-      
-      fscanf(config_file, "%d", &datum);
-      
-      
-      
-      ++n_config;
-      fscanf(config_file, "%d", &datum);
-      id[n_config]=datum;
-
-      
-      
-      //fgets(string, 256, config_file);
-    }
-    while (!feof(config_file) && n_config < maxtab);
-    
-    fclose(config_file);
-  }
-  
-  //printf("reading done\n");
-  
-  for (i=0; i<n_config; ++i) if (id[i] == HIMGCFID) idn=i;
-  
-  skip_x=ncols[idn]/2;
-  skip_y=nrows[idn]/2;
-  
-  //printf("skip %d %d\n", skip_x, skip_y);
+  const unsigned char *CropArea=NULL;
+  int k;
 
-  kkx=kx[config[idn]];
-  nq=kkx[0];
-  nlin=kkx[2*nq+3-2]*ny/2;
-  nss=kkx[2*nq+3-1]*nx/2;
-  
-  //printf("len %d %d %d\n", nlin, nss, nq);
-    
-  if (idn == -1)
-    {printf("Error: invalid HIMGCFID\n"); status=1;}
-  else
+  status=CropMask(HIMGCFID,nx,ny,&CropArea); //crop mask of the image configuration, built only once per process
+  if(status != 0) status=1;
+  if(status == 0)
     {
-      if (tab[idn] != -1)
-	{
-	  filename_croptable=filename_table[tab[idn]];
-	  crop_table=fopen(filename_croptable, "r");
-	  
-	  //for (k=0; k<23; ++k) 
-	  fscanf(crop_table, "%d", &datum); //read header
-	  
-	  fscanf(crop_table, "%d", &datum);
-	  fscanf(crop_table, "%d", &nqq);
-	  
-	  for (j=0; j<nqq; ++j)
-	    {
-	      fscanf(crop_table, "%d", &skip);
-	      fscanf(crop_table, "%d", &take);
-	      skipt[j]=skip;
-	      taket[j]=take;
-	    }
-	  
-	  fclose(crop_table);
-
-	}
-      else
-	{
-	  printf("no crop table\n");
-	  
-	  for (k=0; k<nq; ++k)
-	    for (j=0; j<nlin; ++j)
-	      {
-		skipt[k*nss+j]=0;
-		taket[k*nss+j]=nss;
-	      }
-	}
-      
-      nsx=nss-skip_x;
-      nsy=nlin-skip_y;
-      
-      
-      
-      for (k=0; k<nq; ++k)
-	{
-	  x_orig=kkx[k*2+1]*nx - kkx[k*2+1];
-	  y_orig=kkx[k*2+2]*ny - kkx[k*2+2];
-	  x_dir=-(kkx[k*2+1])*2+1;
-	  y_dir=-(kkx[k*2+2])*2+1;
-	  
-	  
-	  for (j=0; j<skip_y; ++j) for (i=0; i<nss; ++i) Mask[(y_orig+y_dir*j)*nx+x_orig+x_dir*i]=2;   //fill edge rows with NAN
-	  for (j=0; j<nlin; ++j) for (i=0; i<skip_x; ++i) Mask[(y_orig+y_dir*j)*nx+x_orig+x_dir*i]=2;  //fill edge columns with NAN
-	  
-	  
-	  for (j=0; j<nsy; ++j)
-	    {
-	      jx=j+skip_y;
-	      
-	      for (i=0; i<minval(skipt[k*nss+j],nss); ++i){ix=i+skip_x; Mask[(y_orig+y_dir*jx)*nx+x_orig+x_dir*ix]=2;} //pixel OUTSIDE THE CROP TABLE: missing but does not need to be filled
-	      for (i=skipt[k*nss+j]; i<minval(skipt[k*nss+j]+taket[k*nss+j],nss); ++i){ix=i+skip_x; Mask[(y_orig+y_dir*jx)*nx+x_orig+x_dir*ix]=0;} //pixel INSIDE THE CROP TABLE not missing and does not need to be filled
-	      for (i=(skipt[k*nss+j]+taket[k*nss+j]); i<nss; ++i){ix=i+skip_x; Mask[(y_orig+y_dir*jx)*nx+x_orig+x_dir*ix]=2;}
-	    }
-	}
- 
-      //NEED TO FILL THE NAN INSIDE THE CROP TABLE
+      //NEED TO FILL THE NANs INSIDE THE CROP TABLE
       for(k=0;k<nx*ny;++k)
 	{
-	  if(Mask[k] == 0)
-	    {
-	      if(isnan(image[k])) Mask[k] = 1;
-	    }
+	  Mask[k]=CropArea[k];
+	  if(Mask[k] == 0 && isnan(image[k])) Mask[k] = 1;
 	}
 
       //NEED TO FILL THE BAD PIXELS INSIDE THE CROP TABLE (FROM THE BAD PIXEL LIST)
@@ -425,6 +166,7 @@ int MaskCreation(unsigned char *Mask, int nx, int ny, DRMS_Array_t  *BadPixels,
 	    }
 	}
 
+
       //NEED TO CORRECT THE COSMIC-RAY HITS INSIDE THE CROP TABLE (FROM THE COSMIC RAY HIT LIST)
       if(ncosmic > 0)
 	{     
@@ -433,20 +175,8 @@ int MaskCreation(unsigned char *Mask, int nx, int ny, DRMS_Array_t  *BadPixels,
 	      if(Mask[cosmicraylist[k]] == 0) Mask[cosmicraylist[k]] = 1; //pixel not in the crop area and in the cosmic-ray hit list: needs to be filled
 	    }
 	}
-
-      status=0;
-      
     }
-  
-  free(id);
-  free(nrows);
-  free(ncols);
-  free(rowstr);
-  free(colstr);
-  free(config);
-  free(kx);
-  free(filename_table);
-  
+
   return status;
 }
 
@@ -0,0 +1,53 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Segment reads and writes of HMI_observables.c, shared by its threads (see segmentio.h)  */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#include <pthread.h>
+#include "drms.h"
+#include "segmentio.h"
+
+static pthread_mutex_t SegmentLock=PTHREAD_MUTEX_INITIALIZER;
+
+
+//drms_segment_read() of segment, converted to type, with the segment lock held
+DRMS_Array_t *SegmentRead(DRMS_Segment_t *segment,DRMS_Type_t type,int *status)
+{
+  DRMS_Array_t *array;
+
+  pthread_mutex_lock(&SegmentLock);
+  array=drms_segment_read(segment,type,status);
+  pthread_mutex_unlock(&SegmentLock);
+
+  return array;
+}
+
+
+//drms_segment_write() of array in segment, with the segment lock held
+//the array is first scaled by its BSCALE and BZERO and converted to the type of the segment, without the lock (this is what
+//drms_segment_write() would do first): only the compression and the write of the file are done with the lock held
+//returns the status of drms_segment_write()
+int SegmentWrite(DRMS_Segment_t *segment,DRMS_Array_t *array)
+{
+  DRMS_Array_t *raw=NULL;
+  int status;
+
+  if(array->israw == 0) raw=drms_array_convert(segment->info->type,-array->bzero/array->bscale,1.0/array->bscale,array); //physical to raw values
+  else if(array->type != segment->info->type) raw=drms_array_convert(segment->info->type,0.0,1.0,array);
+  if(raw != NULL)
+    {
+      raw->bzero =array->bzero;
+      raw->bscale=array->bscale;
+      raw->israw =1;
+    }
+  else raw=array;                                                    //raw values of the type of the segment already (or failed conversion, done again by drms_segment_write())
+
+  pthread_mutex_lock(&SegmentLock);
+  status=drms_segment_write(segment,raw,0);
+  pthread_mutex_unlock(&SegmentLock);
+
+  if(raw != array) drms_free_array(raw);
+
+  return status;
+}
@@ -0,0 +1,31 @@
+/*-----------------------------------------------------------------------------------------*/
+/*                                                                                         */
+/* Segment reads and writes of HMI_observables.c, shared by its threads                    */
+/*                                                                                         */
+/* the main thread, the prefetch thread (lev1prefetch.c), and the writer thread            */
+/* (lev15writer.c) read and write segments at the same time. Neither the DRMS library nor  */
+/* cfitsio is assumed to be reentrant: SegmentRead() and SegmentWrite() call               */
+/* drms_segment_read() and drms_segment_write() under one lock, so that only one thread at */
+/* a time is inside these functions. SegmentWrite() scales the array and converts it to    */
+/* the type of the segment before it takes the lock, but the compression is done by        */
+/* cfitsio inside drms_segment_write(), so it is serialized with the file write: a read of */
+/* the prefetch thread can wait for the compression and write of one segment. Only the     */
+/* computations of the threads (gapfilling, interpolation, observables) overlap the        */
+/* segment I/O, not the segment I/O of the other threads                                   */
+/*                                                                                         */
+/* ALL THE SEGMENT READS AND WRITES OF HMI_observables.c (AND OF THE MODULES IT USES) MUST */
+/* GO THROUGH THESE FUNCTIONS. The other calls to the DRMS library are made by the main    */
+/* thread only, and never on a record whose segment is being read or written by another    */
+/* thread                                                                                  */
+/*                                                                                         */
+/*-----------------------------------------------------------------------------------------*/
+
+#ifndef SEGMENTIO_H
+#define SEGMENTIO_H
+
+#include "drms.h"
+
+DRMS_Array_t *SegmentRead(DRMS_Segment_t *segment,DRMS_Type_t type,int *status);
+int           SegmentWrite(DRMS_Segment_t *segment,DRMS_Array_t *array);
+
+#endif